@@ -10,27 +10,181 @@
 # Example usage:
 # python3 convert.py kicker/build/bin/kicker.nib robot/lib/Inc/device-bins/kicker_bin.h KICKER_BYTES
 #
-# FPGA should be very similar
+# The FPGA bitstream is mostly runs of the same bytes, so it's stored
+# compressed and decompressed as it's sent to the FPGA:
+# python3 convert.py --compress fpga/build/robocup.nib robot/lib/Inc/device-bins/fpga_bin.h FPGA_BYTES
+#
+# Compressed data is an LZ4 block (lz4_Block_format.md in the LZ4 repo)
+# with match offsets limited to the window, so the decompressor only has
+# to keep that much of its output around. <buf_name>_LEN is the compressed
+# length, <buf_name>_DECOMPRESSED_LEN and <buf_name>_WINDOW are added.
+#
+# <buf_name>_GIT_HASH and <buf_name>_GIT_DIRTY identify the FPGA design,
+# so the robot can tell if it's already loaded. They're read from the
+# git_version.vh the FPGA was synthesized with:
+# python3 convert.py --compress --git-version fpga/build/git_version.vh fpga/build/robocup.nib robot/lib/Inc/device-bins/fpga_bin.h FPGA_BYTES
+# Without it the hash is 0 and the data is marked dirty, so it never matches.
 #
 
-import sys
+import argparse
+import re
 
-if len(sys.argv) != 4:
-	print("Usage: ./convert.py <input.bin> <output.h> <buf_name>")
-	exit(-1)
+MIN_MATCH = 4
+# LZ4 requires the last 5 bytes to be literals and the last match to
+# start at least 12 bytes from the end
+LAST_LITERALS = 5
+MATCH_FIND_LIMIT = 12
+MAX_CHAIN = 64
+
+
+def lz4_length(n):
+	out = bytearray()
+	while n >= 255:
+		out.append(255)
+		n -= 255
+	out.append(n)
+	return out
+
+
+def lz4_sequence(literals, offset, match_len):
+	out = bytearray()
+	lit_len = len(literals)
+	token = min(lit_len, 15) << 4
+	if offset is not None:
+		token |= min(match_len - MIN_MATCH, 15)
+	out.append(token)
+	if lit_len >= 15:
+		out += lz4_length(lit_len - 15)
+	out += literals
+	if offset is not None:
+		out += bytes([offset & 0xff, offset >> 8])
+		if match_len - MIN_MATCH >= 15:
+			out += lz4_length(match_len - MIN_MATCH - 15)
+	return out
+
+
+def lz4_compress(data, window):
+	out = bytearray()
+	chains = {}
+	literal_start = 0
+	pos = 0
+	match_limit = len(data) - MATCH_FIND_LIMIT
+
+	while pos < match_limit:
+		key = data[pos:pos + MIN_MATCH]
+		best_len = 0
+		best_offset = 0
+		candidates = chains.get(key, [])
+		for candidate in reversed(candidates[-MAX_CHAIN:]):
+			offset = pos - candidate
+			if offset > window:
+				break
+			length = MIN_MATCH
+			max_len = len(data) - LAST_LITERALS - pos
+			while length < max_len and data[candidate + length] == data[pos + length]:
+				length += 1
+			if length > best_len:
+				best_len = length
+				best_offset = offset
+
+		if best_len >= MIN_MATCH:
+			out += lz4_sequence(data[literal_start:pos], best_offset, best_len)
+			for i in range(pos, pos + best_len):
+				chains.setdefault(data[i:i + MIN_MATCH], []).append(i)
+			pos += best_len
+			literal_start = pos
+		else:
+			chains.setdefault(key, []).append(pos)
+			pos += 1
+
+	out += lz4_sequence(data[literal_start:], None, 0)
+	return bytes(out)
+
+
+def lz4_decompress(data):
+	out = bytearray()
+	pos = 0
+	while pos < len(data):
+		token = data[pos]
+		pos += 1
+		lit_len = token >> 4
+		if lit_len == 15:
+			while True:
+				lit_len += data[pos]
+				pos += 1
+				if data[pos - 1] != 255:
+					break
+		out += data[pos:pos + lit_len]
+		pos += lit_len
+		if pos == len(data):
+			break
+		offset = data[pos] | data[pos + 1] << 8
+		pos += 2
+		match_len = token & 0xf
+		if match_len == 15:
+			while True:
+				match_len += data[pos]
+				pos += 1
+				if data[pos - 1] != 255:
+					break
+		for _ in range(match_len + MIN_MATCH):
+			out.append(out[-offset])
+	return bytes(out)
+
+
+parser = argparse.ArgumentParser(description="Convert a binary into a C header")
+parser.add_argument('input', help="bin/nib file")
+parser.add_argument('output', help="header to write")
+parser.add_argument('buf_name', help="name of the array in the header")
+parser.add_argument('--compress', action='store_true', help="store the data LZ4 compressed")
+parser.add_argument('--window', type=int, default=2048,
+					help="largest match offset when compressing, the decompressor keeps this many bytes")
+parser.add_argument('--git-version', help="git_version.vh the FPGA design was synthesized with")
+args = parser.parse_args()
+
+git_hash = bytes(20)
+git_dirty = 1
+if args.git_version is not None:
+	with open(args.git_version) as file:
+		version = file.read()
+	hash_match = re.search(r"GIT_VERSION_HASH\s+160'h([0-9a-fA-F]{40})", version)
+	dirty_match = re.search(r"GIT_VERSION_DIRTY\s+1'b([01])", version)
+	if hash_match is None or dirty_match is None:
+		print("No git hash in " + args.git_version)
+		exit(-1)
+	git_hash = bytes.fromhex(hash_match.group(1))
+	git_dirty = int(dirty_match.group(1))
 
 data = None
-with open(sys.argv[1], 'rb') as file:
-	data = file.read()
+try:
+	with open(args.input, 'rb') as file:
+		data = file.read()
+except OSError:
+	pass
 
 if data is None:
-	print("Failed to open file:" + str(sys.argv[1]))
+	print("Failed to open file:" + str(args.input))
 	exit(-1)
 
 num_bytes = len(data)
-hdr_sym = sys.argv[2].upper().replace(".", "_").replace("-", "_")
+hdr_sym = args.output.upper().replace(".", "_").replace("-", "_")
+buf_name = str(args.buf_name)
+
+print(str(args.input) + " has " + str(num_bytes) + " bytes of data.")
+
+defines = ""
+if args.compress:
+	print("Compressing...")
+	compressed = lz4_compress(data, args.window)
+	if lz4_decompress(compressed) != data:
+		print("Compressed data doesn't decompress to the input")
+		exit(-1)
 
-print(str(sys.argv[1]) + " has " + str(num_bytes) + " bytes of data.")
+	print("Compressed to " + str(len(compressed)) + " bytes.")
+	defines += "static const uint32_t " + buf_name.upper() + "_DECOMPRESSED_LEN = " + str(num_bytes) + ";\n"
+	defines += "static const uint32_t " + buf_name.upper() + "_WINDOW = " + str(args.window) + ";\n"
+	data = compressed
+	num_bytes = len(data)
 
 print("Building header file...")
 
@@ -38,8 +192,11 @@ file_string = ""
 file_string += "#ifndef " + hdr_sym + "\n"
 file_string += "#define " + hdr_sym + "\n"
 file_string += "\n"
-file_string += "static const uint32_t " + str(sys.argv[3]).upper() + "_LEN = " + str(num_bytes) + ";\n"
-file_string += "static const uint8_t " + str(sys.argv[3]) + "[" + str(num_bytes) + "] = {"
+file_string += "static const uint32_t " + buf_name.upper() + "_LEN = " + str(num_bytes) + ";\n"
+file_string += defines
+file_string += "static const bool " + buf_name.upper() + "_GIT_DIRTY = " + ("true" if git_dirty else "false") + ";\n"
+file_string += "static const uint8_t " + buf_name.upper() + "_GIT_HASH[20] = {" + ", ".join(hex(b) for b in git_hash) + "};\n"
+file_string += "static const uint8_t " + buf_name + "[" + str(num_bytes) + "] = {"
 
 for i in range(num_bytes):
 	file_string += hex(data[i])
@@ -52,9 +209,9 @@ file_string += "#endif //" + hdr_sym
 
 print("Done.")
 
-print("Opening and writing " + sys.argv[2])
+print("Opening and writing " + args.output)
 
-f = open(sys.argv[2], 'w+')
+f = open(args.output, 'w+')
 f.write(file_string)
 
 print('Done.')
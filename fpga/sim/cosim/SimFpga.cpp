@@ -0,0 +1,176 @@
+#include "SimFpga.hpp"
+
+#include <cmath>
+
+#include "Vrobocup_sim.h"
+#include "verilated.h"
+
+SimFpga* SimFpga::active = nullptr;
+
+namespace {
+// Quadrature states in counting up order, { a, b }
+constexpr uint8_t kQuadrature[4] = {0b00, 0b01, 0b11, 0b10};
+
+// Any valid hall state, so the motors don't report a disconnected sensor
+constexpr uint8_t kHallState = 0b101;
+
+constexpr size_t kAdcNumChannels = 8;
+constexpr uint16_t kAdcWriteBit = 1 << 15;
+}
+
+SimFpga::SimFpga() : model(std::make_unique<Vrobocup_sim>()) {
+    model->sysclk = 0;
+    model->spi_slave_ncs = 1;
+    model->spi_slave_sck = 0;
+    model->spi_slave_mosi = 0;
+    model->spi_master_miso = 0;
+    model->enc_a = 0;
+    model->enc_b = 0;
+
+    uint8_t hallA = 0, hallB = 0, hallC = 0;
+    for (int i = 0; i < 5; i++) {
+        hallA |= ((kHallState >> 2) & 1) << i;
+        hallB |= ((kHallState >> 1) & 1) << i;
+        hallC |= ((kHallState >> 0) & 1) << i;
+    }
+    model->hall_a = hallA;
+    model->hall_b = hallB;
+    model->hall_c = hallC;
+
+    // Shunt amplifiers idle at half scale for 0A
+    adcReadings.fill(1 << 11);
+
+    model->eval();
+}
+
+SimFpga::~SimFpga() {
+    model->final();
+}
+
+void SimFpga::advance(double seconds) {
+    pendingTime += seconds * kSysclkHz;
+    const double whole = std::floor(pendingTime);
+    pendingTime -= whole;
+    advanceCycles(static_cast<uint64_t>(whole));
+}
+
+void SimFpga::advanceCycles(uint64_t cycles) {
+    for (uint64_t i = 0; i < cycles; i++) {
+        tick();
+    }
+}
+
+void SimFpga::tick() {
+    stepStimulus();
+
+    model->sysclk = 1;
+    model->eval();
+    stepAdcs();
+
+    model->sysclk = 0;
+    model->eval();
+
+    cycleCount++;
+}
+
+void SimFpga::setSlaveNcs(bool level) { model->spi_slave_ncs = level; }
+void SimFpga::setSlaveSck(bool level) { model->spi_slave_sck = level; }
+void SimFpga::setSlaveMosi(bool level) { model->spi_slave_mosi = level; }
+bool SimFpga::slaveMiso() const { return model->spi_slave_miso; }
+
+void SimFpga::setEncoderRate(size_t encoder, double stepsPerSecond) {
+    encoders[encoder].rate = stepsPerSecond;
+}
+
+void SimFpga::stepEncoder(size_t encoder, int steps) {
+    encoders[encoder].pending += steps;
+}
+
+void SimFpga::stepEncoderAt(size_t encoder, int steps, uint64_t cycle) {
+    scheduledEncoder = encoder;
+    scheduledSteps = steps;
+    scheduledCycle = cycle;
+}
+
+void SimFpga::stepStimulus() {
+    uint8_t encA = 0, encB = 0;
+
+    if (scheduledSteps != 0 && cycleCount >= scheduledCycle) {
+        encoders[scheduledEncoder].pending += scheduledSteps;
+        scheduledSteps = 0;
+        stepAppliedCycle = cycleCount;
+    }
+
+    for (size_t i = 0; i < kNumEncoders; i++) {
+        Encoder& enc = encoders[i];
+
+        enc.phase += enc.rate / kSysclkHz;
+        if (enc.phase >= 1.0) {
+            enc.pending++;
+            enc.phase -= 1.0;
+        } else if (enc.phase <= -1.0) {
+            enc.pending--;
+            enc.phase += 1.0;
+        }
+
+        // At most one quadrature transition per clock so none are skipped
+        if (enc.pending > 0) {
+            enc.state = (enc.state + 1) & 3;
+            enc.steps++;
+            enc.pending--;
+        } else if (enc.pending < 0) {
+            enc.state = (enc.state + 3) & 3;
+            enc.steps--;
+            enc.pending++;
+        }
+
+        encA |= ((kQuadrature[enc.state] >> 1) & 1) << i;
+        encB |= ((kQuadrature[enc.state] >> 0) & 1) << i;
+    }
+
+    model->enc_a = encA;
+    model->enc_b = encB;
+}
+
+void SimFpga::stepAdcs() {
+    const bool sck = model->spi_master_sck;
+    const bool rising = sck && !lastMasterSck;
+    const bool falling = !sck && lastMasterSck;
+    lastMasterSck = sck;
+
+    bool miso = false;
+
+    for (size_t a = 0; a < adcs.size(); a++) {
+        AdcPort& adc = adcs[a];
+        const bool selected = ((model->adc_ncs >> a) & 1) == 0;
+
+        if (selected && !adc.selected) {
+            // Start of a frame, shift out the conversion of the channel
+            // addressed in the previous frame
+            const size_t channel = a * kAdcNumChannels + adc.nextChannel;
+            const uint16_t reading = (channel < kNumCurrentChannels) ? adcReadings[channel] : 0;
+            adc.shiftOut = (adc.nextChannel << 12) | (reading & 0xFFF);
+            adc.shiftIn = 0;
+            adc.bits = 0;
+        } else if (!selected && adc.selected) {
+            if (adc.bits >= 16 && (adc.shiftIn & kAdcWriteBit)) {
+                adc.nextChannel = (adc.shiftIn >> 10) & 0x7;
+            }
+            adcFrameCount++;
+        } else if (selected) {
+            if (rising) {
+                adc.shiftIn = (adc.shiftIn << 1) | model->spi_master_mosi;
+                adc.bits++;
+            } else if (falling) {
+                adc.shiftOut <<= 1;
+            }
+        }
+
+        adc.selected = selected;
+        if (selected) {
+            miso = (adc.shiftOut >> 15) & 1;
+        }
+    }
+
+    model->spi_master_miso = miso;
+}
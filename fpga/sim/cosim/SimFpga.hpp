@@ -0,0 +1,147 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+#include "mtrain.hpp"
+
+class Vrobocup_sim;
+
+/**
+ * Pins the stubbed DigitalIn/DigitalOut/interruptin calls can be used with
+ */
+namespace cosim {
+constexpr PinName kFpgaNcs{0, 1};
+constexpr PinName kFpgaInitB{0, 2};
+constexpr PinName kFpgaProgB{0, 3};
+constexpr PinName kFpgaDone{0, 4};
+}
+
+/**
+ * Cycle based model of the FPGA board around the Verilated robocup top level
+ *
+ * Time only moves forward through `advance()`, which toggles the system
+ * clock and steps the stimulus for every clock cycle in between:
+ *  - quadrature encoder inputs running at a set rate per encoder
+ *  - valid, static hall inputs so no motor reports an error
+ *  - the current sense ADCs on the FPGA's SPI master bus, returning set
+ *    readings per channel (AD7928 style, result lags a frame)
+ *
+ * The stubbed SPI and pin classes drive the slave port through `active`.
+ */
+class SimFpga {
+public:
+    static constexpr double kSysclkHz = 18.432e6;
+    static constexpr size_t kNumEncoders = 4;
+    static constexpr size_t kNumCurrentChannels = 10;
+
+    SimFpga();
+    ~SimFpga();
+
+    /**
+     * Run the simulation forward
+     */
+    void advance(double seconds);
+
+    /**
+     * Run the simulation forward by whole system clock cycles
+     */
+    void advanceCycles(uint64_t cycles);
+
+    double now() const { return cycleCount / kSysclkHz; }
+    uint64_t cycles() const { return cycleCount; }
+
+    void setSlaveNcs(bool level);
+    void setSlaveSck(bool level);
+    void setSlaveMosi(bool level);
+    bool slaveMiso() const;
+
+    /**
+     * Quadrature steps per second fed to an encoder, negative counts down
+     */
+    void setEncoderRate(size_t encoder, double stepsPerSecond);
+
+    /**
+     * Move an encoder by `steps` immediately, one step per clock
+     */
+    void stepEncoder(size_t encoder, int steps);
+
+    /**
+     * Move an encoder by `steps` once the clock count reaches `cycle`
+     */
+    void stepEncoderAt(size_t encoder, int steps, uint64_t cycle);
+
+    /**
+     * Clock count when the last scheduled step reached the encoder pins
+     */
+    uint64_t scheduledStepCycle() const { return stepAppliedCycle; }
+
+    /**
+     * Total steps fed to an encoder since the simulation started
+     */
+    int64_t encoderSteps(size_t encoder) const { return encoders[encoder].steps; }
+
+    /**
+     * ADC reading for a DRV8303 shunt amplifier output (2 per motor, A then B)
+     */
+    void setCurrentSense(size_t channel, uint16_t lsb) { adcReadings[channel] = lsb; }
+
+    /**
+     * Number of complete frames the ADC model has answered
+     */
+    uint64_t adcFrames() const { return adcFrameCount; }
+
+    /**
+     * Idle time after every byte and chip select change, like the gap
+     * between HAL calls on the mTrain (seconds)
+     */
+    double busGap = 0.5e-6;
+
+    /**
+     * Slave transfer bookkeeping, updated by the stubbed SPI and chip select
+     */
+    uint64_t frameStartCycle = 0;   /**< Chip select asserted */
+    uint64_t commandEndCycle = 0;   /**< Last bit of the command byte clocked */
+    uint64_t frameEndCycle = 0;     /**< Chip select released */
+    size_t frameBytes = 0;
+
+    static SimFpga* active;
+
+private:
+    struct Encoder {
+        double rate = 0.0;
+        double phase = 0.0;
+        int pending = 0;
+        uint8_t state = 0;
+        int64_t steps = 0;
+    };
+
+    struct AdcPort {
+        bool selected = false;
+        uint16_t shiftIn = 0;
+        uint16_t shiftOut = 0;
+        uint8_t bits = 0;
+        uint8_t nextChannel = 0;
+    };
+
+    void tick();
+    void stepStimulus();
+    void stepAdcs();
+
+    std::unique_ptr<Vrobocup_sim> model;
+    uint64_t cycleCount = 0;
+
+    std::array<Encoder, kNumEncoders> encoders{};
+    std::array<uint16_t, kNumCurrentChannels> adcReadings{};
+    std::array<AdcPort, 2> adcs{};
+    bool lastMasterSck = false;
+    uint64_t adcFrameCount = 0;
+
+    double pendingTime = 0.0;
+
+    size_t scheduledEncoder = 0;
+    int scheduledSteps = 0;
+    uint64_t scheduledCycle = 0;
+    uint64_t stepAppliedCycle = 0;
+};
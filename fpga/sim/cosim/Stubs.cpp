@@ -0,0 +1,124 @@
+/**
+ * Host implementations of the stubbed mTrain and FreeRTOS calls, all of
+ * them drive or wait on `SimFpga::active`
+ */
+
+#include "DigitalIn.hpp"
+#include "DigitalOut.hpp"
+#include "SPI.hpp"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "interrupt_in.h"
+
+#include "SimFpga.hpp"
+
+namespace {
+int forcedHz = 0;
+}
+
+uint32_t HAL_GetTick() {
+    return static_cast<uint32_t>(SimFpga::active->now() * 1000.0);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    SimFpga::active->advance(ticks / 1000.0);
+}
+
+TickType_t xTaskGetTickCount() {
+    return HAL_GetTick();
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle() {
+    return nullptr;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t, TickType_t ticks) {
+    vTaskDelay(ticks);
+    return 0;
+}
+
+void vTaskNotifyGiveFromISR(TaskHandle_t, BaseType_t*) {}
+
+DigitalOut::DigitalOut(PinName pin, PullType, PinMode, PinSpeed, bool inverted)
+    : pin(pin), inverted(inverted), state(false) {
+    write(false);
+}
+
+void DigitalOut::write(bool value) {
+    state = value;
+
+    SimFpga& sim = *SimFpga::active;
+    if (pin == cosim::kFpgaNcs) {
+        const bool level = value != inverted;
+        sim.setSlaveNcs(level);
+        if (!level) {
+            sim.frameStartCycle = sim.cycles();
+            sim.frameBytes = 0;
+        } else {
+            sim.frameEndCycle = sim.cycles();
+        }
+        sim.advance(sim.busGap);
+    }
+}
+
+bool DigitalIn::read() const {
+    // The harness never loads a bitstream, the model is always configured
+    return pin == cosim::kFpgaInitB || pin == cosim::kFpgaDone;
+}
+
+void interruptin_init_ex(pin_name, void (*)(), pull_type, interrupt_mode) {}
+
+bool interruptin_read(pin_name pin) {
+    return DigitalIn({pin.port, pin.pin}).read();
+}
+
+SPI::SPI(int, std::optional<PinName>, int hz) : hz(hz) {}
+
+void SPI::frequency(int newHz) {
+    hz = newHz;
+}
+
+void SPI::overrideFrequency(int newHz) {
+    forcedHz = newHz;
+}
+
+void SPI::transmit(uint8_t data) {
+    transmitReceive(data);
+}
+
+void SPI::transmit(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        transmitReceive(data[i]);
+    }
+}
+
+void SPI::transmitReceive(uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        data[i] = transmitReceive(data[i]);
+    }
+}
+
+uint8_t SPI::transmitReceive(uint8_t data) {
+    SimFpga& sim = *SimFpga::active;
+    const double halfPeriod = 0.5 / (forcedHz ? forcedHz : hz);
+
+    // Mode 0, MSB first. MISO is read just before the rising edge like
+    // the mTrain's SPI peripheral samples it.
+    uint8_t received = 0;
+    for (int bit = 7; bit >= 0; bit--) {
+        sim.setSlaveMosi((data >> bit) & 1);
+        sim.advance(halfPeriod);
+        received = (received << 1) | sim.slaveMiso();
+        sim.setSlaveSck(true);
+        sim.advance(halfPeriod);
+        sim.setSlaveSck(false);
+    }
+
+    if (sim.frameBytes++ == 0) {
+        sim.commandEndCycle = sim.cycles();
+    }
+
+    sim.advance(sim.busGap);
+
+    return received;
+}
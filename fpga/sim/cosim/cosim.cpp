@@ -0,0 +1,646 @@
+/**
+ * Co-simulation of robocup.v against the unmodified mTrain FPGA driver
+ *
+ * The driver's SPI traffic is bit-banged into a Verilator model of the FPGA
+ * top level (see SimFpga and the stubs directory), so every check goes
+ * through the same byte stream the robot sends.
+ *
+ * Checks, at the driver's own SPI clock:
+ *  - the FPGA comes up ready and reports the design version the driver expects
+ *  - framing: commanded duty cycles read back unchanged, and encoder deltas
+ *    match the steps fed in since the previous transfer
+ *  - the watchdog tick count matches the time between transfers
+ *  - currents from the ADC model come back through the 0x81 command
+ *  - the 0x82 burst matches the separate encoder, gate driver, current and
+ *    duty cycle reads
+ *  - the PWM period register defaults to 18kHz, takes new frequencies and
+ *    limits them to the supported range
+ *  - encoder velocities from the FPGA match constant encoder rates, and
+ *    fall to 0 once the encoders stop
+ *  - encoder latency: steps landing close to the latch are reported exactly
+ *    once, in this transfer or the next
+ *  - odometry: encoder deltas sum to exactly the steps fed in with every
+ *    encoder at the maximum edge rate, and the update sequence number
+ *    counts every motor update
+ *
+ * Then every candidate clock in `--freqs` is run through the framing check
+ * to find the fastest one that still works.
+ *
+ * Usage:
+ *   robocup-cosim [--freqs 400000,1000000,...] [--transfers N]
+ *                 [--byte-gap-ns N] [--seed N]
+ */
+
+#include <algorithm>
+#include <array>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "drivers/FPGA.hpp"
+#include "Logger.hpp"
+#include "SPI.hpp"
+
+#include "SimFpga.hpp"
+#include "verilated.h"
+
+namespace {
+
+constexpr uint8_t kStatusReady = 1 << 7;
+
+// Cycles for the encoder IIR filter in BLDC_Motor.v to settle on a new count
+constexpr uint64_t kEncoderSettleCycles = 1000;
+
+// The watchdog timer clock is sysclk / 2^WATCHDOG_TIMER_CLK_WIDTH
+constexpr double kCyclesPerWatchdogTick = 256.0;
+
+// Zero current reading of the shunt amplifiers
+constexpr int kCurrentZero = 1 << 11;
+
+struct Options {
+    std::vector<int> freqs = {400'000, 1'000'000, 2'000'000, 3'000'000, 4'000'000, 6'000'000, 8'000'000};
+    int transfers = 20;
+    double byteGap = 0.5e-6;
+    unsigned seed = 1;
+};
+
+int failures = 0;
+
+void check(bool ok, const char* name, const char* detail = "") {
+    printf("  [%s] %s%s%s\n", ok ? "PASS" : "FAIL", name, detail[0] ? ": " : "", detail);
+    if (!ok) {
+        failures++;
+    }
+}
+
+void drainLog() {
+    Logger::drain();
+}
+
+std::array<int64_t, SimFpga::kNumEncoders> stepsNow(const SimFpga& sim) {
+    std::array<int64_t, SimFpga::kNumEncoders> steps{};
+    for (size_t i = 0; i < steps.size(); i++) {
+        steps[i] = sim.encoderSteps(i);
+    }
+    return steps;
+}
+
+bool waitReady(FPGA& fpga, SimFpga& sim) {
+    for (int i = 0; i < 100; i++) {
+        sim.advance(10e-6);
+        if (fpga.watchdog_reset() & kStatusReady) {
+            return true;
+        }
+    }
+    return false;
+}
+
+struct FramingResult {
+    int badStatus = 0;
+    int badEncoders = 0;
+    int badDuties = 0;
+    int badWatchdog = 0;
+    double transferTime = 0.0;
+
+    bool ok() const { return badStatus == 0 && badEncoders == 0 && badDuties == 0 && badWatchdog == 0; }
+};
+
+/**
+ * Random duty cycles and encoder moves through set_duty_get_enc, checked
+ * against read_duty_cycles and the steps fed to the model
+ */
+FramingResult runFraming(FPGA& fpga, SimFpga& sim, std::mt19937& rng, int transfers) {
+    FramingResult result;
+    std::uniform_int_distribution<int> dutyDist(-FPGA::MAX_DUTY_CYCLE, FPGA::MAX_DUTY_CYCLE);
+    std::uniform_int_distribution<int> stepDist(-300, 300);
+
+    std::array<int16_t, 5> duties{};
+    std::array<int16_t, 5> encs{};
+    std::array<int16_t, 5> readback{};
+
+    // Prime so the counts start from a known transfer
+    fpga.set_duty_get_enc(duties.data(), duties.size(), encs.data(), encs.size());
+    auto lastSteps = stepsNow(sim);
+    uint64_t lastLatch = sim.commandEndCycle;
+
+    for (int t = 0; t < transfers; t++) {
+        for (auto& d : duties) {
+            d = static_cast<int16_t>(dutyDist(rng));
+        }
+        int maxSteps = 0;
+        for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+            const int steps = stepDist(rng);
+            sim.stepEncoder(i, steps);
+            maxSteps = std::max(maxSteps, std::abs(steps));
+        }
+        sim.advanceCycles(maxSteps + kEncoderSettleCycles);
+
+        const uint8_t status = fpga.set_duty_get_enc(duties.data(), duties.size(), encs.data(), encs.size());
+        result.transferTime += (sim.frameEndCycle - sim.frameStartCycle) / SimFpga::kSysclkHz;
+
+        if (!(status & kStatusReady)) {
+            result.badStatus++;
+        }
+
+        const auto steps = stepsNow(sim);
+        for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+            if (encs[i] != static_cast<int16_t>(steps[i] - lastSteps[i])) {
+                result.badEncoders++;
+            }
+        }
+        lastSteps = steps;
+
+        // The tick count is latched with the encoders, so compare it with
+        // the time between command bytes
+        const double expectedTicks = (sim.commandEndCycle - lastLatch) / kCyclesPerWatchdogTick;
+        if (std::abs(static_cast<uint16_t>(encs[4]) - expectedTicks) > 2.0) {
+            result.badWatchdog++;
+        }
+        lastLatch = sim.commandEndCycle;
+
+        fpga.read_duty_cycles(readback.data(), readback.size());
+        if (readback != duties) {
+            result.badDuties++;
+        }
+    }
+
+    result.transferTime /= transfers;
+    return result;
+}
+
+void checkFraming(FPGA& fpga, SimFpga& sim, std::mt19937& rng, int transfers) {
+    const FramingResult r = runFraming(fpga, sim, rng, transfers);
+    char detail[96];
+
+    snprintf(detail, sizeof(detail), "%d/%d transfers not ready", r.badStatus, transfers);
+    check(r.badStatus == 0, "status", detail);
+
+    snprintf(detail, sizeof(detail), "%d/%d encoder deltas wrong", r.badEncoders, transfers * 4);
+    check(r.badEncoders == 0, "encoder deltas", detail);
+
+    snprintf(detail, sizeof(detail), "%d/%d readbacks wrong", r.badDuties, transfers);
+    check(r.badDuties == 0, "duty cycles", detail);
+
+    snprintf(detail, sizeof(detail), "%d/%d off by more than 2 ticks", r.badWatchdog, transfers);
+    check(r.badWatchdog == 0, "watchdog dt", detail);
+}
+
+void checkCurrents(FPGA& fpga, SimFpga& sim, std::mt19937& rng) {
+    std::uniform_int_distribution<int> lsbDist(0, 4095);
+    std::array<int16_t, 5> duties{};
+    std::array<int16_t, 5> encs{};
+    std::array<uint16_t, 5> currents{};
+
+    int wrong = 0;
+    const int rounds = 5;
+    for (int r = 0; r < rounds; r++) {
+        std::array<int, 5> expected{};
+        for (size_t m = 0; m < 5; m++) {
+            const int a = lsbDist(rng);
+            const int b = lsbDist(rng);
+            sim.setCurrentSense(2 * m, a);
+            sim.setCurrentSense(2 * m + 1, b);
+
+            const int ia = a - kCurrentZero;
+            const int ib = b - kCurrentZero;
+            expected[m] = std::max({std::abs(ia), std::abs(ib), std::abs(ia + ib)});
+        }
+
+        // Long enough for the gate driver config and a full ADC sweep
+        const uint64_t frames = sim.adcFrames();
+        for (int i = 0; i < 50 && sim.adcFrames() < frames + 24; i++) {
+            sim.advance(100e-6);
+        }
+
+        fpga.set_duty_get_enc_cur(duties.data(), duties.size(), encs.data(), encs.size(),
+                                  currents.data(), currents.size());
+
+        for (size_t m = 0; m < 5; m++) {
+            if (currents[m] != expected[m]) {
+                wrong++;
+                printf("    motor %zu: got %u lsb, expected %d lsb\n", m, currents[m], expected[m]);
+            }
+        }
+    }
+
+    char detail[64];
+    snprintf(detail, sizeof(detail), "%d/%d currents wrong", wrong, rounds * 5);
+    check(wrong == 0, "currents (0x81)", detail);
+}
+
+/**
+ * The 0x82 burst against the same readings taken with the separate commands
+ */
+void checkBurst(FPGA& fpga, SimFpga& sim, std::mt19937& rng) {
+    std::uniform_int_distribution<int> dutyDist(-FPGA::MAX_DUTY_CYCLE, FPGA::MAX_DUTY_CYCLE);
+    std::uniform_int_distribution<int> stepDist(-300, 300);
+    std::uniform_int_distribution<int> lsbDist(0, 4095);
+
+    std::array<int16_t, 5> duties{};
+    std::array<int16_t, 5> encs{};
+    std::array<int16_t, 5> readback{};
+    std::array<uint16_t, 5> currents{};
+    FPGATelemetry telemetry{};
+
+    fpga.set_duty_get_all(duties.data(), duties.size(), telemetry);
+    auto lastSteps = stepsNow(sim);
+
+    int wrong = 0;
+    const int rounds = 5;
+    for (int r = 0; r < rounds; r++) {
+        for (auto& d : duties) {
+            d = static_cast<int16_t>(dutyDist(rng));
+        }
+        for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+            sim.stepEncoder(i, stepDist(rng));
+        }
+        for (size_t ch = 0; ch < 10; ch++) {
+            sim.setCurrentSense(ch, lsbDist(rng));
+        }
+        const uint64_t frames = sim.adcFrames();
+        for (int i = 0; i < 50 && sim.adcFrames() < frames + 24; i++) {
+            sim.advance(100e-6);
+        }
+
+        // Currents can't change between these, nothing new is set on the model
+        fpga.set_duty_get_enc_cur(duties.data(), duties.size(), encs.data(), encs.size(),
+                                  currents.data(), currents.size());
+        const auto steps = stepsNow(sim);
+        sim.advanceCycles(kEncoderSettleCycles);
+
+        const uint8_t status = fpga.set_duty_get_all(duties.data(), duties.size(), telemetry);
+        std::vector<uint16_t> gateDrivers;
+        fpga.gate_drivers(gateDrivers);
+        fpga.read_duty_cycles(readback.data(), readback.size());
+
+        if (!(status & kStatusReady)) {
+            wrong++;
+        }
+        for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+            // Everything moved before the 0x81 transfer, so the burst sees no steps
+            if (encs[i] != static_cast<int16_t>(steps[i] - lastSteps[i]) || telemetry.enc_delta(i) != 0) {
+                wrong++;
+                printf("    encoder %zu: got %d then %d\n", i, encs[i], telemetry.enc_delta(i));
+            }
+        }
+        lastSteps = steps;
+
+        for (size_t m = 0; m < 5; m++) {
+            // The halls don't move in the model
+            if (telemetry.hall_counts[m] != 0 || telemetry.gate_drv(m) != gateDrivers[m] ||
+                telemetry.current(m) != currents[m]) {
+                wrong++;
+                printf("    motor %zu: hall %u, drv 0x%03x (0x%03x), current %u (%u)\n", m,
+                       telemetry.hall_counts[m], telemetry.gate_drv(m), gateDrivers[m],
+                       telemetry.current(m), currents[m]);
+            }
+        }
+
+        if (readback != duties) {
+            wrong++;
+        }
+    }
+
+    char detail[64];
+    snprintf(detail, sizeof(detail), "%d mismatches over %d transfers", wrong, rounds);
+    check(wrong == 0, "burst telemetry (0x82)", detail);
+}
+
+/**
+ * Constant encoder rates against the FPGA's velocity estimate, from a few
+ * edges per update window up to well past the drive motors' top speed, then
+ * stopping
+ */
+void checkVelocity(FPGA& fpga, SimFpga& sim) {
+    const double velocityLsb = 1.0 / (1 << FPGATelemetry::ENC_VELOCITY_FRAC_BITS);
+    const std::array<double, 5> rates = {40.0, 400.0, 4'000.0, 40'000.0, 150'000.0};
+
+    std::array<int16_t, 5> duties{};
+    FPGATelemetry telemetry{};
+
+    int wrong = 0;
+    for (double rate : rates) {
+        // Opposite directions and slightly different rates on each wheel
+        std::array<double, SimFpga::kNumEncoders> expected{};
+        for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+            expected[i] = rate * (1.0 + 0.1 * i) * ((i % 2) ? -1.0 : 1.0);
+            sim.setEncoderRate(i, expected[i]);
+        }
+
+        // At least a couple of edges and a whole update window at the slowest rate
+        sim.advance(std::max(0.01, 3.0 / rate));
+        fpga.set_duty_get_all(duties.data(), duties.size(), telemetry);
+
+        for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+            const double measured = telemetry.enc_velocity(i) * velocityLsb;
+            if (std::abs(measured - expected[i]) > 0.01 * std::abs(expected[i])) {
+                wrong++;
+                printf("    encoder %zu: got %.2f ticks/s, expected %.2f ticks/s\n", i, measured, expected[i]);
+            }
+        }
+    }
+
+    for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+        sim.setEncoderRate(i, 0.0);
+    }
+
+    // Stopped, the estimate can't be any faster than an edge arriving right now
+    const double stopped = 0.05;
+    sim.advance(stopped);
+    fpga.set_duty_get_all(duties.data(), duties.size(), telemetry);
+    for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+        const double measured = telemetry.enc_velocity(i) * velocityLsb;
+        if (std::abs(measured) > 1.0 / (stopped - 0.002)) {
+            wrong++;
+            printf("    encoder %zu: %.2f ticks/s after stopping for %.0f ms\n", i, measured, stopped * 1e3);
+        }
+    }
+
+    // Long enough to give up timing from the last edge entirely
+    sim.advance(1.0);
+    fpga.set_duty_get_all(duties.data(), duties.size(), telemetry);
+    for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+        if (telemetry.enc_velocity(i) != 0) {
+            wrong++;
+            printf("    encoder %zu: %d lsb after stopping for 1 s\n", i, telemetry.enc_velocity(i));
+        }
+    }
+
+    char detail[64];
+    snprintf(detail, sizeof(detail), "%d/%zu readings wrong", wrong, (rates.size() + 2) * SimFpga::kNumEncoders);
+    check(wrong == 0, "encoder velocity", detail);
+}
+
+/**
+ * Encoders moving at the maximum edge rate the FPGA can count (one edge
+ * per clock) through back to back motor updates. Summing the deltas has to
+ * give exactly the steps fed in, and the sequence number has to count
+ * every update, 0x91 reads in between not included.
+ */
+void checkOdometry(FPGA& fpga, SimFpga& sim, int transfers) {
+    std::array<int16_t, 5> duties{};
+    std::array<int16_t, 5> encs{};
+    FPGATelemetry telemetry{};
+
+    fpga.set_duty_get_all(duties.data(), duties.size(), telemetry);
+    const uint8_t firstSequence = telemetry.sequence;
+    const auto startSteps = stepsNow(sim);
+
+    const std::array<double, SimFpga::kNumEncoders> rates = {
+        SimFpga::kSysclkHz, -SimFpga::kSysclkHz, SimFpga::kSysclkHz / 3, -SimFpga::kSysclkHz / 7
+    };
+    for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+        sim.setEncoderRate(i, rates[i]);
+    }
+
+    std::array<int64_t, SimFpga::kNumEncoders> sums{};
+    int updates = 1;
+    for (int t = 0; t < transfers; t++) {
+        // Deltas wrap at 2^16 edges, so keep well under that between updates
+        sim.advance(0.2e-3);
+        fpga.set_duty_get_enc(duties.data(), duties.size(), encs.data(), encs.size());
+        updates++;
+        for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+            sums[i] += encs[i];
+        }
+
+        if (t % 4 == 0) {
+            fpga.read_encs(encs.data(), encs.size());
+        }
+    }
+
+    for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+        sim.setEncoderRate(i, 0.0);
+    }
+    sim.advanceCycles(kEncoderSettleCycles);
+
+    fpga.set_duty_get_all(duties.data(), duties.size(), telemetry);
+    updates++;
+
+    const auto endSteps = stepsNow(sim);
+    int wrong = 0;
+    for (size_t i = 0; i < SimFpga::kNumEncoders; i++) {
+        sums[i] += telemetry.enc_delta(i);
+        if (sums[i] != endSteps[i] - startSteps[i]) {
+            wrong++;
+            printf("    encoder %zu: deltas sum to %" PRId64 ", fed %" PRId64 " steps\n", i, sums[i],
+                   endSteps[i] - startSteps[i]);
+        }
+    }
+
+    const uint8_t sequenceSteps = static_cast<uint8_t>(telemetry.sequence - firstSequence);
+    if (sequenceSteps != static_cast<uint8_t>(updates - 1)) {
+        wrong++;
+        printf("    sequence moved %u over %d updates\n", sequenceSteps, updates - 1);
+    }
+
+    char detail[64];
+    snprintf(detail, sizeof(detail), "%d mismatches over %d updates", wrong, updates);
+    check(wrong == 0, "odometry at the maximum edge rate", detail);
+}
+
+/**
+ * Single encoder steps at a range of distances before the command byte
+ * latches the counts. Each one has to show up exactly once, in this
+ * transfer if it's early enough or the next one otherwise.
+ */
+void checkLatency(FPGA& fpga, SimFpga& sim) {
+    std::array<int16_t, 5> duties{};
+    std::array<int16_t, 5> encs{};
+
+    fpga.set_duty_get_enc(duties.data(), duties.size(), encs.data(), encs.size());
+    sim.advanceCycles(kEncoderSettleCycles);
+
+    // The time from chip select to the end of the command byte is the same
+    // for every transfer at a fixed clock, so use this one to aim the next
+    const uint64_t latchOffset = sim.commandEndCycle - sim.frameStartCycle;
+
+    int lost = 0;
+    int doubled = 0;
+    int64_t latestCounted = -1;
+    int64_t earliestDeferred = -1;
+
+    for (int64_t lead = 128; lead >= -16; lead -= 2) {
+        const uint64_t start = sim.cycles();
+        sim.stepEncoderAt(0, 1, start + latchOffset - lead);
+
+        fpga.set_duty_get_enc(duties.data(), duties.size(), encs.data(), encs.size());
+        const int64_t actualLead = static_cast<int64_t>(sim.commandEndCycle) - static_cast<int64_t>(sim.scheduledStepCycle());
+        const int16_t now = encs[0];
+
+        sim.advanceCycles(kEncoderSettleCycles);
+        fpga.set_duty_get_enc(duties.data(), duties.size(), encs.data(), encs.size());
+        const int16_t next = encs[0];
+        sim.advanceCycles(kEncoderSettleCycles);
+
+        if (now + next == 0) {
+            lost++;
+            printf("    step %" PRId64 " clocks before the latch was lost\n", actualLead);
+        } else if (now + next > 1) {
+            doubled++;
+            printf("    step %" PRId64 " clocks before the latch was counted twice\n", actualLead);
+        } else if (now == 1) {
+            latestCounted = (latestCounted < 0) ? actualLead : std::min(latestCounted, actualLead);
+        } else {
+            earliestDeferred = std::max(earliestDeferred, actualLead);
+        }
+    }
+
+    if (latestCounted >= 0) {
+        printf("    latest step in the same transfer: %" PRId64 " clocks (%.2f us) before the command byte ends\n",
+               latestCounted, latestCounted / SimFpga::kSysclkHz * 1e6);
+    }
+    if (earliestDeferred >= 0) {
+        printf("    earliest step deferred to the next transfer: %" PRId64 " clocks before\n", earliestDeferred);
+    }
+
+    char detail[64];
+    snprintf(detail, sizeof(detail), "%d lost, %d counted twice", lost, doubled);
+    check(lost == 0 && doubled == 0, "encoder steps across the latch", detail);
+}
+
+/**
+ * The PWM carrier frequency through the period register
+ */
+void checkPwm(FPGA& fpga) {
+    struct Case {
+        uint32_t requested;
+        uint32_t expected;
+    };
+    // 18.432MHz over a whole number of clock cycles, 256 to 2048 of them
+    const std::array<Case, 4> cases = {{
+        {36'000, 36'000},
+        {200'000, 72'000},
+        {1'000, 9'000},
+        {18'000, 18'000},
+    }};
+
+    const uint32_t initial = fpga.read_pwm_frequency();
+    char detail[64];
+    snprintf(detail, sizeof(detail), "%" PRIu32 " Hz", initial);
+    check(initial == 18'000, "default PWM frequency", detail);
+
+    int wrong = 0;
+    for (const Case& c : cases) {
+        fpga.set_pwm_frequency(c.requested);
+        const uint32_t actual = fpga.read_pwm_frequency();
+        if (actual != c.expected) {
+            wrong++;
+            printf("    asked for %" PRIu32 " Hz, expected %" PRIu32 " Hz, got %" PRIu32 " Hz\n",
+                   c.requested, c.expected, actual);
+        }
+    }
+    snprintf(detail, sizeof(detail), "%d of %zu wrong", wrong, cases.size());
+    check(wrong == 0, "PWM frequency", detail);
+}
+
+void benchmark(FPGA& fpga, SimFpga& sim, std::mt19937& rng, const Options& options) {
+    printf("\nSPI clock sweep (%d transfers each, %.0f ns between bytes)\n", options.transfers,
+           options.byteGap * 1e9);
+    printf("  %10s  %8s  %12s\n", "clock (Hz)", "result", "transfer (us)");
+
+    int fastest = 0;
+    for (int hz : options.freqs) {
+        SPI::overrideFrequency(hz);
+        const FramingResult r = runFraming(fpga, sim, rng, options.transfers);
+        SPI::overrideFrequency(0);
+
+        printf("  %10d  %8s  %12.1f\n", hz, r.ok() ? "ok" : "FAIL", r.transferTime * 1e6);
+        if (r.ok()) {
+            fastest = std::max(fastest, hz);
+        }
+
+        // Put the model back in a known state after a failed clock rate
+        sim.advance(1e-3);
+        waitReady(fpga, sim);
+    }
+
+    if (fastest) {
+        printf("  fastest passing clock: %d Hz\n", fastest);
+    } else {
+        printf("  no clock rate passed\n");
+    }
+}
+
+Options parseArgs(int argc, char** argv) {
+    Options options;
+    for (int i = 1; i < argc; i++) {
+        const bool hasValue = i + 1 < argc;
+        if (!strcmp(argv[i], "--freqs") && hasValue) {
+            options.freqs.clear();
+            std::string list = argv[++i];
+            size_t pos = 0;
+            while (pos < list.size()) {
+                const size_t comma = list.find(',', pos);
+                options.freqs.push_back(std::stoi(list.substr(pos, comma - pos)));
+                pos = (comma == std::string::npos) ? list.size() : comma + 1;
+            }
+        } else if (!strcmp(argv[i], "--transfers") && hasValue) {
+            options.transfers = std::max(1, atoi(argv[++i]));
+        } else if (!strcmp(argv[i], "--byte-gap-ns") && hasValue) {
+            options.byteGap = atof(argv[++i]) * 1e-9;
+        } else if (!strcmp(argv[i], "--seed") && hasValue) {
+            options.seed = static_cast<unsigned>(atoi(argv[++i]));
+        } else {
+            printf("Usage: %s [--freqs hz,hz,...] [--transfers N] [--byte-gap-ns N] [--seed N]\n", argv[0]);
+            exit(-1);
+        }
+    }
+    return options;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    Verilated::commandArgs(argc, argv);
+    const Options options = parseArgs(argc, argv);
+
+    SimFpga sim;
+    SimFpga::active = &sim;
+    sim.busGap = options.byteGap;
+
+    std::mt19937 rng(options.seed);
+
+    FPGA fpga(std::make_unique<SPI>(), cosim::kFpgaNcs, cosim::kFpgaInitB,
+              cosim::kFpgaProgB, cosim::kFpgaDone);
+
+    printf("Driver SPI clock\n");
+
+    check(waitReady(fpga, sim), "ready");
+    // The model isn't loaded through configure(), so ask it what it is
+    check(fpga.read_design_version() == FPGA::DESIGN_VERSION, "design version");
+    drainLog();
+
+    checkFraming(fpga, sim, rng, options.transfers);
+    drainLog();
+
+    checkCurrents(fpga, sim, rng);
+    drainLog();
+
+    checkBurst(fpga, sim, rng);
+    drainLog();
+
+    checkPwm(fpga);
+    drainLog();
+
+    checkVelocity(fpga, sim);
+    drainLog();
+
+    checkLatency(fpga, sim);
+    drainLog();
+
+    checkOdometry(fpga, sim, options.transfers);
+    drainLog();
+
+    benchmark(fpga, sim, rng, options);
+    drainLog();
+
+    printf("\n%d check%s failed\n", failures, failures == 1 ? "" : "s");
+    return failures ? 1 : 0;
+}
@@ -0,0 +1,59 @@
+// Verilator top level for the co-simulation harness
+//
+// The slave MISO line is tristated inside robocup, so it's brought out here as
+// a plain output. Everything else is passed straight through.
+
+`include "robocup.v"
+
+module robocup_sim #(
+    parameter       NUM_MOTORS              =   ( 5                 ) ,
+                    NUM_HALL_SENS           =   ( NUM_MOTORS        ) ,
+                    NUM_ENCODERS            =   ( NUM_MOTORS - 1    )
+    ) (
+    input                               sysclk,
+
+    output      [ NUM_MOTORS - 1:0 ]    phase_aH,   phase_aL,   phase_bH,   phase_bL,   phase_cH,   phase_cL,
+    input       [ NUM_HALL_SENS - 1:0 ] hall_a,     hall_b,     hall_c,
+    input       [ NUM_ENCODERS - 1:0 ]  enc_a,
+    input       [ NUM_ENCODERS - 1:0 ]  enc_b,
+    output      [ NUM_MOTORS - 1:0 ]    drv_ncs,
+    output      [ 1:0 ]                 adc_ncs,
+
+    input                               spi_slave_sck,          spi_slave_mosi,         spi_slave_ncs,
+    output                              spi_slave_miso,
+
+    input                               spi_master_miso,
+    output                              spi_master_sck,         spi_master_mosi
+);
+
+wire spi_slave_miso_z;
+
+robocup #(
+    .NUM_MOTORS         ( NUM_MOTORS        )
+    ) dut (
+    .sysclk             ( sysclk            ) ,
+    .phase_aH           ( phase_aH          ) ,
+    .phase_aL           ( phase_aL          ) ,
+    .phase_bH           ( phase_bH          ) ,
+    .phase_bL           ( phase_bL          ) ,
+    .phase_cH           ( phase_cH          ) ,
+    .phase_cL           ( phase_cL          ) ,
+    .hall_a             ( hall_a            ) ,
+    .hall_b             ( hall_b            ) ,
+    .hall_c             ( hall_c            ) ,
+    .enc_a              ( enc_a             ) ,
+    .enc_b              ( enc_b             ) ,
+    .drv_ncs            ( drv_ncs           ) ,
+    .adc_ncs            ( adc_ncs           ) ,
+    .spi_slave_sck      ( spi_slave_sck     ) ,
+    .spi_slave_mosi     ( spi_slave_mosi    ) ,
+    .spi_slave_ncs      ( spi_slave_ncs     ) ,
+    .spi_slave_miso     ( spi_slave_miso_z  ) ,
+    .spi_master_miso    ( spi_master_miso   ) ,
+    .spi_master_sck     ( spi_master_sck    ) ,
+    .spi_master_mosi    ( spi_master_mosi   )
+);
+
+assign spi_slave_miso = spi_slave_miso_z;
+
+endmodule
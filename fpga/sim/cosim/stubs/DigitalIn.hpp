@@ -0,0 +1,18 @@
+#pragma once
+
+#include "mtrain.hpp"
+
+/**
+ * Input pin read from the simulated FPGA's outputs, see `cosim::readPin`
+ */
+class DigitalIn {
+public:
+    DigitalIn(PinName pin, PullType = PullType::PullNone) : pin(pin) {}
+
+    bool read() const;
+
+    operator bool() const { return read(); }
+
+private:
+    PinName pin;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "mtrain.hpp"
+
+/**
+ * SPI master that bit-bangs the simulated FPGA's slave port in mode 0
+ *
+ * Each byte is clocked at the frequency last passed to `frequency()`,
+ * unless the harness forces one with `overrideFrequency()` to try clock
+ * rates the driver doesn't ask for.
+ */
+class SPI {
+public:
+    SPI(int bus = 0, std::optional<PinName> cs = std::nullopt, int hz = 1'000'000);
+
+    void frequency(int hz);
+
+    void transmit(uint8_t data);
+    void transmit(const uint8_t* data, size_t len);
+
+    uint8_t transmitReceive(uint8_t data);
+    void transmitReceive(uint8_t* data, size_t len);
+
+    /**
+     * Clock rate used for every byte regardless of `frequency()`, 0 to disable
+     */
+    static void overrideFrequency(int hz);
+
+private:
+    int hz;
+};
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "pin_defs.h"
+
+/**
+ * Pins read like the stubbed `DigitalIn`, the callbacks are never called
+ */
+
+enum interrupt_mode { INTERRUPT_RISING, INTERRUPT_FALLING, INTERRUPT_RISING_FALLING };
+
+void interruptin_init_ex(pin_name pin, void (*callback)(), pull_type pull, interrupt_mode mode);
+
+bool interruptin_read(pin_name pin);
@@ -0,0 +1,30 @@
+#pragma once
+
+/**
+ * Host stand-in for the mTrain BSP, just enough for the drivers built into
+ * the co-simulation harness
+ */
+
+#include <cstdint>
+#include <cstdlib>
+
+/**
+ * Same fields as the mTrain's, the harness only uses `pin`
+ */
+struct PinName {
+    uint32_t port;
+    uint32_t pin;
+
+    constexpr bool operator==(const PinName& other) const {
+        return port == other.port && pin == other.pin;
+    }
+};
+
+enum class PullType { PullNone, PullUp, PullDown };
+enum class PinMode { PushPull, OpenDrain };
+enum class PinSpeed { Low, Medium, High, VeryHigh };
+
+/**
+ * Milliseconds of simulated time
+ */
+uint32_t HAL_GetTick();
@@ -0,0 +1,14 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Host stand-in for the mTrain's C pin definitions
+ */
+
+struct pin_name {
+    uint32_t port;
+    uint32_t pin;
+};
+
+enum pull_type { PULL_NONE, PULL_UP, PULL_DOWN };
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+/**
+ * Runs the simulation for `ticks` milliseconds
+ */
+void vTaskDelay(TickType_t ticks);
+
+TickType_t xTaskGetTickCount();
+
+/**
+ * There's only the one task, it's never notified from an interrupt since
+ * the harness never loads a bitstream
+ */
+using TaskHandle_t = void*;
+
+TaskHandle_t xTaskGetCurrentTaskHandle();
+
+uint32_t ulTaskNotifyTake(BaseType_t clearOnExit, TickType_t ticks);
+
+void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t* woken);
+
+#define portYIELD_FROM_ISR(woken) ((void)(woken))
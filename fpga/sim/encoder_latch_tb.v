@@ -0,0 +1,271 @@
+`timescale 1ns/1ps
+
+`include "robocup.v"
+
+/*
+*  Self-checking testbench for the encoder deltas the motor update commands return.
+*
+*  Every encoder steps at up to the highest rate the design can count, one quadrature
+*  step every clock cycle, while back to back CMD_UPDATE_MTRS_ALL transfers read them.
+*  The deltas have to add up to exactly the steps taken and the update sequence number
+*  has to go up by one per transfer.
+*
+*  Then a single edge is placed at every clock around the command byte, where the
+*  positions are latched, so it lands before, on and after the latch. It has to show
+*  up in exactly one of the two transfers either side of it.
+*
+*  Every check that doesn't hold prints a line starting with FAIL. Run it with
+*  `make fpga-tests`.
+*/
+
+module encoder_latch_tb;
+
+localparam NUM_MOTORS           = 5;
+localparam NUM_ENCODERS         = NUM_MOTORS - 1;
+
+localparam CMD_UPDATE_MTRS_ALL  = 'h82;
+localparam RES_ALL_LEN          = 53;
+localparam RES_ALL_SEQ          = 52;
+
+localparam SCK_HALF_PERIOD      = 8;        // clock cycles
+localparam TRANSFER_GAP         = 32;       // clock cycles between transfers
+
+// Clocks from the chip select falling to the positions being latched are about 8 bits
+// of SCK, the sweep covers a good margin either side
+localparam SWEEP_START          = 16 * SCK_HALF_PERIOD - 32;
+localparam SWEEP_END            = 16 * SCK_HALF_PERIOD + 32;
+
+reg clk = 0;
+always #1 clk = !clk;
+
+reg spi_slave_sck = 0;
+reg spi_slave_mosi = 0;
+reg spi_slave_ncs = 1;
+wire spi_slave_miso;
+
+reg [NUM_MOTORS-1:0] halls_a = {NUM_MOTORS{1'b1}};
+reg [NUM_MOTORS-1:0] halls_b = {NUM_MOTORS{1'b1}};
+reg [NUM_MOTORS-1:0] halls_c = {NUM_MOTORS{1'b1}};
+
+wire [NUM_MOTORS-1:0] phases_aH, phases_aL, phases_bH, phases_bL, phases_cH, phases_cL;
+wire [NUM_MOTORS-1:0] drv_ncs;
+wire [1:0] adc_ncs;
+wire spi_master_sck, spi_master_mosi;
+
+// The simulated encoders, as positions turned into quadrature
+reg  [15:0] enc_pos [NUM_ENCODERS-1:0];
+wire [NUM_ENCODERS-1:0] encoders_a, encoders_b;
+
+genvar g;
+generate
+    for (g = 0; g < NUM_ENCODERS; g = g + 1)
+    begin : ENCODER_SIM
+        initial enc_pos[g] = 0;
+        assign encoders_a[g] = enc_pos[g][1];
+        assign encoders_b[g] = enc_pos[g][1] ^ enc_pos[g][0];
+    end
+endgenerate
+
+robocup #(
+    .NUM_MOTORS             ( NUM_MOTORS        ) ,
+    .SPI_MASTER_DATA_WIDTH  ( 16                ) ,
+    .SPI_SLAVE_DATA_WIDTH   ( 8                 )
+    ) dut (
+    .sysclk                 ( clk               ) ,
+    .phase_aH               ( phases_aH         ) ,
+    .phase_aL               ( phases_aL         ) ,
+    .phase_bH               ( phases_bH         ) ,
+    .phase_bL               ( phases_bL         ) ,
+    .phase_cH               ( phases_cH         ) ,
+    .phase_cL               ( phases_cL         ) ,
+    .hall_a                 ( halls_a           ) ,
+    .hall_b                 ( halls_b           ) ,
+    .hall_c                 ( halls_c           ) ,
+    .enc_a                  ( encoders_a        ) ,
+    .enc_b                  ( encoders_b        ) ,
+    .drv_ncs                ( drv_ncs           ) ,
+    .adc_ncs                ( adc_ncs           ) ,
+    .spi_slave_sck          ( spi_slave_sck     ) ,
+    .spi_slave_mosi         ( spi_slave_mosi    ) ,
+    .spi_slave_ncs          ( spi_slave_ncs     ) ,
+    .spi_slave_miso         ( spi_slave_miso    ) ,
+    .spi_master_sck         ( spi_master_sck    ) ,
+    .spi_master_mosi        ( spi_master_mosi   ) ,
+    .spi_master_miso        ( 1'b0              )
+);
+
+// Clocks since the chip select fell for the current transfer
+integer transfer_clock = 0;
+always @(posedge clk) transfer_clock = transfer_clock + 1;
+
+// Encoder motion, changed between clock edges so it's never sampled mid change. While
+// spinning, encoder 0 steps forwards every clock, 1 backwards every clock, 2 forwards every
+// other clock & 3 backwards every third. A single edge at `edge_at` moves encoder 0
+// forwards & 1 backwards.
+reg spinning = 0;
+integer edge_at = -1;
+integer spin_clock = 0;
+integer steps [NUM_ENCODERS-1:0];
+integer k;
+
+initial for (k = 0; k < NUM_ENCODERS; k = k + 1) steps[k] = 0;
+
+task step;
+    input integer enc;
+    input integer dir;
+    begin
+        enc_pos[enc] = enc_pos[enc] + dir;
+        steps[enc] = steps[enc] + dir;
+    end
+endtask
+
+always @(negedge clk) begin
+    if ( spinning ) begin
+        spin_clock = spin_clock + 1;
+        step(0, 1);
+        step(1, -1);
+        if ( spin_clock % 2 == 0 ) step(2, 1);
+        if ( spin_clock % 3 == 0 ) step(3, -1);
+    end
+    if ( edge_at >= 0 && transfer_clock == edge_at ) begin
+        step(0, 1);
+        step(1, -1);
+        edge_at = -1;
+    end
+end
+
+// One mode 0 transfer of CMD_UPDATE_MTRS_ALL with zero duty cycles. MISO is sampled on
+// the rising SCK edge like the STM32 does.
+reg [7:0] response [RES_ALL_LEN-1:0];
+reg [7:0] request;
+reg [7:0] received;
+integer byte_num, bit_num;
+
+task update_transfer;
+    begin
+        @(posedge clk);
+        spi_slave_ncs = 0;
+        transfer_clock = 0;
+        repeat ( SCK_HALF_PERIOD ) @(posedge clk);
+
+        for (byte_num = 0; byte_num < RES_ALL_LEN; byte_num = byte_num + 1) begin
+            request = ( byte_num == 0 ) ? CMD_UPDATE_MTRS_ALL : 8'h00;
+            for (bit_num = 7; bit_num >= 0; bit_num = bit_num - 1) begin
+                spi_slave_mosi = request[bit_num];
+                repeat ( SCK_HALF_PERIOD ) @(posedge clk);
+                spi_slave_sck = 1;
+                received = { received[6:0], spi_slave_miso };
+                repeat ( SCK_HALF_PERIOD ) @(posedge clk);
+                spi_slave_sck = 0;
+            end
+            response[byte_num] = received;
+        end
+
+        repeat ( SCK_HALF_PERIOD ) @(posedge clk);
+        spi_slave_ncs = 1;
+        repeat ( TRANSFER_GAP ) @(posedge clk);
+    end
+endtask
+
+integer failures = 0;
+integer total [NUM_ENCODERS-1:0];
+reg [15:0] delta;
+reg [7:0] seq;
+reg [7:0] seq_prev;
+integer offset;
+integer transfers;
+integer latched_before;
+
+task fail;
+    input [8*64-1:0] name;
+    begin
+        failures = failures + 1;
+        $display("FAIL: %0s at %0t", name, $time);
+    end
+endtask
+
+// Checks the status & sequence number of the latest transfer, and adds its deltas on
+task read_response;
+    begin
+        if ( response[0][7] != 1 ) fail("status byte without sys_rdy");
+        seq = response[RES_ALL_SEQ];
+        if ( seq != seq_prev + 8'd1 ) begin
+            fail("sequence number skipped");
+            $display("    sequence %0d after %0d", seq, seq_prev);
+        end
+        seq_prev = seq;
+        for (k = 0; k < NUM_ENCODERS; k = k + 1) begin
+            delta = { response[2*k+1], response[2*k+2] };
+            total[k] = total[k] + $signed(delta);
+        end
+    end
+endtask
+
+task start_totals;
+    begin
+        for (k = 0; k < NUM_ENCODERS; k = k + 1) begin
+            total[k] = 0;
+            steps[k] = 0;
+        end
+    end
+endtask
+
+task check_totals;
+    input [8*64-1:0] name;
+    begin
+        for (k = 0; k < NUM_ENCODERS; k = k + 1) begin
+            if ( total[k] != steps[k] ) begin
+                fail(name);
+                $display("    encoder %0d: deltas add up to %0d, %0d steps", k, total[k], steps[k]);
+            end
+        end
+    end
+endtask
+
+initial begin
+    // Let the design come out of its startup delay, then take the first sequence number
+    repeat ( 256 ) @(posedge clk);
+    update_transfer;
+    seq_prev = response[RES_ALL_SEQ];
+    update_transfer;
+    read_response;
+
+    // Highest edge rate: every transfer runs with encoders stepping on every clock
+    start_totals;
+    spinning = 1;
+    for (transfers = 0; transfers < 16; transfers = transfers + 1) begin
+        update_transfer;
+        read_response;
+    end
+    spinning = 0;
+    update_transfer;
+    read_response;
+    check_totals("deltas at the highest edge rate don't add up");
+    $display("highest edge rate: %0d, %0d, %0d, %0d steps over %0d transfers",
+             steps[0], steps[1], steps[2], steps[3], transfers + 1);
+
+    // A single edge at every clock across the command byte
+    latched_before = 0;
+    for (offset = SWEEP_START; offset <= SWEEP_END; offset = offset + 1) begin
+        start_totals;
+        edge_at = offset;
+        update_transfer;
+        read_response;
+        if ( total[0] == 1 ) latched_before = latched_before + 1;
+        update_transfer;
+        read_response;
+        check_totals("edge during the command byte lost or counted twice");
+        if ( edge_at != -1 ) fail("edge never issued");
+    end
+    // Sweeping the latch has to catch the edge landing on either side of it
+    if ( latched_before == 0 ) fail("edge never landed before the latch");
+    if ( latched_before == SWEEP_END - SWEEP_START + 1 ) fail("edge never landed after the latch");
+    $display("single edge: in the first transfer for %0d of %0d offsets",
+             latched_before, SWEEP_END - SWEEP_START + 1);
+
+    $display("encoder_latch_tb: %0d failures", failures);
+    if ( failures != 0 ) $display("FAIL: encoder_latch_tb");
+    $finish;
+end
+
+endmodule
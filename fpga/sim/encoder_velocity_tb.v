@@ -0,0 +1,204 @@
+`timescale 1ns/1ps
+
+`include "BLDC_Encoder_Velocity.v"
+
+/*
+*  Self-checking testbench for BLDC_Encoder_Velocity, with the parameters robocup.v uses.
+*
+*  A simulated encoder steps at constant rates, from the highest the module can see (an
+*  edge every clock cycle) down to periods either side of the 24 bit timestamp limit, and
+*  stops dead to model a stalled wheel. Each velocity update is checked against the exact
+*  rate, saturation, and the bound the time since the last edge puts on it. Every check
+*  that doesn't hold prints a line starting with FAIL.
+*
+*  The periods near the timestamp limit take a couple of hundred million clock cycles, so
+*  this runs for a few minutes. Run it with `make fpga-tests`.
+*/
+
+module encoder_velocity_tb;
+
+localparam CLK_FREQ         = 18432000;
+localparam WINDOW           = 18432;
+localparam TIMESTAMP_WIDTH  = 24;
+localparam FRAC_WIDTH       = 8;
+
+localparam signed [63:0] EDGE_SCALE      = CLK_FREQ * ( 64'd1 << FRAC_WIDTH );
+localparam signed [63:0] MAX_VELOCITY    = 64'h7FFFFFFF;
+localparam integer       TIMESTAMP_LIMIT = 1 << TIMESTAMP_WIDTH;
+
+// Cycles from the end of a window until its update is out of the divider
+localparam UPDATE_DELAY     = 64;
+
+reg clk = 0;
+always #1 clk = !clk;
+
+integer cycle = 0;
+always @(posedge clk) cycle = cycle + 1;
+
+// The simulated encoder, a quadrature step every `edge_period` cycles in `edge_dir`
+integer edge_period = 0;        // 0 stops the encoder
+integer edge_dir = 1;
+integer edge_timer = 0;
+integer edges = 0;
+integer last_edge = 0;          // cycle of the latest edge
+integer enc_pos = 0;
+
+wire [1:0] enc = { enc_pos[1], enc_pos[1] ^ enc_pos[0] };
+
+// Changed between clock edges so the module never samples it mid change
+always @(negedge clk) begin
+    if ( edge_period != 0 ) begin
+        edge_timer = edge_timer + 1;
+        if ( edge_timer >= edge_period ) begin
+            edge_timer = 0;
+            enc_pos = enc_pos + edge_dir;
+            edges = edges + 1;
+            last_edge = cycle;
+        end
+    end
+end
+
+wire signed [31:0] velocity;
+
+BLDC_Encoder_Velocity #(
+    .CLK_FREQ           ( CLK_FREQ          ) ,
+    .WINDOW             ( WINDOW            ) ,
+    .TIMESTAMP_WIDTH    ( TIMESTAMP_WIDTH   ) ,
+    .FRAC_WIDTH         ( FRAC_WIDTH        )
+    ) dut (
+    .clk                ( clk               ) ,
+    .enc                ( enc               ) ,
+    .velocity           ( velocity          )
+);
+
+integer failures = 0;
+integer checks = 0;
+reg signed [63:0] sample;
+reg signed [63:0] previous;
+reg signed [63:0] expected;
+reg signed [63:0] bound;
+integer since_edge;
+integer i;
+
+task fail;
+    input [8*48-1:0] name;
+    begin
+        failures = failures + 1;
+        $display("FAIL: %0s: velocity %0d at cycle %0d, %0d cycles after the last edge",
+                 name, sample, cycle, cycle - last_edge);
+    end
+endtask
+
+// Waits for the update after the next window and samples it
+task next_update;
+    begin
+        @(posedge clk);
+        while ( !dut.window_done ) @(posedge clk);
+        repeat ( UPDATE_DELAY ) @(posedge clk);
+        sample = velocity;
+        since_edge = cycle - last_edge;
+        checks = checks + 1;
+    end
+endtask
+
+// Exact velocity of a steady edge period, saturated like the module
+task rate_velocity;
+    input integer period;
+    input integer dir;
+    begin
+        expected = EDGE_SCALE / period;
+        if ( expected > MAX_VELOCITY ) expected = MAX_VELOCITY;
+        if ( dir < 0 ) expected = -expected;
+    end
+endtask
+
+task start_encoder;
+    input integer period;
+    input integer dir;
+    begin
+        @(negedge clk);
+        edge_period = period;
+        edge_dir = dir;
+        edge_timer = 0;
+        edges = 0;
+    end
+endtask
+
+// Runs at a steady rate and checks a few updates once the previous rate has left the window
+task check_rate;
+    input [8*48-1:0] name;
+    input integer period;
+    input integer dir;
+    begin
+        start_encoder(period, dir);
+        rate_velocity(period, dir);
+        next_update;
+        next_update;
+        for (i = 0; i < 4; i = i + 1) begin
+            next_update;
+            if ( sample - expected > 1 || expected - sample > 1 ) fail(name);
+        end
+        $display("%0s: %0d, expected %0d", name, sample, expected);
+    end
+endtask
+
+initial begin
+    // Steady rates, exact to the lsb. An edge every cycle or every other one is past the
+    // largest velocity that fits and saturates.
+    check_rate("1000 cycles/edge forwards", 1000, 1);
+    check_rate("1000 cycles/edge backwards", 1000, -1);
+    check_rate("3 cycles/edge forwards", 3, 1);
+    check_rate("2 cycles/edge backwards", 2, -1);
+    check_rate("max edge rate forwards", 1, 1);
+    check_rate("max edge rate backwards", 1, -1);
+    check_rate("max edge rate reversing", 1, 1);
+
+    // Stalled wheel: from a steady speed the encoder stops dead. The velocity can only fall,
+    // one edge over the time since the last one bounds it, and it's 0 once that time has
+    // passed the timestamp limit.
+    check_rate("before stalling", 1000, 1);
+    start_encoder(0, 1);
+    previous = sample;
+    while ( cycle - last_edge < TIMESTAMP_LIMIT + 2 * WINDOW ) begin
+        next_update;
+        if ( sample < 0 ) fail("stalled, sign flipped");
+        if ( sample > previous ) fail("stalled, rose");
+        if ( since_edge > 2 * WINDOW ) begin
+            // The window ended UPDATE_DELAY cycles back, with a little slack for the sync
+            bound = EDGE_SCALE / ( since_edge - 2 * UPDATE_DELAY );
+            if ( sample > bound ) fail("stalled, above one edge since the last");
+        end
+        if ( sample == 0 && since_edge < TIMESTAMP_LIMIT - 2 * WINDOW ) fail("stalled, 0 too early");
+        previous = sample;
+    end
+    if ( sample != 0 ) fail("stalled, not 0 after the timestamp limit");
+    $display("stalled: %0d after %0d cycles", sample, since_edge);
+
+    // An edge period just inside the timestamp limit still has a velocity, from the second
+    // edge on, and it holds all the way to the next edge
+    start_encoder(TIMESTAMP_LIMIT - 2 * WINDOW, 1);
+    rate_velocity(TIMESTAMP_LIMIT - 2 * WINDOW, 1);
+    wait ( edges == 2 );
+    while ( edges == 2 ) begin
+        next_update;
+        if ( edges == 2 && ( sample - expected > 1 || expected - sample > 1 ) ) fail("just inside the timestamp limit");
+    end
+    $display("just inside the timestamp limit: %0d, expected %0d", sample, expected);
+
+    // Just past it every edge is the first after a stop, so the velocity stays 0 rather than
+    // the timestamps wrapping into a bogus period
+    start_encoder(0, 1);
+    while ( sample != 0 ) next_update;
+    start_encoder(TIMESTAMP_LIMIT + 2 * WINDOW, 1);
+    while ( edges < 3 ) begin
+        next_update;
+        if ( sample != 0 ) fail("just past the timestamp limit");
+    end
+    $display("just past the timestamp limit: %0d", sample);
+
+    $display("encoder_velocity_tb: %0d updates checked, %0d failures", checks, failures);
+    if ( failures != 0 ) $display("FAIL: encoder_velocity_tb");
+    $finish;
+end
+
+endmodule
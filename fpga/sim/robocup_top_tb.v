@@ -186,7 +186,6 @@ task motors_on;
     begin
         spi_on();
         spi(8'hb0);
-        spi(8'h00);
         spi_off();
     end
 endtask
@@ -195,7 +194,6 @@ task motors_off;
     begin
         spi_on();
         spi(8'h30);
-        spi(8'h00);
         spi_off();
     end
 endtask
@@ -0,0 +1,221 @@
+`timescale 1ns/1ps
+
+`include "BLDC_Motor.v"
+
+/*
+*  Self-checking testbench for sinusoidal commutation, against six-step on the same motor.
+*
+*  A simulated motor spins at a constant speed, driven once with six-step and once with
+*  sinusoidal commutation. Every PWM period the average voltage on each phase is measured
+*  from its switch states, with dead time and a floating phase counted as the midpoint, and
+*  turned into a voltage vector. The part of the vector at 90 degrees to the rotor is what
+*  makes torque.
+*
+*  Six-step has to show its known torque ripple, roughly 13%, and the vector sweeping a
+*  whole sector, or the measurement itself is off. Sinusoidal has to drive the motor with
+*  the ripple and the sweep both flat, centred on the average six-step vector. Every check
+*  that doesn't hold prints a line starting with FAIL. Run it with `make fpga-tests`.
+*/
+
+module sinusoidal_tb;
+
+localparam EDGE_CYCLES      = 600;          // clock cycles between encoder edges
+localparam EDGES_PER_REV    = 256;          // per electrical revolution, 2048 edges & 8 pole pairs
+localparam ANGLE_PER_EDGE   = 6;            // rotor angle units of 1536 per electrical revolution
+localparam PWM_PERIOD       = 1023;
+localparam DUTY_CYCLE       = 14'h0800;     // 25% forwards, in the 0x93 high resolution format
+localparam STARTUP_CYCLES   = 2300000;      // long enough for the `BLDC_Driver` startup ramp
+localparam MEASURE_PERIODS  = 600;          // 4 electrical revolutions
+
+reg clk = 0;
+reg en = 0;
+reg measure = 0;
+
+integer edge_count = 0;
+integer edge_timer = 0;
+
+// The simulated motor
+wire [10:0] true_angle = ( edge_count % EDGES_PER_REV ) * ANGLE_PER_EDGE;
+wire [2:0] sector = true_angle / 256;
+wire [2:0] hall = ( sector == 0 ) ? 3'b101 :
+                  ( sector == 1 ) ? 3'b100 :
+                  ( sector == 2 ) ? 3'b110 :
+                  ( sector == 3 ) ? 3'b010 :
+                  ( sector == 4 ) ? 3'b011 : 3'b001;
+wire [1:0] enc = ( edge_count % 4 == 0 ) ? 2'b00 :
+                 ( edge_count % 4 == 1 ) ? 2'b01 :
+                 ( edge_count % 4 == 2 ) ? 2'b11 : 2'b10;
+
+wire [2:0] six_step_phaseH, six_step_phaseL, sine_phaseH, sine_phaseL;
+
+always begin
+    #1 clk = !clk;
+end
+
+always @(posedge clk) begin
+    edge_timer = edge_timer + 1;
+    if ( edge_timer == EDGE_CYCLES ) begin
+        edge_timer = 0;
+        edge_count = edge_count + 1;
+    end
+end
+
+integer failures = 0;
+
+task fail;
+    input [8*64-1:0] name;
+    begin
+        failures = failures + 1;
+        $display("FAIL: %0s", name);
+    end
+endtask
+
+initial begin
+    #20 en = 1;
+    #( 2 * STARTUP_CYCLES ) measure = 1;
+    #( 2 * MEASURE_PERIODS * ( PWM_PERIOD + 1 ) ) measure = 0;
+    six_step_meter.report;
+    sine_meter.report;
+
+    if ( six_step_meter.samples < MEASURE_PERIODS - 1 || sine_meter.samples < MEASURE_PERIODS - 1 ) begin
+        fail("missed PWM periods while measuring");
+    end else begin
+        // Six-step, to check the measurement: its ripple and a 60 degree sweep
+        if ( six_step_meter.ripple < 8.0 ) fail("six-step torque ripple too low to be measured right");
+        if ( six_step_meter.lead_range < 45.0 ) fail("six-step vector not sweeping a sector");
+
+        // Sinusoidal, flat and on the average six-step vector
+        if ( sine_meter.perp_mean < 0.01 ) fail("sinusoidal commutation not driving the motor");
+        if ( sine_meter.ripple > 5.0 ) fail("sinusoidal torque ripple above 5%");
+        if ( sine_meter.lead_range > 10.0 ) fail("sinusoidal vector sweeping more than 10 degrees");
+        if ( sine_meter.lead_mean - six_step_meter.lead_mean > 15.0 ||
+             six_step_meter.lead_mean - sine_meter.lead_mean > 15.0 )
+            fail("sinusoidal vector more than 15 degrees off the six-step average");
+    end
+
+    $display("sinusoidal_tb: %0d failures", failures);
+    if ( failures != 0 ) $display("FAIL: sinusoidal_tb");
+    $finish;
+end
+
+BLDC_Motor #(
+    .SINUSOIDAL_COMMUTATION ( 0 )
+    ) six_step_motor (
+    .clk                ( clk               ) ,
+    .en                 ( en                ) ,
+    .reset_enc_count    ( 1'b0              ) ,
+    .reset_hall_count   ( 1'b0              ) ,
+    .duty_cycle         ( DUTY_CYCLE        ) ,
+    .pwm_period         ( PWM_PERIOD        ) ,
+    .enc                ( enc               ) ,
+    .hall               ( hall              ) ,
+    .phaseH             ( six_step_phaseH   ) ,
+    .phaseL             ( six_step_phaseL   )
+);
+
+BLDC_Motor #(
+    .SINUSOIDAL_COMMUTATION ( 1 )
+    ) sine_motor (
+    .clk                ( clk               ) ,
+    .en                 ( en                ) ,
+    .reset_enc_count    ( 1'b0              ) ,
+    .reset_hall_count   ( 1'b0              ) ,
+    .duty_cycle         ( DUTY_CYCLE        ) ,
+    .pwm_period         ( PWM_PERIOD        ) ,
+    .enc                ( enc               ) ,
+    .hall               ( hall              ) ,
+    .phaseH             ( sine_phaseH       ) ,
+    .phaseL             ( sine_phaseL       )
+);
+
+sinusoidal_tb_meter #( .PERIOD( PWM_PERIOD + 1 ), .SINUSOIDAL( 0 ) ) six_step_meter ( clk, measure, six_step_phaseH, six_step_phaseL, true_angle );
+sinusoidal_tb_meter #( .PERIOD( PWM_PERIOD + 1 ), .SINUSOIDAL( 1 ) ) sine_meter ( clk, measure, sine_phaseH, sine_phaseL, true_angle );
+
+endmodule
+
+
+// Voltage vector statistics for one motor
+module sinusoidal_tb_meter ( clk, measure, phaseH, phaseL, angle );
+
+parameter PERIOD = 1024;
+parameter SINUSOIDAL = 0;
+
+input clk, measure;
+input [2:0] phaseH, phaseL;
+input [10:0] angle;
+
+localparam PI = 3.14159265358979;
+
+integer cycle = 0;
+integer high [2:0];
+integer low [2:0];
+integer p;
+integer samples = 0;
+
+real v [2:0];
+real alpha, beta, magnitude, lead, perp;
+real perp_min = 1.0e9, perp_max = -1.0e9, perp_sum = 0.0, lead_sum = 0.0, lead_min = 1.0e9, lead_max = -1.0e9;
+
+initial begin
+    for (p = 0; p < 3; p = p + 1) begin
+        high[p] = 0;
+        low[p] = 0;
+    end
+end
+
+always @(posedge clk) begin
+    if ( measure ) begin
+        for (p = 0; p < 3; p = p + 1) begin
+            if ( phaseH[p] ) high[p] = high[p] + 1;
+            if ( phaseL[p] ) low[p] = low[p] + 1;
+        end
+        cycle = cycle + 1;
+
+        if ( cycle == PERIOD ) begin
+            for (p = 0; p < 3; p = p + 1) begin
+                v[p] = ( high[p] + ( PERIOD - high[p] - low[p] ) / 2.0 ) / PERIOD;
+                high[p] = 0;
+                low[p] = 0;
+            end
+            cycle = 0;
+
+            // Phase A is bit 2
+            alpha = ( 2.0 * v[2] - v[1] - v[0] ) / 3.0;
+            beta = ( v[1] - v[0] ) / $sqrt(3.0);
+            magnitude = $sqrt( alpha * alpha + beta * beta );
+
+            lead = $atan2( beta, alpha ) - angle * 2.0 * PI / 1536.0;
+            while ( lead > PI ) lead = lead - 2.0 * PI;
+            while ( lead <= -PI ) lead = lead + 2.0 * PI;
+            lead = lead * 180.0 / PI;
+            perp = magnitude * $sin( lead * PI / 180.0 );
+            if ( perp < 0.0 ) perp = -perp;
+
+            samples = samples + 1;
+            perp_sum = perp_sum + perp;
+            lead_sum = lead_sum + lead;
+            if ( perp < perp_min ) perp_min = perp;
+            if ( perp > perp_max ) perp_max = perp;
+            if ( lead < lead_min ) lead_min = lead;
+            if ( lead > lead_max ) lead_max = lead;
+        end
+    end
+end
+
+// Results of the measurement, set by `report`
+real perp_mean = 0.0, ripple = 0.0, lead_mean = 0.0, lead_range = 0.0;
+
+task report;
+    begin
+        if ( samples > 0 ) begin
+            perp_mean = perp_sum / samples;
+            lead_mean = lead_sum / samples;
+            lead_range = lead_max - lead_min;
+            if ( perp_mean > 0.0 ) ripple = 100.0 * ( perp_max - perp_min ) / perp_mean;
+        end
+        $display ("%s: %0d periods, torque %f, ripple %f%%, lead angle %f to %f, mean %f degrees",
+                  SINUSOIDAL ? "sinusoidal" : "six-step  ", samples, perp_mean, ripple, lead_min, lead_max, lead_mean);
+    end
+endtask
+
+endmodule
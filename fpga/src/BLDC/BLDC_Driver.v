@@ -4,6 +4,15 @@
 *  A BLDC controller that includes hall sensor error detection and incremental
 *  duty cycles during startup for reducing motor startup current.
 *
+*  The duty cycle has more resolution than there are clock cycles in a PWM period,
+*  so it's scaled onto the runtime PWM period once per period and the remainder is
+*  carried over to the next one. The on time dithers between the two nearest clock
+*  cycles and averages out to the requested duty cycle.
+*
+*  With `SINUSOIDAL` set, the phases are driven with space vector PWM at an angle that
+*  follows `rotor_angle` instead of the six-step pattern from the halls, whenever
+*  `rotor_angle_valid` is set. The duty cycle scales the amplitude of the waveform.
+*
 */
 
 `ifndef _BLDC_DRIVER_
@@ -11,6 +20,7 @@
 
 `include "Hall_Effect_Sensor.v"
 `include "Phase_Driver.v"
+`include "SVPWM_Table.v"
 
 /*
 *  If `STARTUP_INCREMENT_COMPLETELY` is defined, the state machine will ignore the
@@ -25,22 +35,28 @@
 
 
 // BLDC_Driver module
-module BLDC_Driver ( clk, en, hall, duty_cycle, direction, phaseH, phaseL, connected, fault );
+module BLDC_Driver ( clk, en, hall, rotor_angle, rotor_angle_valid, duty_cycle, pwm_period, direction, phaseH, phaseL, connected, fault );
 
 // Module parameters - passed parameters will overwrite the values here
-parameter PHASE_DRIVER_MAX_COUNTER =            ( 'h3FF );
-parameter MAX_DUTY_CYCLE =                      ( 'h3FF );
-parameter DUTY_CYCLE_STEP_RES =                 ( 1 );
+parameter PWM_PERIOD_WIDTH =                    ( 11 );
+parameter MAX_DUTY_CYCLE =                      ( 'h1FFF );
 parameter DEAD_TIME =                           ( 8 );
+parameter SINUSOIDAL =                          ( 0 );
+parameter SECTOR_ANGLE =                        ( 256 );                // `rotor_angle` units in one hall sector, must match the `SVPWM_Table`
+parameter VECTOR_OFFSET =                       ( 5 * SECTOR_ANGLE );   // Voltage vector angle from the rotor angle, the average of the six-step pattern
 
 // Local parameters - can not be altered outside this module
 `include "log2-macro.v"     // This must be included here
 localparam DUTY_CYCLE_WIDTH =   `LOG2( MAX_DUTY_CYCLE );
+localparam ROTOR_ANGLE_WIDTH =  ( `LOG2( SECTOR_ANGLE ) + 3 );
 
 // Module inputs/outputs
 input clk, en;
 input [2:0] hall;
+input [ROTOR_ANGLE_WIDTH-1:0] rotor_angle;   // From `BLDC_Rotor_Angle`, only used with `SINUSOIDAL` set
+input rotor_angle_valid;
 input [DUTY_CYCLE_WIDTH-1:0] duty_cycle;
+input [PWM_PERIOD_WIDTH-1:0] pwm_period;     // PWM period in clock cycles, minus 1
 input direction;
 output reg [2:0] phaseH, phaseL;
 output reg connected = 0;
@@ -53,7 +69,8 @@ output reg fault = 0;
 localparam NUM_PHASES =                  3;  // This will always be constant
 localparam HALL_STATE_STEADY_COUNT =   125;  // Threshold value in determining when the hall effect sensor is locked into an error state
 
-localparam STARTUP_COUNTER_WIDTH =       13;  // Counter for ticking the startup pwm duty_cycle changes. Time expires when register overflows to 0
+localparam STARTUP_COUNTER_WIDTH =       ( 23 - DUTY_CYCLE_WIDTH );  // Counter for ticking the startup pwm duty_cycle changes. Time expires when register overflows to 0
+                                                                    // Scaled with the duty cycle so ramping through the full range always takes 2^23 clock cycles
 localparam STARTUP_STEP_COUNTER_WIDTH =  8;  // The counter that tracks the number of startup cycle periods. ie. how many times the duty cycle has been updated
 // The startup time is equal to (1/18.432) * 2^(STARTUP_COUNTER_WIDTH + STARTUP_STEP_COUNTER_WIDTH)
 
@@ -61,12 +78,23 @@ localparam STARTUP_STEP_COUNTER_WIDTH =  8;  // The counter that tracks the numb
 // ===============================================
 localparam STARTUP_END_DUTY_CYCLE =         ( MAX_DUTY_CYCLE >> 2 );                        // Divide by 4 to get 25% of the max speed for startup state
 localparam STARTUP_END_STEP_COUNT =         ( (1 << STARTUP_STEP_COUNTER_WIDTH) - 1 );      // Startup state exiting computed using this value and the MIN_DUTY_CYCLE for fixed time ramping
-localparam STARTUP_PERIOD_CLOCK_CYCLES =    ( 1 << (DUTY_CYCLE_WIDTH + 3) );                // The number of input clock cycles in one period of the startup counter's clock - this is best
-                                                                                            // set to a value that evenly divides into the PWM period from 'Phase_Driver.v'
+localparam STARTUP_PERIOD_CLOCK_CYCLES =    ( 1 << STARTUP_COUNTER_WIDTH );                 // The number of input clock cycles in one period of the startup counter's clock
 localparam HALL_CHECK_COUNTER_WIDTH =       `LOG2( HALL_STATE_STEADY_COUNT );               // Counter used for reduced sampling of the hall effect sensor
-localparam PHASE_DRIVER_COUNTER_WIDTH =     `LOG2( PHASE_DRIVER_MAX_COUNTER );
+localparam PWM_COMPARE_WIDTH =              ( PWM_PERIOD_WIDTH + 1 );                       // Holds a full period, `pwm_period + 1`
+localparam PWM_PRODUCT_WIDTH =              ( DUTY_CYCLE_WIDTH + PWM_COMPARE_WIDTH );
+localparam PWM_MUL_STEP_WIDTH =             `LOG2( PWM_COMPARE_WIDTH + 1 );
 localparam MIN_DUTY_CYCLE =                 ( 1 );
 
+// Sinusoidal commutation, angles are in units of 1/SECTOR_ANGLE of 60 degrees
+localparam TURN_ANGLE =                     ( 6 * SECTOR_ANGLE );
+localparam HALF_TURN_ANGLE =                ( 3 * SECTOR_ANGLE );
+localparam QUARTER_TURN_ANGLE =             ( 3 * SECTOR_ANGLE / 2 );                       // The `SVPWM_Table` holds a quarter wave
+localparam PHASE_ANGLE =                    ( 2 * SECTOR_ANGLE );                           // Between phases A, B & C
+localparam SVPWM_ADDR_WIDTH =               `LOG2( QUARTER_TURN_ANGLE );
+localparam SVPWM_VALUE_WIDTH =              ( 12 );
+localparam SINE_PRODUCT_WIDTH =             ( PWM_PRODUCT_WIDTH + SVPWM_VALUE_WIDTH );
+localparam SINE_MUL_STEP_WIDTH =            `LOG2( SVPWM_VALUE_WIDTH + 1 );
+
 
 // State machine declarations for readability
 // ===============================================
@@ -116,6 +144,26 @@ wire hall_recheck = ( hall_hardware_err_cnt == HALL_STATE_STEADY_COUNT ) ||
 
 reg startup_wait_delay = 0;
 
+// Scaling the duty cycle onto the PWM period. The multiply is shift & add, one bit
+// per clock cycle, so it doesn't use any of the hardware multipliers. It finishes
+// many times over in the shortest PWM period.
+reg  [PWM_PERIOD_WIDTH-1:0]           pwm_counter               = 0;    // Runs in step with the counters of the `Phase_Driver`s
+reg  [PWM_MUL_STEP_WIDTH-1:0]         pwm_mul_steps             = 0;
+reg  [PWM_COMPARE_WIDTH-1:0]          pwm_mul_multiplier        = 0;
+reg  [PWM_PRODUCT_WIDTH-1:0]          pwm_mul_multiplicand      = 0,
+                                      pwm_mul_acc               = 0,
+                                      pwm_product               = 0;    // duty_cycle_s * ( pwm_period + 1 )
+reg  [DUTY_CYCLE_WIDTH-1:0]           pwm_residue               = 0;    // Fraction of a clock cycle left over from the last period
+reg  [PWM_COMPARE_WIDTH-1:0]          pwm_compare               = 0;    // High side on time for this period in clock cycles
+
+wire [PWM_PRODUCT_WIDTH:0]            pwm_dithered              = pwm_product + pwm_residue;
+
+// Sinusoidal commutation. Each phase's table value is multiplied with `pwm_product` in
+// turn using a single table lookup and shift & add multiplier, and the result is added
+// to or taken from half of the PWM period. Dithered the same way as `pwm_compare`.
+wire                                  sine_active               = ( SINUSOIDAL != 0 ) && rotor_angle_valid;
+reg  [PWM_COMPARE_WIDTH-1:0]          sine_compare              [NUM_PHASES-1:0];   // High side on time of each phase for this period
+
 // Variable used for instantiation of the number of phases
 genvar j;
 
@@ -377,6 +425,121 @@ begin : MOTOR_STATES
 end  // MOTOR_STATES
 
 
+always @(posedge clk)
+begin : PWM_SCALING
+    if ( pwm_mul_steps == 0 ) begin
+        pwm_product             <= pwm_mul_acc;
+        pwm_mul_acc             <= 0;
+        pwm_mul_multiplicand    <= duty_cycle_s;
+        pwm_mul_multiplier      <= pwm_period + 1;
+        pwm_mul_steps           <= PWM_COMPARE_WIDTH;
+    end else begin
+        if ( pwm_mul_multiplier[0] == 1 ) begin
+            pwm_mul_acc         <= pwm_mul_acc + pwm_mul_multiplicand;
+        end
+        pwm_mul_multiplicand    <= pwm_mul_multiplicand << 1;
+        pwm_mul_multiplier      <= pwm_mul_multiplier >> 1;
+        pwm_mul_steps           <= pwm_mul_steps - 1;
+    end
+
+    // Same wrap as the `Phase_Driver`s, so the on time only changes between periods
+    pwm_counter <= pwm_counter + 1;
+    if ( pwm_counter >= pwm_period ) begin
+        pwm_counter <= 0;
+        pwm_compare <= pwm_dithered[PWM_PRODUCT_WIDTH-1:DUTY_CYCLE_WIDTH];
+        pwm_residue <= pwm_dithered[DUTY_CYCLE_WIDTH-1:0];
+    end
+end  // PWM_SCALING
+
+
+generate
+if ( SINUSOIDAL != 0 )
+begin : GEN_SINE_SCALING
+    reg  [1:0]                          sine_phase                = 0;    // Phase whose product is being computed
+    reg  [SINE_MUL_STEP_WIDTH-1:0]      sine_mul_steps            = 0;
+    reg  [SVPWM_VALUE_WIDTH-1:0]        sine_mul_multiplier       = 0;
+    reg  [SINE_PRODUCT_WIDTH-1:0]       sine_mul_multiplicand     = 0,
+                                        sine_mul_acc              = 0;
+    reg                                 sine_mul_negative         = 0;
+    reg  [SINE_PRODUCT_WIDTH-1:0]       sine_product              [NUM_PHASES-1:0];   // pwm_product * |table value|
+    reg                                 sine_negative             [NUM_PHASES-1:0];
+    reg  [DUTY_CYCLE_WIDTH-1:0]         sine_residue              [NUM_PHASES-1:0];
+
+    wire [1:0]                          sine_phase_next           = ( sine_phase == NUM_PHASES - 1 ) ? 0 : sine_phase + 1;
+
+    // The voltage vector's angle, reversed for the other direction
+    wire [ROTOR_ANGLE_WIDTH:0]          sine_vector_sum           = rotor_angle + ( direction ? VECTOR_OFFSET % TURN_ANGLE : ( VECTOR_OFFSET + HALF_TURN_ANGLE ) % TURN_ANGLE );
+    wire [ROTOR_ANGLE_WIDTH-1:0]        sine_vector               = ( sine_vector_sum >= TURN_ANGLE ) ? sine_vector_sum - TURN_ANGLE : sine_vector_sum;
+
+    // Angle of the next phase, phase A is bit 2 like the `Hall_Effect_Sensor` outputs
+    wire [ROTOR_ANGLE_WIDTH-1:0]        sine_axis                 = ( sine_phase_next == 2 ) ? 0 :
+                                                                    ( sine_phase_next == 1 ) ? PHASE_ANGLE : 2 * PHASE_ANGLE;
+    wire [ROTOR_ANGLE_WIDTH-1:0]        sine_angle                = ( sine_vector >= sine_axis ) ? sine_vector - sine_axis : sine_vector + TURN_ANGLE - sine_axis;
+
+    // Fold the angle onto the quarter wave in the table
+    wire                                sine_angle_negative       = ( sine_angle >= QUARTER_TURN_ANGLE ) && ( sine_angle < 3 * QUARTER_TURN_ANGLE );
+    wire [ROTOR_ANGLE_WIDTH-1:0]        sine_addr                 = ( sine_angle < QUARTER_TURN_ANGLE )     ? sine_angle :
+                                                                    ( sine_angle < HALF_TURN_ANGLE )        ? HALF_TURN_ANGLE - 1 - sine_angle :
+                                                                    ( sine_angle < 3 * QUARTER_TURN_ANGLE ) ? sine_angle - HALF_TURN_ANGLE :
+                                                                                                              TURN_ANGLE - 1 - sine_angle;
+
+    wire [SVPWM_VALUE_WIDTH-1:0]        sine_table_value;
+    reg                                 sine_table_negative       = 0;    // In step with `sine_table_value`
+
+    wire [PWM_PRODUCT_WIDTH-1:0]        sine_half                 = ( pwm_period + 1 ) << ( DUTY_CYCLE_WIDTH - 1 );
+    wire [PWM_PRODUCT_WIDTH-1:0]        sine_dithered             [NUM_PHASES-1:0];
+
+    for (j = 0; j < NUM_PHASES; j = j + 1)
+    begin : GEN_SINE_DITHER
+        // Half of the product, with the table's full scale and the duty cycle's fraction bits removed
+        wire [PWM_PRODUCT_WIDTH-1:0] amplitude = sine_product[j][SINE_PRODUCT_WIDTH-1:SVPWM_VALUE_WIDTH+1];
+
+        assign sine_dithered[j] = ( sine_negative[j] ? sine_half - amplitude : sine_half + amplitude ) + sine_residue[j];
+    end
+
+    SVPWM_Table svpwmTable ( .clk( clk ), .addr( sine_addr[SVPWM_ADDR_WIDTH-1:0] ), .value( sine_table_value ) );
+
+    always @(posedge clk) sine_table_negative <= sine_angle_negative;
+
+    always @(posedge clk)
+    begin : SINE_SCALING
+        // The table is addressed with the next phase while this one is multiplied
+        if ( sine_mul_steps == 0 ) begin
+            sine_product[sine_phase]    <= sine_mul_acc;
+            sine_negative[sine_phase]   <= sine_mul_negative;
+            sine_phase                  <= sine_phase_next;
+            sine_mul_acc                <= 0;
+            sine_mul_multiplicand       <= pwm_product;
+            sine_mul_multiplier         <= sine_table_value;
+            sine_mul_negative           <= sine_table_negative;
+            sine_mul_steps              <= SVPWM_VALUE_WIDTH;
+        end else begin
+            if ( sine_mul_multiplier[0] == 1 ) begin
+                sine_mul_acc            <= sine_mul_acc + sine_mul_multiplicand;
+            end
+            sine_mul_multiplicand       <= sine_mul_multiplicand << 1;
+            sine_mul_multiplier         <= sine_mul_multiplier >> 1;
+            sine_mul_steps              <= sine_mul_steps - 1;
+        end
+
+        // Changes between periods like `pwm_compare`, and brakes like six-step does at 0
+        if ( pwm_counter >= pwm_period ) begin : SINE_WRAP
+            integer p;
+            for (p = 0; p < NUM_PHASES; p = p + 1) begin
+                if ( duty_cycle_s == 0 ) begin
+                    sine_compare[p]     <= 0;
+                    sine_residue[p]     <= 0;
+                end else begin
+                    sine_compare[p]     <= sine_dithered[p][PWM_PRODUCT_WIDTH-1:DUTY_CYCLE_WIDTH];
+                    sine_residue[p]     <= sine_dithered[p][DUTY_CYCLE_WIDTH-1:0];
+                end
+            end
+        end
+    end  // SINE_SCALING
+end
+endgenerate
+
+
 // The Hall_Effect_Sensor module does not use synced inputs - no need to as long as we sync things at the top module.
 Hall_Effect_Sensor hallEffectSensor ( .hall( hall_s ), .direction( direction ), .u( u ), .z( z ) );
 
@@ -387,17 +550,15 @@ for (j = 0; j < NUM_PHASES; j = j + 1)
 begin : GEN_PHASE_DRIVER
     Phase_Driver #(
         .DEAD_TIME              ( DEAD_TIME                         ) ,
-        .COUNTER_WIDTH          ( PHASE_DRIVER_COUNTER_WIDTH        ) ,
-        .MAX_COUNTER            ( PHASE_DRIVER_MAX_COUNTER          ) ,
-        .DUTY_CYCLE_WIDTH       ( DUTY_CYCLE_WIDTH                  ) ,
-        .MAX_DUTY_CYCLE         ( MAX_DUTY_CYCLE                    ) ,
-        .DUTY_CYCLE_STEP_RES    ( DUTY_CYCLE_STEP_RES               )
+        .COUNTER_WIDTH          ( PWM_PERIOD_WIDTH                  ) ,
+        .DUTY_CYCLE_WIDTH       ( PWM_COMPARE_WIDTH                 )
         ) motorPhaseDriver (
         .clk                    ( clk                               ) ,
-        .duty_cycle             ( (u[j] == 1) ? duty_cycle_s : 0    ) ,
-        .high_z                 ( z[j]                              ) ,
+        .duty_cycle             ( sine_active ? sine_compare[j] : (u[j] == 1) ? pwm_compare : 0 ) ,
+        .high_z                 ( sine_active ? 1'b0 : z[j]         ) ,
         .pwm_high               ( phaseH_s[j]                       ) ,
-        .pwm_low                ( phaseL_s[j]                       )
+        .pwm_low                ( phaseL_s[j]                       ) ,
+        .period                 ( pwm_period                        )
     );
 end
 endgenerate
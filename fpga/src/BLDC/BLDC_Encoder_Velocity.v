@@ -0,0 +1,199 @@
+/*
+*  BLDC_Encoder_Velocity.v
+*
+*  Estimates an encoder's velocity from encoder edges timestamped with the system clock.
+*
+*  Every WINDOW clock cycles the velocity is updated with the net number of edges since the
+*  last update, divided by the time between the last edge of the previous update and the
+*  latest edge. At high speeds that's a count over the window with the quantization of the
+*  window's end points removed. At low speeds where there are few or no edges in a window,
+*  it becomes the period between edges, and the time since the last edge bounds the estimate
+*  so it falls off towards 0 when the encoder stops. After 2^TIMESTAMP_WIDTH cycles without
+*  an edge, the velocity is 0.
+*
+*  The velocity is signed, in encoder ticks per second with FRAC_WIDTH fractional bits.
+*
+*/
+
+`ifndef _BLDC_ENCODER_VELOCITY_
+`define _BLDC_ENCODER_VELOCITY_
+
+// BLDC_Encoder_Velocity module
+module BLDC_Encoder_Velocity ( clk, enc, velocity );
+
+// Module parameters
+parameter CLK_FREQ =            ( 18432000  );
+parameter WINDOW =              ( 18432     );  // clock cycles between updates, 1ms at 18.432MHz
+parameter TIMESTAMP_WIDTH =     ( 24        );
+parameter VELOCITY_WIDTH =      ( 32        );
+parameter FRAC_WIDTH =          ( 8         );
+
+// Module inputs/outputs
+input clk;
+input [1:0] enc;
+output reg signed [VELOCITY_WIDTH-1:0] velocity = 0;
+// ===============================================
+
+
+// Local parameters that can not be altered outside of this file.
+// ===============================================
+localparam STEP_0 = 'b00;
+localparam STEP_1 = 'b01;
+localparam STEP_2 = 'b10;
+localparam STEP_3 = 'b11;
+
+localparam COUNT_WIDTH =        ( 16 );     // enough for an edge every clock cycle for a whole window
+localparam WINDOW_WIDTH =       ( 16 );
+localparam NUMERATOR_WIDTH =    ( 50 );
+localparam DIVIDER_STEP_WIDTH = (  6 );
+
+// Velocity of one edge per clock cycle, everything else is this divided by the cycles per edge
+localparam [NUMERATOR_WIDTH-1:0] EDGE_SCALE = CLK_FREQ * ( 64'd1 << FRAC_WIDTH );
+
+localparam [TIMESTAMP_WIDTH-1:0] MAX_TIMESTAMP = { TIMESTAMP_WIDTH{1'b1} };
+localparam [VELOCITY_WIDTH-2:0] MAX_VELOCITY = { (VELOCITY_WIDTH-1){1'b1} };
+
+
+// Register and Wire declarations
+// ===============================================
+reg [1:0] enc_d = 0; always @(posedge clk) enc_d <= enc;
+
+wire count_up =
+    ( ( enc_d == STEP_0 ) && ( enc == STEP_1 ) ) ||
+    ( ( enc_d == STEP_1 ) && ( enc == STEP_3 ) ) ||
+    ( ( enc_d == STEP_3 ) && ( enc == STEP_2 ) ) ||
+    ( ( enc_d == STEP_2 ) && ( enc == STEP_0 ) );
+
+wire count_down =
+    ( ( enc_d == STEP_2 ) && ( enc == STEP_3 ) ) ||
+    ( ( enc_d == STEP_3 ) && ( enc == STEP_1 ) ) ||
+    ( ( enc_d == STEP_1 ) && ( enc == STEP_0 ) ) ||
+    ( ( enc_d == STEP_0 ) && ( enc == STEP_2 ) );
+
+wire edge_now = count_up | count_down;
+
+reg [WINDOW_WIDTH-1:0]          window_counter  = 0;
+wire                            window_done     = ( window_counter == (WINDOW - 1) );
+
+// Everything is timed from the reference edge, the last edge at or before the previous update
+reg                             ref_valid       = 0;    // cleared when the encoder stops for too long
+reg [TIMESTAMP_WIDTH-1:0]       ref_age         = 0;    // cycles since the reference edge
+reg [TIMESTAMP_WIDTH-1:0]       last_edge_age   = 0;    // cycles since the latest edge
+reg [TIMESTAMP_WIDTH-1:0]       edge_span       = 0;    // cycles from the reference edge to the latest edge
+reg signed [COUNT_WIDTH-1:0]    edge_count      = 0;    // net edges since the reference edge
+reg                             window_edges    = 0;    // whether any edge was seen since the last update
+
+// Sequential divider, one quotient bit per clock
+reg [DIVIDER_STEP_WIDTH-1:0]    div_steps       = 0;
+reg [NUMERATOR_WIDTH-1:0]       div_quotient    = 0;
+reg [TIMESTAMP_WIDTH-1:0]       div_remainder   = 0;
+reg [TIMESTAMP_WIDTH-1:0]       div_denominator = 1;
+reg                             div_negative    = 0;
+reg                             div_is_bound    = 0;    // result only limits the current velocity
+
+wire [TIMESTAMP_WIDTH:0]        div_shifted     = { div_remainder, div_quotient[NUMERATOR_WIDTH-1] };
+wire [TIMESTAMP_WIDTH+1:0]      div_trial       = { 1'b0, div_shifted } - { 2'b0, div_denominator };
+wire                            div_borrow      = div_trial[TIMESTAMP_WIDTH+1];
+
+wire [COUNT_WIDTH-1:0]          edge_count_abs  = edge_count[COUNT_WIDTH-1] ? -edge_count : edge_count;
+wire [VELOCITY_WIDTH-2:0]       velocity_abs    = velocity[VELOCITY_WIDTH-1] ? -velocity : velocity;
+
+// The quotient once the last bit has been shifted in, saturated to the velocity's width
+wire [NUMERATOR_WIDTH-1:0]      div_result      = div_borrow ? { div_quotient[NUMERATOR_WIDTH-2:0], 1'b0 } : { div_quotient[NUMERATOR_WIDTH-2:0], 1'b1 };
+wire [VELOCITY_WIDTH-2:0]       div_result_sat  = ( div_result > MAX_VELOCITY ) ? MAX_VELOCITY : div_result[VELOCITY_WIDTH-2:0];
+
+
+// Begin main logic
+always @( posedge clk ) begin : EDGE_TIMING
+    window_counter <= window_done ? 0 : window_counter + 1;
+
+    if ( ref_age != MAX_TIMESTAMP )         ref_age <= ref_age + 1;
+    if ( last_edge_age != MAX_TIMESTAMP )   last_edge_age <= last_edge_age + 1;
+
+    if ( window_done ) begin
+        // The latest edge becomes the reference for the next update, and an edge on
+        // this exact cycle is the first one of the next update
+        if ( last_edge_age != MAX_TIMESTAMP )   ref_age <= last_edge_age + 1;
+        edge_span       <=  0;
+        edge_count      <=  0;
+        window_edges    <=  0;
+
+        if ( edge_now ) begin
+            last_edge_age   <=  0;
+            window_edges    <=  1;
+
+            if ( ref_valid ) begin
+                edge_span   <=  last_edge_age + 1;
+                edge_count  <=  count_up ? 1 : -1;
+            end else begin
+                ref_valid   <=  1;
+                ref_age     <=  0;
+            end
+        end
+
+    end else if ( edge_now ) begin
+        last_edge_age   <=  0;
+        window_edges    <=  1;
+
+        if ( ref_valid ) begin
+            edge_span   <=  ref_age + 1;
+            edge_count  <=  count_up ? edge_count + 1 : edge_count - 1;
+        end else begin
+            // The first edge after a stop only starts the timing
+            ref_valid   <=  1;
+            ref_age     <=  0;
+        end
+
+    end else if ( ref_valid && ( ref_age == MAX_TIMESTAMP ) ) begin
+        // Stopped for too long to time the next edge from this one
+        ref_valid       <=  0;
+        edge_count      <=  0;
+    end
+end
+
+always @( posedge clk ) begin : VELOCITY_UPDATE
+    if ( window_done ) begin
+        div_steps           <=  0;
+
+        if ( ~ref_valid ) begin
+            velocity        <=  0;
+
+        end else if ( window_edges && ( edge_count != 0 ) && ( edge_span != 0 ) ) begin
+            // Net edges over the time they took
+            div_quotient    <=  edge_count_abs * EDGE_SCALE;
+            div_remainder   <=  0;
+            div_denominator <=  edge_span;
+            div_negative    <=  edge_count[COUNT_WIDTH-1];
+            div_is_bound    <=  0;
+            div_steps       <=  NUMERATOR_WIDTH;
+
+        end else if ( window_edges ) begin
+            // Edges that cancel out, the encoder is sitting on an edge
+            velocity        <=  0;
+
+        end else if ( last_edge_age != 0 ) begin
+            // No edges, so the next one is at least this far away
+            div_quotient    <=  EDGE_SCALE;
+            div_remainder   <=  0;
+            div_denominator <=  last_edge_age;
+            div_negative    <=  velocity[VELOCITY_WIDTH-1];
+            div_is_bound    <=  1;
+            div_steps       <=  NUMERATOR_WIDTH;
+        end
+
+    end else if ( div_steps != 0 ) begin
+        div_steps           <=  div_steps - 1;
+        div_quotient        <=  { div_quotient[NUMERATOR_WIDTH-2:0], ~div_borrow };
+        div_remainder       <=  div_borrow ? div_shifted[TIMESTAMP_WIDTH-1:0] : div_trial[TIMESTAMP_WIDTH-1:0];
+
+        if ( div_steps == 1 ) begin
+            if ( ~div_is_bound || ( div_result_sat < velocity_abs ) ) begin
+                velocity    <=  div_negative ? -$signed({ 1'b0, div_result_sat }) : $signed({ 1'b0, div_result_sat });
+            end
+        end
+    end
+end
+
+endmodule
+
+`endif
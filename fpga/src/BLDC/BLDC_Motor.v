@@ -15,17 +15,22 @@
 `include "BLDC_Hall_Counter.v"
 `include "BLDC_Encoder_Counter.v"
 `include "BLDC_Encoder_Checker.v"
+`include "BLDC_Encoder_Velocity.v"
+`include "BLDC_Rotor_Angle.v"
 `include "IIR_LowPass_Filter.v"
 
 
 // BLDC_Motor module
-module BLDC_Motor ( clk, en, reset_enc_count, reset_hall_count, duty_cycle, enc, hall, phaseH, phaseL, enc_count, hall_count, has_error );
+module BLDC_Motor ( clk, en, reset_enc_count, reset_hall_count, duty_cycle, pwm_period, enc, hall, phaseH, phaseL, enc_position, enc_velocity, hall_count, has_error );
 
 // Module parameters - passed parameters will overwrite the values here
-parameter MAX_DUTY_CYCLE =          ( 'h1FF             );
-parameter MAX_DUTY_CYCLE_COUNTER =  ( MAX_DUTY_CYCLE    );
+parameter MAX_DUTY_CYCLE =          ( 'h3FFF            );  // Sign bit & magnitude
+parameter PWM_PERIOD_WIDTH =        ( 11                );
 parameter ENCODER_COUNT_WIDTH =     ( 15                );
 parameter HALL_COUNT_WIDTH =        ( 7                 );
+parameter VELOCITY_WIDTH =          ( 32                );
+parameter VELOCITY_FRAC_WIDTH =     ( 8                 );
+parameter SINUSOIDAL_COMMUTATION =  ( 0                 );    // Space vector PWM instead of six-step, needs the encoder
 
 // Local parameters - can not be altered outside this module
 `include "log2-macro.v"     // This must be included here
@@ -34,17 +39,21 @@ localparam DUTY_CYCLE_WIDTH =   `LOG2( MAX_DUTY_CYCLE );
 // Module inputs/outputs
 input clk, en, reset_enc_count, reset_hall_count;
 input [DUTY_CYCLE_WIDTH-1:0] duty_cycle;
+input [PWM_PERIOD_WIDTH-1:0] pwm_period;
 input [1:0] enc;
 input [2:0] hall;
 output [2:0] phaseH, phaseL;
-output signed [ENCODER_COUNT_WIDTH-1:0] enc_count;
+output [ENCODER_COUNT_WIDTH-1:0] enc_position;
+output signed [VELOCITY_WIDTH-1:0] enc_velocity;
 output signed [HALL_COUNT_WIDTH-1:0] hall_count;
 output has_error;
 // ===============================================
 
 wire has_error, has_hall_fault, has_enc_fault;
-wire signed [ENCODER_COUNT_WIDTH-1:0] enc_count_raw;
+wire signed [ENCODER_COUNT_WIDTH-1:0] enc_count_raw, enc_count;
 wire signed [HALL_COUNT_WIDTH-1:0] hall_count_raw;
+wire [10:0] rotor_angle;
+wire rotor_angle_valid;
 
 // Show the expected startup length during synthesis. Assumes an 18.432MHz input clock.
 initial begin
@@ -62,6 +71,25 @@ BLDC_Encoder_Counter #(         // Instantiation of the encoder for counting the
     .count                      ( enc_count_raw             )
 );
 
+BLDC_Encoder_Velocity #(        // Velocity from timestamped encoder edges, unfiltered and never reset
+    .VELOCITY_WIDTH             ( VELOCITY_WIDTH            ) ,
+    .FRAC_WIDTH                 ( VELOCITY_FRAC_WIDTH       )
+    ) encoder_velocity (
+    .clk                        ( clk                       ) ,
+    .enc                        ( enc                       ) ,
+    .velocity                   ( enc_velocity              )
+);
+
+BLDC_Rotor_Angle #(             // Rotor angle for sinusoidal commutation
+    .SECTOR_ANGLE               ( 256                       )
+    ) rotor_angle_estimator (
+    .clk                        ( clk                       ) ,
+    .hall                       ( hall                      ) ,
+    .enc                        ( enc                       ) ,
+    .angle                      ( rotor_angle               ) ,
+    .valid                      ( rotor_angle_valid         )
+);
+
 BLDC_Hall_Counter #(            // Instantiation of the hall effect sensor's counter
     .COUNTER_WIDTH              ( HALL_COUNT_WIDTH          )
     ) hall_counter (
@@ -71,7 +99,16 @@ BLDC_Hall_Counter #(            // Instantiation of the hall effect sensor's cou
     .count                      ( hall_count_raw            )
 );
 
-IIR_LowPass_Filter #(           // IIR filter for the encoder count value
+BLDC_Encoder_Counter #(         // Free running encoder position, never reset so no edge is ever missed
+    .COUNTER_WIDTH              ( ENCODER_COUNT_WIDTH       )
+    ) encoder_position (
+    .clk                        ( clk                       ) ,
+    .reset                      ( 1'b0                      ) ,
+    .enc                        ( enc                       ) ,
+    .count                      ( enc_position              )
+);
+
+IIR_LowPass_Filter #(           // IIR filter for the encoder count value, only used for checking the encoder
     .WIDTH                      ( ENCODER_COUNT_WIDTH       ) ,
     .GAIN                       ( 5                         )
     ) encoder_count_filterer (
@@ -105,16 +142,20 @@ BLDC_Encoder_Checker #(         // Instantiation of the encoder checker
 );
 
 BLDC_Driver #(                  // Instantiation of the motor driving module
-    .PHASE_DRIVER_MAX_COUNTER   ( MAX_DUTY_CYCLE_COUNTER    ) ,
-    .MAX_DUTY_CYCLE             ( MAX_DUTY_CYCLE            ) ,
-    .DUTY_CYCLE_STEP_RES        ( 1                         ) ,
-    .DEAD_TIME                  ( 10                        )
+    .PWM_PERIOD_WIDTH           ( PWM_PERIOD_WIDTH          ) ,
+    .MAX_DUTY_CYCLE             ( MAX_DUTY_CYCLE >> 1       ) ,
+    .DEAD_TIME                  ( 10                        ) ,
+    .SINUSOIDAL                 ( SINUSOIDAL_COMMUTATION    ) ,
+    .SECTOR_ANGLE               ( 256                       )
     ) bldc_motor (
     .clk                        ( clk                       ) ,
     .en                         ( en                        ) ,
     .hall                       ( hall                      ) ,
+    .rotor_angle                ( rotor_angle               ) ,
+    .rotor_angle_valid          ( rotor_angle_valid         ) ,
     .direction                  ( duty_cycle[DUTY_CYCLE_WIDTH-1] ) ,
-    .duty_cycle                 ( { duty_cycle[DUTY_CYCLE_WIDTH-2:0], 1'b0 } ) ,
+    .duty_cycle                 ( duty_cycle[DUTY_CYCLE_WIDTH-2:0] ) ,
+    .pwm_period                 ( pwm_period                ) ,
     .phaseH                     ( phaseH                    ) ,
     .phaseL                     ( phaseL                    ) ,
     .connected                  ( is_hall_connected         ) ,
@@ -16,11 +16,11 @@
 
 
 // BLDC_Motor module - no encoder
-module BLDC_Motor_No_Encoder ( clk, en, reset_hall_count, duty_cycle, hall, phaseH, phaseL, hall_count, has_error );
+module BLDC_Motor_No_Encoder ( clk, en, reset_hall_count, duty_cycle, pwm_period, hall, phaseH, phaseL, hall_count, has_error );
 
 // Module parameters - passed parameters will overwrite the values here
-parameter MAX_DUTY_CYCLE =          ( 'h1FF             );
-parameter MAX_DUTY_CYCLE_COUNTER =  ( MAX_DUTY_CYCLE    );
+parameter MAX_DUTY_CYCLE =          ( 'h3FFF            );  // Sign bit & magnitude
+parameter PWM_PERIOD_WIDTH =        ( 11                );
 parameter HALL_COUNT_WIDTH =        ( 7                 );
 
 // Local parameters - can not be altered outside this module
@@ -30,6 +30,7 @@ localparam DUTY_CYCLE_WIDTH =   `LOG2( MAX_DUTY_CYCLE );
 // Module inputs/outputs
 input clk, en, reset_hall_count;
 input [DUTY_CYCLE_WIDTH-1:0] duty_cycle;
+input [PWM_PERIOD_WIDTH-1:0] pwm_period;
 input [2:0] hall;
 output [2:0] phaseH, phaseL;
 output [HALL_COUNT_WIDTH-1:0] hall_count;
@@ -53,16 +54,18 @@ BLDC_Hall_Counter #(            // Instantiation of the hall effect sensor's cou
 );
 
 BLDC_Driver #(                  // Instantiation of the motor driving module
-    .PHASE_DRIVER_MAX_COUNTER   ( MAX_DUTY_CYCLE_COUNTER    ) ,
-    .MAX_DUTY_CYCLE             ( MAX_DUTY_CYCLE            ) ,
-    .DUTY_CYCLE_STEP_RES        ( 1                         ) ,
+    .PWM_PERIOD_WIDTH           ( PWM_PERIOD_WIDTH          ) ,
+    .MAX_DUTY_CYCLE             ( MAX_DUTY_CYCLE >> 1       ) ,
     .DEAD_TIME                  ( 20                        )
     ) bldc_motor (
     .clk                        ( clk                       ) ,
     .en                         ( en                        ) ,
     .hall                       ( hall                      ) ,
+    .rotor_angle                ( 'b0                       ) ,    // No encoder, always six-step
+    .rotor_angle_valid          ( 'b0                       ) ,
     .direction                  ( 'b0                       ) ,
-    .duty_cycle                 ( { duty_cycle[DUTY_CYCLE_WIDTH-2:0], 1'b0 } ) ,
+    .duty_cycle                 ( duty_cycle[DUTY_CYCLE_WIDTH-2:0] ) ,
+    .pwm_period                 ( pwm_period                ) ,
     .phaseH                     ( phaseH                    ) ,
     .phaseL                     ( phaseL                    ) ,
     .connected                  ( is_hall_connected         ) ,
@@ -0,0 +1,123 @@
+/*
+*  BLDC_Rotor_Angle.v
+*
+*  Estimates the rotor's electrical angle from the hall sensors, interpolated
+*  between hall transitions with the encoder.
+*
+*  The halls give the 60 degree sector the rotor is in, and a hall transition is the
+*  exact edge between two sectors. On a transition the angle is set to the edge that
+*  was just crossed. Between transitions, every encoder edge moves the angle by
+*  ANGLE_PER_EDGE, but never out of the sector the halls say the rotor is in. So an
+*  encoder that doesn't line up with the halls exactly only ever leaves the angle off
+*  until the next transition.
+*
+*  The angle is in units of 1/SECTOR_ANGLE of a sector, with sector 0 starting at
+*  0. The sectors are numbered in the order the halls step through them:
+*  101, 100, 110, 010, 011, 001.
+*
+*/
+
+`ifndef _BLDC_ROTOR_ANGLE_
+`define _BLDC_ROTOR_ANGLE_
+
+// BLDC_Rotor_Angle module
+module BLDC_Rotor_Angle ( clk, hall, enc, angle, valid );
+
+// Module parameters
+parameter SECTOR_ANGLE =        ( 256 );    // must be a power of 2
+parameter ANGLE_PER_EDGE =      (   6 );    // 2048 edges per rev over 8 pole pairs is 256 edges per electrical rev
+parameter ENC_REVERSED =        (   0 );    // set if the encoder counts down while the halls step forwards
+
+// Local parameters - can not be altered outside this module
+`include "log2-macro.v"     // This must be included here
+localparam OFFSET_WIDTH =       `LOG2( SECTOR_ANGLE );
+localparam ANGLE_WIDTH =        ( OFFSET_WIDTH + 3 );
+
+// Module inputs/outputs
+input clk;
+input [2:0] hall;
+input [1:0] enc;
+output [ANGLE_WIDTH-1:0] angle;
+output reg valid = 0;
+// ===============================================
+
+
+// Local parameters that can not be altered outside of this file.
+// ===============================================
+localparam STEP_0 = 'b00;
+localparam STEP_1 = 'b01;
+localparam STEP_2 = 'b10;
+localparam STEP_3 = 'b11;
+
+localparam NUM_SECTORS = 6;
+localparam NO_SECTOR = 7;
+
+localparam [OFFSET_WIDTH-1:0] SECTOR_END = SECTOR_ANGLE - 1;
+localparam [OFFSET_WIDTH-1:0] SECTOR_MIDDLE = SECTOR_ANGLE / 2;
+
+
+// Register and Wire declarations
+// ===============================================
+reg [1:0] enc_d = 0; always @(posedge clk) enc_d <= enc;
+reg [2:0] hall_d = 0; always @(posedge clk) hall_d <= hall;
+
+wire count_up =
+    ( ( enc_d == STEP_0 ) && ( enc == STEP_1 ) ) ||
+    ( ( enc_d == STEP_1 ) && ( enc == STEP_3 ) ) ||
+    ( ( enc_d == STEP_3 ) && ( enc == STEP_2 ) ) ||
+    ( ( enc_d == STEP_2 ) && ( enc == STEP_0 ) );
+
+wire count_down =
+    ( ( enc_d == STEP_2 ) && ( enc == STEP_3 ) ) ||
+    ( ( enc_d == STEP_3 ) && ( enc == STEP_1 ) ) ||
+    ( ( enc_d == STEP_1 ) && ( enc == STEP_0 ) ) ||
+    ( ( enc_d == STEP_0 ) && ( enc == STEP_2 ) );
+
+wire step_forward   = ENC_REVERSED ? count_down : count_up;
+wire step_backward  = ENC_REVERSED ? count_up : count_down;
+
+wire [2:0] sector_now = ( hall == 3'b101 ) ? 0 :
+                        ( hall == 3'b100 ) ? 1 :
+                        ( hall == 3'b110 ) ? 2 :
+                        ( hall == 3'b010 ) ? 3 :
+                        ( hall == 3'b011 ) ? 4 :
+                        ( hall == 3'b001 ) ? 5 : NO_SECTOR;
+
+reg [2:0]               sector = 0;     // the last valid sector
+reg [OFFSET_WIDTH-1:0]  offset = 0;     // angle within the sector
+
+wire [2:0] sector_next = ( sector == NUM_SECTORS - 1 ) ? 0 : sector + 1;
+wire [2:0] sector_prev = ( sector == 0 ) ? NUM_SECTORS - 1 : sector - 1;
+
+assign angle = { sector, offset };
+
+
+// Begin main logic
+always @( posedge clk ) begin : ROTOR_ANGLE
+    if ( sector_now == NO_SECTOR ) begin
+        valid   <=  0;
+
+    end else if ( ( hall != hall_d ) || ( valid == 0 ) ) begin
+        sector  <=  sector_now;
+        valid   <=  1;
+
+        if ( valid && ( sector_now == sector_next ) ) begin
+            offset  <=  0;
+        end else if ( valid && ( sector_now == sector_prev ) ) begin
+            offset  <=  SECTOR_END;
+        end else begin
+            // No idea where in the sector the rotor is
+            offset  <=  SECTOR_MIDDLE;
+        end
+
+    end else if ( step_forward ) begin
+        offset  <=  ( offset > SECTOR_END - ANGLE_PER_EDGE ) ? SECTOR_END : offset + ANGLE_PER_EDGE;
+
+    end else if ( step_backward ) begin
+        offset  <=  ( offset < ANGLE_PER_EDGE ) ? 0 : offset - ANGLE_PER_EDGE;
+    end
+end
+
+endmodule
+
+`endif
@@ -55,25 +55,23 @@ do not alternate going on and off so there is no danger of shoot through.
 `ifndef _PHASE_DRIVER_
 `define _PHASE_DRIVER_
 
-module Phase_Driver ( clk, duty_cycle, high_z, pwm_high, pwm_low );
+module Phase_Driver ( clk, duty_cycle, high_z, pwm_high, pwm_low, period );
 
 parameter DEAD_TIME = 8;             // dead time in units of clock ticks
-parameter COUNTER_WIDTH = 10;        // bits available to counter
-parameter MAX_COUNTER = 'h3ff;       // PWM period = MAX_COUNTER * clockPeriod
-parameter DUTY_CYCLE_WIDTH = 10;     // bits available to duty_cycle
-parameter MAX_DUTY_CYCLE = 'h3ff;    // Value represeting a duty cycle of 100%
-parameter DUTY_CYCLE_STEP_RES = 1;   // ceil( MAX_COUNTER / MAX_DUTY_CYCLE )
+parameter COUNTER_WIDTH = 11;        // bits available to counter and period
+parameter DUTY_CYCLE_WIDTH = 12;     // bits available to duty_cycle, enough to hold period + 1
 
 input   clk;
-input   [DUTY_CYCLE_WIDTH-1:0] duty_cycle;
+input   [DUTY_CYCLE_WIDTH-1:0] duty_cycle;  // high side on time in clock ticks, period + 1 is 100%
 input   high_z;
+input   [COUNTER_WIDTH-1:0] period;         // PWM period = ( period + 1 ) * clockPeriod
 output  pwm_high, pwm_low;
 // ===============================================
 
 reg [COUNTER_WIDTH-1:0] counter = 0;
 
 wire h = ( ( counter + DEAD_TIME ) < duty_cycle ) ? 1 : 0;
-wire l = ( ( counter >= ( duty_cycle ) ) && ( ( counter + DEAD_TIME ) <= MAX_COUNTER ) ) ? 1 : 0;
+wire l = ( ( counter >= ( duty_cycle ) ) && ( ( counter + DEAD_TIME ) <= period ) ) ? 1 : 0;
 
 
 assign  pwm_high =  (high_z == 1) ? 0 : h;
@@ -84,7 +82,7 @@ assign  pwm_low =   (high_z == 1) ? 0 :
 
 always @(posedge clk) begin : PHASE_DRIVER
     counter <= counter + 1;
-    if (counter >= MAX_COUNTER) counter <= 0;
+    if (counter >= period) counter <= 0;
 end
 
 endmodule
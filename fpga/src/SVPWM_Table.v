@@ -0,0 +1,413 @@
+/*
+*  SVPWM_Table.v
+*
+*  Generated by util/svpwm-table.py, edit that instead.
+*
+*  The first quarter wave of one phase of the space vector PWM waveform, full
+*  scale is 4095. The value is registered so it's inferred as a block ROM.
+*
+*/
+
+`ifndef _SVPWM_TABLE_
+`define _SVPWM_TABLE_
+
+// SVPWM_Table module
+module SVPWM_Table ( clk, addr, value );
+
+input clk;
+input [8:0] addr;
+output reg [11:0] value = 0;
+
+always @( posedge clk ) begin : SVPWM_LOOKUP
+    case ( addr )
+        9'd0   : value <= 12'd3551;
+        9'd1   : value <= 12'd3559;
+        9'd2   : value <= 12'd3567;
+        9'd3   : value <= 12'd3575;
+        9'd4   : value <= 12'd3583;
+        9'd5   : value <= 12'd3592;
+        9'd6   : value <= 12'd3600;
+        9'd7   : value <= 12'd3608;
+        9'd8   : value <= 12'd3615;
+        9'd9   : value <= 12'd3623;
+        9'd10  : value <= 12'd3631;
+        9'd11  : value <= 12'd3639;
+        9'd12  : value <= 12'd3646;
+        9'd13  : value <= 12'd3654;
+        9'd14  : value <= 12'd3662;
+        9'd15  : value <= 12'd3669;
+        9'd16  : value <= 12'd3676;
+        9'd17  : value <= 12'd3684;
+        9'd18  : value <= 12'd3691;
+        9'd19  : value <= 12'd3698;
+        9'd20  : value <= 12'd3705;
+        9'd21  : value <= 12'd3713;
+        9'd22  : value <= 12'd3720;
+        9'd23  : value <= 12'd3727;
+        9'd24  : value <= 12'd3733;
+        9'd25  : value <= 12'd3740;
+        9'd26  : value <= 12'd3747;
+        9'd27  : value <= 12'd3754;
+        9'd28  : value <= 12'd3760;
+        9'd29  : value <= 12'd3767;
+        9'd30  : value <= 12'd3774;
+        9'd31  : value <= 12'd3780;
+        9'd32  : value <= 12'd3786;
+        9'd33  : value <= 12'd3793;
+        9'd34  : value <= 12'd3799;
+        9'd35  : value <= 12'd3805;
+        9'd36  : value <= 12'd3811;
+        9'd37  : value <= 12'd3818;
+        9'd38  : value <= 12'd3824;
+        9'd39  : value <= 12'd3830;
+        9'd40  : value <= 12'd3835;
+        9'd41  : value <= 12'd3841;
+        9'd42  : value <= 12'd3847;
+        9'd43  : value <= 12'd3853;
+        9'd44  : value <= 12'd3858;
+        9'd45  : value <= 12'd3864;
+        9'd46  : value <= 12'd3870;
+        9'd47  : value <= 12'd3875;
+        9'd48  : value <= 12'd3880;
+        9'd49  : value <= 12'd3886;
+        9'd50  : value <= 12'd3891;
+        9'd51  : value <= 12'd3896;
+        9'd52  : value <= 12'd3901;
+        9'd53  : value <= 12'd3906;
+        9'd54  : value <= 12'd3911;
+        9'd55  : value <= 12'd3916;
+        9'd56  : value <= 12'd3921;
+        9'd57  : value <= 12'd3926;
+        9'd58  : value <= 12'd3931;
+        9'd59  : value <= 12'd3935;
+        9'd60  : value <= 12'd3940;
+        9'd61  : value <= 12'd3944;
+        9'd62  : value <= 12'd3949;
+        9'd63  : value <= 12'd3953;
+        9'd64  : value <= 12'd3958;
+        9'd65  : value <= 12'd3962;
+        9'd66  : value <= 12'd3966;
+        9'd67  : value <= 12'd3970;
+        9'd68  : value <= 12'd3974;
+        9'd69  : value <= 12'd3978;
+        9'd70  : value <= 12'd3982;
+        9'd71  : value <= 12'd3986;
+        9'd72  : value <= 12'd3990;
+        9'd73  : value <= 12'd3994;
+        9'd74  : value <= 12'd3997;
+        9'd75  : value <= 12'd4001;
+        9'd76  : value <= 12'd4004;
+        9'd77  : value <= 12'd4008;
+        9'd78  : value <= 12'd4011;
+        9'd79  : value <= 12'd4015;
+        9'd80  : value <= 12'd4018;
+        9'd81  : value <= 12'd4021;
+        9'd82  : value <= 12'd4024;
+        9'd83  : value <= 12'd4027;
+        9'd84  : value <= 12'd4030;
+        9'd85  : value <= 12'd4033;
+        9'd86  : value <= 12'd4036;
+        9'd87  : value <= 12'd4039;
+        9'd88  : value <= 12'd4042;
+        9'd89  : value <= 12'd4044;
+        9'd90  : value <= 12'd4047;
+        9'd91  : value <= 12'd4049;
+        9'd92  : value <= 12'd4052;
+        9'd93  : value <= 12'd4054;
+        9'd94  : value <= 12'd4057;
+        9'd95  : value <= 12'd4059;
+        9'd96  : value <= 12'd4061;
+        9'd97  : value <= 12'd4063;
+        9'd98  : value <= 12'd4065;
+        9'd99  : value <= 12'd4067;
+        9'd100 : value <= 12'd4069;
+        9'd101 : value <= 12'd4071;
+        9'd102 : value <= 12'd4073;
+        9'd103 : value <= 12'd4074;
+        9'd104 : value <= 12'd4076;
+        9'd105 : value <= 12'd4078;
+        9'd106 : value <= 12'd4079;
+        9'd107 : value <= 12'd4081;
+        9'd108 : value <= 12'd4082;
+        9'd109 : value <= 12'd4083;
+        9'd110 : value <= 12'd4085;
+        9'd111 : value <= 12'd4086;
+        9'd112 : value <= 12'd4087;
+        9'd113 : value <= 12'd4088;
+        9'd114 : value <= 12'd4089;
+        9'd115 : value <= 12'd4090;
+        9'd116 : value <= 12'd4090;
+        9'd117 : value <= 12'd4091;
+        9'd118 : value <= 12'd4092;
+        9'd119 : value <= 12'd4093;
+        9'd120 : value <= 12'd4093;
+        9'd121 : value <= 12'd4094;
+        9'd122 : value <= 12'd4094;
+        9'd123 : value <= 12'd4094;
+        9'd124 : value <= 12'd4095;
+        9'd125 : value <= 12'd4095;
+        9'd126 : value <= 12'd4095;
+        9'd127 : value <= 12'd4095;
+        9'd128 : value <= 12'd4095;
+        9'd129 : value <= 12'd4095;
+        9'd130 : value <= 12'd4095;
+        9'd131 : value <= 12'd4095;
+        9'd132 : value <= 12'd4094;
+        9'd133 : value <= 12'd4094;
+        9'd134 : value <= 12'd4094;
+        9'd135 : value <= 12'd4093;
+        9'd136 : value <= 12'd4093;
+        9'd137 : value <= 12'd4092;
+        9'd138 : value <= 12'd4091;
+        9'd139 : value <= 12'd4090;
+        9'd140 : value <= 12'd4090;
+        9'd141 : value <= 12'd4089;
+        9'd142 : value <= 12'd4088;
+        9'd143 : value <= 12'd4087;
+        9'd144 : value <= 12'd4086;
+        9'd145 : value <= 12'd4085;
+        9'd146 : value <= 12'd4083;
+        9'd147 : value <= 12'd4082;
+        9'd148 : value <= 12'd4081;
+        9'd149 : value <= 12'd4079;
+        9'd150 : value <= 12'd4078;
+        9'd151 : value <= 12'd4076;
+        9'd152 : value <= 12'd4074;
+        9'd153 : value <= 12'd4073;
+        9'd154 : value <= 12'd4071;
+        9'd155 : value <= 12'd4069;
+        9'd156 : value <= 12'd4067;
+        9'd157 : value <= 12'd4065;
+        9'd158 : value <= 12'd4063;
+        9'd159 : value <= 12'd4061;
+        9'd160 : value <= 12'd4059;
+        9'd161 : value <= 12'd4057;
+        9'd162 : value <= 12'd4054;
+        9'd163 : value <= 12'd4052;
+        9'd164 : value <= 12'd4049;
+        9'd165 : value <= 12'd4047;
+        9'd166 : value <= 12'd4044;
+        9'd167 : value <= 12'd4042;
+        9'd168 : value <= 12'd4039;
+        9'd169 : value <= 12'd4036;
+        9'd170 : value <= 12'd4033;
+        9'd171 : value <= 12'd4030;
+        9'd172 : value <= 12'd4027;
+        9'd173 : value <= 12'd4024;
+        9'd174 : value <= 12'd4021;
+        9'd175 : value <= 12'd4018;
+        9'd176 : value <= 12'd4015;
+        9'd177 : value <= 12'd4011;
+        9'd178 : value <= 12'd4008;
+        9'd179 : value <= 12'd4004;
+        9'd180 : value <= 12'd4001;
+        9'd181 : value <= 12'd3997;
+        9'd182 : value <= 12'd3994;
+        9'd183 : value <= 12'd3990;
+        9'd184 : value <= 12'd3986;
+        9'd185 : value <= 12'd3982;
+        9'd186 : value <= 12'd3978;
+        9'd187 : value <= 12'd3974;
+        9'd188 : value <= 12'd3970;
+        9'd189 : value <= 12'd3966;
+        9'd190 : value <= 12'd3962;
+        9'd191 : value <= 12'd3958;
+        9'd192 : value <= 12'd3953;
+        9'd193 : value <= 12'd3949;
+        9'd194 : value <= 12'd3944;
+        9'd195 : value <= 12'd3940;
+        9'd196 : value <= 12'd3935;
+        9'd197 : value <= 12'd3931;
+        9'd198 : value <= 12'd3926;
+        9'd199 : value <= 12'd3921;
+        9'd200 : value <= 12'd3916;
+        9'd201 : value <= 12'd3911;
+        9'd202 : value <= 12'd3906;
+        9'd203 : value <= 12'd3901;
+        9'd204 : value <= 12'd3896;
+        9'd205 : value <= 12'd3891;
+        9'd206 : value <= 12'd3886;
+        9'd207 : value <= 12'd3880;
+        9'd208 : value <= 12'd3875;
+        9'd209 : value <= 12'd3870;
+        9'd210 : value <= 12'd3864;
+        9'd211 : value <= 12'd3858;
+        9'd212 : value <= 12'd3853;
+        9'd213 : value <= 12'd3847;
+        9'd214 : value <= 12'd3841;
+        9'd215 : value <= 12'd3835;
+        9'd216 : value <= 12'd3830;
+        9'd217 : value <= 12'd3824;
+        9'd218 : value <= 12'd3818;
+        9'd219 : value <= 12'd3811;
+        9'd220 : value <= 12'd3805;
+        9'd221 : value <= 12'd3799;
+        9'd222 : value <= 12'd3793;
+        9'd223 : value <= 12'd3786;
+        9'd224 : value <= 12'd3780;
+        9'd225 : value <= 12'd3774;
+        9'd226 : value <= 12'd3767;
+        9'd227 : value <= 12'd3760;
+        9'd228 : value <= 12'd3754;
+        9'd229 : value <= 12'd3747;
+        9'd230 : value <= 12'd3740;
+        9'd231 : value <= 12'd3733;
+        9'd232 : value <= 12'd3727;
+        9'd233 : value <= 12'd3720;
+        9'd234 : value <= 12'd3713;
+        9'd235 : value <= 12'd3705;
+        9'd236 : value <= 12'd3698;
+        9'd237 : value <= 12'd3691;
+        9'd238 : value <= 12'd3684;
+        9'd239 : value <= 12'd3676;
+        9'd240 : value <= 12'd3669;
+        9'd241 : value <= 12'd3662;
+        9'd242 : value <= 12'd3654;
+        9'd243 : value <= 12'd3646;
+        9'd244 : value <= 12'd3639;
+        9'd245 : value <= 12'd3631;
+        9'd246 : value <= 12'd3623;
+        9'd247 : value <= 12'd3615;
+        9'd248 : value <= 12'd3608;
+        9'd249 : value <= 12'd3600;
+        9'd250 : value <= 12'd3592;
+        9'd251 : value <= 12'd3583;
+        9'd252 : value <= 12'd3575;
+        9'd253 : value <= 12'd3567;
+        9'd254 : value <= 12'd3559;
+        9'd255 : value <= 12'd3551;
+        9'd256 : value <= 12'd3534;
+        9'd257 : value <= 12'd3509;
+        9'd258 : value <= 12'd3483;
+        9'd259 : value <= 12'd3458;
+        9'd260 : value <= 12'd3433;
+        9'd261 : value <= 12'd3407;
+        9'd262 : value <= 12'd3382;
+        9'd263 : value <= 12'd3356;
+        9'd264 : value <= 12'd3331;
+        9'd265 : value <= 12'd3305;
+        9'd266 : value <= 12'd3279;
+        9'd267 : value <= 12'd3254;
+        9'd268 : value <= 12'd3228;
+        9'd269 : value <= 12'd3202;
+        9'd270 : value <= 12'd3176;
+        9'd271 : value <= 12'd3150;
+        9'd272 : value <= 12'd3124;
+        9'd273 : value <= 12'd3098;
+        9'd274 : value <= 12'd3072;
+        9'd275 : value <= 12'd3046;
+        9'd276 : value <= 12'd3019;
+        9'd277 : value <= 12'd2993;
+        9'd278 : value <= 12'd2967;
+        9'd279 : value <= 12'd2940;
+        9'd280 : value <= 12'd2914;
+        9'd281 : value <= 12'd2888;
+        9'd282 : value <= 12'd2861;
+        9'd283 : value <= 12'd2834;
+        9'd284 : value <= 12'd2808;
+        9'd285 : value <= 12'd2781;
+        9'd286 : value <= 12'd2754;
+        9'd287 : value <= 12'd2728;
+        9'd288 : value <= 12'd2701;
+        9'd289 : value <= 12'd2674;
+        9'd290 : value <= 12'd2647;
+        9'd291 : value <= 12'd2620;
+        9'd292 : value <= 12'd2593;
+        9'd293 : value <= 12'd2566;
+        9'd294 : value <= 12'd2539;
+        9'd295 : value <= 12'd2512;
+        9'd296 : value <= 12'd2485;
+        9'd297 : value <= 12'd2458;
+        9'd298 : value <= 12'd2430;
+        9'd299 : value <= 12'd2403;
+        9'd300 : value <= 12'd2376;
+        9'd301 : value <= 12'd2348;
+        9'd302 : value <= 12'd2321;
+        9'd303 : value <= 12'd2294;
+        9'd304 : value <= 12'd2266;
+        9'd305 : value <= 12'd2239;
+        9'd306 : value <= 12'd2211;
+        9'd307 : value <= 12'd2183;
+        9'd308 : value <= 12'd2156;
+        9'd309 : value <= 12'd2128;
+        9'd310 : value <= 12'd2101;
+        9'd311 : value <= 12'd2073;
+        9'd312 : value <= 12'd2045;
+        9'd313 : value <= 12'd2017;
+        9'd314 : value <= 12'd1989;
+        9'd315 : value <= 12'd1962;
+        9'd316 : value <= 12'd1934;
+        9'd317 : value <= 12'd1906;
+        9'd318 : value <= 12'd1878;
+        9'd319 : value <= 12'd1850;
+        9'd320 : value <= 12'd1822;
+        9'd321 : value <= 12'd1794;
+        9'd322 : value <= 12'd1766;
+        9'd323 : value <= 12'd1737;
+        9'd324 : value <= 12'd1709;
+        9'd325 : value <= 12'd1681;
+        9'd326 : value <= 12'd1653;
+        9'd327 : value <= 12'd1625;
+        9'd328 : value <= 12'd1596;
+        9'd329 : value <= 12'd1568;
+        9'd330 : value <= 12'd1540;
+        9'd331 : value <= 12'd1512;
+        9'd332 : value <= 12'd1483;
+        9'd333 : value <= 12'd1455;
+        9'd334 : value <= 12'd1426;
+        9'd335 : value <= 12'd1398;
+        9'd336 : value <= 12'd1369;
+        9'd337 : value <= 12'd1341;
+        9'd338 : value <= 12'd1313;
+        9'd339 : value <= 12'd1284;
+        9'd340 : value <= 12'd1255;
+        9'd341 : value <= 12'd1227;
+        9'd342 : value <= 12'd1198;
+        9'd343 : value <= 12'd1170;
+        9'd344 : value <= 12'd1141;
+        9'd345 : value <= 12'd1112;
+        9'd346 : value <= 12'd1084;
+        9'd347 : value <= 12'd1055;
+        9'd348 : value <= 12'd1026;
+        9'd349 : value <= 12'd998;
+        9'd350 : value <= 12'd969;
+        9'd351 : value <= 12'd940;
+        9'd352 : value <= 12'd911;
+        9'd353 : value <= 12'd883;
+        9'd354 : value <= 12'd854;
+        9'd355 : value <= 12'd825;
+        9'd356 : value <= 12'd796;
+        9'd357 : value <= 12'd767;
+        9'd358 : value <= 12'd739;
+        9'd359 : value <= 12'd710;
+        9'd360 : value <= 12'd681;
+        9'd361 : value <= 12'd652;
+        9'd362 : value <= 12'd623;
+        9'd363 : value <= 12'd594;
+        9'd364 : value <= 12'd565;
+        9'd365 : value <= 12'd536;
+        9'd366 : value <= 12'd507;
+        9'd367 : value <= 12'd478;
+        9'd368 : value <= 12'd449;
+        9'd369 : value <= 12'd420;
+        9'd370 : value <= 12'd391;
+        9'd371 : value <= 12'd363;
+        9'd372 : value <= 12'd334;
+        9'd373 : value <= 12'd305;
+        9'd374 : value <= 12'd276;
+        9'd375 : value <= 12'd247;
+        9'd376 : value <= 12'd218;
+        9'd377 : value <= 12'd189;
+        9'd378 : value <= 12'd160;
+        9'd379 : value <= 12'd131;
+        9'd380 : value <= 12'd102;
+        9'd381 : value <= 12'd73;
+        9'd382 : value <= 12'd44;
+        9'd383 : value <= 12'd15;
+        default : value <= 0;
+    endcase
+end
+
+endmodule
+
+`endif
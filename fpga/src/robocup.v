@@ -21,7 +21,8 @@ module robocup #(
                     NUM_HALL_SENS           =   ( NUM_MOTORS        ) ,
                     NUM_ENCODERS            =   ( NUM_MOTORS - 1    ) ,
                     SPI_MASTER_DATA_WIDTH   =   ( 16                ) ,
-                    SPI_SLAVE_DATA_WIDTH    =   ( 8                 )
+                    SPI_SLAVE_DATA_WIDTH    =   ( 8                 ) ,
+                    SINUSOIDAL_COMMUTATION  =   ( 0                 )       // Space vector PWM for the wheel motors instead of six-step
 
     ) (
     // Clock
@@ -63,9 +64,21 @@ integer j, k;
 // Derived parameters
 localparam ENCODER_COUNT_WIDTH          =   ( 16 );
 localparam HALL_COUNT_WIDTH             =   (  8 );
-localparam DUTY_CYCLE_WIDTH             =   ( 10 );
+localparam DUTY_CYCLE_WIDTH             =   ( 14 );     // Sign bit & 13 bit magnitude
+localparam LEGACY_DUTY_CYCLE_WIDTH      =   ( 10 );     // Sign bit & 9 bit magnitude, from before the high resolution format
+localparam DUTY_CYCLE_HIGH_RES_BIT      =   ( 15 );     // Set in a duty cycle word that's in the high resolution format
 localparam STARTUP_DELAY_WIDTH          =   (  5 );
 localparam DRIBBLER_INDEX               =   ( NUM_MOTORS - 1 );
+localparam CURRENT_WIDTH                =   ( 14 );
+localparam VELOCITY_WIDTH               =   ( 32 );
+localparam VELOCITY_FRAC_WIDTH          =   (  8 );
+
+// The PWM period is set at runtime, in clock cycles minus 1. The default is the
+// ~18kHz carrier from before it was configurable. The shortest period keeps the
+// dead time a small part of every period.
+localparam PWM_PERIOD_WIDTH             =   ( 11 );
+localparam PWM_PERIOD_DEFAULT           =   ( 1023 );   // 18.432MHz / 1024 = 18kHz
+localparam PWM_PERIOD_MIN               =   ( 255 );    // 18.432MHz / 256  = 72kHz
 
 // To calculate the watchdog timer's expire time, use the following equation:
 // (1/<freq-of-sysclk>) * (2^WATCHDOG_TIMER_CLK_WIDTH) * (2^WATCHDOG_TIMER_WIDTH)
@@ -145,10 +158,16 @@ always @(posedge sysclk) start_delay_r <= start_delay_r + 1;
 assign spi_slave_miso = ( spi_slave_ncs_s == 1 ? 1'bZ : spi_slave_miso_o );
 
 // Internal logic declarations
-wire [ ENCODER_COUNT_WIDTH  - 1:0 ] enc_count        [ NUM_ENCODERS  - 1:0 ];
+wire [ ENCODER_COUNT_WIDTH  - 1:0 ] enc_position     [ NUM_ENCODERS  - 1:0 ];
+reg  [ ENCODER_COUNT_WIDTH  - 1:0 ] enc_position_l   [ NUM_ENCODERS  - 1:0 ];
+wire [ ENCODER_COUNT_WIDTH  - 1:0 ] enc_delta        [ NUM_ENCODERS  - 1:0 ];
 wire [ HALL_COUNT_WIDTH     - 1:0 ] hall_count       [ NUM_HALL_SENS - 1:0 ];
 wire [ NUM_HALL_SENS        - 1:0 ] motor_has_error;
+wire [ CURRENT_WIDTH        - 1:0 ] motor_current    [ NUM_MOTORS    - 1:0 ];
+wire [ VELOCITY_WIDTH       - 1:0 ] enc_velocity     [ NUM_ENCODERS  - 1:0 ];
 reg  [ DUTY_CYCLE_WIDTH     - 1:0 ] duty_cycle       [ NUM_MOTORS    - 1:0 ];
+wire [ DUTY_CYCLE_WIDTH     - 1:0 ] duty_cycle_req   [ NUM_MOTORS    - 1:0 ];
+reg  [ PWM_PERIOD_WIDTH     - 1:0 ] pwm_period       = PWM_PERIOD_DEFAULT;
 reg  [ WATCHDOG_TIMER_WIDTH - 1:0 ] watchdog_timer   [1:0];
 
 // This gets set on a watchdog timer overflow
@@ -168,8 +187,16 @@ ClkDivide #(
 );
 
 
+// Bumped whenever the SPI commands change, so the MCU can tell what the loaded design
+// understands. Designs from before this register answer its read with 0xAA like any
+// other unknown command. 1 has CMD_UPDATE_MTRS_CUR, CMD_UPDATE_MTRS_ALL, the 13 bit
+// duty cycles & CMD_PWM_PERIOD.
+localparam DESIGN_VERSION       = 1;
+
 // Command types for SPI access
 localparam CMD_UPDATE_MTRS      = 0;
+localparam CMD_UPDATE_MTRS_CUR  = 1;
+localparam CMD_UPDATE_MTRS_ALL  = 2;
 // The command types beginning at 0x10 have selectable read/write types according to the command's MSB.
 localparam CMD_WRITE_TYPE       = 0;
 localparam CMD_READ_TYPE        = 1;
@@ -180,11 +207,21 @@ localparam CMD_DUTY_CYCLE       = CMD_RW_TYPE_BASE + 3;
 localparam CMD_VERSION1         = CMD_RW_TYPE_BASE + 4;
 localparam CMD_VERSION2         = CMD_RW_TYPE_BASE + 5;
 localparam CMD_GATE_DRV_STATUS  = CMD_RW_TYPE_BASE + 6;
+localparam CMD_PWM_PERIOD       = CMD_RW_TYPE_BASE + 7;
+localparam CMD_DESIGN_VERSION   = CMD_RW_TYPE_BASE + 8;
 // The command strobes start after the read/write command types
 localparam CMD_STROBE_START         = CMD_RW_TYPE_BASE + 'h10;
 localparam CMD_TOGGLE_MOTOR_EN      = CMD_RW_TYPE_BASE + CMD_STROBE_START;
-// Response & request buffer sizes
-localparam SPI_SLAVE_RES_BUF_LEN = 12;
+// Where each block of telemetry starts in the CMD_UPDATE_MTRS_ALL response. The
+// status, encoder & watchdog bytes are placed the same as for CMD_UPDATE_MTRS.
+localparam RES_ALL_HALL_START   = 2 * NUM_ENCODERS + 3;
+localparam RES_ALL_DRV_START    = RES_ALL_HALL_START + NUM_HALL_SENS;
+localparam RES_ALL_CUR_START    = RES_ALL_DRV_START + 2 * NUM_MOTORS;
+localparam RES_ALL_VEL_START    = RES_ALL_CUR_START + 2 * NUM_MOTORS;
+localparam RES_ALL_SEQ          = RES_ALL_VEL_START + 4 * NUM_ENCODERS;
+// Response & request buffer sizes. CMD_UPDATE_MTRS_ALL is the longest transfer at
+// 1 status, 8 encoder, 2 watchdog, 5 hall, 10 gate driver, 10 current, 16 velocity & 1 sequence bytes.
+localparam SPI_SLAVE_RES_BUF_LEN = RES_ALL_SEQ + 1;
 localparam SPI_SLAVE_REQ_BUF_LEN = SPI_SLAVE_RES_BUF_LEN;
 localparam SPI_SLAVE_COUNTER_WIDTH = `LOG2(SPI_SLAVE_RES_BUF_LEN);
 
@@ -201,6 +238,13 @@ wire spi_slave_start_flag = ( (spi_slave_ncs_s == 0) && (spi_slave_ncs_d == 1) )
      spi_slave_end_flag = ( (spi_slave_ncs_s == 1) && (spi_slave_ncs_d == 0) );
 wire spi_slave_byte_done;
 
+// The SPI_Slave module flags the last byte a few clocks after the chip select
+// line can already be released, so act on the request only once that's passed.
+// Otherwise the byte count & request buffer may or may not include the last
+// byte depending on how quickly the master ends the transfer.
+reg [3:0] spi_slave_end_sr = 0;  always @(posedge sysclk) spi_slave_end_sr <= { spi_slave_end_sr[2:0], spi_slave_end_flag };
+wire spi_slave_rx_done_flag = spi_slave_end_sr[3];
+
 reg                                     spi_master_start = 0;
 reg [ NUM_MOTORS - 1:0 ]                spi_master_sel_num = 0;
 reg [ NUM_MOTORS - 1:0 ]                spi_master_sel = 0;
@@ -216,9 +260,17 @@ wire                                    spi_master_sel_num_i = ( spi_master_sel_
 reg [1:0] spi_master_busy_sr = 0;  always @(posedge sysclk) spi_master_busy_sr <= { spi_master_busy_sr[0], spi_master_busy };
 wire spi_master_trxfr_done_flag   =   ( spi_master_busy_sr == 2'b10 );
 
+// The ADCs share the SPI master bus with the gate drivers. While the current
+// sense sweep is running, the selected ADC gets the chip select instead.
+reg                                     spi_master_adc_state = 0;
+reg                                     spi_master_adc_sel_num = 0;
+reg [ 1:0 ]                             spi_master_adc_sel = 0;
+
 // select an SPI slave device according to the spi_master_sel_num index of the signal array
-always@(posedge sysclk) spi_master_sel[spi_master_sel_num] <= spi_master_sel_now;
+always@(posedge sysclk) spi_master_sel[spi_master_sel_num] <= spi_master_sel_now & ~spi_master_adc_state;
+always@(posedge sysclk) spi_master_adc_sel[spi_master_adc_sel_num] <= spi_master_sel_now & spi_master_adc_state;
 assign drv_ncs_o = ~spi_master_sel;
+assign adc_ncs_o = ~spi_master_adc_sel;
 
 SPI_Master spi_master_module (
     .clk            ( sysclk                ) ,
@@ -242,8 +294,58 @@ reg spi_master_config_state;
 // latch in the valid signal on the falling edges
 reg spi_master_valid_q;  always @(negedge sysclk) spi_master_valid_q <= spi_master_valid;
 
+// The current sense ADCs are 8 channel, 12 bit AD7928 compatible parts. Every
+// 16 bit frame writes the control register with the channel to convert next and
+// returns the result of the previous frame's channel as { 0, ADD[2:0], DATA[11:0] }.
+//
+// Each DRV8303 has 2 shunt amplifier outputs (phase A & B) which are wired in
+// motor order across the ADCs:
+//   ADC 0 channel 2*m   = motor m phase A      (motors 0-3)
+//   ADC 0 channel 2*m+1 = motor m phase B
+//   ADC 1 channel 0/1   = dribbler phase A/B
+localparam ADC_NUM_CHANNELS         = 8;
+localparam ADC_DATA_WIDTH           = 12;
+localparam NUM_CURRENT_CHANNELS     = 2 * NUM_MOTORS;
+
+// Input range of the ADC
+//   0 = 0V to 2 x REF_IN
+//   1 = 0V to REF_IN
+localparam ADC_RANGE = 1;
+
+// The shunt amplifiers are biased to half of their reference for zero current,
+// so this is the ADC reading for 0A
+localparam ADC_ZERO_CURRENT = ( 1 << (ADC_DATA_WIDTH - 1) );
+
+// Control register: WRITE, normal power mode, straight binary output
+wire [2:0]  spi_master_adc_addr;
+wire [SPI_MASTER_DATA_WIDTH-1:0] spi_master_adc_ctrl =  (1                      << 15)  |
+                                                        (spi_master_adc_addr    << 10)  |
+                                                        (3                      << 8 )  |
+                                                        (ADC_RANGE              << 5 )  |
+                                                        (1                      << 4 );
+
 // This is where we assign the data we want to send to the selected SPI slave
-assign spi_master_di = spi_master_data_array_out[spi_master_recv_index];
+assign spi_master_di = spi_master_adc_state ? spi_master_adc_ctrl : spi_master_data_array_out[spi_master_recv_index];
+
+// Frame index within the sweep of the selected ADC. The frame after the last
+// channel only collects the last result, since the output lags a frame.
+reg  [3:0]  spi_master_adc_frame = 0;
+wire [3:0]  spi_master_adc_channels = ( spi_master_adc_sel_num == 0 ) ?
+                ( ( NUM_CURRENT_CHANNELS > ADC_NUM_CHANNELS ) ? ADC_NUM_CHANNELS : NUM_CURRENT_CHANNELS ) :
+                ( NUM_CURRENT_CHANNELS - ADC_NUM_CHANNELS );
+wire        spi_master_adc_sweep_done = ( spi_master_adc_frame >= spi_master_adc_channels );
+assign      spi_master_adc_addr = spi_master_adc_sweep_done ? 0 : spi_master_adc_frame[2:0];
+
+// Where the result returned by the ADC is stored
+wire [3:0]  adc_sample_index = { spi_master_adc_sel_num, spi_master_d0[14:12] };
+
+reg [ ADC_DATA_WIDTH - 1:0 ] adc_sample [ NUM_CURRENT_CHANNELS - 1:0 ];
+
+initial begin
+    for (j = 0; j < NUM_CURRENT_CHANNELS; j = j + 1) begin
+        adc_sample[j] = ADC_ZERO_CURRENT;
+    end
+end
 
 
 // This sets the max output current for the gate pins
@@ -324,6 +426,10 @@ begin : SPI_MASTER_COMM
         // enter config state for the gate drivers
         spi_master_config_state <= 1;
         spi_master_sel_num <= 0;
+        // restart the current sense sweep after the config
+        spi_master_adc_state <= 0;
+        spi_master_adc_sel_num <= 0;
+        spi_master_adc_frame <= 0;
 
     end else if ( spi_master_trxfr_done_flag == 1 ) begin
         // take appropiate action if the SPI received data is flagged as being valid
@@ -331,12 +437,34 @@ begin : SPI_MASTER_COMM
             // start the next transfer out
             spi_master_start <= 1;
 
-            if ( spi_master_recv_index >= 2 ) begin
+            if ( spi_master_adc_state == 1 ) begin
+                // the first frame of a sweep returns whatever was converted last
+                if ( ( spi_master_adc_frame != 0 ) && ( adc_sample_index < NUM_CURRENT_CHANNELS ) ) begin
+                    adc_sample[adc_sample_index] <= spi_master_d0[ADC_DATA_WIDTH-1:0];
+                end
+
+                if ( spi_master_adc_sweep_done == 1 ) begin
+                    spi_master_adc_frame <= 0;
+
+                    if ( ( spi_master_adc_sel_num == 1 ) || ( NUM_CURRENT_CHANNELS <= ADC_NUM_CHANNELS ) ) begin
+                        // all currents are sampled, go poll the next gate driver
+                        spi_master_adc_sel_num <= 0;
+                        spi_master_adc_state <= 0;
+                    end else begin
+                        spi_master_adc_sel_num <= spi_master_adc_sel_num + 1;
+                    end
+                end else begin
+                    spi_master_adc_frame <= spi_master_adc_frame + 1;
+                end
+
+            end else if ( spi_master_recv_index >= 2 ) begin
                 if ( spi_master_recv_index == 3 ) begin
                     // reset the rx buffer to the beginning
                     spi_master_recv_index <= 0;
                     // store only bit-7 from address 0x01 since it's the only one with useful information
                     spi_master_data_array_in[spi_master_sel_num_i][11] <= spi_master_d0[7];
+                    // sweep the current sense ADCs in between each gate driver status read
+                    spi_master_adc_state <= ~spi_master_config_state;
 
                     if ( spi_master_sel_num >= (NUM_MOTORS - 1) ) begin
                         // reset the selected SPI slave to the first one
@@ -372,6 +500,23 @@ begin : SPI_MASTER_COMM
     end
 end
 
+// Phase current magnitude for each motor. With phase A & B measured, phase C is
+// -(A + B), and the largest of the 3 is the current through the motor.
+generate
+    for (i = 0; i < NUM_MOTORS; i = i + 1)
+    begin : CURRENT_MAGNITUDE
+        wire signed [ CURRENT_WIDTH - 1:0 ]  phase_a = $signed({ 1'b0, adc_sample[2*i]   }) - ADC_ZERO_CURRENT;
+        wire signed [ CURRENT_WIDTH - 1:0 ]  phase_b = $signed({ 1'b0, adc_sample[2*i+1] }) - ADC_ZERO_CURRENT;
+        wire signed [ CURRENT_WIDTH - 1:0 ]  phase_c = -( phase_a + phase_b );
+        wire        [ CURRENT_WIDTH - 1:0 ]  abs_a   = phase_a[CURRENT_WIDTH-1] ? -phase_a : phase_a;
+        wire        [ CURRENT_WIDTH - 1:0 ]  abs_b   = phase_b[CURRENT_WIDTH-1] ? -phase_b : phase_b;
+        wire        [ CURRENT_WIDTH - 1:0 ]  abs_c   = phase_c[CURRENT_WIDTH-1] ? -phase_c : phase_c;
+        wire        [ CURRENT_WIDTH - 1:0 ]  max_ab  = ( abs_a > abs_b ) ? abs_a : abs_b;
+
+        assign motor_current[i] = ( max_ab > abs_c ) ? max_ab : abs_c;
+    end
+endgenerate
+
 wire command_byte_rdy = ( ( spi_slave_byte_count == 1 ) && ( spi_slave_byte_done_d == 1 ) );
 wire [ SPI_SLAVE_DATA_WIDTH - 1:0 ]  spi_slave_di = spi_slave_res_buf[ spi_slave_byte_count ];
 wire [ SPI_SLAVE_DATA_WIDTH - 2:0 ] command_byte = command_byte_rdy ? spi_slave_do[SPI_SLAVE_DATA_WIDTH - 2:0] : spi_slave_req_buf[0][SPI_SLAVE_DATA_WIDTH - 2:0];
@@ -395,7 +540,7 @@ SPI_Slave spi_slave_module (
 always @( posedge sysclk )
 begin : SPI_SLAVE_LOAD_BYTE
     // If the chip select line is toggled and it is now high, we are ending an SPI transfer, so reset everything & take action with what we received
-    if ( spi_slave_end_flag ) begin
+    if ( spi_slave_rx_done_flag ) begin
         // Signal to do something with the received bytes & save how may bytes were received. We do this here so it will happen after we set the received byte count
         rx_vals_flag <= 1;
 
@@ -426,6 +571,55 @@ end
 always @( posedge sysclk )  spi_slave_byte_done_d <= spi_slave_byte_done;
 
 reg motor_update_flag = 0;
+
+// The motor update commands return the encoder movement since the previous motor update.
+// Each encoder's position counter is never reset. Instead, the position at every update
+// is kept and subtracted from the position now, on the same clock edge as the new
+// position is kept, so an edge can't be missed or counted twice however close it lands
+// to the update. The subtraction is modulo 2^ENCODER_COUNT_WIDTH, so the delta is
+// correct through the position wrapping around.
+wire enc_update_rdy = ( command_byte_rdy == 1 ) && ( command_rw == CMD_READ_TYPE ) &&
+                      ( ( command_byte == CMD_UPDATE_MTRS ) || ( command_byte == CMD_UPDATE_MTRS_CUR ) || ( command_byte == CMD_UPDATE_MTRS_ALL ) );
+
+// Counts motor updates so the MCU can tell if one happened that it didn't get the response to
+reg [ SPI_SLAVE_DATA_WIDTH - 1:0 ] enc_update_seq = 0;
+
+generate
+    for (i = 0; i < NUM_ENCODERS; i = i + 1)
+    begin : ENCODER_DELTA
+        initial enc_position_l[i] = 0;
+        assign enc_delta[i] = enc_position[i] - enc_position_l[i];
+    end
+endgenerate
+
+// Duty cycles are received low byte first. A word with DUTY_CYCLE_HIGH_RES_BIT set holds
+// the sign & 13 bit magnitude in its low bits. Otherwise it's the original format with
+// the sign at bit 9 and a 9 bit magnitude, which is scaled up to the same full scale.
+wire [ 2 * SPI_SLAVE_DATA_WIDTH - 1:0 ] duty_cycle_word  [ NUM_MOTORS - 1:0 ];
+
+generate
+    for (i = 0; i < NUM_MOTORS; i = i + 1)
+    begin : DUTY_CYCLE_DECODE
+        assign duty_cycle_word[i] = { spi_slave_req_buf[2*i+2], spi_slave_req_buf[2*i+1] };  // The received data bytes start at index 1 (not 0)
+        assign duty_cycle_req[i]  = ( duty_cycle_word[i][DUTY_CYCLE_HIGH_RES_BIT] == 1 ) ?
+                                    duty_cycle_word[i][DUTY_CYCLE_WIDTH-1:0] :
+                                    { duty_cycle_word[i][LEGACY_DUTY_CYCLE_WIDTH-1:0], { (DUTY_CYCLE_WIDTH - LEGACY_DUTY_CYCLE_WIDTH){1'b0} } };
+    end
+endgenerate
+
+wire [ 2 * SPI_SLAVE_DATA_WIDTH - 1:0 ] pwm_period_req = { spi_slave_req_buf[2], spi_slave_req_buf[1] };
+
+always @( negedge sysclk )
+begin : ENCODER_DELTA_LATCH
+    if ( enc_update_rdy ) begin
+        for (j = 0; j < NUM_ENCODERS; j = j + 1)
+        begin : KEEP_ENC_POSITIONS
+            enc_position_l[j] <= enc_position[j];
+        end
+        enc_update_seq <= enc_update_seq + 1;
+    end
+end
+
 assign gate_drivers_set_config = ( sys_begin_startup == 1 ) || ( motor_update_flag == 1 );
 
 always @( negedge sysclk )
@@ -445,22 +639,87 @@ begin : SPI_SLAVE_LOAD_RESPONSE_BUFFER
                     // Encoder inputs are latched here so all readings are from the same time
                     for (j = 0; j < NUM_ENCODERS; j = j + 1)
                     begin : LATCH_ENC_COUNTS_ON_UPDATE
-                        spi_slave_res_buf[2*j+1]    <=  enc_count[j][ENCODER_COUNT_WIDTH-1:SPI_SLAVE_DATA_WIDTH];
-                        spi_slave_res_buf[2*j+2]    <=  enc_count[j][SPI_SLAVE_DATA_WIDTH-1:0];
+                        spi_slave_res_buf[2*j+1]    <=  enc_delta[j][ENCODER_COUNT_WIDTH-1:SPI_SLAVE_DATA_WIDTH];
+                        spi_slave_res_buf[2*j+2]    <=  enc_delta[j][SPI_SLAVE_DATA_WIDTH-1:0];
+                    end
+                    // The latched watchdog timer count
+                    spi_slave_res_buf[2*NUM_ENCODERS+1] <= watchdog_timer[1][WATCHDOG_TIMER_WIDTH - 1 : (WATCHDOG_TIMER_WIDTH - SPI_SLAVE_DATA_WIDTH )];
+                    spi_slave_res_buf[2*NUM_ENCODERS+2] <= watchdog_timer[1][(WATCHDOG_TIMER_WIDTH - SPI_SLAVE_DATA_WIDTH - 1) : 0];
+                    motor_update_flag <= 1;
+                end
+
+                // Same as CMD_UPDATE_MTRS with the motor currents appended
+                CMD_UPDATE_MTRS_CUR :
+                begin
+                    for (j = 0; j < NUM_ENCODERS; j = j + 1)
+                    begin : LATCH_ENC_COUNTS_ON_UPDATE_CUR
+                        spi_slave_res_buf[2*j+1]    <=  enc_delta[j][ENCODER_COUNT_WIDTH-1:SPI_SLAVE_DATA_WIDTH];
+                        spi_slave_res_buf[2*j+2]    <=  enc_delta[j][SPI_SLAVE_DATA_WIDTH-1:0];
+                    end
+                    // The latched watchdog timer count
+                    spi_slave_res_buf[2*NUM_ENCODERS+1] <= watchdog_timer[1][WATCHDOG_TIMER_WIDTH - 1 : (WATCHDOG_TIMER_WIDTH - SPI_SLAVE_DATA_WIDTH )];
+                    spi_slave_res_buf[2*NUM_ENCODERS+2] <= watchdog_timer[1][(WATCHDOG_TIMER_WIDTH - SPI_SLAVE_DATA_WIDTH - 1) : 0];
+                    // Currents are latched with the encoders so they're from the same time
+                    for (j = 0; j < NUM_MOTORS; j = j + 1)
+                    begin : LATCH_CURRENTS_ON_UPDATE
+                        spi_slave_res_buf[2*NUM_ENCODERS+2*j+3] <= { {(2*SPI_SLAVE_DATA_WIDTH-CURRENT_WIDTH){1'b0}}, motor_current[j][CURRENT_WIDTH-1:SPI_SLAVE_DATA_WIDTH] };
+                        spi_slave_res_buf[2*NUM_ENCODERS+2*j+4] <= motor_current[j][SPI_SLAVE_DATA_WIDTH-1:0];
+                    end
+                    motor_update_flag <= 1;
+                end
+
+                // Everything the motor loop needs in one transfer. The encoder, hall &
+                // watchdog counts are all reset by this, so they cover the same period.
+                CMD_UPDATE_MTRS_ALL :
+                begin
+                    for (j = 0; j < NUM_ENCODERS; j = j + 1)
+                    begin : LATCH_ENC_COUNTS_ON_UPDATE_ALL
+                        spi_slave_res_buf[2*j+1]    <=  enc_delta[j][ENCODER_COUNT_WIDTH-1:SPI_SLAVE_DATA_WIDTH];
+                        spi_slave_res_buf[2*j+2]    <=  enc_delta[j][SPI_SLAVE_DATA_WIDTH-1:0];
                     end
                     // The latched watchdog timer count
                     spi_slave_res_buf[2*NUM_ENCODERS+1] <= watchdog_timer[1][WATCHDOG_TIMER_WIDTH - 1 : (WATCHDOG_TIMER_WIDTH - SPI_SLAVE_DATA_WIDTH )];
                     spi_slave_res_buf[2*NUM_ENCODERS+2] <= watchdog_timer[1][(WATCHDOG_TIMER_WIDTH - SPI_SLAVE_DATA_WIDTH - 1) : 0];
+
+                    for (j = 0; j < NUM_HALL_SENS; j = j + 1)
+                    begin : LATCH_HALL_COUNTS_ON_UPDATE_ALL
+                        spi_slave_res_buf[RES_ALL_HALL_START+j] <= hall_count[j][HALL_COUNT_WIDTH-1:0];
+                    end
+
+                    // Same byte order as CMD_GATE_DRV_STATUS, low byte first
+                    for (j = 0; j < NUM_MOTORS; j = j + 1)
+                    begin : LATCH_GATE_DRV_STATUS_ON_UPDATE_ALL
+                        spi_slave_res_buf[RES_ALL_DRV_START+2*j]    <= spi_master_data_array_in[j][7:0];
+                        spi_slave_res_buf[RES_ALL_DRV_START+2*j+1]  <= { 4'b0, spi_master_data_array_in[j][11:8] };
+                    end
+
+                    for (j = 0; j < NUM_MOTORS; j = j + 1)
+                    begin : LATCH_CURRENTS_ON_UPDATE_ALL
+                        spi_slave_res_buf[RES_ALL_CUR_START+2*j]    <= { {(2*SPI_SLAVE_DATA_WIDTH-CURRENT_WIDTH){1'b0}}, motor_current[j][CURRENT_WIDTH-1:SPI_SLAVE_DATA_WIDTH] };
+                        spi_slave_res_buf[RES_ALL_CUR_START+2*j+1]  <= motor_current[j][SPI_SLAVE_DATA_WIDTH-1:0];
+                    end
+
+                    // Encoder velocities, high byte first
+                    for (j = 0; j < NUM_ENCODERS; j = j + 1)
+                    begin : LATCH_VELOCITIES_ON_UPDATE_ALL
+                        spi_slave_res_buf[RES_ALL_VEL_START+4*j]    <= enc_velocity[j][31:24];
+                        spi_slave_res_buf[RES_ALL_VEL_START+4*j+1]  <= enc_velocity[j][23:16];
+                        spi_slave_res_buf[RES_ALL_VEL_START+4*j+2]  <= enc_velocity[j][15:8];
+                        spi_slave_res_buf[RES_ALL_VEL_START+4*j+3]  <= enc_velocity[j][7:0];
+                    end
+
+                    // The sequence number of this update
+                    spi_slave_res_buf[RES_ALL_SEQ] <= enc_update_seq + 1;
                     motor_update_flag <= 1;
                 end
 
                 CMD_ENCODER_COUNT :
                 begin
-                    // Encoder inputs are latched here so all readings are from the same time
+                    // The movement since the last motor update, without starting a new one
                     for (j = 0; j < NUM_ENCODERS; j = j + 1)
                     begin : LATCH_ENC_COUNTS
-                        spi_slave_res_buf[2*j+1]    <=  enc_count[j][ENCODER_COUNT_WIDTH-1:SPI_SLAVE_DATA_WIDTH];
-                        spi_slave_res_buf[2*j+2]    <=  enc_count[j][SPI_SLAVE_DATA_WIDTH-1:0];
+                        spi_slave_res_buf[2*j+1]    <=  enc_delta[j][ENCODER_COUNT_WIDTH-1:SPI_SLAVE_DATA_WIDTH];
+                        spi_slave_res_buf[2*j+2]    <=  enc_delta[j][SPI_SLAVE_DATA_WIDTH-1:0];
                     end
                     // The latched watchdog timer count
                     spi_slave_res_buf[2*NUM_ENCODERS+1] <= watchdog_timer[1][WATCHDOG_TIMER_WIDTH - 1: (WATCHDOG_TIMER_WIDTH - SPI_SLAVE_DATA_WIDTH )];
@@ -478,14 +737,25 @@ begin : SPI_SLAVE_LOAD_RESPONSE_BUFFER
 
                 CMD_DUTY_CYCLE :
                 begin
-                    // Latch the current duty cycles of the motors
+                    // Latch the current duty cycles of the motors, always in the high resolution format
                     for (j = 0; j < NUM_MOTORS; j = j + 1)
                     begin : UPDATE_DUTY_CYCLES
-                        spi_slave_res_buf[2*j+1]    <=  duty_cycle[j][DUTY_CYCLE_WIDTH-1:SPI_SLAVE_DATA_WIDTH];
+                        spi_slave_res_buf[2*j+1]    <=  { 1'b1, { (2 * SPI_SLAVE_DATA_WIDTH - DUTY_CYCLE_WIDTH - 1){1'b0} }, duty_cycle[j][DUTY_CYCLE_WIDTH-1:SPI_SLAVE_DATA_WIDTH] };
                         spi_slave_res_buf[2*j+2]    <=  duty_cycle[j][SPI_SLAVE_DATA_WIDTH-1:0];
                     end
                 end
 
+                CMD_PWM_PERIOD :
+                begin
+                    spi_slave_res_buf[1]    <=  { { (2 * SPI_SLAVE_DATA_WIDTH - PWM_PERIOD_WIDTH){1'b0} }, pwm_period[PWM_PERIOD_WIDTH-1:SPI_SLAVE_DATA_WIDTH] };
+                    spi_slave_res_buf[2]    <=  pwm_period[SPI_SLAVE_DATA_WIDTH-1:0];
+                end
+
+                CMD_DESIGN_VERSION :
+                begin
+                    spi_slave_res_buf[1]    <=  DESIGN_VERSION;
+                end
+
 `ifdef GIT_VERSION_HASH
                 CMD_VERSION1 :
                 begin
@@ -542,6 +812,8 @@ begin : SPI_SORT_REQUEST_BUFFER
             duty_cycle[j] <= 0;
         end
 
+        pwm_period <= PWM_PERIOD_DEFAULT;
+
     end else if ( watchdog_trigger == 1 ) begin
         motors_en <= 0;
 
@@ -551,11 +823,25 @@ begin : SPI_SORT_REQUEST_BUFFER
             case ( command_byte_l )
                 CMD_TOGGLE_MOTOR_EN :
                 begin
-                    // Only take action if we received exactly 1 extra byte
+                    // Only take action if we received just the command byte
                     if ( spi_slave_byte_count == 1 ) begin
                         motors_en <= 0;
                     end
                 end
+
+                CMD_PWM_PERIOD :
+                begin
+                    // Low byte first like the duty cycles, limited to what the phase drivers can do
+                    if ( spi_slave_byte_count == 3 ) begin
+                        if ( pwm_period_req < PWM_PERIOD_MIN ) begin
+                            pwm_period <= PWM_PERIOD_MIN;
+                        end else if ( pwm_period_req > `MAX_VALUE( PWM_PERIOD_WIDTH ) ) begin
+                            pwm_period <= `MAX_VALUE( PWM_PERIOD_WIDTH );
+                        end else begin
+                            pwm_period <= pwm_period_req[PWM_PERIOD_WIDTH-1:0];
+                        end
+                    end
+                end
             endcase // command_byte - write
 
         end else begin
@@ -569,12 +855,25 @@ begin : SPI_SORT_REQUEST_BUFFER
                      * if the user flips the top and low bytes of the duty
                      * cycle, so don't do that.
                      */
-                    if ( spi_slave_byte_count == (2 * NUM_MOTORS) ) begin
+                    if ( spi_slave_byte_count == (2 * NUM_MOTORS + 1) ) begin
                         // Set the new duty_cycle values
                         for ( j = 0; j < NUM_MOTORS; j = j + 1 )
                         begin : UPDATE_DUTY_CYCLES
-                            duty_cycle[j][SPI_SLAVE_DATA_WIDTH-1:0]                 <=  spi_slave_req_buf[2*j+1];
-                            duty_cycle[j][DUTY_CYCLE_WIDTH-1:SPI_SLAVE_DATA_WIDTH]  <=  spi_slave_req_buf[2*j+2];   // The received data bytes start at index 1 (not 0)
+                            duty_cycle[j]   <=  duty_cycle_req[j];
+                        end
+
+                        motors_en <= 1;
+                    end
+                end
+
+                CMD_UPDATE_MTRS_CUR, CMD_UPDATE_MTRS_ALL :
+                begin
+                    // The rest of the response is clocked out after the duty cycles,
+                    // so only require the command byte and all of the duty cycle bytes
+                    if ( spi_slave_byte_count > (2 * NUM_MOTORS) ) begin
+                        for ( j = 0; j < NUM_MOTORS; j = j + 1 )
+                        begin : UPDATE_DUTY_CYCLES_CUR
+                            duty_cycle[j]   <=  duty_cycle_req[j];
                         end
 
                         motors_en <= 1;
@@ -583,7 +882,7 @@ begin : SPI_SORT_REQUEST_BUFFER
 
                 CMD_TOGGLE_MOTOR_EN :
                 begin
-                    // Only take action if we received exactly 1 extra byte
+                    // Only take action if we received just the command byte
                     if ( spi_slave_byte_count == 1 ) begin
                         motors_en <= 1;
                     end
@@ -627,19 +926,25 @@ generate
     begin : BLDC_MOTOR_INST
         BLDC_Motor #(
             .MAX_DUTY_CYCLE         ( `MAX_VALUE( DUTY_CYCLE_WIDTH )) ,
+            .PWM_PERIOD_WIDTH       ( PWM_PERIOD_WIDTH              ) ,
             .ENCODER_COUNT_WIDTH    ( ENCODER_COUNT_WIDTH           ) ,
-            .HALL_COUNT_WIDTH       ( HALL_COUNT_WIDTH              )
+            .HALL_COUNT_WIDTH       ( HALL_COUNT_WIDTH              ) ,
+            .VELOCITY_WIDTH         ( VELOCITY_WIDTH                ) ,
+            .VELOCITY_FRAC_WIDTH    ( VELOCITY_FRAC_WIDTH           ) ,
+            .SINUSOIDAL_COMMUTATION ( SINUSOIDAL_COMMUTATION        )
             ) motor (
             .clk                    ( sysclk                        ) ,
             .en                     ( motors_en & sys_rdy           ) ,
             .reset_enc_count        ( motor_update_flag             ) ,
             .reset_hall_count       ( motor_update_flag             ) ,
             .duty_cycle             ( duty_cycle[i]                 ) ,
+            .pwm_period             ( pwm_period                    ) ,
             .enc                    ( enc_s[i]                      ) ,
             .hall                   ( hall_s[i]                     ) ,
             .phaseH                 ( phaseH_o[i]                   ) ,
             .phaseL                 ( phaseL_o[i]                   ) ,
-            .enc_count              ( enc_count[i]                  ) ,
+            .enc_position           ( enc_position[i]               ) ,
+            .enc_velocity           ( enc_velocity[i]               ) ,
             .hall_count             ( hall_count[i]                 ) ,
             .has_error              ( motor_has_error[i]            )
         );
@@ -650,12 +955,14 @@ endgenerate
 `ifndef DRIBBLER_MOTOR_DISABLE
 BLDC_Motor_No_Encoder #(
     .MAX_DUTY_CYCLE         ( `MAX_VALUE( DUTY_CYCLE_WIDTH )        ) ,
+    .PWM_PERIOD_WIDTH       ( PWM_PERIOD_WIDTH                      ) ,
     .HALL_COUNT_WIDTH       ( HALL_COUNT_WIDTH                      )
     ) dribbler_motor (
     .clk                    ( sysclk                                ) ,
     .en                     ( motors_en & sys_rdy                   ) ,
     .reset_hall_count       ( motor_update_flag                     ) ,
     .duty_cycle             ( duty_cycle[DRIBBLER_INDEX]            ) ,
+    .pwm_period             ( pwm_period                            ) ,
     .hall                   ( hall_s[DRIBBLER_INDEX]                ) ,
     .phaseH                 ( phaseH_o[DRIBBLER_INDEX]              ) ,
     .phaseL                 ( phaseL_o[DRIBBLER_INDEX]              ) ,
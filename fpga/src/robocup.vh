@@ -27,6 +27,10 @@
 `define __SIMULATION__
 `endif  // __ICARUS__
 
+`ifdef VERILATOR
+`define __SIMULATION__
+`endif  // VERILATOR
+
 `ifdef __SIMULATION__
 `undef DRIBBLER_MOTOR_DISABLE
 `endif  // __SIMULATION__
@@ -0,0 +1,160 @@
+#!/usr/bin/env python3
+
+#
+# Fits a kick calibration from logged kicks and writes it as an EEPROM
+# image for the kicker
+#
+# The log is a CSV with a row per kick and the columns
+#   strength  what the kick was commanded with, 0 - 255
+#   voltage   cap voltage the kicker reported just before it, ADC counts
+#   speed     ball speed after it, m/s
+# Log kicks with the calibration erased, so the strength is the FET on
+# time, over a spread of strengths and of voltages as the caps drain.
+#
+# Ball speed is fit as voltage * (a * sqrt(t) + b * t) for an on time t,
+# and the table takes the on time closest to each speed at each voltage.
+# The table's layout is read from kicker_commands.h, see Kick calibration
+# there.
+#
+# Example usage:
+# python3 kicker/calibrate.py kicks.csv kick_cal.eep
+# avrdude -c <programmer> -p t167 -U eeprom:w:kick_cal.eep:i
+#
+# The mTrain sets the EESAVE fuse before it flashes the kicker, so the
+# calibration stays through firmware updates.
+#
+
+import argparse
+import csv
+import math
+import os
+import re
+
+COMMANDS_HEADER = os.path.join(os.path.dirname(os.path.abspath(__file__)),
+							   "../robot/lib/Inc/drivers/Internal/kicker_commands.h")
+
+# The firmware's uncalibrated on times, from kicker/main.c
+MIN_FET_TIME_MS = 0.8
+MAX_FET_TIME_MS = 10.0
+TIMER_PER_MS = 4
+FLOW_TICKS_MIN_X1024 = int(MIN_FET_TIME_MS * TIMER_PER_MS * 1024 + 0.5)
+FLOW_TICKS_SLOPE_X1024 = int((MAX_FET_TIME_MS - MIN_FET_TIME_MS) * TIMER_PER_MS * 1024 / 255 + 0.5)
+FLOW_TICKS_MAX = int(MAX_FET_TIME_MS * TIMER_PER_MS + 0.5)
+
+
+def read_defines(path):
+	defines = {}
+	with open(path) as file:
+		for line in file:
+			match = re.match(r"#define\s+(KICK_CAL_\w+|KICKER_CRC_INIT)\s+\((\w+)\)", line)
+			if match is not None:
+				defines[match.group(1)] = int(match.group(2), 0)
+	return defines
+
+
+def crc_update(crc, data):
+	# kicker_crc_update()
+	data ^= crc & 0xff
+	data ^= (data << 4) & 0xff
+	return ((data << 8) | (crc >> 8)) ^ (data >> 4) ^ (data << 3)
+
+
+def fet_time_ms(ticks):
+	# Each phase lasts a tick longer than its count
+	return (ticks + 1) / TIMER_PER_MS
+
+
+def uncalibrated_ticks(strength):
+	return (FLOW_TICKS_MIN_X1024 + FLOW_TICKS_SLOPE_X1024 * strength + 512) >> 10
+
+
+def predict(fit, voltage, time_ms):
+	return voltage * (fit[0] * math.sqrt(time_ms) + fit[1] * time_ms)
+
+
+def fit_kicks(kicks):
+	# Least squares for speed = a * x + b * y
+	sxx = sxy = syy = sxs = sys = 0.0
+	for voltage, time_ms, speed in kicks:
+		x = voltage * math.sqrt(time_ms)
+		y = voltage * time_ms
+		sxx += x * x
+		sxy += x * y
+		syy += y * y
+		sxs += x * speed
+		sys += y * speed
+	det = sxx * syy - sxy * sxy
+	if abs(det) < 1e-12:
+		return None
+	return ((sxs * syy - sys * sxy) / det, (sys * sxx - sxs * sxy) / det)
+
+
+def intel_hex(data, address):
+	out = ""
+	for start in range(0, len(data), 16):
+		chunk = data[start:start + 16]
+		record = bytes([len(chunk), (address + start) >> 8, (address + start) & 0xff, 0]) + chunk
+		out += ":" + record.hex().upper() + "%02X\n" % (-sum(record) & 0xff)
+	out += ":00000001FF\n"
+	return out
+
+
+parser = argparse.ArgumentParser(description="Fit a kick calibration from logged kicks")
+parser.add_argument('log', help="CSV of strength, voltage and speed per kick")
+parser.add_argument('output', help="EEPROM image to write, Intel HEX")
+parser.add_argument('--header', default=COMMANDS_HEADER, help="kicker_commands.h with the table layout")
+args = parser.parse_args()
+
+cal = read_defines(args.header)
+rows = cal["KICK_CAL_ROWS"]
+columns = cal["KICK_CAL_COLUMNS"]
+
+kicks = []
+try:
+	with open(args.log, newline='') as file:
+		for row in csv.DictReader(file):
+			strength = int(row["strength"])
+			kicks.append((float(row["voltage"]), fet_time_ms(uncalibrated_ticks(strength)), float(row["speed"])))
+except (OSError, KeyError, ValueError) as e:
+	print("Failed to read " + str(args.log) + ": " + str(e))
+	exit(-1)
+
+fit = fit_kicks(kicks)
+if fit is None:
+	print("Not enough different kicks in " + str(args.log) + " to fit")
+	exit(-1)
+
+rms = math.sqrt(sum((predict(fit, v, t) - s) ** 2 for v, t, s in kicks) / len(kicks))
+print(str(len(kicks)) + " kicks, speed = V * (%.5f * sqrt(t) + %.5f * t), %.3f m/s RMS error" % (fit[0], fit[1], rms))
+
+row_voltages = [cal["KICK_CAL_VOLTAGE_MIN"] + (r << cal["KICK_CAL_VOLTAGE_SHIFT"]) for r in range(rows)]
+logged = [v for v, _, _ in kicks]
+if min(logged) > row_voltages[0] or max(logged) < row_voltages[-1]:
+	print("Warning: kicks logged from %d to %d, the table goes from %d to %d" %
+		  (min(logged), max(logged), row_voltages[0], row_voltages[-1]))
+
+table = bytearray()
+print("mm/s " + " ".join("%5d" % ((c << cal["KICK_CAL_STRENGTH_SHIFT"]) * cal["KICK_CAL_SPEED_STEP_MM_S"])
+						 for c in range(columns)))
+for voltage in row_voltages:
+	line = ""
+	for c in range(columns):
+		speed = (c << cal["KICK_CAL_STRENGTH_SHIFT"]) * cal["KICK_CAL_SPEED_STEP_MM_S"] / 1000.0
+		ticks = min(range(FLOW_TICKS_MAX + 1), key=lambda t: abs(predict(fit, voltage, fet_time_ms(t)) - speed))
+		table.append(ticks)
+		line += " %5.2f" % fet_time_ms(ticks)
+	print("%3d V" % voltage + line + " ms")
+
+# Version, the table then the CRC of both
+data = bytearray([cal["KICK_CAL_VERSION"]]) + table
+crc = cal["KICKER_CRC_INIT"]
+for b in data:
+	crc = crc_update(crc, b)
+data += bytes([crc & 0xff, crc >> 8])
+
+print("Opening and writing " + args.output)
+
+f = open(args.output, 'w+')
+f.write(intel_hex(bytes(data), cal["KICK_CAL_ADDRESS"]))
+
+print('Done.')
@@ -1,10 +1,13 @@
 #include <stdbool.h>
 
 #include <avr/wdt.h>
+#include <avr/eeprom.h>
 #include <avr/interrupt.h>
 #include <avr/io.h>
+#include <avr/pgmspace.h>
 #include <stddef.h>
 #include <stdlib.h>
+#include <util/atomic.h>
 #include <util/delay.h>
 
 #include "HAL_attiny167.h"
@@ -14,13 +17,24 @@
 #include "pins.h"
 
 // kicker parameters
-#define MAX_KICK_STRENGTH 15.0f //2^4 - 1
+#define MAX_KICK_STRENGTH 255.0f
 #define MIN_EFFECTIVE_KICK_FET_EN_TIME 0.8f
 #define MAX_EFFECTIVE_KICK_FET_EN_TIME 10.0f
 
 #define KICK_TIME_SLOPE \
     (MAX_EFFECTIVE_KICK_FET_EN_TIME - MIN_EFFECTIVE_KICK_FET_EN_TIME)
 
+// FET on time in timer ticks as MIN + SLOPE * strength, scaled by 1024,
+// without a kick calibration
+#define FLOW_TICKS_MIN_X1024 \
+    ((uint32_t)(MIN_EFFECTIVE_KICK_FET_EN_TIME * TIMER_PER_MS * 1024 + 0.5f))
+#define FLOW_TICKS_SLOPE_X1024 \
+    ((uint32_t)(KICK_TIME_SLOPE * TIMER_PER_MS * 1024 / MAX_KICK_STRENGTH + 0.5f))
+
+// Longest FET on time in timer ticks, calibrated or not
+#define FLOW_TICKS_MAX \
+    ((uint8_t)(MAX_EFFECTIVE_KICK_FET_EN_TIME * TIMER_PER_MS + 0.5f))
+
 // How much time to give for the LT to stop charging the caps
 #define STOP_CHARGING_SAFETY_MARGIN_MS 5
 // How much time to give the FET to stop current flow
@@ -42,8 +56,33 @@
 
 #define TIMING_CONSTANT ((MAX_TIMER_FREQ / DESIRED_TIMER_FREQ) - 1)
 
-// get different ball reading for X * 10 us before switching
-#define BALL_SENSE_MAX_SAMPLES 5
+#if KICK_CAL_TICK_US * TIMER_PER_MS != 1000
+#error "The kick calibration's on times have to be in timer ticks"
+#endif
+
+// Reads of the breakbeam that have to agree with an edge for it to count
+#define BALL_SENSE_CONFIRM_SAMPLES 3
+
+// Edges after one that counted are ignored for this long, then the pin is
+// read again, 200 us in timer 1 cycles
+#define BALL_SENSE_LOCKOUT_CYCLES 1600
+
+// Timer 1 runs at the CPU clock, a kicker tick is 1024 of its cycles
+#define CYCLES_PER_TICK_SHIFT 10
+
+// Charge thresholds, in ADC counts like current_voltage
+#define CHARGE_START_VOLTAGE 239
+#define CHARGE_STOP_VOLTAGE 244
+#define OVERVOLTAGE_LIMIT 250
+
+// How long the LT3751 can charge without reaching the target before it's
+// reported, 5 s in kicker ticks
+#define CHARGE_TIMEOUT_TICKS ((uint16_t)(5000000UL / KICKER_TICK_US))
+
+// How long the LT3751 has to have been off for a kick to skip the stop
+// charging phase, in kicker ticks
+#define CHARGE_IDLE_TICKS \
+    ((uint16_t)(STOP_CHARGING_SAFETY_MARGIN_MS * 1000UL / KICKER_TICK_US + 1))
 
 // Corresponds to the values of the kick_type_is_kick
 #define IS_KICK true
@@ -64,19 +103,62 @@ volatile struct {
     volatile bool kick_on_breakbeam; // Kick when breakbeam triggers?
     volatile bool commanded_charge; // Commanded to charge the caps?
     volatile uint8_t kick_power; // Commanded power to kick at
-} command = {false, false, false, false, 0};
+    volatile uint8_t flow_ticks; // FET on time for kick_power, see kick_flow_ticks()
+} command = {false, false, false, false, 0, 0};
+
+// Sequence of the last command frame applied, and of the command behind
+// the last kick that fired
+volatile uint8_t accepted_sequence = 0;
+volatile uint8_t fired_sequence = 0;
 
 // Current kick command
 volatile bool current_kick_type_is_kick = true;
 
+// FET on times from EEPROM, by cap voltage and strength. See Kick
+// calibration in kicker_commands.h.
+uint8_t kick_cal[KICK_CAL_ROWS][KICK_CAL_COLUMNS];
+bool kick_calibrated = false;
+
 // Global vars so we don't have to read pins in interrupts etc
 volatile uint8_t current_voltage = 0;
 volatile bool ball_sensed = false;
 
+// Kicker ticks when the ball was last sensed
+volatile uint16_t ball_sensed_time = 0;
+
+// FAULT_* bits since the last status frame
+volatile uint8_t faults = 0;
+
 // Global state variables
 volatile bool in_debug_mode = false;
 volatile bool charge_allowed = true; // Don't charge during kick
 
+// The LT3751 has been off for at least the stop charging phase
+volatile bool charger_idle = false;
+
+// Upper half of the timer 1 cycle count
+volatile uint16_t timer1_overflows = 0;
+
+#ifdef KICKER_INSTRUMENT_LATENCY
+// Cycles from the last breakbeam edge that kicked to the FET turning on,
+// see READ_KICK_LATENCY_LOW
+volatile uint32_t breakbeam_edge_cycles = 0;
+volatile bool latency_pending = false;
+volatile uint16_t kick_latency = 0;
+#endif
+
+// CRC of the entire flash, computed once at boot
+uint16_t flash_crc = KICKER_CRC_INIT;
+
+// A read reply is in SPDR, send it as the first byte of the next frame
+volatile bool spi_reply_pending = false;
+
+// The frame being received and the status being sent back. Only touched
+// by the SPI and chip select interrupts.
+uint8_t spi_rx[KICKER_FRAME_LENGTH];
+uint8_t spi_tx[FRAME_STATUS_LENGTH];
+volatile uint8_t spi_index = 0;
+
 void init();
 
 /*
@@ -89,36 +171,181 @@ bool is_kicking() {
            time.charge_phase >= 0;
 }
 
+/*
+ * CPU cycles, timer 1 free running at the CPU clock and its overflows
+ */
+uint32_t get_cycles() {
+    uint16_t high;
+    uint16_t low;
+
+    // 16 bit reads go through a temp register the interrupts share
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        high = timer1_overflows;
+        low = TCNT1;
+
+        // Overflowed since interrupts went off
+        if ((TIFR1 & _BV(TOV1)) && low < 0x8000)
+            high++;
+    }
+
+    return ((uint32_t)high << 16) | low;
+}
+
+/*
+ * Kicker ticks of KICKER_TICK_US
+ */
+uint16_t get_time() {
+    return (uint16_t)(get_cycles() >> CYCLES_PER_TICK_SHIFT);
+}
+
+#ifdef KICKER_INSTRUMENT_LATENCY
+/*
+ * The FET just turned on, ends a breakbeam latency measurement
+ */
+void record_kick_latency() {
+    if (!latency_pending)
+        return;
+
+    uint32_t latency = get_cycles() - breakbeam_edge_cycles;
+    kick_latency = latency > 0xFFFF ? 0xFFFF : (uint16_t)latency;
+    latency_pending = false;
+}
+#endif
+
+/*
+ * Turns the FET for the current kick type on
+ */
+void fet_on() {
+    if (current_kick_type_is_kick == IS_KICK) {
+        HAL_SetPin(KICK_PIN);
+    } else {
+        HAL_SetPin(CHIP_PIN);
+    }
+
+#ifdef KICKER_INSTRUMENT_LATENCY
+    record_kick_latency();
+#endif
+}
+
+/*
+ * `frac` of the way from a to b, in steps of 1 << shift, rounded
+ */
+uint8_t interpolate(uint8_t a, uint8_t b, uint8_t frac, uint8_t shift) {
+    uint16_t sum = (uint16_t)a * (uint8_t)((1 << shift) - frac) +
+                   (uint16_t)b * frac;
+    return (uint8_t)((sum + (1 << (shift - 1))) >> shift);
+}
+
+/**
+ * FET on time in timer ticks for a kick at `strength`. Kicks go through
+ * the calibration at the current cap voltage if there is one, chips and
+ * uncalibrated kicks are linear in the strength.
+ *
+ * Without a hardware multiply this is too slow for the breakbeam
+ * interrupt, the main loop keeps command.flow_ticks up to date instead.
+ */
+uint8_t kick_flow_ticks(uint8_t strength, bool is_kick) {
+    if (!kick_calibrated || is_kick == IS_CHIP) {
+        return (uint8_t)((FLOW_TICKS_MIN_X1024 +
+                          FLOW_TICKS_SLOPE_X1024 * strength + 512) >> 10);
+    }
+
+    // The rows either side of the voltage, past the ends the end one
+    uint8_t voltage = current_voltage;
+    uint8_t row = 0;
+    uint8_t row_frac = 0;
+    if (voltage >= KICK_CAL_VOLTAGE_MIN +
+                   ((KICK_CAL_ROWS - 1) << KICK_CAL_VOLTAGE_SHIFT)) {
+        row = KICK_CAL_ROWS - 1;
+    } else if (voltage > KICK_CAL_VOLTAGE_MIN) {
+        uint8_t offset = voltage - KICK_CAL_VOLTAGE_MIN;
+        row = offset >> KICK_CAL_VOLTAGE_SHIFT;
+        row_frac = offset & ((1 << KICK_CAL_VOLTAGE_SHIFT) - 1);
+    }
+
+    // The last column is past 255, so there's always one after
+    uint8_t column = strength >> KICK_CAL_STRENGTH_SHIFT;
+    uint8_t column_frac = strength & ((1 << KICK_CAL_STRENGTH_SHIFT) - 1);
+
+    uint8_t ticks = interpolate(kick_cal[row][column],
+                                kick_cal[row][column + 1],
+                                column_frac, KICK_CAL_STRENGTH_SHIFT);
+
+    if (row_frac != 0) {
+        uint8_t above = interpolate(kick_cal[row + 1][column],
+                                    kick_cal[row + 1][column + 1],
+                                    column_frac, KICK_CAL_STRENGTH_SHIFT);
+        ticks = interpolate(ticks, above, row_frac, KICK_CAL_VOLTAGE_SHIFT);
+    }
+
+    return ticks;
+}
+
 /**
- * start the kick FSM for desired strength. If the FSM is already running,
- * the call will be ignored.
+ * start the kick FSM for desired FET on time, see kick_flow_ticks(). If
+ * the FSM is already running, the call will be ignored.
+ *
+ * Called from the breakbeam interrupt too. When the LT3751 has been off
+ * long enough the stop charging phase is skipped and the FET turns on
+ * straight away.
+ *
+ * @return Whether the kick started
  */
-void kick(uint8_t strength, bool is_kick) {
+bool kick(uint8_t flow_ticks, bool is_kick) {
     // check if the kick FSM is running
-    if (is_kicking()) return;
+    if (is_kicking()) return false;
 
-    // initialize the countdowns for pre and post kick
-    time.stop_charge_phase = (STOP_CHARGING_SAFETY_MARGIN_MS * TIMER_PER_MS);
+    // Set kick type after we have commited to the kick
+    // such that it doesn't change halfway through the kick
+    current_kick_type_is_kick = is_kick;
 
-    // compute time the solenoid FET is turned on, in milliseconds, based on
-    // min and max effective FET enabled times
-    float strength_ratio = (strength / MAX_KICK_STRENGTH);
-    float time_cnt_flt_ms =
-        KICK_TIME_SLOPE * strength_ratio + MIN_EFFECTIVE_KICK_FET_EN_TIME;
-    float time_cnt_flt = time_cnt_flt_ms * TIMER_PER_MS;
-    time.flow_phase = (int)(time_cnt_flt + 0.5f);  // round
+    time.flow_phase = flow_ticks;
 
     time.stop_flow_phase   = (STOP_FLOW_SAFETY_MARGIN_MS * TIMER_PER_MS);
 
     // force to int32_t, default word size too small
     time.charge_phase = ((int32_t)CHARGE_TIME_MS) * TIMER_PER_MS;
 
-    // Set kick type after we have commited to the kick
-    // such that it doesn't change halfway through the kick
-    current_kick_type_is_kick = is_kick;
+    // No charging from here on, charge_caps() checks this with interrupts
+    // off so it can't turn the LT3751 back on under us
+    charge_allowed = false;
+
+    if (charger_idle) {
+        // Turning the FET on now takes the place of the flow phase's first
+        // tick, so the FET is on for as long as after a stop charging phase
+        time.stop_charge_phase = -1;
+        time.flow_phase--;
+        fet_on();
+    } else {
+        // initialize the countdowns for pre and post kick
+        time.stop_charge_phase = (STOP_CHARGING_SAFETY_MARGIN_MS * TIMER_PER_MS);
+        HAL_ClearPin(LT_CHARGE);
+    }
 
-    // start timer to enable the kick FSM processing interrupt
+    // start timer to enable the kick FSM processing interrupt, a full tick
+    // from now
+    TCNT0 = 0;
     TCCR0B |= _BV(CS01); // No prescale
+
+    return true;
+}
+
+/**
+ * Fires the latest command's kick. Called with interrupts off, from the
+ * main loop or the breakbeam interrupt.
+ *
+ * @return Whether the kick started
+ */
+bool fire_command() {
+    command.kick_immediate = false;
+    command.kick_on_breakbeam = false;
+
+    // pow
+    if (!kick(command.flow_ticks, command.kick_type_is_kick))
+        return false;
+
+    fired_sequence = accepted_sequence;
+    return true;
 }
 
 void handle_debug_mode() {
@@ -133,12 +360,14 @@ void handle_debug_mode() {
         bool chip_db_pressed = !(HAL_IsSet(DB_CHIP_PIN));
         bool charge_db_pressed = !(HAL_IsSet(DB_CHG_PIN));
 
-        // Simple rising edge triggers
-        if (!kick_db_down && kick_db_pressed) 
-            kick(255, IS_KICK);
+        // Simple rising edge triggers, the breakbeam interrupt kicks too
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (!kick_db_down && kick_db_pressed)
+                kick(FLOW_TICKS_MAX, IS_KICK);
 
-        if (!chip_db_down && chip_db_pressed)
-            kick(255, IS_CHIP);
+            if (!chip_db_down && chip_db_pressed)
+                kick(FLOW_TICKS_MAX, IS_CHIP);
+        }
 
         // If we should be charging
         if (!charge_db_down && charge_db_pressed)
@@ -150,82 +379,202 @@ void handle_debug_mode() {
     }
 }
 
-uint8_t get_voltage() {
-    // Start conversation by writing to start bit
-    ADCSRA |= _BV(ADSC);
-
-    // Wait for ADSC bit to clear
-    while (ADCSRA & _BV(ADSC));
+/*
+ * Takes a new breakbeam state, from the breakbeam interrupts. Kicks if
+ * the ball just came in and a kick is waiting on it, then ignores the
+ * breakbeam for the lockout so a bouncing edge only counts once.
+ */
+void ball_sense_changed(bool sensed) {
+    ball_sensed = sensed;
+
+    if (sensed) {
+        ball_sensed_time = get_time();
+
+        if (command.kick_on_breakbeam) {
+#ifdef KICKER_INSTRUMENT_LATENCY
+            latency_pending = true;
+            if (!fire_command())
+                latency_pending = false;
+#else
+            fire_command();
+#endif
+        }
+    }
 
-    // ADHC will range from 0 to 255 corresponding to 0 through VCC
-    return ADCH;
+    PCMSK1 &= ~_BV(PCINT11);
+    OCR1B = TCNT1 + BALL_SENSE_LOCKOUT_CYCLES;
+    TIFR1 = _BV(OCF1B);
+    TIMSK1 |= _BV(OCIE1B);
 }
 
-void try_read_voltage() {
-    static uint32_t time = 0;
+void charge_caps() {
+    // When the LT3751 last started and stopped charging
+    static uint16_t charge_start_time = 0;
+    static uint16_t charge_stop_time = 0;
 
-    // Don't run the adc every loop
-    // 1000 * 10 us = 10 ms
-    if (time % 1000 == 0) {
-        current_voltage = get_voltage();
-    }
-    time++;
-}
+    // A kick from an interrupt mustn't land between checking charge_allowed
+    // and turning the LT3751 on
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        // if we dropped below acceptable voltage, then this will catch it
+        // note: these aren't true voltages, just ADC output, but it matches
+        // fairly close
 
-void update_ball_sense() {
-    static uint32_t ball_sense_change_count = 0;
+        // Stop charging if we are at the voltage target
+        if (current_voltage > CHARGE_STOP_VOLTAGE ||
+            !charge_allowed ||
+            !command.commanded_charge) {
 
-    // Filter ball value
-    // Want X amount in a row to be the same
-    bool new_reading = HAL_IsSet(BALL_SENSE_RX);
+            if (HAL_IsSet(LT_CHARGE))
+                charge_stop_time = get_time();
 
-    // If we sensed the ball, but don't think it's triggered
-    // or we didn't sense the ball, and think it's triggered
-    // AKA our estimate is wrong
-    if (ball_sensed ^ new_reading)
-        ball_sense_change_count++;
-    else // else correct reading
-        ball_sense_change_count = 0;
+            HAL_ClearPin(LT_CHARGE);
 
-    // We got a wrong reading X times in a row
-    // so we should swap
-    if (ball_sense_change_count > BALL_SENSE_MAX_SAMPLES) {
-        ball_sense_change_count = 0;
+        // Charge if we are too low
+        } else if (current_voltage < CHARGE_START_VOLTAGE &&
+                   charge_allowed &&
+                   command.commanded_charge) {
 
-        ball_sensed = !ball_sensed;
+            if (!HAL_IsSet(LT_CHARGE))
+                charge_start_time = get_time();
+
+            HAL_SetPin(LT_CHARGE);
+            charger_idle = false;
+        }
     }
-}
 
-void charge_caps() {
-    // if we dropped below acceptable voltage, then this will catch it
-    // note: these aren't true voltages, just ADC output, but it matches
-    // fairly close
-    
-    // Stop charging if we are at the voltage target
-    if (current_voltage > 244 ||
-        !charge_allowed ||
-        !command.commanded_charge) {
+    // Checked every loop, so the tick count can't wrap around unseen
+    if (!HAL_IsSet(LT_CHARGE) && !charger_idle &&
+        (uint16_t)(get_time() - charge_stop_time) >= CHARGE_IDLE_TICKS) {
+        charger_idle = true;
+    }
 
-        HAL_ClearPin(LT_CHARGE);
+    uint8_t new_faults = 0;
+
+    if (HAL_IsSet(LT_CHARGE) &&
+        (uint16_t)(get_time() - charge_start_time) > CHARGE_TIMEOUT_TICKS) {
+        new_faults |= FAULT_CHARGE_TIMEOUT;
+
+        // Keeps it from wrapping around to look like a fresh charge
+        charge_start_time = get_time() - CHARGE_TIMEOUT_TICKS;
+    }
 
-    // Charge if we are too low
-    } else if (current_voltage < 239 &&
-               charge_allowed &&
-               command.commanded_charge) {
+    if (current_voltage > OVERVOLTAGE_LIMIT)
+        new_faults |= FAULT_OVERVOLTAGE;
 
-        HAL_SetPin(LT_CHARGE);
+    ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+        faults |= new_faults;
     }
 }
 
-void fill_spi_return() {
-    uint8_t ret_byte = 0x00;
+/*
+ * Snapshots the state into the status frame, at the start of a frame
+ */
+void fill_status_frame() {
+    uint8_t state = 0x00;
 
     if (ball_sensed)
-        ret_byte |= BREAKBEAM_TRIPPED;
+        state |= STATE_BALL_SENSED;
+    if (HAL_IsSet(LT_CHARGE))
+        state |= STATE_CHARGING;
+    if (current_voltage >= CHARGE_START_VOLTAGE)
+        state |= STATE_CHARGED;
+    if (is_kicking())
+        state |= STATE_KICKING;
+    if (command.kick_on_breakbeam)
+        state |= STATE_ARMED;
+    if (command.commanded_charge)
+        state |= STATE_CHARGE_ALLOWED;
+    if (in_debug_mode)
+        state |= STATE_DEBUG_MODE;
+    if (kick_calibrated)
+        state |= STATE_CALIBRATED;
+
+    uint16_t now = get_time();
+
+    spi_tx[FRAME_STATUS_VERSION] = KICKER_PROTOCOL_VERSION;
+    spi_tx[FRAME_STATUS_STATE] = state;
+    spi_tx[FRAME_STATUS_FAULTS] = faults;
+    spi_tx[FRAME_STATUS_VOLTAGE] = current_voltage;
+    spi_tx[FRAME_STATUS_ACCEPTED_SEQUENCE] = accepted_sequence;
+    spi_tx[FRAME_STATUS_FIRED_SEQUENCE] = fired_sequence;
+    spi_tx[FRAME_STATUS_TIME] = now & 0xFF;
+    spi_tx[FRAME_STATUS_TIME + 1] = now >> 8;
+    spi_tx[FRAME_STATUS_BREAKBEAM_TIME] = ball_sensed_time & 0xFF;
+    spi_tx[FRAME_STATUS_BREAKBEAM_TIME + 1] = ball_sensed_time >> 8;
+
+    uint16_t crc = kicker_frame_crc(spi_tx, FRAME_STATUS_CRC);
+    spi_tx[FRAME_STATUS_CRC] = crc & 0xFF;
+    spi_tx[FRAME_STATUS_CRC + 1] = crc >> 8;
+
+    faults = 0;
+}
+
+uint16_t compute_flash_crc() {
+    uint16_t crc = KICKER_CRC_INIT;
+
+    for (uint16_t addr = 0; addr <= FLASHEND; addr++)
+        crc = kicker_crc_update(crc, pgm_read_byte(addr));
+
+    return crc;
+}
+
+/*
+ * Loads the kick calibration from EEPROM, if there's an intact one
+ */
+void load_kick_calibration() {
+    uint8_t cal[KICK_CAL_LENGTH];
+    eeprom_read_block(cal, (const void*)KICK_CAL_ADDRESS, KICK_CAL_LENGTH);
+
+    uint16_t crc = cal[KICK_CAL_CRC] | ((uint16_t)cal[KICK_CAL_CRC + 1] << 8);
+    if (cal[0] != KICK_CAL_VERSION ||
+        kicker_frame_crc(cal, KICK_CAL_CRC) != crc)
+        return;
+
+    // Never on for longer than an uncalibrated kick at full power
+    const uint8_t* ticks = cal + KICK_CAL_TABLE;
+    for (uint8_t row = 0; row < KICK_CAL_ROWS; row++) {
+        for (uint8_t column = 0; column < KICK_CAL_COLUMNS; column++) {
+            uint8_t t = *ticks++;
+            kick_cal[row][column] = t > FLOW_TICKS_MAX ? FLOW_TICKS_MAX : t;
+        }
+    }
 
-    ret_byte |= VOLTAGE_MASK & (current_voltage >> 1);
+    kick_calibrated = true;
+}
 
-    SPDR = ret_byte;
+/*
+ * Puts the value asked for by a read command in SPDR, to be sent back
+ * in the next transfer
+ */
+void reply_to_read(uint8_t read) {
+    uint8_t reply = 0x00;
+
+    switch (read) {
+        case READ_FLASH_CRC_LOW:
+            reply = flash_crc & 0xFF;
+            break;
+
+        case READ_FLASH_CRC_HIGH:
+            reply = flash_crc >> 8;
+            break;
+
+        case READ_PROTOCOL_VERSION:
+            reply = KICKER_PROTOCOL_VERSION;
+            break;
+
+#ifdef KICKER_INSTRUMENT_LATENCY
+        case READ_KICK_LATENCY_LOW:
+            reply = kick_latency & 0xFF;
+            break;
+
+        case READ_KICK_LATENCY_HIGH:
+            reply = kick_latency >> 8;
+            break;
+#endif
+    }
+
+    SPDR = reply;
+    spi_reply_pending = true;
 }
 
 void main() {
@@ -235,67 +584,206 @@ void main() {
 
         handle_debug_mode();
 
-        try_read_voltage();
-
-        update_ball_sense();
-
         charge_caps();
 
-        // Kick on give command
-        if ((command.kick_on_breakbeam && ball_sensed) ||
-            command.kick_immediate) {
-
-            // pow
-            kick(command.kick_power, command.kick_type_is_kick);
-            command.kick_immediate = false;
-            command.kick_on_breakbeam = false;
+        // The on time for the commanded power at the voltage now, for
+        // when the breakbeam kicks. A frame changing the command part way
+        // through works it out itself.
+        uint8_t power = command.kick_power;
+        bool is_kick = command.kick_type_is_kick;
+        uint8_t flow_ticks = kick_flow_ticks(power, is_kick);
+
+        // Kick on give command. The breakbeam interrupt kicks when the
+        // ball comes in, this catches a kick armed with the ball already
+        // there. A new frame could replace the command part way through.
+        ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+            if (command.kick_power == power &&
+                command.kick_type_is_kick == is_kick)
+                command.flow_ticks = flow_ticks;
+
+            if ((command.kick_on_breakbeam && ball_sensed) ||
+                command.kick_immediate) {
+                fire_command();
+            }
         }
 
-        fill_spi_return();
-
         _delay_us(10);
     }
 }
 
 /*
- * SPI Interrupt. Triggers when we have a new byte available, it'll be
- * stored in SPDR. Writing a response also occurs using the SPDR register.
- * 
- * Receive the command and set the global variables accordingly
+ * Applies a complete command frame in spi_rx
  */
-ISR(SPI_STC_vect) {
+void handle_command_frame() {
+    uint16_t crc = spi_rx[FRAME_CMD_CRC] |
+                   ((uint16_t)spi_rx[FRAME_CMD_CRC + 1] << 8);
+
+    if (spi_rx[FRAME_CMD_VERSION] != KICKER_PROTOCOL_VERSION ||
+        kicker_frame_crc(spi_rx, FRAME_CMD_CRC) != crc) {
+        faults |= FAULT_BAD_FRAME;
+        return;
+    }
+
     // Don't take commands in debug mode
     if (in_debug_mode)
         return;
-    
-    uint8_t recv_data = SPDR;
-    
+
+    uint8_t flags = spi_rx[FRAME_CMD_FLAGS];
+
     // Fill our globals with the commands
-    command.kick_type_is_kick = (recv_data & TYPE_FIELD) == TYPE_KICK;
-    command.commanded_charge  = recv_data & CHARGE_ALLOWED;
-    command.kick_power        = recv_data & KICK_POWER_MASK;
+    command.kick_type_is_kick = (flags & TYPE_FIELD) == TYPE_KICK;
+    command.commanded_charge  = flags & CHARGE_ALLOWED;
+    command.kick_power        = spi_rx[FRAME_CMD_STRENGTH];
 
     // If chip, force max power
     if (command.kick_type_is_kick == IS_CHIP) {
-        command.kick_power = 0xF;
+        command.kick_power = 0xFF;
     }
 
+    command.flow_ticks = kick_flow_ticks(command.kick_power,
+                                         command.kick_type_is_kick);
+
+    // The same frame is sent until it's acknowledged, only act on it once
+    uint8_t sequence = spi_rx[FRAME_CMD_SEQUENCE];
+    if (sequence == accepted_sequence)
+        return;
+
+    accepted_sequence = sequence;
+
     // If we get a cancel kick command
     // Stop the kicks
-    if ((recv_data & CANCEL_KICK) == CANCEL_KICK) {
+    if ((flags & CANCEL_KICK) == CANCEL_KICK) {
         command.kick_immediate = false;
         command.kick_on_breakbeam = false;
 
     // Set the correct kick action
-    } else if (recv_data & KICK_IMMEDIATE) {
+    } else if (flags & KICK_IMMEDIATE) {
         command.kick_immediate    = true;
         command.kick_on_breakbeam = false;
-    } else if (recv_data & KICK_ON_BREAKBEAM) {
+    } else if (flags & KICK_ON_BREAKBEAM) {
         command.kick_immediate    = false;
         command.kick_on_breakbeam = true;
     }
 }
 
+/*
+ * SPI Interrupt. Triggers when we have a new byte available, it'll be
+ * stored in SPDR. Writing a response also occurs using the SPDR register.
+ *
+ * Stores the byte and queues up the next status byte, mtrain leaves a
+ * gap between bytes for this
+ */
+ISR(SPI_STC_vect) {
+    uint8_t recv_data = SPDR;
+    uint8_t index = spi_index;
+
+    // Any reply was just sent
+    spi_reply_pending = false;
+
+    if (index < KICKER_FRAME_LENGTH)
+        spi_rx[index] = recv_data;
+
+    if (index < 0xFF)
+        spi_index = index + 1;
+
+    // A frame never starts with a read, so this is a single byte read.
+    // Reads don't change any commands, so answer them in debug mode too.
+    if (index == 0 && IS_READ_COMMAND(recv_data)) {
+        reply_to_read(recv_data);
+        return;
+    }
+
+    // Byte index + 1 of the frame is status byte index
+    SPDR = index < FRAME_STATUS_LENGTH ? spi_tx[index] : 0x00;
+}
+
+/*
+ * Breakbeam interrupt, on either edge
+ */
+ISR(PCINT1_vect) {
+#ifdef KICKER_INSTRUMENT_LATENCY
+    uint32_t edge_cycles = get_cycles();
+#endif
+
+    bool sensed = HAL_IsSet(BALL_SENSE_RX);
+
+    // Too short to be the ball
+    for (uint8_t i = 0; i < BALL_SENSE_CONFIRM_SAMPLES; i++) {
+        if (HAL_IsSet(BALL_SENSE_RX) != sensed)
+            return;
+    }
+
+    if (sensed == ball_sensed)
+        return;
+
+#ifdef KICKER_INSTRUMENT_LATENCY
+    breakbeam_edge_cycles = edge_cycles;
+#endif
+
+    ball_sense_changed(sensed);
+}
+
+/*
+ * End of the breakbeam lockout, catches up on anything it missed
+ */
+ISR(TIMER1_COMPB_vect) {
+    TIMSK1 &= ~_BV(OCIE1B);
+
+    // Drop the edges from the lockout and listen again
+    PCIFR = _BV(PCIF1);
+    PCMSK1 |= _BV(PCINT11);
+
+    bool sensed = HAL_IsSet(BALL_SENSE_RX);
+    if (sensed != ball_sensed) {
+#ifdef KICKER_INSTRUMENT_LATENCY
+        // When it actually changed is somewhere in the lockout
+        breakbeam_edge_cycles = get_cycles();
+#endif
+
+        ball_sense_changed(sensed);
+    }
+}
+
+/*
+ * Kicker clock, counts the upper half of the timer 1 cycles
+ */
+ISR(TIMER1_OVF_vect) {
+    timer1_overflows++;
+}
+
+/*
+ * ADC conversion done, it's free running so the next one has started
+ */
+ISR(ADC_vect) {
+    // ADHC will range from 0 to 255 corresponding to 0 through VCC
+    current_voltage = ADCH;
+}
+
+/*
+ * Chip select interrupt. Frames are handled once it rises, and the status
+ * is snapshot when it falls.
+ */
+ISR(PCINT0_vect) {
+    // Between single byte reads it can rise and fall again before this
+    // runs, so finish the last frame whichever edge this is
+    if (spi_index == KICKER_FRAME_LENGTH) {
+        handle_command_frame();
+    } else if (spi_index > 1 ||
+               (spi_index == 1 && !IS_READ_COMMAND(spi_rx[0]))) {
+        faults |= FAULT_BAD_FRAME;
+    }
+
+    spi_index = 0;
+
+    if (!HAL_IsSet(N_KICK_CS_PIN)) {
+        // mtrain waits at least 10 us before the first byte
+        fill_status_frame();
+
+        if (!spi_reply_pending)
+            SPDR = 0x00;
+    }
+}
+
 /**
  * Timer interrupt for chipping/kicking - called every millisecond by timer
  *
@@ -334,11 +822,7 @@ ISR(TIMER0_COMPA_vect) {
          * wait for kick interval to end
          */
 
-        if (current_kick_type_is_kick == IS_KICK) {
-            HAL_SetPin(KICK_PIN);
-        } else {
-            HAL_SetPin(CHIP_PIN);
-        }
+        fet_on();
 
         time.flow_phase--;
     } else if (time.stop_flow_phase >= 0) {
@@ -449,7 +933,17 @@ void init() {
     // This is because you cannot go from {input, tristate} -> {output, high}
     // in a single step
     HAL_SetPin(BALL_SENSE_TX);
+
+    // Interrupt on either breakbeam edge
+    PCMSK1 |= _BV(PCINT11);
+    PCICR |= _BV(PCIE1);
     
+    // Before SPI is enabled, so it's ready for the first read. Takes
+    // around 60 ms.
+    flash_crc = compute_flash_crc();
+
+    load_kick_calibration();
+
     /**
      * Enable SPI slave
      */
@@ -458,6 +952,10 @@ void init() {
     SPCR &= ~_BV(MSTR);
     SPCR |= _BV(SPE) | _BV(SPIE);
 
+    // Frames are framed by chip select, interrupt on both of its edges
+    PCMSK0 |= _BV(PCINT6);
+    PCICR |= _BV(PCIE0);
+
     ///////////////////////////////////////////////////////////////////////////
     //  TIMER INITIALIZATION
     //
@@ -481,6 +979,12 @@ void init() {
     TIMSK0 |= _BV(OCIE0A);    // Interrupt on TIMER 0
     TCCR0A |= _BV(WGM01); // CTC
     OCR0A = TIMING_CONSTANT;  // OCR0A is max val of timer before reset
+
+    // Timer 1 free runs at the CPU clock, with the overflows as the upper
+    // half it's the kicker's clock. Compare B times the breakbeam lockout.
+    TCCR1A = 0x00;
+    TCCR1B = _BV(CS10);
+    TIMSK1 |= _BV(TOIE1);
     ///////////////////////////////////////////////////////////////////////////
 
 
@@ -496,8 +1000,13 @@ void init() {
     //  Ensure ADC isn't off
     PRR &= ~_BV(PRADC);
 
-    // Enable adc
-    ADCSRA |= _BV(ADEN);
+    // Free running (ADTS = 0) with an interrupt after every conversion, at
+    // clk / 128 that's a new voltage every 208 us without the main loop
+    // waiting on it
+    ADCSRB &= ~(_BV(ADTS2) | _BV(ADTS1) | _BV(ADTS0));
+    ADCSRA |= _BV(ADEN) | _BV(ADATE) | _BV(ADIE) |
+              _BV(ADPS2) | _BV(ADPS1) | _BV(ADPS0);
+    ADCSRA |= _BV(ADSC);
 
     /**
      * Button logic
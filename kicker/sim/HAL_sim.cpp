@@ -0,0 +1,38 @@
+/**
+ * HAL_attiny167.c for the simulation, built into the firmware module
+ *
+ * The only difference is HAL_IsSet on an output. The chip's PINx follows
+ * the pin a cycle after PORTx changes, the simulation only drives PINx from
+ * outside, so an output reads back from PORTx.
+ */
+
+#include "HAL_attiny167.h"
+
+void HAL_SetLED(pin_name p, bool on) {
+    if (on)
+        HAL_ClearPin(p);
+    else
+        HAL_SetPin(p);
+}
+
+bool HAL_IsSet(pin_name p) {
+    if (*p.dd_reg & _BV(p.pin))
+        return *p.port_reg & _BV(p.pin);
+    return *p.pin_reg & _BV(p.pin);
+}
+
+void HAL_SetPin(pin_name p) {
+    *p.port_reg |= _BV(p.pin);
+}
+
+void HAL_ClearPin(pin_name p) {
+    *p.port_reg &= ~_BV(p.pin);
+}
+
+void HAL_SetInputPin(pin_name p) {
+    *p.dd_reg &= ~_BV(p.pin);
+}
+
+void HAL_SetOutputPin(pin_name p) {
+    *p.dd_reg |= _BV(p.pin);
+}
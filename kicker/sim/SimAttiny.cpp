@@ -0,0 +1,571 @@
+#include "SimAttiny.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <iterator>
+
+#include <dlfcn.h>
+
+#include <avr/eeprom.h>
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+
+SimAttiny* SimAttiny::active = nullptr;
+
+// The registers, the firmware module links against these
+
+volatile uint8_t SREG = 0;
+
+volatile uint8_t DDRA = 0, PORTA = 0, PINA = 0;
+volatile uint8_t DDRB = 0, PORTB = 0, PINB = 0;
+
+volatile uint8_t MCUCR = 0, MCUSR = 0, WDTCR = 0, CLKPR = 0, PRR = 0;
+
+volatile uint8_t SPCR = 0;
+SpiDataRegister SPDR;
+
+volatile uint8_t PCICR = 0, PCMSK0 = 0, PCMSK1 = 0;
+FlagRegister PCIFR;
+
+volatile uint8_t TCCR0A = 0, TCCR0B = 0, TCNT0 = 0, OCR0A = 0, TIMSK0 = 0;
+FlagRegister TIFR0;
+
+volatile uint8_t TCCR1A = 0, TCCR1B = 0, TIMSK1 = 0;
+Timer1Counter TCNT1;
+volatile uint16_t OCR1B = 0;
+FlagRegister TIFR1;
+
+volatile uint8_t ADMUX = 0, ADCSRA = 0, ADCSRB = 0, ADCH = 0;
+
+SpiDataRegister& SpiDataRegister::operator=(uint8_t data) {
+    SimAttiny::active->writeSpdr(data);
+    return *this;
+}
+
+SpiDataRegister::operator uint8_t() const {
+    return SimAttiny::active->readSpdr();
+}
+
+Timer1Counter::operator uint16_t() const {
+    return SimAttiny::active->timer1();
+}
+
+uint8_t pgm_read_byte(uint16_t address) {
+    return SimAttiny::active->flashByte(address);
+}
+
+void eeprom_read_block(void* dst, const void* src, size_t n) {
+    const auto address = static_cast<uint16_t>(reinterpret_cast<uintptr_t>(src));
+    for (size_t i = 0; i < n; i++) {
+        static_cast<uint8_t*>(dst)[i] = SimAttiny::active->eepromByte(address + i);
+    }
+}
+
+void _delay_us(double us) {
+    SimAttiny::active->firmwareDelay(us);
+}
+
+namespace {
+constexpr size_t kFirmwareStackSize = 256 * 1024;
+
+// Handlers the firmware may define, in vector order, which is their
+// priority. Ones it doesn't define are left out of the module.
+constexpr const char* kVectorNames[] = {
+    "PCINT0_vect", "PCINT1_vect", "TIMER1_COMPB_vect", "TIMER1_OVF_vect",
+    "TIMER0_COMPA_vect", "SPI_STC_vect", "ADC_vect",
+};
+enum Vector { kPcint0, kPcint1, kTimer1CompB, kTimer1Ovf, kTimer0CompA, kSpiStc, kAdc };
+
+// Prescalers selected by CSn2..0, 0 is stopped
+constexpr uint32_t kTimerPrescalers[8] = {0, 1, 8, 64, 256, 1024, 0, 0};
+
+// Serial programming write and erase times, from the datasheet
+constexpr double kFlashWriteTime = 4.5e-3;
+constexpr double kChipEraseTime = 9.0e-3;
+constexpr double kFuseWriteTime = 4.5e-3;
+
+constexpr uint8_t kSignature[3] = {0x1E, 0x94, 0x87};
+
+// Pin levels seen last step for pin changes, ports A and B
+uint8_t lastLevels[2] = {0, 0};
+
+uint8_t levels(char port) {
+    const uint8_t ddr = port == 'A' ? DDRA : DDRB;
+    const uint8_t out = port == 'A' ? PORTA : PORTB;
+    const uint8_t in = port == 'A' ? PINA : PINB;
+    return static_cast<uint8_t>((out & ddr) | (in & ~ddr));
+}
+
+void checkPinChanges() {
+    const uint8_t a = levels('A');
+    const uint8_t b = levels('B');
+    if ((a ^ lastLevels[0]) & PCMSK0) {
+        PCIFR.set(_BV(PCIF0));
+    }
+    if ((b ^ lastLevels[1]) & PCMSK1) {
+        PCIFR.set(_BV(PCIF1));
+    }
+    lastLevels[0] = a;
+    lastLevels[1] = b;
+}
+
+uint64_t toCycles(double seconds) {
+    return static_cast<uint64_t>(seconds * SimAttiny::kClockHz);
+}
+}
+
+SimAttiny::SimAttiny(std::string firmwarePath, std::vector<uint8_t> flashImage)
+    : flash(std::move(flashImage)), eeprom(kEepromSize, 0xFF),
+      firmwarePath(std::move(firmwarePath)),
+      firmwareStack(new char[kFirmwareStackSize]) {
+    flash.resize(kFlashSize, 0xFF);
+    std::fill(std::begin(pageBuffer), std::end(pageBuffer), 0xFF);
+    active = this;
+    resetPeripherals();
+}
+
+SimAttiny::~SimAttiny() {
+    unload();
+    if (active == this) {
+        active = nullptr;
+    }
+}
+
+void SimAttiny::advance(double seconds) {
+    pendingTime += seconds * kClockHz;
+    const double whole = std::floor(pendingTime);
+    pendingTime -= whole;
+    advanceCycles(static_cast<uint64_t>(whole));
+}
+
+void SimAttiny::advanceCycles(uint64_t cycles) {
+    const uint64_t end = cycleCount + cycles;
+    while (cycleCount + kStepCycles <= end) {
+        step();
+    }
+    // Less than a step is left over, it's carried to the next call
+    pendingTime += static_cast<double>(end - cycleCount);
+}
+
+void SimAttiny::setPin(Pin pin, bool level) {
+    volatile uint8_t& in = pinRegister(pin.port);
+    if (level) {
+        in |= _BV(pin.bit);
+    } else {
+        in &= static_cast<uint8_t>(~_BV(pin.bit));
+    }
+    checkPinChanges();
+}
+
+bool SimAttiny::pin(Pin pin) const {
+    return levels(pin.port) & _BV(pin.bit);
+}
+
+void SimAttiny::setReset(bool level) {
+    if (level != inReset) {
+        return;
+    }
+
+    inReset = !level;
+    if (inReset) {
+        unload();
+        resetPeripherals();
+        ispEnabled = false;
+        ispIndex = 0;
+        ispClockHz = (fuseLow & kFuseCkdiv8) ? kClockHz : kClockHz / 8;
+    } else {
+        boot();
+    }
+}
+
+uint8_t SimAttiny::spiTransfer(uint8_t mosi, int hz) {
+    const double byteTime = 8.0 / hz;
+
+    if (inReset) {
+        advance(byteTime);
+        // SCK high and low each need more than 2 of the chip's cycles
+        if (static_cast<uint64_t>(hz) * 4 >= ispClockHz) {
+            ispClockViolations++;
+            return ispTransfer(0xFF);
+        }
+        return ispTransfer(mosi);
+    }
+
+    // Chip select high, the slave leaves MISO alone and the pull up wins
+    if (!(SPCR & _BV(SPE)) || pin({'A', PA6})) {
+        advance(byteTime);
+        return 0xFF;
+    }
+
+    spiBusy = true;
+    const uint8_t miso = spiShift;
+    advance(byteTime);
+    spiBusy = false;
+
+    // Unless the firmware loads a new byte, the received one goes back out
+    spiReceived = mosi;
+    spiShift = mosi;
+    spiDone = true;
+    return miso;
+}
+
+void SimAttiny::writeSpdr(uint8_t data) {
+    // A write collision on the chip, the byte in flight is unchanged
+    if (!spiBusy) {
+        spiShift = data;
+    }
+}
+
+uint8_t SimAttiny::flashByte(uint16_t address) const {
+    return address < flash.size() ? flash[address] : 0xFF;
+}
+
+uint8_t SimAttiny::eepromByte(uint16_t address) const {
+    return address < eeprom.size() ? eeprom[address] : 0xFF;
+}
+
+void SimAttiny::writeEeprom(size_t address, const std::vector<uint8_t>& data) {
+    for (size_t i = 0; i < data.size() && address + i < eeprom.size(); i++) {
+        eeprom[address + i] = data[i];
+    }
+}
+
+void SimAttiny::firmwareDelay(double us) {
+    firmwareWakeCycle = cycleCount + toCycles(us * 1e-6);
+    swapcontext(&firmwareContext, &simContext);
+}
+
+void SimAttiny::firmwareEntry() {
+    active->firmwareMain();
+
+    // The firmware never returns from main
+    fprintf(stderr, "Kicker firmware returned from main\n");
+    abort();
+}
+
+void SimAttiny::boot() {
+    firmware = dlopen(firmwarePath.c_str(), RTLD_NOW | RTLD_LOCAL);
+    if (firmware == nullptr) {
+        fprintf(stderr, "Couldn't load the kicker firmware: %s\n", dlerror());
+        abort();
+    }
+
+    firmwareMain = reinterpret_cast<Entry>(dlsym(firmware, "kicker_main"));
+    if (firmwareMain == nullptr) {
+        fprintf(stderr, "The kicker firmware has no kicker_main\n");
+        abort();
+    }
+    for (size_t i = 0; i < std::size(kVectorNames); i++) {
+        vectors[i] = reinterpret_cast<Handler>(dlsym(firmware, kVectorNames[i]));
+    }
+
+    getcontext(&firmwareContext);
+    firmwareContext.uc_stack.ss_sp = firmwareStack.get();
+    firmwareContext.uc_stack.ss_size = kFirmwareStackSize;
+    firmwareContext.uc_link = nullptr;
+    makecontext(&firmwareContext, firmwareEntry, 0);
+    firmwareWakeCycle = cycleCount;
+
+    boots++;
+}
+
+void SimAttiny::unload() {
+    if (firmware == nullptr) {
+        return;
+    }
+
+    // Wherever the firmware was parked, it never resumes
+    dlclose(firmware);
+    firmware = nullptr;
+    firmwareMain = nullptr;
+    std::fill(std::begin(vectors), std::end(vectors), nullptr);
+
+    // Its globals would carry over to the next boot
+    if (dlopen(firmwarePath.c_str(), RTLD_NOW | RTLD_NOLOAD) != nullptr) {
+        fprintf(stderr, "The kicker firmware module can't be unloaded\n");
+        abort();
+    }
+}
+
+void SimAttiny::resetPeripherals() {
+    // PINx are driven from outside and keep their levels
+    SREG = 0;
+    DDRA = PORTA = DDRB = PORTB = 0;
+    MCUCR = MCUSR = WDTCR = CLKPR = PRR = 0;
+    SPCR = 0;
+    PCICR = PCMSK0 = PCMSK1 = 0;
+    TCCR0A = TCCR0B = TCNT0 = OCR0A = TIMSK0 = 0;
+    TCCR1A = TCCR1B = TIMSK1 = 0;
+    OCR1B = 0;
+    ADMUX = ADCSRA = ADCSRB = ADCH = 0;
+    PCIFR = 0xFF;
+    TIFR0 = 0xFF;
+    TIFR1 = 0xFF;
+
+    timer0Prescale = timer1Prescale = 0;
+    timer1Count = 0;
+    adcCycles = 0;
+    adcConverting = false;
+    adcFirst = true;
+    spiBusy = spiDone = false;
+    spiShift = spiReceived = 0;
+
+    lastLevels[0] = levels('A');
+    lastLevels[1] = levels('B');
+}
+
+void SimAttiny::step() {
+    cycleCount += kStepCycles;
+
+    if (!inReset) {
+        stepTimer0();
+        stepTimer1();
+        stepAdc();
+    }
+
+    if (onStep) {
+        onStep(static_cast<double>(kStepCycles) / kClockHz);
+    }
+
+    if (inReset) {
+        return;
+    }
+
+    checkPinChanges();
+    runInterrupts();
+
+    if (cycleCount >= firmwareWakeCycle) {
+        runFirmware();
+        checkPinChanges();
+    }
+}
+
+void SimAttiny::stepTimer0() {
+    const uint32_t prescaler = kTimerPrescalers[TCCR0B & 0x07];
+    if (prescaler == 0) {
+        timer0Prescale = 0;
+        return;
+    }
+
+    timer0Prescale += kStepCycles;
+    while (timer0Prescale >= prescaler) {
+        timer0Prescale -= prescaler;
+
+        // Clear timer on compare match
+        if ((TCCR0A & _BV(WGM01)) && TCNT0 == OCR0A) {
+            TCNT0 = 0;
+            TIFR0.set(_BV(OCF0A));
+        } else {
+            TCNT0++;
+        }
+    }
+}
+
+void SimAttiny::stepTimer1() {
+    const uint32_t prescaler = kTimerPrescalers[TCCR1B & 0x07];
+    if (prescaler == 0) {
+        timer1Prescale = 0;
+        return;
+    }
+
+    timer1Prescale += kStepCycles;
+    while (timer1Prescale >= prescaler) {
+        timer1Prescale -= prescaler;
+
+        // Normal mode
+        timer1Count++;
+        if (timer1Count == 0) {
+            TIFR1.set(_BV(TOV1));
+        }
+        if (timer1Count == OCR1B) {
+            TIFR1.set(_BV(OCF1B));
+        }
+    }
+}
+
+void SimAttiny::stepAdc() {
+    if (!(ADCSRA & _BV(ADEN))) {
+        adcConverting = false;
+        adcFirst = true;
+        return;
+    }
+
+    if (!adcConverting) {
+        if (!(ADCSRA & _BV(ADSC))) {
+            return;
+        }
+        adcConverting = true;
+        adcCycles = 0;
+    }
+
+    const uint8_t adps = ADCSRA & 0x07;
+    const uint32_t prescaler = adps == 0 ? 2 : (1u << adps);
+    // The first conversion after enabling also sets up the analog side
+    const uint32_t conversion = (adcFirst ? 25 : 13) * prescaler;
+
+    adcCycles += kStepCycles;
+    if (adcCycles < conversion) {
+        return;
+    }
+
+    // Left adjusted, ADCH is the top 8 bits
+    ADCH = voltage;
+    ADCSRA |= _BV(ADIF);
+    adcFirst = false;
+    adcCycles -= conversion;
+
+    if (!(ADCSRA & _BV(ADATE))) {
+        ADCSRA &= static_cast<uint8_t>(~_BV(ADSC));
+        adcConverting = false;
+    }
+}
+
+void SimAttiny::runInterrupts() {
+    // A handler can raise another flag, but not forever
+    for (int handled = 0; handled < 16 && (SREG & _BV(SREG_I)); handled++) {
+        // Flags are cleared as their handler is entered
+        int next = -1;
+        if ((PCIFR & _BV(PCIF0)) && (PCICR & _BV(PCIE0))) {
+            PCIFR = _BV(PCIF0);
+            next = kPcint0;
+        } else if ((PCIFR & _BV(PCIF1)) && (PCICR & _BV(PCIE1))) {
+            PCIFR = _BV(PCIF1);
+            next = kPcint1;
+        } else if ((TIFR1 & _BV(OCF1B)) && (TIMSK1 & _BV(OCIE1B))) {
+            TIFR1 = _BV(OCF1B);
+            next = kTimer1CompB;
+        } else if ((TIFR1 & _BV(TOV1)) && (TIMSK1 & _BV(TOIE1))) {
+            TIFR1 = _BV(TOV1);
+            next = kTimer1Ovf;
+        } else if ((TIFR0 & _BV(OCF0A)) && (TIMSK0 & _BV(OCIE0A))) {
+            TIFR0 = _BV(OCF0A);
+            next = kTimer0CompA;
+        } else if (spiDone && (SPCR & _BV(SPIE))) {
+            spiDone = false;
+            next = kSpiStc;
+        } else if ((ADCSRA & _BV(ADIF)) && (ADCSRA & _BV(ADIE))) {
+            ADCSRA &= static_cast<uint8_t>(~_BV(ADIF));
+            next = kAdc;
+        }
+
+        if (next < 0) {
+            return;
+        }
+
+        // On the chip an enabled interrupt without a handler jumps to the
+        // reset vector, which is never what the firmware meant
+        if (vectors[next] == nullptr) {
+            fprintf(stderr, "Kicker firmware enabled %s without a handler\n", kVectorNames[next]);
+            abort();
+        }
+
+        SREG &= static_cast<uint8_t>(~_BV(SREG_I));
+        vectors[next]();
+        SREG |= _BV(SREG_I);
+    }
+}
+
+void SimAttiny::runFirmware() {
+    swapcontext(&simContext, &firmwareContext);
+}
+
+uint8_t SimAttiny::ispTransfer(uint8_t mosi) {
+    // Each byte shifts out the one before it, except for the answer to a
+    // read in the last byte
+    uint8_t miso = ispIndex == 0 ? 0 : ispBytes[ispIndex - 1];
+    if (ispIndex == 3 && ispEnabled) {
+        miso = ispRead();
+    }
+
+    ispBytes[ispIndex++] = mosi;
+    if (ispIndex == 4) {
+        ispIndex = 0;
+        ispCommand();
+    }
+    return miso;
+}
+
+uint8_t SimAttiny::ispRead() const {
+    const uint16_t word = ((ispBytes[1] << 8) | ispBytes[2]) & (kFlashSize / 2 - 1);
+
+    switch (ispBytes[0]) {
+        case 0x20:
+            return flash[word * 2];
+        case 0x28:
+            return flash[word * 2 + 1];
+        case 0x30:
+            return (ispBytes[2] & 0x03) < 3 ? kSignature[ispBytes[2] & 0x03] : 0xFF;
+        case 0x50:
+            return ispBytes[1] == 0x00 ? fuseLow : 0xFF;
+        case 0x58:
+            return ispBytes[1] == 0x08 ? fuseHigh : 0xFF;
+        case 0xF0:
+            return cycleCount < ispBusyUntil ? 0x01 : 0x00;
+        default:
+            return ispBytes[2];
+    }
+}
+
+void SimAttiny::ispCommand() {
+    if (!ispEnabled) {
+        ispEnabled = ispBytes[0] == 0xAC && ispBytes[1] == 0x53;
+        return;
+    }
+
+    if (ispBytes[0] == 0xF0) {
+        return;
+    }
+    if (cycleCount < ispBusyUntil) {
+        ispBusyViolations++;
+        return;
+    }
+
+    const uint16_t word = ((ispBytes[1] << 8) | ispBytes[2]) & (kFlashSize / 2 - 1);
+    const size_t pageOffset = (ispBytes[2] & 0x3F) * 2;
+
+    switch (ispBytes[0]) {
+        case 0xAC:
+            if (ispBytes[1] == 0x80) {
+                std::fill(flash.begin(), flash.end(), 0xFF);
+                if (fuseHigh & kFuseEesave) {
+                    std::fill(eeprom.begin(), eeprom.end(), 0xFF);
+                }
+                ispBusyUntil = cycleCount + toCycles(kChipEraseTime);
+            } else if ((ispBytes[1] & 0xF0) == 0xA0) {
+                // EESAVE takes effect straight away, CKDIV8 from the next
+                // reset. The extended fuse and lock bits aren't modelled.
+                if (ispBytes[1] == 0xA8) {
+                    fuseHigh = ispBytes[3];
+                } else if (ispBytes[1] == 0xA0) {
+                    fuseLow = ispBytes[3];
+                }
+                ispBusyUntil = cycleCount + toCycles(kFuseWriteTime);
+            }
+            break;
+        case 0x40:
+            pageBuffer[pageOffset] = ispBytes[3];
+            break;
+        case 0x48:
+            pageBuffer[pageOffset + 1] = ispBytes[3];
+            break;
+        case 0x4C: {
+            // Programming only clears bits, anything not erased first stays
+            const size_t page = (word * 2) & ~(kPageSize - 1);
+            for (size_t i = 0; i < kPageSize; i++) {
+                flash[page + i] &= pageBuffer[i];
+            }
+            std::fill(std::begin(pageBuffer), std::end(pageBuffer), 0xFF);
+            ispBusyUntil = cycleCount + toCycles(kFlashWriteTime);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+volatile uint8_t& SimAttiny::pinRegister(char port) const {
+    return port == 'A' ? PINA : PINB;
+}
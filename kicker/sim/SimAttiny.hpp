@@ -0,0 +1,245 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ucontext.h>
+
+#include "mtrain.hpp"
+
+/**
+ * Pins the stubbed DigitalOut can be used with, the kicker's ISP lines
+ */
+namespace kicker_sim {
+constexpr PinName kKickerCs{0, 1};
+constexpr PinName kKickerReset{0, 2};
+}
+
+/**
+ * Cycle based model of the ATtiny167 running the kicker firmware
+ *
+ * The firmware in `kicker/main.c` is built as C++ against the stub headers
+ * in `stubs/attiny`, into a module of its own that turns its register
+ * accesses into accesses to this model. Loading the module afresh is how a
+ * reset puts every firmware global back to its initial value.
+ *
+ * The firmware's main loop runs in a context of its own: every
+ * `_delay_us()` hands control back here, and time only moves forward
+ * through `advance()`, which steps the peripherals 1 us at a time:
+ *  - timer 0 and timer 1 with their prescalers, CTC, compare B and overflow
+ *  - the ADC, converting `voltage` at its prescaler, free running or not
+ *  - the SPI slave, a byte at a time from `spiTransfer()`
+ *  - pin change interrupts on both ports
+ *  - serial programming (AVR910) while reset is held low, with the high
+ *    fuse's EESAVE keeping the EEPROM through a chip erase and SCK held
+ *    under a quarter of the clock the low fuse's CKDIV8 left it at
+ *
+ * Pending interrupts run in vector order whenever SREG's I bit is set and
+ * the main loop is waiting, so the main loop itself takes no time and is
+ * never interrupted part way. Interrupt handlers take no time either.
+ *
+ * The stubbed mTrain SPI and pin classes drive it through `active`.
+ */
+class SimAttiny {
+public:
+    static constexpr uint32_t kClockHz = 8'000'000;
+
+    /**
+     * Cycles per step, 1 us
+     */
+    static constexpr uint32_t kStepCycles = 8;
+
+    static constexpr size_t kFlashSize = 16 * 1024;
+    static constexpr size_t kEepromSize = 512;
+
+    /**
+     * High fuse bit that keeps the EEPROM through a chip erase when it's
+     * programmed (0)
+     */
+    static constexpr uint8_t kFuseEesave = 1 << 3;
+
+    /**
+     * Low fuse bit that divides the clock by 8 out of reset when it's
+     * programmed (0), until the firmware sets its own prescaler
+     */
+    static constexpr uint8_t kFuseCkdiv8 = 1 << 7;
+
+    /**
+     * Serial programming page, in bytes
+     */
+    static constexpr size_t kPageSize = 128;
+
+    struct Pin {
+        char port;
+        uint8_t bit;
+    };
+
+    /**
+     * @param firmwarePath The firmware module to run
+     * @param flashImage What `pgm_read_byte()` returns until it's
+     *        reprogrammed, erased (0xFF) past its end
+     */
+    SimAttiny(std::string firmwarePath, std::vector<uint8_t> flashImage = {});
+    ~SimAttiny();
+
+    /**
+     * Run the simulation forward
+     */
+    void advance(double seconds);
+    void advanceCycles(uint64_t cycles);
+
+    double now() const { return static_cast<double>(cycleCount) / kClockHz; }
+    uint64_t cycles() const { return cycleCount; }
+
+    /**
+     * Drives an input pin from outside, like the breakbeam or chip select
+     */
+    void setPin(Pin pin, bool level);
+
+    /**
+     * Level of a pin, what the firmware drives if it's an output
+     */
+    bool pin(Pin pin) const;
+
+    /**
+     * Drives the reset pin. Low stops the firmware and enters serial
+     * programming, high boots the firmware from the start. It starts low.
+     */
+    void setReset(bool level);
+
+    /**
+     * Clocks one byte through the SPI slave at `hz`, like a master would,
+     * or through serial programming while in reset
+     *
+     * @return What the chip shifted out at the same time
+     */
+    uint8_t spiTransfer(uint8_t mosi, int hz);
+
+    const std::vector<uint8_t>& flashContents() const { return flash; }
+    const std::vector<uint8_t>& eepromContents() const { return eeprom; }
+    uint8_t highFuse() const { return fuseHigh; }
+    uint8_t lowFuse() const { return fuseLow; }
+
+    /**
+     * Writes the EEPROM from outside, like an external programmer
+     */
+    void writeEeprom(size_t address, const std::vector<uint8_t>& data);
+
+    /**
+     * Serial programming commands other than a poll sent while a write
+     * or erase was still busy, which the chip ignores
+     */
+    int ispBusyViolations = 0;
+
+    /**
+     * Serial programming bytes clocked faster than the chip can take,
+     * which it garbles
+     */
+    int ispClockViolations = 0;
+
+    /**
+     * Times the firmware has booted
+     */
+    int boots = 0;
+
+    /**
+     * ADC reading of the cap voltage monitor, 0 - 255
+     */
+    uint8_t voltage = 0;
+
+    /**
+     * Called every step after the peripherals, with the step's length in
+     * seconds, for models of the board around the chip
+     */
+    std::function<void(double)> onStep;
+
+    /**
+     * Bytes clocked since chip select last fell, kept by the stubbed SPI
+     */
+    size_t frameBytes = 0;
+
+    // Register side effects, from the stub headers
+    void writeSpdr(uint8_t data);
+    uint8_t readSpdr() const { return spiReceived; }
+    uint16_t timer1() const { return timer1Count; }
+    uint8_t flashByte(uint16_t address) const;
+    uint8_t eepromByte(uint16_t address) const;
+
+    /**
+     * Parks the firmware until `us` from now
+     */
+    void firmwareDelay(double us);
+
+    static SimAttiny* active;
+
+private:
+    using Entry = void (*)();
+    using Handler = void (*)();
+
+    static void firmwareEntry();
+
+    void boot();
+    void unload();
+    void resetPeripherals();
+
+    void step();
+    void stepTimer0();
+    void stepTimer1();
+    void stepAdc();
+    void runInterrupts();
+    void runFirmware();
+
+    uint8_t ispTransfer(uint8_t mosi);
+    uint8_t ispRead() const;
+    void ispCommand();
+
+    volatile uint8_t& pinRegister(char port) const;
+
+    uint64_t cycleCount = 0;
+    double pendingTime = 0.0;
+
+    std::vector<uint8_t> flash;
+    std::vector<uint8_t> eeprom;
+
+    // Unprogrammed EESAVE and programmed CKDIV8, as the chip ships
+    uint8_t fuseHigh = 0xDF;
+    uint8_t fuseLow = 0x62;
+
+    // The firmware module and its entry points, in vector order
+    std::string firmwarePath;
+    void* firmware = nullptr;
+    Entry firmwareMain = nullptr;
+    Handler vectors[7] = {};
+
+    bool inReset = true;
+
+    ucontext_t simContext{};
+    ucontext_t firmwareContext{};
+    std::unique_ptr<char[]> firmwareStack;
+    uint64_t firmwareWakeCycle = 0;
+
+    uint32_t timer0Prescale = 0;
+    uint32_t timer1Prescale = 0;
+    uint16_t timer1Count = 0;
+
+    uint32_t adcCycles = 0;
+    bool adcConverting = false;
+    bool adcFirst = true;
+
+    bool spiBusy = false;
+    bool spiDone = false;
+    uint8_t spiShift = 0;
+    uint8_t spiReceived = 0;
+
+    // Serial programming
+    bool ispEnabled = false;
+    uint8_t ispBytes[4] = {};
+    size_t ispIndex = 0;
+    uint64_t ispBusyUntil = 0;
+    uint32_t ispClockHz = kClockHz / 8;
+    uint8_t pageBuffer[kPageSize];
+};
@@ -0,0 +1,98 @@
+/**
+ * Host implementations of the stubbed mTrain and FreeRTOS calls, all of
+ * them drive or wait on `SimAttiny::active`
+ */
+
+#include "DigitalOut.hpp"
+#include "SPI.hpp"
+#include "FreeRTOS.h"
+#include "task.h"
+#include "delay.h"
+
+#include <avr/io.h>
+
+#include "SimAttiny.hpp"
+
+namespace {
+// Byte of the next chip select frame to corrupt, and how
+size_t corruptIndex = 0;
+uint8_t corruptMask = 0;
+}
+
+uint32_t HAL_GetTick() {
+    return static_cast<uint32_t>(SimAttiny::active->now() * 1000.0);
+}
+
+void vTaskDelay(TickType_t ticks) {
+    SimAttiny::active->advance(ticks / 1000.0);
+}
+
+TickType_t xTaskGetTickCount() {
+    return HAL_GetTick();
+}
+
+void DWT_Delay(uint32_t us) {
+    SimAttiny::active->advance(us * 1e-6);
+}
+
+uint32_t DWT_GetTick() {
+    return static_cast<uint32_t>(SimAttiny::active->now() * 1e6);
+}
+
+uint32_t DWT_SysTick_To_us() {
+    return 1;
+}
+
+DigitalOut::DigitalOut(PinName pin, PullType, PinMode, PinSpeed, bool inverted)
+    : pin(pin), inverted(inverted), state(false) {
+    write(false);
+}
+
+void DigitalOut::write(bool value) {
+    state = value;
+
+    SimAttiny& sim = *SimAttiny::active;
+    const bool level = value != inverted;
+    if (pin == kicker_sim::kKickerCs) {
+        sim.setPin({'A', PA6}, level);
+        if (!level) {
+            sim.frameBytes = 0;
+        }
+    } else if (pin == kicker_sim::kKickerReset) {
+        sim.setReset(level);
+    }
+}
+
+SPI::SPI(int, std::optional<PinName>, int hz) : hz(hz) {}
+
+void SPI::frequency(int newHz) {
+    hz = newHz;
+    frequencyChanges++;
+}
+
+void SPI::corruptByte(size_t index, uint8_t mask) {
+    corruptIndex = index;
+    corruptMask = mask;
+}
+
+void SPI::transmit(uint8_t data) {
+    transmitReceive(data);
+}
+
+void SPI::transmit(const uint8_t* data, size_t len) {
+    for (size_t i = 0; i < len; i++) {
+        transmitReceive(data[i]);
+    }
+}
+
+uint8_t SPI::transmitReceive(uint8_t data) {
+    SimAttiny& sim = *SimAttiny::active;
+
+    if (corruptMask != 0 && sim.frameBytes == corruptIndex) {
+        data ^= corruptMask;
+        corruptMask = 0;
+    }
+    sim.frameBytes++;
+
+    return sim.spiTransfer(data, hz);
+}
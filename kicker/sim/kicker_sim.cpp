@@ -0,0 +1,517 @@
+/**
+ * Simulation of the kicker firmware against the unmodified mTrain
+ * KickerBoard driver
+ *
+ * The driver's SPI traffic goes byte by byte into a model of the ATtiny167
+ * running `kicker/main.c` (see SimAttiny and the stubs directory), with a
+ * model of the charger and caps around it, so every check goes through the
+ * same frames the robot sends.
+ *
+ * Checks, with the driver serviced at KickerModule's rate:
+ *  - flash(): programming an erased chip over ISP, without a command
+ *    landing while a write is busy, and the flash CRC check skipping it
+ *    the second time
+ *  - the firmware speaks the driver's protocol, status frames parse and
+ *    report the voltage the ADC sees
+ *  - the caps charge to the target and the charger stops there
+ *  - kick FET on times at full and no power, and a chip uses the chip FET
+ *  - a command frame the kicker already took doesn't kick again
+ *  - breakbeam kicks: latency from the edge to the FET with the charger
+ *    idle and while it's charging, a glitch between samples doesn't kick
+ *    and a bouncing edge only kicks once
+ *  - the ball sensed age follows the breakbeam
+ *  - a corrupted command frame is reported and not acted on, and the
+ *    driver's retry kicks
+ *  - a kick calibration in EEPROM survives reflashing, and kicks take
+ *    their on time from it by cap voltage while chips stay at full power
+ *
+ * Throughout, the charger and a FET are never on together.
+ *
+ * Usage:
+ *   kicker-sim
+ */
+
+#include <algorithm>
+#include <cinttypes>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include "drivers/KickerBoard.hpp"
+#include "device-bins/kicker_bin.h"
+#include "Logger.hpp"
+#include "SPI.hpp"
+
+#include "SimAttiny.hpp"
+
+namespace {
+
+constexpr SimAttiny::Pin kChipPin{'B', 0};
+constexpr SimAttiny::Pin kKickPin{'B', 1};
+constexpr SimAttiny::Pin kChargePin{'B', 2};
+constexpr SimAttiny::Pin kBreakbeamPin{'B', 3};
+constexpr SimAttiny::Pin kDebugSwitchPin{'B', 5};
+constexpr SimAttiny::Pin kButtonPins[] = {{'A', 1}, {'A', 3}, {'A', 7}};
+
+// KickerModule's period
+constexpr double kServicePeriod = 0.04;
+
+// Reflashing once the chip runs at 8 MHz, from reset to running again
+constexpr double kReflashTime = 1.0;
+
+// Charger and caps, in ADC counts. Charging from empty takes about a
+// second, well inside the firmware's charge timeout.
+constexpr double kChargeRate = 250.0;
+constexpr double kDischargeTau = 3e-3;
+constexpr double kLeakTau = 60.0;
+
+// Below the firmware's charge start voltage
+constexpr double kLowVoltage = 200.0;
+
+// The firmware's FET timing. Every phase runs a 250 us timer 0 tick
+// longer than its count, and starts on the tick after the one before.
+constexpr double kMaxKickTime = 10.25e-3;
+constexpr double kMinKickTime = 1.0e-3;
+constexpr double kKickTolerance = 0.1e-3;
+constexpr double kStopChargeTime = 5.5e-3;
+
+// FET on time for a kick of `ticks` timer 0 ticks
+constexpr double kickTime(int ticks) {
+    return (ticks + 1) * KICK_CAL_TICK_US * 1e-6;
+}
+
+// Test calibration, longer with more strength and at lower voltages
+constexpr uint8_t calibrationTicks(int row, int column) {
+    return static_cast<uint8_t>(4 + 3 * column + 2 * (KICK_CAL_ROWS - 1 - row));
+}
+
+// After a kick the firmware doesn't charge for 2 s
+constexpr double kRecoverTime = 3.5;
+
+int failures = 0;
+
+void check(bool ok, const char* name, const char* detail = "") {
+    printf("  [%s] %s%s%s\n", ok ? "PASS" : "FAIL", name, detail[0] ? ": " : "", detail);
+    if (!ok) {
+        failures++;
+    }
+}
+
+void drainLog() {
+    Logger::drain();
+}
+
+/**
+ * The charger, caps and FETs around the chip
+ */
+struct Board {
+    double voltage = 0.0;
+
+    // Steps with the charger and a FET on at once
+    int overlaps = 0;
+
+    // FET pulses, on either FET
+    int kickPulses = 0;
+    int chipPulses = 0;
+    bool fetOn = false;
+    uint64_t pulseStart = 0;
+    double lastPulse = 0.0;
+
+    void step(SimAttiny& sim, double dt) {
+        const bool charging = sim.pin(kChargePin);
+        const bool kick = sim.pin(kKickPin);
+        const bool chip = sim.pin(kChipPin);
+
+        if (charging && (kick || chip)) {
+            overlaps++;
+        }
+
+        if (charging) {
+            voltage = std::min(255.0, voltage + kChargeRate * dt);
+        }
+        if (kick || chip) {
+            voltage -= voltage * dt / kDischargeTau;
+        }
+        voltage -= voltage * dt / kLeakTau;
+        sim.voltage = static_cast<uint8_t>(std::lround(voltage));
+
+        if ((kick || chip) && !fetOn) {
+            pulseStart = sim.cycles();
+            if (kick) {
+                kickPulses++;
+            } else {
+                chipPulses++;
+            }
+        } else if (!(kick || chip) && fetOn) {
+            lastPulse = static_cast<double>(sim.cycles() - pulseStart) / SimAttiny::kClockHz;
+        }
+        fetOn = kick || chip;
+    }
+
+    int pulses() const { return kickPulses + chipPulses; }
+};
+
+/**
+ * Runs the driver like KickerModule does for `seconds`
+ */
+void run(KickerBoard& kicker, SimAttiny& sim, double seconds) {
+    const double end = sim.now() + seconds;
+    while (sim.now() < end) {
+        const double start = sim.now();
+        kicker.service();
+        sim.advance(std::max(0.0, std::min(start + kServicePeriod, end) - sim.now()));
+    }
+    drainLog();
+}
+
+/**
+ * Runs the driver until `done` or `timeout`
+ *
+ * @return Whether it was done in time
+ */
+template <typename Done>
+bool runUntil(KickerBoard& kicker, SimAttiny& sim, double timeout, Done done) {
+    const double end = sim.now() + timeout;
+    while (sim.now() < end) {
+        run(kicker, sim, kServicePeriod);
+        if (done()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * Lets the caps recharge after a kick
+ */
+bool recharge(KickerBoard& kicker, SimAttiny& sim) {
+    run(kicker, sim, kRecoverTime);
+    return runUntil(kicker, sim, 2.0, [&] { return kicker.isCharged(); });
+}
+
+void checkFlash(KickerBoard& kicker, SimAttiny& sim) {
+    char detail[96];
+
+    // Out of the box the chip runs at 1 MHz, so this one is slow
+    double start = sim.now();
+    const bool programmed = kicker.flash(false, true);
+    double time = sim.now() - start;
+    drainLog();
+
+    const auto& flash = sim.flashContents();
+    bool matches = std::equal(KICKER_BYTES, KICKER_BYTES + KICKER_BYTES_LEN, flash.begin());
+    snprintf(detail, sizeof(detail), "%u bytes in %.2f s, %.0f bytes/s",
+             static_cast<unsigned>(KICKER_BYTES_LEN), time, KICKER_BYTES_LEN / time);
+    check(programmed && matches, "flash programs over ISP", detail);
+
+    snprintf(detail, sizeof(detail), "low fuse 0x%02X", sim.lowFuse());
+    check(sim.lowFuse() & SimAttiny::kFuseCkdiv8, "flash clears CKDIV8", detail);
+
+    // Every flash after that talks to it at 8 MHz
+    start = sim.now();
+    const bool reprogrammed = kicker.flash(false, true);
+    time = sim.now() - start;
+    drainLog();
+
+    matches = std::equal(KICKER_BYTES, KICKER_BYTES + KICKER_BYTES_LEN, flash.begin());
+    snprintf(detail, sizeof(detail), "%u bytes in %.2f s, %.0f bytes/s",
+             static_cast<unsigned>(KICKER_BYTES_LEN), time, KICKER_BYTES_LEN / time);
+    check(reprogrammed && matches && time < kReflashTime, "reflash", detail);
+
+    snprintf(detail, sizeof(detail), "%d commands while busy, %d bytes too fast",
+             sim.ispBusyViolations, sim.ispClockViolations);
+    check(sim.ispBusyViolations == 0 && sim.ispClockViolations == 0,
+          "flash waits on writes at a safe SCK", detail);
+
+    const int boots = sim.boots;
+    const double crcStart = sim.now();
+    const bool skipped = kicker.flash(true, true);
+    drainLog();
+    snprintf(detail, sizeof(detail), "%.0f ms", (sim.now() - crcStart) * 1e3);
+    check(skipped && sim.boots == boots && sim.now() - crcStart < 0.5,
+          "flash CRC matches", detail);
+}
+
+void checkStatus(KickerBoard& kicker, SimAttiny& sim) {
+    char detail[96];
+
+    check(kicker.checkProtocolVersion(), "protocol version");
+    drainLog();
+
+    const int clockChanges = SPI::frequencyChanges;
+    run(kicker, sim, 0.2);
+    snprintf(detail, sizeof(detail), "faults 0x%02X", kicker.getFaults());
+    check(kicker.isHealthy() && kicker.getFaults() == 0, "status frames", detail);
+
+    snprintf(detail, sizeof(detail), "%d clock changes", SPI::frequencyChanges - clockChanges);
+    check(SPI::frequencyChanges == clockChanges, "frames keep the bus clock", detail);
+
+    snprintf(detail, sizeof(detail), "reported %u, ADC %u", kicker.getVoltage(), sim.voltage);
+    check(std::abs(kicker.getVoltage() - sim.voltage) <= 2, "voltage", detail);
+}
+
+void checkCharge(KickerBoard& kicker, SimAttiny& sim, Board& board) {
+    char detail[96];
+
+    kicker.setChargeAllowed(true);
+    const double start = sim.now();
+    const bool charged = runUntil(kicker, sim, 3.0, [&] { return kicker.isCharged(); });
+    snprintf(detail, sizeof(detail), "%.2f s to %u", sim.now() - start, kicker.getVoltage());
+    check(charged, "charges", detail);
+
+    run(kicker, sim, 0.5);
+    snprintf(detail, sizeof(detail), "%.1f counts, charger %s", board.voltage,
+             sim.pin(kChargePin) ? "on" : "off");
+    check(!sim.pin(kChargePin) && board.voltage < 250.0 && kicker.isHealthy(),
+          "stops at the target", detail);
+}
+
+void checkKick(KickerBoard& kicker, SimAttiny& sim, Board& board, uint8_t strength,
+               double expected, const char* name) {
+    char detail[96];
+
+    const int kicks = board.kickPulses;
+    kicker.kick(strength);
+    run(kicker, sim, 0.1);
+
+    snprintf(detail, sizeof(detail), "%d kicks, %.2f ms, expected %.2f ms",
+             board.kickPulses - kicks, board.lastPulse * 1e3, expected * 1e3);
+    check(board.kickPulses == kicks + 1 && std::abs(board.lastPulse - expected) <= kKickTolerance,
+          name, detail);
+}
+
+void checkKicks(KickerBoard& kicker, SimAttiny& sim, Board& board) {
+    char detail[96];
+
+    kicker.kickType(true);
+    checkKick(kicker, sim, board, 255, kMaxKickTime, "kick at full power");
+
+    // The frame keeps going out with the same sequence, as a no-op
+    const int pulses = board.pulses();
+    run(kicker, sim, 0.5);
+    snprintf(detail, sizeof(detail), "%d more kicks", board.pulses() - pulses);
+    check(board.pulses() == pulses && kicker.isKickDone(), "no repeated kick", detail);
+
+    check(recharge(kicker, sim), "recharges after a kick");
+    checkKick(kicker, sim, board, 0, kMinKickTime, "kick at no power");
+
+    recharge(kicker, sim);
+    kicker.kickType(false);
+    const int chips = board.chipPulses;
+    const int kicks = board.kickPulses;
+    kicker.kick(255);
+    run(kicker, sim, 0.1);
+    snprintf(detail, sizeof(detail), "%d chips, %d kicks", board.chipPulses - chips,
+             board.kickPulses - kicks);
+    check(board.chipPulses == chips + 1 && board.kickPulses == kicks, "chip", detail);
+    kicker.kickType(true);
+
+    recharge(kicker, sim);
+}
+
+/**
+ * Arms a breakbeam kick, breaks the beam and waits for the FET
+ *
+ * @return Seconds from the edge to the FET, or -1 if it never came
+ */
+double breakbeamKick(KickerBoard& kicker, SimAttiny& sim, Board& board) {
+    kicker.kickOnBreakbeam(128);
+    run(kicker, sim, 2 * kServicePeriod);
+
+    const int pulses = board.pulses();
+    const uint64_t edge = sim.cycles();
+    sim.setPin(kBreakbeamPin, true);
+    for (int i = 0; i < 20000 && board.pulses() == pulses; i++) {
+        sim.advance(1e-6);
+    }
+    if (board.pulses() == pulses) {
+        return -1.0;
+    }
+    return static_cast<double>(board.pulseStart - edge) / SimAttiny::kClockHz;
+}
+
+void clearBreakbeam(KickerBoard& kicker, SimAttiny& sim) {
+    sim.setPin(kBreakbeamPin, false);
+    run(kicker, sim, 0.1);
+}
+
+void checkBreakbeam(KickerBoard& kicker, SimAttiny& sim, Board& board) {
+    char detail[96];
+
+    // Charged and the charger's been off for a while
+    double latency = breakbeamKick(kicker, sim, board);
+    snprintf(detail, sizeof(detail), "%.1f us", latency * 1e6);
+    check(latency >= 0 && latency < 20e-6, "breakbeam kick, charger idle", detail);
+    run(kicker, sim, 0.1);
+    check(kicker.isKickDone(), "breakbeam kick done");
+    clearBreakbeam(kicker, sim);
+    recharge(kicker, sim);
+
+    // Drain the caps so the charger is running when the ball comes
+    board.voltage = kLowVoltage;
+    runUntil(kicker, sim, 1.0, [&] { return sim.pin(kChargePin); });
+    latency = breakbeamKick(kicker, sim, board);
+    snprintf(detail, sizeof(detail), "%.2f ms", latency * 1e3);
+    check(latency >= kStopChargeTime - 0.5e-3 && latency <= kStopChargeTime + 0.5e-3,
+          "breakbeam kick, charging", detail);
+    clearBreakbeam(kicker, sim);
+    recharge(kicker, sim);
+
+    // Back before the next step, the firmware never sees it
+    kicker.kickOnBreakbeam(128);
+    run(kicker, sim, 2 * kServicePeriod);
+    int pulses = board.pulses();
+    sim.setPin(kBreakbeamPin, true);
+    sim.setPin(kBreakbeamPin, false);
+    run(kicker, sim, 0.1);
+    check(board.pulses() == pulses && !kicker.isBallSensed() && !kicker.isKickDone(),
+          "breakbeam glitch ignored");
+    kicker.cancelBreakbeam();
+    run(kicker, sim, 0.1);
+
+    // A bouncing edge, settling with the ball in
+    kicker.kickOnBreakbeam(128);
+    run(kicker, sim, 2 * kServicePeriod);
+    pulses = board.pulses();
+    for (int i = 0; i < 5; i++) {
+        sim.setPin(kBreakbeamPin, true);
+        sim.advance(20e-6);
+        sim.setPin(kBreakbeamPin, false);
+        sim.advance(20e-6);
+    }
+    sim.setPin(kBreakbeamPin, true);
+    const double sensed = sim.now();
+    run(kicker, sim, 0.2);
+    snprintf(detail, sizeof(detail), "%d kicks", board.pulses() - pulses);
+    check(board.pulses() == pulses + 1, "bouncing breakbeam", detail);
+
+    const double age = kicker.getBallSensedAge() * 1e-6;
+    const double expected = sim.now() - sensed;
+    snprintf(detail, sizeof(detail), "%.1f ms, expected about %.1f ms", age * 1e3, expected * 1e3);
+    check(kicker.isBallSensed() && std::abs(age - expected) < kServicePeriod + 1e-3,
+          "ball sensed age", detail);
+
+    clearBreakbeam(kicker, sim);
+    recharge(kicker, sim);
+}
+
+void checkBadFrame(KickerBoard& kicker, SimAttiny& sim, Board& board) {
+    char detail[96];
+
+    const int pulses = board.pulses();
+    kicker.kick(255);
+    SPI::corruptByte(FRAME_CMD_STRENGTH, 0x01);
+    kicker.service();
+    sim.advance(kServicePeriod);
+    const bool ignored = board.pulses() == pulses;
+
+    // The fault comes back in the next status, which retries the kick
+    kicker.service();
+    const uint8_t faults = kicker.getFaults();
+    sim.advance(kServicePeriod);
+    drainLog();
+
+    snprintf(detail, sizeof(detail), "faults 0x%02X, %d kicks", faults, board.pulses() - pulses);
+    check(ignored && (faults & FAULT_BAD_FRAME) && board.pulses() == pulses + 1,
+          "corrupted frame", detail);
+
+    run(kicker, sim, 0.2);
+    check(kicker.isHealthy() && kicker.getFaults() == 0, "healthy after a bad frame");
+    recharge(kicker, sim);
+}
+
+void checkCalibration(KickerBoard& kicker, SimAttiny& sim, Board& board) {
+    char detail[96];
+
+    std::vector<uint8_t> calibration(KICK_CAL_LENGTH);
+    calibration[0] = KICK_CAL_VERSION;
+    for (int row = 0; row < KICK_CAL_ROWS; row++) {
+        for (int column = 0; column < KICK_CAL_COLUMNS; column++) {
+            calibration[KICK_CAL_TABLE + row * KICK_CAL_COLUMNS + column] =
+                calibrationTicks(row, column);
+        }
+    }
+    const uint16_t crc = kicker_frame_crc(calibration.data(), KICK_CAL_CRC);
+    calibration[KICK_CAL_CRC] = crc & 0xFF;
+    calibration[KICK_CAL_CRC + 1] = crc >> 8;
+
+    // Written by an external programmer, then the robot reflashes
+    sim.writeEeprom(KICK_CAL_ADDRESS, calibration);
+    const bool programmed = kicker.flash(false, true);
+    drainLog();
+    const bool kept = std::equal(calibration.begin(), calibration.end(),
+                                 sim.eepromContents().begin() + KICK_CAL_ADDRESS);
+    snprintf(detail, sizeof(detail), "high fuse 0x%02X", sim.highFuse());
+    check(programmed && kept && !(sim.highFuse() & SimAttiny::kFuseEesave),
+          "calibration survives flashing", detail);
+
+    check(kicker.checkProtocolVersion(), "protocol version after flashing");
+    run(kicker, sim, 0.2);
+    check(kicker.isCalibrated(), "status reports the calibration");
+
+    recharge(kicker, sim);
+
+    // Strength 128 is column 4, charged is the top row
+    checkKick(kicker, sim, board, 128, kickTime(calibrationTicks(KICK_CAL_ROWS - 1, 4)),
+              "calibrated kick, charged");
+    recharge(kicker, sim);
+
+    // Drained to row 2, without the charger bringing it back up
+    kicker.setChargeAllowed(false);
+    board.voltage = KICK_CAL_VOLTAGE_MIN + (2 << KICK_CAL_VOLTAGE_SHIFT);
+    run(kicker, sim, 0.2);
+    checkKick(kicker, sim, board, 128, kickTime(calibrationTicks(2, 4)),
+              "calibrated kick, drained");
+    kicker.setChargeAllowed(true);
+    recharge(kicker, sim);
+
+    kicker.kickType(false);
+    kicker.kick(128);
+    run(kicker, sim, 0.1);
+    snprintf(detail, sizeof(detail), "%.2f ms", board.lastPulse * 1e3);
+    check(std::abs(board.lastPulse - kMaxKickTime) <= kKickTolerance,
+          "calibrated chip at full power", detail);
+    kicker.kickType(true);
+    recharge(kicker, sim);
+}
+
+}  // namespace
+
+int main() {
+    // Starts out erased, flash() programs it
+    SimAttiny sim(KICKER_FIRMWARE_PATH);
+
+    // Not in debug mode, no buttons pressed
+    sim.setPin(kDebugSwitchPin, true);
+    for (const auto& pin : kButtonPins) {
+        sim.setPin(pin, true);
+    }
+
+    Board board;
+    sim.onStep = [&](double dt) { board.step(sim, dt); };
+
+    LockedStruct<SPI> spi;
+    SPIBusManager spiBus(spi);
+    auto nCs = std::make_shared<DigitalOut>(kicker_sim::kKickerCs);
+    KickerBoard kicker(spiBus, nCs, kicker_sim::kKickerReset);
+
+    printf("Kicker firmware simulation\n");
+
+    checkFlash(kicker, sim);
+    checkStatus(kicker, sim);
+    checkCharge(kicker, sim, board);
+    checkKicks(kicker, sim, board);
+    checkBreakbeam(kicker, sim, board);
+    checkBadFrame(kicker, sim, board);
+    checkCalibration(kicker, sim, board);
+
+    char detail[96];
+    snprintf(detail, sizeof(detail), "%d steps", board.overlaps);
+    check(board.overlaps == 0, "charger off while a FET is on", detail);
+
+    drainLog();
+    printf("%s, %d failure%s\n", failures ? "FAILED" : "PASSED", failures, failures == 1 ? "" : "s");
+    return failures;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stddef.h>
+
+/**
+ * Reads SimAttiny's EEPROM, `src` is the address
+ */
+void eeprom_read_block(void* dst, const void* src, size_t n);
@@ -0,0 +1,11 @@
+#pragma once
+
+#include <avr/io.h>
+
+/**
+ * Interrupt handlers are plain functions SimAttiny calls by name
+ */
+#define ISR(vector) extern "C" void vector()
+
+inline void cli() { SREG &= static_cast<uint8_t>(~_BV(SREG_I)); }
+inline void sei() { SREG |= _BV(SREG_I); }
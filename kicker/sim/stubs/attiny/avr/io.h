@@ -0,0 +1,147 @@
+#pragma once
+
+/**
+ * Host stand-in for avr-libc's ATtiny167 registers, backed by SimAttiny
+ *
+ * Registers without side effects are plain memory the simulation reads and
+ * writes between instructions. The few that act on access on the chip are
+ * small classes, which is why the firmware is built as C++ here.
+ */
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+#define FLASHEND 0x3FFF
+
+/**
+ * Interrupt flags, writing a 1 clears that flag like on the chip
+ */
+class FlagRegister {
+public:
+    FlagRegister& operator=(uint8_t clear) {
+        flags &= static_cast<uint8_t>(~clear);
+        return *this;
+    }
+
+    operator uint8_t() const { return flags; }
+
+    void set(uint8_t bits) { flags |= bits; }
+
+private:
+    volatile uint8_t flags = 0;
+};
+
+/**
+ * SPI data, a write loads the shift register unless a byte is being
+ * clocked (a write collision), a read is the last byte received
+ */
+class SpiDataRegister {
+public:
+    SpiDataRegister& operator=(uint8_t data);
+    operator uint8_t() const;
+};
+
+/**
+ * Timer 1's count, read only
+ */
+class Timer1Counter {
+public:
+    operator uint16_t() const;
+};
+
+extern volatile uint8_t SREG;
+
+extern volatile uint8_t DDRA, PORTA, PINA;
+extern volatile uint8_t DDRB, PORTB, PINB;
+
+extern volatile uint8_t MCUCR, MCUSR, WDTCR, CLKPR, PRR;
+
+extern volatile uint8_t SPCR;
+extern SpiDataRegister SPDR;
+
+extern volatile uint8_t PCICR, PCMSK0, PCMSK1;
+extern FlagRegister PCIFR;
+
+extern volatile uint8_t TCCR0A, TCCR0B, TCNT0, OCR0A, TIMSK0;
+extern FlagRegister TIFR0;
+
+extern volatile uint8_t TCCR1A, TCCR1B, TIMSK1;
+extern Timer1Counter TCNT1;
+extern volatile uint16_t OCR1B;
+extern FlagRegister TIFR1;
+
+extern volatile uint8_t ADMUX, ADCSRA, ADCSRB, ADCH;
+
+/**
+ * The firmware's main, renamed by the build so SimAttiny can find it in the
+ * firmware module by name
+ */
+extern "C" void kicker_main(void);
+
+// Bit numbers from iotn167.h
+
+#define PA0 0
+#define PA1 1
+#define PA2 2
+#define PA3 3
+#define PA4 4
+#define PA5 5
+#define PA6 6
+#define PA7 7
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+
+#define SREG_I 7
+
+#define PUD 4
+#define WDRF 3
+#define WDCE 4
+#define WDE 3
+#define CLKPCE 7
+#define PRADC 0
+
+#define SPIE 7
+#define SPE 6
+#define MSTR 4
+
+#define PCIE0 0
+#define PCIE1 1
+#define PCIF0 0
+#define PCIF1 1
+#define PCINT6 6
+#define PCINT11 3
+
+#define CS00 0
+#define CS01 1
+#define CS02 2
+#define WGM01 1
+#define OCIE0A 1
+#define OCF0A 1
+
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define TOIE1 0
+#define OCIE1B 2
+#define TOV1 0
+#define OCF1B 2
+
+#define ADLAR 5
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIF 4
+#define ADIE 3
+#define ADPS2 2
+#define ADPS1 1
+#define ADPS0 0
+#define ADTS2 2
+#define ADTS1 1
+#define ADTS0 0
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Reads SimAttiny's flash image
+ */
+uint8_t pgm_read_byte(uint16_t address);
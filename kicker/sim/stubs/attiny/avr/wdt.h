@@ -0,0 +1,6 @@
+#pragma once
+
+/**
+ * The simulation has no watchdog
+ */
+inline void wdt_reset() {}
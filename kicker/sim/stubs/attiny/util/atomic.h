@@ -0,0 +1,12 @@
+#pragma once
+
+#include <avr/interrupt.h>
+
+/**
+ * Same as avr-libc's, SREG is saved and interrupts are off for the block
+ */
+#define ATOMIC_RESTORESTATE
+
+#define ATOMIC_BLOCK(type) \
+    for (uint8_t sreg_save = SREG, atomic_once = (cli(), 1); atomic_once; \
+         SREG = sreg_save, atomic_once = 0)
@@ -0,0 +1,7 @@
+#pragma once
+
+/**
+ * Hands control back to the simulation until `us` of simulated time have
+ * passed, interrupts only run while the firmware waits here
+ */
+void _delay_us(double us);
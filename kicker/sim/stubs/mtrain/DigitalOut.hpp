@@ -0,0 +1,29 @@
+#pragma once
+
+#include "mtrain.hpp"
+
+/**
+ * Output pin wired to the simulated kicker's pins, see `kicker_sim`
+ */
+class DigitalOut {
+public:
+    DigitalOut(PinName pin, PullType pull = PullType::PullNone,
+               PinMode mode = PinMode::PushPull, PinSpeed speed = PinSpeed::Low,
+               bool inverted = false);
+
+    void write(bool state);
+    bool read() const { return state; }
+    void toggle() { write(!state); }
+
+    DigitalOut& operator=(bool value) {
+        write(value);
+        return *this;
+    }
+
+    operator bool() const { return read(); }
+
+private:
+    PinName pin;
+    bool inverted;
+    bool state;
+};
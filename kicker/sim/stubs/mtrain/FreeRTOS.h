@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Host stand-in for FreeRTOS, time only advances when the harness runs
+ * the simulation
+ */
+
+using TickType_t = uint32_t;
+using BaseType_t = long;
+
+#define pdFALSE 0
+#define pdTRUE 1
+
+#define configTICK_RATE_HZ 1000
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+#define portMAX_DELAY 0xFFFFFFFFUL
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+
+#include "mtrain.hpp"
+
+/**
+ * SPI master wired to the simulated kicker's SPI slave, one byte at a time
+ * at the frequency last passed to `frequency()`
+ *
+ * The harness can flip bits in a byte about to be sent with
+ * `corruptByte()`, to see what the kicker does with a damaged frame, and
+ * count how often the bus clock is set with `frequencyChanges`.
+ */
+class SPI {
+public:
+    SPI(int bus = 0, std::optional<PinName> cs = std::nullopt, int hz = 1'000'000);
+
+    void frequency(int hz);
+
+    void transmit(uint8_t data);
+    void transmit(const uint8_t* data, size_t len);
+
+    uint8_t transmitReceive(uint8_t data);
+
+    /**
+     * XORs `mask` into byte `index` of the next chip select frame
+     */
+    static void corruptByte(size_t index, uint8_t mask);
+
+    static inline int frequencyChanges = 0;
+
+private:
+    int hz;
+};
@@ -0,0 +1,18 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Runs the simulation for `us` microseconds
+ */
+void DWT_Delay(uint32_t us);
+
+/**
+ * Simulated time in DWT cycles, which the sim counts one per microsecond
+ */
+uint32_t DWT_GetTick();
+
+/**
+ * DWT cycles per microsecond
+ */
+uint32_t DWT_SysTick_To_us();
@@ -0,0 +1,13 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+/**
+ * There's only the one task, so every lock is free
+ */
+
+using SemaphoreHandle_t = void*;
+
+inline SemaphoreHandle_t xSemaphoreCreateRecursiveMutex() { return nullptr; }
+inline BaseType_t xSemaphoreTakeRecursive(SemaphoreHandle_t, TickType_t) { return pdTRUE; }
+inline BaseType_t xSemaphoreGiveRecursive(SemaphoreHandle_t) { return pdTRUE; }
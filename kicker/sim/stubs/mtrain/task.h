@@ -0,0 +1,10 @@
+#pragma once
+
+#include "FreeRTOS.h"
+
+/**
+ * Runs the simulation for `ticks` milliseconds
+ */
+void vTaskDelay(TickType_t ticks);
+
+TickType_t xTaskGetTickCount();
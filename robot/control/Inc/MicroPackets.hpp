@@ -52,6 +52,8 @@ struct MotorFeedback {
 
     float encoders[4];    /**< Encoder readings from each wheel motor (rad/s)  */
     float currents[4];    /**< Current readings from each wheel motor (amps)  */
+    int32_t encoderTicks[4]; /**< Total encoder ticks of each wheel motor since boot, for odometry */
+    uint8_t hallCounts[5]; /**< Hall transitions of each motor since the last update, dribbler last */
 };
 
 /** @struct IMUData
@@ -59,13 +61,32 @@ struct MotorFeedback {
  *
  * Passed from @ref IMUModule to @ref MotionControlModule
  */
+struct IMUSample {
+    uint32_t timestamp;       /**< Time the IMU took the sample (milliseconds) */
+
+    float accelerations[3];   /**< Linear acceleration on axes [X,Y,Z] (g) */
+    float omegas[3];          /**< Angular velocities on axes [X,Y,Z], bias removed once calibrated (rad/s) */
+};
+
 struct IMUData {
     bool isValid = false;     /**< Stores whether given data is valid  */
     bool initialized = false; /**< Stores whether IMU has been initialized */
     uint32_t lastUpdate;      /**< Time at which IMUData was last updated (milliseconds) */
 
-    float accelerations[3];   /**< Linear acceleration on axes [X,Y,Z] (m/s^2) */
-    float omegas[3];          /**< Angular velocities on axes [X,Y,Z] (rad/s) */
+    float accelerations[3];   /**< Linear acceleration on axes [X,Y,Z] from the latest sample (g) */
+    float omegas[3];          /**< Angular velocities on axes [X,Y,Z] from the latest sample (rad/s) */
+
+    bool gyroCalibrated = false; /**< Whether the gyro bias has been removed from `omegas` */
+    float temperature;        /**< IMU die temperature, the gyro bias drifts with it (deg C) */
+
+    static constexpr int kMaxSamples = 16;
+
+    /**
+     * Every sample since the consumer last cleared `numSamples`, oldest
+     * first. When it's full the oldest are dropped.
+     */
+    IMUSample samples[kMaxSamples];
+    uint8_t numSamples = 0;
 };
 
 /** @struct BatteryVoltage
@@ -80,7 +101,9 @@ struct BatteryVoltage {
     bool isValid = false; /**< Stores whether given data is valid  */
     uint32_t lastUpdate;  /**< Time at which BatteryVoltage was last updated (milliseconds) */
 
-    uint8_t rawVoltage;   /**< Battery voltage (volts)  */
+    uint8_t rawVoltage;   /**< Raw 8-bit battery voltage reading (0-255)  */
+    float voltage;        /**< Filtered bus voltage (volts)  */
+    float percentage;     /**< Estimated state of charge (0-100)  */
     bool isCritical;      /**< Stores whether battery voltage level is critical (nearly dead)  */
 };
 
@@ -97,6 +120,8 @@ struct FPGAStatus {
     uint32_t lastUpdate;      /**< Time at which FPGAStatus was last updated (milliseconds) */
 
     bool motorHasErrors[5];   /**< Stores whether each of the motors has an error  */
+    uint16_t gateDriverStatus[5]; /**< DRV8303 status of each motor, see FPGA::gate_drivers */
+    uint32_t missedUpdates;   /**< Motor updates the FPGA made that the responses were lost for */
     bool FPGAHasError;        /**< Stores whether FPGA has an error  */
 };
 
@@ -158,6 +183,8 @@ struct KickerInfo {
     bool kickerHasError;      /**< Stores whether Kicker has an error */
     bool kickerCharged;       /**< Stores whether Kicker is charged above appropriate threshold to kick */
     bool ballSenseTriggered;  /**< Stores whether Breakbeam is tripped */
+    uint8_t voltage;          /**< Cap voltage, 0 - 255, roughly volts */
+    uint8_t faults;           /**< FAULT_* bits the kicker last reported */
 };
 
 /** @struct DebugInfo
@@ -2,6 +2,10 @@
 #include "drivers/MCP23017.hpp"
 
 #define SHARED_I2C_BUS I2CBus::I2CBus1
+// The I2C1 pins (PB8/PB9), to clock the bus free when a device holds SDA
+// low. Without them a stuck device is only skipped.
+#define SHARED_I2C_SCL (PinName{GPIOB, GPIO_PIN_8})
+#define SHARED_I2C_SDA (PinName{GPIOB, GPIO_PIN_9})
 
 #define SHARED_SPI_BUS SpiBus::SpiBus2
 
@@ -22,6 +26,10 @@
 
 #define DOT_STAR_CS p11
 
+// MPU6050 data ready. Without it IMUModule reads the FIFO on its timer
+// instead, define it as the mTrain pin once INT is routed to one.
+// #define IMU_INT
+
 #define HEX_SWITCH_BIT0 MCP23017::ExpPinName::PinA7
 #define HEX_SWITCH_BIT1 MCP23017::ExpPinName::PinA4
 #define HEX_SWITCH_BIT2 MCP23017::ExpPinName::PinA6
@@ -14,7 +14,7 @@ public:
     /**
      * Number of times per second (frequency) that BatteryModule should run (Hz).
      */
-    static constexpr float kFrequency = 1.0f;
+    static constexpr float kFrequency = 10.0f;
 
     /**
      * Number of seconds elapsed (period) between BatteryModule runs (milliseconds)
@@ -38,7 +38,9 @@ public:
     /**
      * Code to run when called by RTOS once per system tick (`kperiod`)
      *
-     * Updates `batteryVoltage` with new information from `battery`
+     * Updates `batteryVoltage` with new information from `battery`. If
+     * the battery ADC didn't start, `batteryVoltage` stays invalid and the
+     * low power profile is never applied.
      */
     void entry() override;
 
@@ -46,4 +48,9 @@ private:
     LockedStruct<BatteryVoltage>& batteryVoltage;
 
     Battery battery;
+
+    /**
+     * Whether the low power profile has been applied to the other modules
+     */
+    bool lowPowerActive = false;
 };
\ No newline at end of file
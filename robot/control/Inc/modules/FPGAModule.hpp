@@ -62,6 +62,13 @@ private:
     FPGA fpga;
     bool fpgaInitialized;
 
+    /**
+     * Sequence number of the last motor update, to catch updates whose
+     * encoder ticks never made it back
+     */
+    bool hasUpdateSequence;
+    uint8_t lastUpdateSequence;
+
     /**
      * Max amount of time that can elapse from the latest
      * command from motion control
@@ -71,10 +78,45 @@ private:
      */
     static constexpr uint32_t COMMAND_TIMEOUT = 250; // ms
 
+    /**
+     * PWM carrier frequency of the motors
+     */
+    static constexpr uint32_t PWM_FREQUENCY = 18'000; // Hz
+
+    /**
+     * Dribbler commands are in the FPGA's original 9 bit duty cycle units
+     */
+    static constexpr int16_t DRIBBLER_DUTY_SCALE = (FPGA::MAX_DUTY_CYCLE + 1) / 512;
+
     /**
      * Number of enc ticks per revolution of the wheel
      * Encoder is on the motor before the gear ratio
      */
     static constexpr uint32_t GEAR_RATIO = 3;
     static constexpr uint32_t ENC_TICK_PER_REV = 2048 * GEAR_RATIO;
+
+    /**
+     * Encoder velocity from the FPGA is in enc ticks/sec with
+     * `FPGATelemetry::ENC_VELOCITY_FRAC_BITS` fractional bits
+     */
+    static constexpr float ENC_VELOCITY_LSB = 1.0f / (1 << FPGATelemetry::ENC_VELOCITY_FRAC_BITS);
+
+    /**
+     * Phase current sensing, see the current sense ADC section in robocup.v
+     *
+     * The DRV8303 amplifies the voltage across each low side shunt by
+     * DRV8303_AMP_GAIN (40 V/V) around half of the reference, and the
+     * FPGA returns the largest phase magnitude in lsb of the 12 bit ADC
+     */
+    static constexpr float CURRENT_ADC_REFERENCE = 3.3f; // V
+    static constexpr float CURRENT_ADC_FULL_SCALE = 4096.0f;
+    static constexpr float CURRENT_SENSE_GAIN = 40.0f; // V/V
+    static constexpr float CURRENT_SHUNT_RESISTANCE = 0.01f; // ohm
+    static constexpr float AMP_PER_CURRENT_LSB =
+        CURRENT_ADC_REFERENCE / CURRENT_ADC_FULL_SCALE / (CURRENT_SENSE_GAIN * CURRENT_SHUNT_RESISTANCE);
+
+    /**
+     * FAULT bit of the DRV8303 status halfword, see `FPGA::gate_drivers`
+     */
+    static constexpr uint16_t GATE_DRIVER_FAULT = 1 << 10;
 };
@@ -2,6 +2,8 @@
 
 #include <cstdint>
 #include <chrono>
+#include <atomic>
+#include <array>
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -12,7 +14,7 @@
 class GenericModule {
 public:
     GenericModule(std::chrono::milliseconds period, const char *name, int priority = 1, int stackSize = 1024)
-        : period(period), name(name), priority(priority), stackSize(stackSize) {}
+        : period(period), lowPowerPeriod(period), name(name), priority(priority), stackSize(stackSize) {}
 
     /**
      * Called once to initialize the module. All initialization work should be
@@ -30,6 +32,28 @@ public:
      */
     std::chrono::milliseconds period;
 
+    /**
+     * The module period while the robot is in the low power profile (milliseconds)
+     *
+     * Defaults to `period`, non-essential modules override it in their
+     * constructor to run less often when the battery is critical
+     */
+    std::chrono::milliseconds lowPowerPeriod;
+
+    /**
+     * Whether the module should currently run at `lowPowerPeriod`
+     *
+     * Written by the battery task, read by the module's own task
+     */
+    std::atomic<bool> lowPower{false};
+
+    /**
+     * @return The period the module should currently run at (milliseconds)
+     */
+    std::chrono::milliseconds currentPeriod() const {
+        return lowPower.load() ? lowPowerPeriod : period;
+    }
+
     /**
      * A human-readable name for the process
      */
@@ -43,4 +67,47 @@ public:
     int stackSize = 1024;
 
     TaskHandle_t handle = nullptr;
+
+    /**
+     * Don't call `start()` until `module` has finished its own `start()`
+     *
+     * Must be called before the scheduler is started. Modules without
+     * dependencies all start at once, so slow bring-up (FPGA configuration,
+     * radio association, kicker verification) overlaps.
+     */
+    void dependsOn(GenericModule& module) {
+        if (numDependencies < dependencies.size()) {
+            dependencies[numDependencies++] = &module;
+        }
+    }
+
+    /**
+     * @return Whether every module this one depends on is ready
+     */
+    bool dependenciesReady() const {
+        for (size_t i = 0; i < numDependencies; i++) {
+            if (!dependencies[i]->ready.load()) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static constexpr size_t kMaxDependencies = 4;
+
+    std::array<GenericModule*, kMaxDependencies> dependencies{};
+    size_t numDependencies = 0;
+
+    /**
+     * Set once `start()` has returned, written by the module's own task
+     */
+    std::atomic<bool> ready{false};
+
+    /**
+     * Boot timeline (ticks): when the task first ran, when its
+     * dependencies were ready, and when `start()` returned
+     */
+    TickType_t taskStartTick = 0;
+    TickType_t dependenciesReadyTick = 0;
+    TickType_t readyTick = 0;
 };
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "GenericModule.hpp"
+#include "drivers/I2CBusManager.hpp"
+
+/**
+ * Module running the shared I2C bus's queued transactions
+ *
+ * Runs at the priority of the control loops so a transaction the IMU is
+ * waiting on starts as soon as the bus is free.
+ */
+class I2CBusModule : public GenericModule {
+public:
+    /**
+     * Number of seconds elapsed (period) between I2CBusModule runs (milliseconds)
+     *
+     * Each run waits for transactions, so this only limits how often it
+     * goes back to waiting
+     */
+    static constexpr std::chrono::milliseconds kPeriod{1};
+
+    /**
+     * Priority used by RTOS
+     */
+    static constexpr int kPriority = 3;
+
+    /**
+     * How often the per device latency and utilization is logged (milliseconds)
+     */
+    static constexpr uint32_t kStatsPeriod = 10'000;
+
+    explicit I2CBusModule(I2CBusManager& i2cBus);
+
+    /**
+     * Code to run when called by RTOS once per system tick (`kperiod`)
+     *
+     * Runs every transaction queued, waiting for one until the stats are
+     * next due
+     */
+    void entry() override;
+
+private:
+    I2CBusManager& i2cBus;
+
+    uint32_t lastStats;
+};
@@ -1,9 +1,11 @@
 #pragma once
 
-#include "I2C.hpp"
 #include "GenericModule.hpp"
 #include "MicroPackets.hpp" 
+#include "drivers/I2CBusManager.hpp"
 #include "drivers/MPU6050.h"
+#include "motion-control/GyroBiasEstimator.hpp"
+#include "FlashStorage.hpp"
 #include "LockedStruct.hpp"
 #include <memory>
 
@@ -27,26 +29,122 @@ public:
      */
     static constexpr int kPriority = 3;
 
+    /**
+     * Rate the MPU6050 samples at, into its FIFO (Hz)
+     *
+     * Each run reads every sample queued since the last one
+     */
+    static constexpr int kSampleRate = 1000;
+
+    /**
+     * Time between samples (milliseconds)
+     */
+    static constexpr uint32_t kSamplePeriod = 1000 / kSampleRate;
+
+    /**
+     * Fastest any wheel can turn with the robot still counting as
+     * stationary, for the gyro bias (rad/s)
+     */
+    static constexpr float kStationaryWheelSpeed = 0.05f;
+
+    /**
+     * How often the temperature is read (milliseconds)
+     */
+    static constexpr uint32_t kTemperaturePeriod = 100;
+
+    /**
+     * Least time between saving the gyro calibration (milliseconds)
+     */
+    static constexpr uint32_t kCalibrationSavePeriod = 60'000;
+
+    /**
+     * Change in the gyro bias, on any axis, that's worth saving (rad/s)
+     */
+    static constexpr float kCalibrationSaveChange = 0.001f;
+
     /**
      * Constructor for IMUModule
-     * @param sharedI2C Pointer to I2C object which reads/writes on I2C bus
+     * @param i2cBus I2C bus shared with the IO expander
+     * @param motorFeedback Wheel speeds, to tell when the robot is still and the gyro should read 0
      * @param imuData Shared memory location containing linear acceleration and angular velocity along/about X,Y, and Z axes
      */
-    IMUModule(std::shared_ptr<I2C> sharedI2C, LockedStruct<IMUData>& imuData);
+    IMUModule(I2CBusManager& i2cBus, LockedStruct<MotorFeedback>& motorFeedback,
+              LockedStruct<IMUData>& imuData);
 
     /**
      * Code which initializes module
+     *
+     * Picks up the gyro calibration saved on an earlier boot
      */
     void start() override;
 
     /**
      * Code to run when called by RTOS once per system tick (`kperiod`)
      *
-     * @note As of May 2020, IMUModule is not integrated on the robots due to issues. The code immediately returns.
+     * Burst reads every sample queued in the FIFO. With `IMU_INT` defined
+     * it first waits for the data ready interrupt to say a batch is queued.
+     * While the MPU6050 isn't responding it's skipped, only retrying now
+     * and then, so it doesn't hold up the rest of the bus.
+     *
+     * While the wheels are still, the gyro samples also go into its bias
+     * estimate, which is saved to flash as it changes.
      */
     void entry() override;
 
 private:
+    /**
+     * Accel then gyro, X Y Z, each big endian
+     */
+    static constexpr int kSampleBytes = 12;
+
+    static constexpr uint16_t kFIFOSize = 1024;
+
+    /**
+     * Most samples one I2C read can get, its length is a byte
+     */
+    static constexpr int kMaxBurstSamples = 255 / kSampleBytes;
+
+    /**
+     * Empties the FIFO and starts queueing samples again
+     */
+    void restartFIFO();
+
+    /**
+     * Converts a sample read from the FIFO, removes the gyro bias and adds
+     * it to `imuData`
+     *
+     * @return Whether the sample finished a bias window
+     */
+    bool addSample(IMUData& imuData, const uint8_t* raw, uint32_t timestamp, bool stationary);
+
+    /**
+     * @return Whether the wheels have all been still in the latest feedback
+     */
+    bool isStationary();
+
+    /**
+     * Saves the gyro calibration if it's moved far enough from the saved one
+     */
+    void saveCalibration();
+
+    /**
+     * Identifies the calibration record in flash, change it along with
+     * `GyroBiasEstimator::Calibration`
+     */
+    static constexpr uint32_t kCalibrationMagic = 0x47425331; // "GBS1"
+
     MPU6050 imu;
+    LockedStruct<MotorFeedback>& motorFeedback;
     LockedStruct<IMUData>& imuData;
+
+    GyroBiasEstimator gyroBias;
+    FlashStorage calibrationStorage;
+    GyroBiasEstimator::Calibration savedCalibration;
+    bool hasSavedCalibration;
+    uint32_t lastCalibrationSave;
+
+    float temperature;
+    uint32_t lastTemperatureRead;
+
+    uint8_t fifoBuffer[kMaxBurstSamples * kSampleBytes];
 };
\ No newline at end of file
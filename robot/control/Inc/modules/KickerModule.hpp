@@ -28,11 +28,11 @@ public:
 
     /**
      * Constructor for KickerModule
-     * @param spi Pointer to SPI object which handles communication on SPI bus
+     * @param spiBus Shared SPI bus the kicker is on
      * @param kickerCommand Shared memory location containing kicker shoot mode, trigger mode, and kick strength
      * @param kickerInfo Shared memory location containing kicker status
      */
-    KickerModule(LockedStruct<SPI>& spi,
+    KickerModule(SPIBusManager& spiBus,
                  LockedStruct<KickerCommand>& kickerCommand,
                  LockedStruct<KickerInfo>& kickerInfo);
 
@@ -8,10 +8,10 @@
 #include "LockedStruct.hpp"
 #include "DigitalOut.hpp"
 #include "I2C.hpp"
-#include "SPI.hpp"
 #include "GenericModule.hpp"
 #include "MicroPackets.hpp"
 #include "drivers/MCP23017.hpp"
+#include "drivers/SPIBusManager.hpp"
 
 
 /**
@@ -73,6 +73,16 @@ public:
      */
     static constexpr std::chrono::milliseconds kPeriod{static_cast<int>(1000 / kFrequency)};
 
+    /**
+     * Frequency that LEDModule drops to in the low power profile (Hz)
+     */
+    static constexpr float kLowPowerFrequency = 2.0f;
+
+    /**
+     * Period between LEDModule runs in the low power profile (milliseconds)
+     */
+    static constexpr std::chrono::milliseconds kLowPowerPeriod{static_cast<int>(1000 / kLowPowerFrequency)};
+
     /**
      * Priority used by RTOS
      *
@@ -80,18 +90,24 @@ public:
      */
     static constexpr int kPriority = 1;
 
+    /**
+     * DotStar SCK (Hz), well under what APA102s take so the wiring to
+     * them doesn't matter
+     */
+    static constexpr int kDotStarFrequency = 4'000'000;
+
     /**
      * Constructor for LEDModule
      *
      * @param ioExpander shared_ptr with mutex locks for MCP23017 driver
-     * @param dotStarSPI SPI bus for dotStar LEDS
+     * @param spiBus Shared SPI bus the dotStar LEDs are on
      * @param batteryVoltage Shared memory location containing data on battery voltage and critical status
      * @param fpgaStatus Shared memory location containing whether motors or FPGA have errors
      * @param kickerInfo Shared memory location containing kicker status
      * @param radioError Shared memory location containing whether radio has an error
      */
     LEDModule(LockedStruct<MCP23017>& ioExpander,
-              LockedStruct<SPI>& dotStarSPI,
+              SPIBusManager& spiBus,
               LockedStruct<BatteryVoltage>& batteryVoltage,
               LockedStruct<FPGAStatus>& fpgaStatus,
               LockedStruct<KickerInfo>& kickerInfo,
@@ -183,7 +199,7 @@ private:
     const static uint16_t IOExpanderErrorLEDMask = 0xFF00;
 
     LockedStruct<MCP23017>& ioExpander;
-    LockedStruct<SPI>& dotStarSPI;
+    SPIBusManager& spiBus;
 
     LockedStruct<BatteryVoltage>& batteryVoltage;
     LockedStruct<FPGAStatus>& fpgaStatus;
@@ -191,7 +207,7 @@ private:
     LockedStruct<RadioError>& radioError;
     LockedStruct<IMUData>& imuData;
 
-    DigitalOut dotStarNCS;
+    SPIBusManager::DeviceId dotStar;
 
     // RADIO
     const struct Error ERR_RADIO_BOOT_FAIL = {CategoryColors::RADIO_ERROR,
@@ -251,6 +267,11 @@ private:
      */
     bool lightsOn = true;
 
+    /**
+     * Number of entries in `failed_modules` that have already been logged
+     */
+    size_t reportedFailedModules = 0;
+
     /**
      * Array of mTrain LEDs as `DigitalOut`s
      */
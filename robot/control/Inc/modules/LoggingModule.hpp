@@ -0,0 +1,36 @@
+#pragma once
+
+#include "GenericModule.hpp"
+
+/**
+ * Module draining the deferred log queue to stdout
+ *
+ * Runs at the lowest module priority so that formatting and the blocking
+ * USB/UART write only happen in time the control loops aren't using.
+ */
+class LoggingModule : public GenericModule {
+public:
+    /**
+     * Number of times per second (frequency) that LoggingModule should run (Hz)
+     */
+    static constexpr float kFrequency = 20.0f;
+
+    /**
+     * Number of seconds elapsed (period) between LoggingModule runs (milliseconds)
+     */
+    static constexpr std::chrono::milliseconds kPeriod{static_cast<int>(1000 / kFrequency)};
+
+    /**
+     * Priority used by RTOS
+     */
+    static constexpr int kPriority = 1;
+
+    LoggingModule();
+
+    /**
+     * Code to run when called by RTOS once per system tick (`kperiod`)
+     *
+     * Formats and writes out every queued log message
+     */
+    void entry() override;
+};
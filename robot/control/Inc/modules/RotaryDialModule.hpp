@@ -22,6 +22,16 @@ public:
      */
     static constexpr std::chrono::milliseconds kPeriod{static_cast<int>(1000 / kFrequency)};
 
+    /**
+     * Frequency that RotaryDialModule drops to in the low power profile (Hz)
+     */
+    static constexpr float kLowPowerFrequency = 0.2f;
+
+    /**
+     * Period between RotaryDialModule runs in the low power profile (milliseconds)
+     */
+    static constexpr std::chrono::milliseconds kLowPowerPeriod{static_cast<int>(1000 / kLowPowerFrequency)};
+
     /**
      * Priority used by RTOS
      */
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstdint>
+
+/**
+ * Estimates the gyro's zero rate bias, and how it drifts with temperature
+ *
+ * While the robot is stationary the gyro should read 0, so whatever it
+ * averages over a window of samples is the bias at that temperature. Every
+ * window is a point in a line fit of bias against temperature, with older
+ * windows counting less and less, so the bias follows the gyro as it warms
+ * up and the slope of the fit gives the drift at temperatures it hasn't
+ * been stationary at yet.
+ */
+class GyroBiasEstimator {
+public:
+    /**
+     * Bias as a line in temperature, what's kept across boots
+     */
+    struct Calibration {
+        float bias[3];              /**< Bias at `temperature` [X,Y,Z] (rad/s) */
+        float drift[3];             /**< Change in bias with temperature [X,Y,Z] (rad/s per deg C) */
+        float temperature;          /**< deg C */
+    };
+
+    /**
+     * Samples averaged into a window, 1 second at the IMU's sample rate
+     */
+    static constexpr uint32_t kWindowSamples = 1000;
+
+    /**
+     * Biggest difference between samples of one window on any axis
+     * (rad/s), more means the robot was moving even if the wheels weren't
+     */
+    static constexpr float kMaxWindowSpread = 0.05f;
+
+    /**
+     * How much of the fit is kept each new window
+     */
+    static constexpr float kForgetting = 0.8f;
+
+    /**
+     * Spread of the windows' temperatures, as a variance, before the drift
+     * is fitted (deg C squared). Any less and the slope is mostly noise.
+     */
+    static constexpr float kMinTemperatureVariance = 1.0f;
+
+    GyroBiasEstimator();
+
+    /**
+     * Starts from a calibration saved before, it counts as one window
+     */
+    void setCalibration(const Calibration& calibration);
+
+    const Calibration& getCalibration() const { return calibration; }
+
+    /**
+     * @return Whether there's a bias, from a window or setCalibration()
+     */
+    bool isCalibrated() const { return calibrated; }
+
+    /**
+     * @param omegas Uncorrected gyro sample [X,Y,Z] (rad/s)
+     * @param temperature deg C
+     * @param stationary Whether the robot is known to be still, the window
+     *        starts over when it isn't
+     * @return Whether a window just finished and updated the calibration
+     */
+    bool addSample(const float omegas[3], float temperature, bool stationary);
+
+    /**
+     * @param omegas Uncorrected gyro sample [X,Y,Z], corrected in place (rad/s)
+     */
+    void correct(float omegas[3], float temperature) const;
+
+private:
+    /**
+     * Temperatures are fitted relative to this (deg C)
+     */
+    static constexpr float kFitOrigin = 25.0f;
+
+    void resetWindow();
+    void addWindow(const float bias[3], float temperature);
+
+    Calibration calibration;
+    bool calibrated;
+
+    // The window being averaged
+    uint32_t windowCount;
+    float windowSum[3];
+    float windowMin[3];
+    float windowMax[3];
+    float windowTemperatureSum;
+
+    // Weighted sums of the windows for the line fit
+    float fitWeight;
+    float fitTemperature;
+    float fitTemperatureSquared;
+    float fitBias[3];
+    float fitTemperatureBias[3];
+};
@@ -3,6 +3,8 @@
 #include <cstdint>
 #include <Eigen/Dense>
 
+#include "MicroPackets.hpp"
+
 /**
  * Controller for wheel velocities
  */
@@ -33,12 +35,18 @@ public:
      * Updates the controller with the latest input and calculates
      * the correct wheel velocities to reach this target
      * 
+     * The feed-forward works out the voltage each motor needs and divides
+     * it by the measured bus voltage, so the same command gives the same
+     * acceleration across the whole battery curve
+     *
      * @param pv Current state (XYW vel in m/s or rad/s)
      * @param sp Current target (XYW vel in m/s or rad/s)
-     * @param output Motor targets (rad/s)
+     * @param battery Latest battery reading, the nominal bus voltage is used if it isn't valid
+     * @param output Motor duty cycles in % max (-1 to 1)
      */
     void calculateBody(Eigen::Matrix<float, numStates, 1> pv,
                        Eigen::Matrix<float, numStates, 1> sp,
+                       const BatteryVoltage& battery,
                        Eigen::Matrix<float, numWheels, 1>& outputs);
 
     /**
@@ -53,7 +61,20 @@ public:
                          Eigen::Matrix<float, numWheels, 1> sp,
                          Eigen::Matrix<float, numWheels, 1>& outputs);
 
+    /**
+     * Bus voltage the duty cycle model (`SpeedToDutyCycle`) was characterized at (volts)
+     */
+    static constexpr float nominalBusVoltage = 24.0f;
+
 private:
+    /**
+     * Picks the bus voltage to divide by from the latest battery reading
+     *
+     * Readings that are invalid or outside of a plausible pack voltage
+     * fall back to the nominal voltage
+     */
+    static float busVoltageFrom(const BatteryVoltage& battery);
+
     /**
      * Limits the difference between the previous target and the new target
      * such that the acceleration limits below are never broken
@@ -107,6 +128,12 @@ private:
      */
     float dt;
 
+    /**
+     * Range of bus voltages trusted for feed-forward scaling (volts)
+     */
+    static constexpr float minBusVoltage = 12.0f;
+    static constexpr float maxBusVoltage = 30.0f;
+
     /**
      * Max wheel acceleration (rad/s^2)
      */
@@ -3,8 +3,10 @@
 
 using namespace std::literals;
 
+extern void setLowPowerMode(bool enabled);
+
 BatteryModule::BatteryModule(LockedStruct<BatteryVoltage>& batteryVoltage)
-    : GenericModule(1000ms, "battery"),
+    : GenericModule(kPeriod, "battery", kPriority),
       batteryVoltage(batteryVoltage) {
 
     // It makes no sense to actually attempt to lock the mutex here, because
@@ -14,15 +16,35 @@ BatteryModule::BatteryModule(LockedStruct<BatteryVoltage>& batteryVoltage)
     batteryLock->isValid = false;
     batteryLock->lastUpdate = 0;
     batteryLock->rawVoltage = 0;
+    batteryLock->voltage = 0.0f;
+    batteryLock->percentage = 0.0f;
     batteryLock->isCritical = false;
 }
 
 void BatteryModule::entry(void) {
+    // Leave the reading invalid, and the other modules at full rate, rather
+    // than report the empty sample buffer as a critical battery
+    if (!battery.ok()) {
+        return;
+    }
+
     battery.update();
 
-    auto batteryLock = batteryVoltage.lock();
-    batteryLock->isValid = true;
-    batteryLock->lastUpdate = HAL_GetTick();
-    batteryLock->rawVoltage = battery.getRaw();
-    batteryLock->isCritical = battery.isBattCritical();
+    const bool isCritical = battery.isBattCritical();
+
+    {
+        auto batteryLock = batteryVoltage.lock();
+        batteryLock->isValid = true;
+        batteryLock->lastUpdate = HAL_GetTick();
+        batteryLock->rawVoltage = battery.getRaw();
+        batteryLock->voltage = battery.getVoltage();
+        batteryLock->percentage = battery.getBattPercentage();
+        batteryLock->isCritical = isCritical;
+    }
+
+    // Slow the non-essential modules down to stretch what's left
+    if (isCritical != lowPowerActive) {
+        setLowPowerMode(isCritical);
+        lowPowerActive = isCritical;
+    }
 }
\ No newline at end of file
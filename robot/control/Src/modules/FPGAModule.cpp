@@ -1,5 +1,6 @@
 #include "modules/FPGAModule.hpp"
 #include "iodefs.h"
+#include "Logger.hpp"
 
 #include <cmath>
 #include <delay.h>
@@ -14,7 +15,7 @@ FPGAModule::FPGAModule(std::unique_ptr<SPI> spi,
       motorCommand(motorCommand), motorFeedback(motorFeedback),
       fpgaStatus(fpgaStatus),
       fpga(std::move(spi), FPGA_CS, FPGA_INIT, FPGA_PROG, FPGA_DONE),
-      fpgaInitialized(false) {
+      fpgaInitialized(false), hasUpdateSequence(false), lastUpdateSequence(0) {
     {
         auto motorFeedbackLock = motorFeedback.unsafe_value();
         motorFeedbackLock->isValid = false;
@@ -22,6 +23,10 @@ FPGAModule::FPGAModule(std::unique_ptr<SPI> spi,
         for (int i = 0; i < 4; i++) {
             motorFeedbackLock->encoders[i] = 0.0f;
             motorFeedbackLock->currents[i] = 0.0f;
+            motorFeedbackLock->encoderTicks[i] = 0;
+        }
+        for (int i = 0; i < 5; i++) {
+            motorFeedbackLock->hallCounts[i] = 0;
         }
     }
 
@@ -31,18 +36,39 @@ FPGAModule::FPGAModule(std::unique_ptr<SPI> spi,
         fpgaStatusLock->lastUpdate = 0;
         // msb is 1 to indicate no errors
         fpgaStatusLock->FPGAHasError = false;
-        for (int i = 0; i < 4; i++) {
+        for (int i = 0; i < 5; i++) {
             fpgaStatusLock->motorHasErrors[i] = false;
+            fpgaStatusLock->gateDriverStatus[i] = 0;
         }
+        fpgaStatusLock->missedUpdates = 0;
     }
 }
 
 void FPGAModule::start() {
-    vTaskDelay(3000);
-    auto fpgaStatusLock = fpgaStatus.lock();
-    fpgaInitialized = fpga.configure();
-    printf("INFO: FPGA probably configured\r\n");
-    fpgaStatusLock->initialized = fpgaInitialized;
+    // fpgaStatus isn't locked while configuring, so the modules reading it
+    // keep running. It stays not initialized until we're done.
+
+    // After a soft reset the FPGA is still running, and its watchdog has
+    // already stopped the motors. Only reload it if it's a different design.
+    if (fpga.check_loaded()) {
+        fpgaInitialized = true;
+        LOG_INFO("FPGA already configured, skipped loading at tick %lu", xTaskGetTickCount());
+    } else {
+        // configure() waits for the FPGA itself, from toggling PROG_B to DONE
+        fpgaInitialized = fpga.configure();
+        if (fpgaInitialized) {
+            LOG_INFO("FPGA configured at tick %lu", xTaskGetTickCount());
+        } else {
+            LOG_WARN("FPGA configuration failed, continuing anyway");
+        }
+    }
+
+    // The bitstream in fpga_bin.h may still be one that can't change it
+    if (!fpga.legacy_design()) {
+        fpga.set_pwm_frequency(PWM_FREQUENCY);
+    }
+    LOG_INFO("FPGA PWM at %u Hz", static_cast<unsigned>(fpga.read_pwm_frequency()));
+    fpgaStatus.lock()->initialized = fpgaInitialized;
 }
 
 void FPGAModule::entry() {
@@ -63,7 +89,7 @@ void FPGAModule::entry() {
 
     // FPGA initialized so we all good
     std::array<int16_t, 5> dutyCycles{0, 0, 0, 0, 0};
-    std::array<int16_t, 5> encDeltas{};
+    FPGATelemetry telemetry{};
 
     {
         auto motorCommandLock = motorCommand.lock();
@@ -72,6 +98,8 @@ void FPGAModule::entry() {
         if (motorCommandLock->isValid &&
             (HAL_GetTick() - motorCommandLock->lastUpdate) < COMMAND_TIMEOUT) {
 
+            // The feed-forward gains in RobotController were fit with the
+            // wheel commands halved here, so keep the same scale
             for (int i = 0; i < 4; i++) {
                 dutyCycles.at(i) = static_cast<int16_t>(
                         motorCommandLock->wheels[i] * fpga.MAX_DUTY_CYCLE / 2);
@@ -81,61 +109,53 @@ void FPGAModule::entry() {
                     dutyCycles.at(i) = -fpga.MAX_DUTY_CYCLE;
                 }
             }
-            dutyCycles.at(4) = motorCommandLock->dribbler;
+            dutyCycles.at(4) = static_cast<int16_t>(motorCommandLock->dribbler * DRIBBLER_DUTY_SCALE);
         }
     }
 
-    // Communicate with FPGA
-    uint8_t status = fpga.set_duty_get_enc(
-        dutyCycles.data(), dutyCycles.size(),
-        encDeltas.data(), encDeltas.size());
-
-    /*
-     * The time since the last update is derived with the value of
-     * WATCHDOG_TIMER_CLK_WIDTH in robocup.v
-     *
-     * The last encoder reading (5th one) from the FPGA is the watchdog
-     * timer's tick since the last SPI transfer.
-     *
-     * Multiply the received tick count by:
-     *     (1/18.432) * 2 * (2^WATCHDOG_TIMER_CLK_WIDTH)
-     *
-     * This will give you the duration since the last SPI transfer in
-     * microseconds (us).
-     *
-     * For example, if WATCHDOG_TIMER_CLK_WIDTH = 6, here's how you would
-     * convert into time assuming the fpga returned a reading of 1265 ticks:
-     *     time_in_us = [ 1265 * (1/18.432) * 2 * (2^6) ] = 8784.7us
-     *
-     * The precision would be in increments of the multiplier. For
-     * this example, that is:
-     *     time_precision = 6.94us
-     *
-     */
-    float dt = static_cast<float>(encDeltas[4]) * (1 / 18.432e6) * 2 * 128;
-
-    // Force dt to be nonzero
-    // so nan's don't filter up
-    // If it's too small, just assume dt is massive
-    // so theres no recordered encoder outut since it's
-    // probably junk data
-    if (dt < 0.0001) {
-        dt = 1;
+    // Communicate with FPGA, everything comes back in the one transfer
+    uint8_t status = fpga.set_duty_get_all(dutyCycles.data(), dutyCycles.size(), telemetry);
+
+    // The FPGA counts every motor update, a gap means one happened that we
+    // never got the encoder ticks for. Nothing comes back when it isn't ready,
+    // and a legacy design doesn't count them.
+    const bool fpgaReady = (status & (1 << 7)) != 0;
+    uint8_t missed = 0;
+    if (fpgaReady && !fpga.legacy_design()) {
+        if (hasUpdateSequence) {
+            missed = static_cast<uint8_t>(telemetry.sequence - lastUpdateSequence - 1);
+            if (missed != 0) {
+                LOG_WARN("FPGA: missed %u motor updates", missed);
+            }
+        }
+        hasUpdateSequence = true;
+        lastUpdateSequence = telemetry.sequence;
     }
 
     {
         auto motorFeedbackLock = motorFeedback.lock();
-        // Convert encoders to rad/sec from enc ticks since last reading
+        // The FPGA times the encoder edges itself and returns enc ticks/sec,
+        // so there's no dependence on when this transfer happened
         for (int i = 0; i < 4; i++) {
-            // (rad / s) = (enc) * (rev / enc) * (rad / rev) * (1 / sec)
+            // (rad / s) = (enc / s) * (rev / enc) * (rad / rev)
             motorFeedbackLock->encoders[i] =
-                    static_cast<float>(encDeltas[i]) * (1 / static_cast<float>(ENC_TICK_PER_REV)) * (2 * M_PI / 1) *
-                    (1 / dt);
+                    static_cast<float>(telemetry.enc_velocity(i)) * ENC_VELOCITY_LSB *
+                    (1 / static_cast<float>(ENC_TICK_PER_REV)) * (2 * M_PI / 1);
         }
 
         // Convert from adc lsb to amp
         for (int i = 0; i < 4; i++) {
-            motorFeedbackLock->currents[i] = 0.0f;
+            motorFeedbackLock->currents[i] = static_cast<float>(telemetry.current(i)) * AMP_PER_CURRENT_LSB;
+        }
+
+        if (fpgaReady) {
+            for (int i = 0; i < 4; i++) {
+                motorFeedbackLock->encoderTicks[i] += telemetry.enc_delta(i);
+            }
+        }
+
+        for (int i = 0; i < 5; i++) {
+            motorFeedbackLock->hallCounts[i] = telemetry.hall_counts[i];
         }
 
         motorFeedbackLock->isValid = true;
@@ -147,11 +167,16 @@ void FPGAModule::entry() {
         fpgaStatusLock->isValid = true;
         fpgaStatusLock->lastUpdate = HAL_GetTick();
         // msb is 1 to indicate no errors
-        fpgaStatusLock->FPGAHasError = (status & (1 << 7)) == 0;
-
-        // 1 is to indicate error on the specific wheel
-        for (int i = 0; i < 4; i++) {
-            fpgaStatusLock->motorHasErrors[i] = (status & (1 << i)) == 1;
+        fpgaStatusLock->FPGAHasError = !fpgaReady;
+        fpgaStatusLock->missedUpdates += missed;
+
+        // 1 is to indicate error on the specific motor, either a hall
+        // fault or the gate driver reporting a fault
+        for (int i = 0; i < 5; i++) {
+            const uint16_t gateDriver = telemetry.gate_drv(i);
+            fpgaStatusLock->gateDriverStatus[i] = gateDriver;
+            fpgaStatusLock->motorHasErrors[i] = (status & (1 << i)) != 0 ||
+                                                (gateDriver & GATE_DRIVER_FAULT) != 0;
         }
     }
 }
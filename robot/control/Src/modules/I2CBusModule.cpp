@@ -0,0 +1,17 @@
+#include "modules/I2CBusModule.hpp"
+#include "mtrain.hpp"
+
+I2CBusModule::I2CBusModule(I2CBusManager& i2cBus)
+    : GenericModule(kPeriod, "i2c", kPriority),
+      i2cBus(i2cBus), lastStats(0) {}
+
+void I2CBusModule::entry() {
+    const uint32_t sinceStats = HAL_GetTick() - lastStats;
+    if (sinceStats >= kStatsPeriod) {
+        i2cBus.logStats();
+        lastStats = HAL_GetTick();
+        return;
+    }
+
+    i2cBus.service(pdMS_TO_TICKS(kStatsPeriod - sinceStats));
+}
@@ -1,13 +1,57 @@
 #include "modules/IMUModule.hpp"
 #include "mtrain.hpp"
+#include "iodefs.h"
+#include "Logger.hpp"
+#include <algorithm>
 #include <cmath>
 
-IMUModule::IMUModule(std::shared_ptr<I2C> sharedI2C, LockedStruct<IMUData>& imuData)
+#ifdef IMU_INT
+#include "interrupt_in.h"
+
+namespace {
+/**
+ * Samples per batch, the IMU task is woken once it's all queued
+ */
+constexpr uint32_t kBatchSamples = IMUModule::kSampleRate / static_cast<int>(IMUModule::kFrequency);
+
+TaskHandle_t imuTask = nullptr;
+volatile uint32_t samplesQueued = 0;
+
+// Once per sample from the data ready interrupt
+void dataReady_cb() {
+    if (imuTask != nullptr && ++samplesQueued >= kBatchSamples) {
+        samplesQueued = 0;
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(imuTask, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+}
+#endif
+
+namespace {
+/**
+ * Oldest wheel feedback that can say the robot is stationary (milliseconds)
+ */
+constexpr uint32_t kMaxFeedbackAge = 50;
+}
+
+IMUModule::IMUModule(I2CBusManager& i2cBus, LockedStruct<MotorFeedback>& motorFeedback,
+                     LockedStruct<IMUData>& imuData)
     : GenericModule(kPeriod, "imu", kPriority),
-      imu(sharedI2C), imuData(imuData) {
+      imu(i2cBus), motorFeedback(motorFeedback), imuData(imuData),
+      calibrationStorage(kCalibrationMagic, sizeof(GyroBiasEstimator::Calibration)),
+      savedCalibration{}, hasSavedCalibration(false), lastCalibrationSave(0),
+      temperature(0.0f), lastTemperatureRead(0) {
+#if defined(SHARED_I2C_SCL) && defined(SHARED_I2C_SDA)
+    imu.getI2Cdev().setBusRecovery(SHARED_I2C_BUS, {SHARED_I2C_SCL, SHARED_I2C_SDA});
+#endif
+
     auto imuDataLock = imuData.unsafe_value();
     imuDataLock->isValid = false;
     imuDataLock->lastUpdate = 0;
+    imuDataLock->gyroCalibrated = false;
+    imuDataLock->temperature = 0.0f;
 
     for (int i = 0; i < 3; i++) {
         imuDataLock->accelerations[i] = 0.0f;
@@ -18,21 +62,21 @@ IMUModule::IMUModule(std::shared_ptr<I2C> sharedI2C, LockedStruct<IMUData>& imuD
 void IMUModule::start() {
     imu.initialize();
 
+    // Only accel and gyro go into the FIFO, 12 bytes a sample
     imu.setTempFIFOEnabled(false);
-    imu.setXGyroFIFOEnabled(false);
-    imu.setYGyroFIFOEnabled(false);
-    imu.setZGyroFIFOEnabled(false);
-    imu.setAccelFIFOEnabled(false);
+    imu.setXGyroFIFOEnabled(true);
+    imu.setYGyroFIFOEnabled(true);
+    imu.setZGyroFIFOEnabled(true);
+    imu.setAccelFIFOEnabled(true);
     imu.setSlave2FIFOEnabled(false);
     imu.setSlave1FIFOEnabled(false);
     imu.setSlave0FIFOEnabled(false);
 
-    // Set rate to be 125hz
-    imu.setRate(7);
+    // The gyro runs at 1khz with the lpf on, sample every reading
+    imu.setRate(1000 / kSampleRate - 1);
     imu.setExternalFrameSync(MPU6050_EXT_SYNC_DISABLED);
     imu.setDLPFMode(MPU6050_DLPF_BW_188); // 188hz bandwidth, 2ms lag, lpf
     imu.setIntEnabled(0);
-    imu.setFIFOEnabled(false);
     imu.setIntI2CMasterEnabled(false);
 
     // Resets analog paths to restart config
@@ -57,24 +101,173 @@ void IMUModule::start() {
     imu.setInterruptMode(0);
     imu.setInterruptDrive(0);
     imu.setInterruptLatch(0); // check this if doesn't work
-    imu.setIntDataReadyEnabled(true);
     imu.setInterruptLatchClear(1);
     imu.setIntDataReadyEnabled(true);
 
+    // Start from an empty FIFO now it's configured
+    restartFIFO();
+
+#ifdef IMU_INT
+    imuTask = xTaskGetCurrentTaskHandle();
+    interruptin_init_ex(pin_name{IMU_INT.port, IMU_INT.pin}, &dataReady_cb, PULL_NONE, INTERRUPT_RISING);
+#endif
+
+    // Die temperature, from the register map
+    temperature = imu.getTemperature() / 340.0f + 36.53f;
+    lastTemperatureRead = HAL_GetTick();
 
-    printf("INFO: IMU initialized\r\n");
-    imuData.lock()->initialized = true;
+    // Until it's been still for a window, the bias from the last time is
+    // much closer than none
+    if (calibrationStorage.load(&savedCalibration)) {
+        gyroBias.setCalibration(savedCalibration);
+        hasSavedCalibration = true;
+        LOG_INFO("IMU: Loaded gyro bias %ld %ld %ld mrad/s",
+                 static_cast<long>(savedCalibration.bias[0] * 1000),
+                 static_cast<long>(savedCalibration.bias[1] * 1000),
+                 static_cast<long>(savedCalibration.bias[2] * 1000));
+    } else {
+        LOG_WARN("IMU: No saved gyro bias, waiting to be still");
+    }
+
+    const bool initialized = imu.getI2Cdev().getStats().timeouts == 0;
+    if (initialized) {
+        LOG_INFO("IMU initialized");
+    } else {
+        LOG_WARN("IMU timed out while initializing");
+    }
+    auto imuDataLock = imuData.lock();
+    imuDataLock->initialized = initialized;
+    imuDataLock->gyroCalibrated = gyroBias.isCalibrated();
+    imuDataLock->temperature = temperature;
 }
 
+// Occasionally the MPU6050 holds the data line low
+// causing a consistent timeout on the i2c bus
+// We tried to recover the bus by clocking out a ton
+// of just clock signals, but it did not seem to solve
+// the problem
+// I2Cdev now recovers the bus and stops using the MPU6050
+// while it keeps timing out, so the IO expander keeps working.
+// Its transactions are queued ahead of the IO expander's.
 void IMUModule::entry(void) {
-    // IMU removed
-    // Occasionally the MPU6050 holds the data line low
-    // causing a consistent timeout on the i2c bus
-    // We tried to recover the bus by clocking out a ton
-    // of just clock signals, but it did not seem to solve
-    // the problem
-    // A new imu is on the docket
-    return;
+#ifdef IMU_INT
+    // Read anyway if an interrupt was missed
+    ulTaskNotifyTake(pdTRUE, 2 * kPeriod.count());
+#endif
+
+    const uint16_t fifoCount = imu.getFIFOCount();
+
+    // Not responding, keep what we had marked stale
+    if (imu.getI2Cdev().isOffline()) {
+        imuData.lock()->isValid = false;
+        return;
+    }
+
+    // Samples are split across the end, start over
+    if (fifoCount >= kFIFOSize) {
+        restartFIFO();
+        LOG_WARN("IMU: FIFO overflowed, dropped %u samples", fifoCount / kSampleBytes);
+        return;
+    }
+
+    const int numSamples = fifoCount / kSampleBytes;
+    if (numSamples == 0) {
+        return;
+    }
+
+    // Drifts slowly, so it's only read now and then
+    if (HAL_GetTick() - lastTemperatureRead >= kTemperaturePeriod) {
+        temperature = imu.getTemperature() / 340.0f + 36.53f;
+        lastTemperatureRead = HAL_GetTick();
+    }
+
+    const bool stationary = isStationary();
+    bool windowDone = false;
+
+    // The newest sample was just taken, the rest were taken a sample
+    // period apart before it
+    const uint32_t now = HAL_GetTick();
+    int sample = 0;
+    while (sample < numSamples) {
+        const int burstSamples = std::min(numSamples - sample, kMaxBurstSamples);
+        if (!imu.getFIFOBytes(fifoBuffer, burstSamples * kSampleBytes)) {
+            // Whatever was left in the FIFO is out of step now
+            restartFIFO();
+            return;
+        }
+
+        auto imuDataLock = imuData.lock();
+        for (int i = 0; i < burstSamples; i++, sample++) {
+            windowDone |= addSample(imuDataLock.value(), &fifoBuffer[i * kSampleBytes],
+                                    now - (numSamples - 1 - sample) * kSamplePeriod, stationary);
+        }
+        imuDataLock->isValid = true;
+        imuDataLock->lastUpdate = now;
+        imuDataLock->gyroCalibrated = gyroBias.isCalibrated();
+        imuDataLock->temperature = temperature;
+    }
+
+    if (windowDone) {
+        saveCalibration();
+    }
+}
+
+void IMUModule::restartFIFO() {
+    // It can only be reset while it's disabled
+    imu.setFIFOEnabled(false);
+    imu.resetFIFO();
+    imu.setFIFOEnabled(true);
+}
+
+bool IMUModule::isStationary() {
+    auto motorFeedbackLock = motorFeedback.lock();
+    if (!motorFeedbackLock->isValid || HAL_GetTick() - motorFeedbackLock->lastUpdate > kMaxFeedbackAge) {
+        return false;
+    }
+
+    for (int i = 0; i < 4; i++) {
+        if (!(std::abs(motorFeedbackLock->encoders[i]) < kStationaryWheelSpeed)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void IMUModule::saveCalibration() {
+    const GyroBiasEstimator::Calibration& calibration = gyroBias.getCalibration();
+
+    if (hasSavedCalibration) {
+        if (HAL_GetTick() - lastCalibrationSave < kCalibrationSavePeriod) {
+            return;
+        }
+
+        // Compare the bias each gives at the current temperature
+        bool changed = false;
+        for (int i = 0; i < 3; i++) {
+            const float bias = calibration.bias[i] + calibration.drift[i] * (temperature - calibration.temperature);
+            const float savedBias = savedCalibration.bias[i] +
+                                    savedCalibration.drift[i] * (temperature - savedCalibration.temperature);
+            changed |= std::abs(bias - savedBias) > kCalibrationSaveChange;
+        }
+        if (!changed) {
+            return;
+        }
+    }
+
+    // Still at the end of a window, so a sector erase stalling the CPU
+    // doesn't matter much
+    if (calibrationStorage.save(&calibration)) {
+        savedCalibration = calibration;
+        hasSavedCalibration = true;
+        lastCalibrationSave = HAL_GetTick();
+        LOG_INFO("IMU: Saved gyro bias %ld %ld %ld mrad/s",
+                 static_cast<long>(calibration.bias[0] * 1000),
+                 static_cast<long>(calibration.bias[1] * 1000),
+                 static_cast<long>(calibration.bias[2] * 1000));
+    }
+}
+
+bool IMUModule::addSample(IMUData& imuData, const uint8_t* raw, uint32_t timestamp, bool stationary) {
     // Accel lsb -> g conversions
     // +- 2g = 16384 lsb/g
     // +- 4g = 8192 lsb/g
@@ -90,18 +283,30 @@ void IMUModule::entry(void) {
     const float convertGyro = 1.0f / 32.8f;
     const float degToRad = M_PI / 180.0f;
 
+    // Drop the oldest sample if the consumer hasn't kept up
+    if (imuData.numSamples == IMUData::kMaxSamples) {
+        std::copy(&imuData.samples[1], &imuData.samples[IMUData::kMaxSamples], &imuData.samples[0]);
+        imuData.numSamples--;
+    }
 
-    int16_t motion[6];
+    IMUSample& imuSample = imuData.samples[imuData.numSamples++];
+    imuSample.timestamp = timestamp;
 
-    imu.getMotion6(&motion[0], &motion[1], &motion[2],
-                   &motion[3], &motion[4], &motion[5]);
+    for (int i = 0; i < 3; i++) {
+        const auto accel = static_cast<int16_t>(raw[2 * i] << 8 | raw[2 * i + 1]);
+        const auto gyro = static_cast<int16_t>(raw[6 + 2 * i] << 8 | raw[6 + 2 * i + 1]);
 
-    auto imuDataLock = imuData.lock();
-    imuDataLock->isValid = true;
-    imuDataLock->lastUpdate = HAL_GetTick();
+        imuSample.accelerations[i] = accel * convertAccel;
+        imuSample.omegas[i] = gyro * convertGyro * degToRad;
+    }
+
+    // The estimate needs the gyro as it was read
+    const bool windowDone = gyroBias.addSample(imuSample.omegas, temperature, stationary);
+    gyroBias.correct(imuSample.omegas, temperature);
 
     for (int i = 0; i < 3; i++) {
-        imuDataLock->accelerations[i] = motion[i] * convertAccel;
-        imuDataLock->omegas[i] = motion[i+3] * convertGyro * degToRad;
+        imuData.accelerations[i] = imuSample.accelerations[i];
+        imuData.omegas[i] = imuSample.omegas[i];
     }
-}
\ No newline at end of file
+    return windowDone;
+}
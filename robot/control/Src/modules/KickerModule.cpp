@@ -2,24 +2,29 @@
 
 #include "mtrain.hpp"
 #include "iodefs.h"
+#include "Logger.hpp"
 
-KickerModule::KickerModule(LockedStruct<SPI>& spi,
+KickerModule::KickerModule(SPIBusManager& spiBus,
                            LockedStruct<KickerCommand>& kickerCommand,
                            LockedStruct<KickerInfo>& kickerInfo)
     : GenericModule(kPeriod, "kicker", kPriority),
       kickerCommand(kickerCommand), kickerInfo(kickerInfo),
-      prevKickTime(0), nCs(std::make_shared<DigitalOut>(KICKER_CS)), kicker(spi, nCs, KICKER_RST) {
+      prevKickTime(0), nCs(std::make_shared<DigitalOut>(KICKER_CS)), kicker(spiBus, nCs, KICKER_RST) {
     auto kickerInfoLock = kickerInfo.unsafe_value();
     kickerInfoLock->isValid = false;
     kickerInfoLock->lastUpdate = 0;
     kickerInfoLock->kickerHasError = false;
     kickerInfoLock->kickerCharged = false;
     kickerInfoLock->ballSenseTriggered = false;
+    kickerInfoLock->voltage = 0;
+    kickerInfoLock->faults = 0;
 }
 
 void KickerModule::start() {
     bool initialized = kicker.flash(false, true);
-    printf("INFO: Kicker initialized\r\n");
+    // Firmware that doesn't speak the current protocol gets v1 commands
+    kicker.checkProtocolVersion();
+    LOG_INFO("Kicker initialized");
     {
         kickerInfo.lock()->initialized = initialized;
     }
@@ -71,8 +76,10 @@ void KickerModule::entry(void) {
         auto kickerInfoLock = kickerInfo.lock();
         kickerInfoLock->isValid = true;
         kickerInfoLock->lastUpdate = HAL_GetTick();
-        kickerInfoLock->kickerHasError = kicker.isHealthy();
+        kickerInfoLock->kickerHasError = !kicker.isHealthy();
         kickerInfoLock->ballSenseTriggered = kicker.isBallSensed();
         kickerInfoLock->kickerCharged = kicker.isCharged();
+        kickerInfoLock->voltage = kicker.getVoltage();
+        kickerInfoLock->faults = kicker.getFaults();
     }
 }
@@ -1,8 +1,9 @@
 #include "modules/LEDModule.hpp"
 #include "iodefs.h"
+#include "Logger.hpp"
 
 LEDModule::LEDModule(LockedStruct<MCP23017>& ioExpander,
-                     LockedStruct<SPI>& sharedSPI,
+                     SPIBusManager& spiBus,
                      LockedStruct<BatteryVoltage>& batteryVoltage,
                      LockedStruct<FPGAStatus>& fpgaStatus,
                      LockedStruct<KickerInfo>& kickerInfo,
@@ -13,11 +14,12 @@ LEDModule::LEDModule(LockedStruct<MCP23017>& ioExpander,
       kickerInfo(kickerInfo), radioError(radioError),
       imuData(imuData),
       ioExpander(ioExpander),
-      dotStarSPI(sharedSPI),
-      dotStarNCS(DOT_STAR_CS),
+      spiBus(spiBus),
+      dotStar(spiBus.addDevice({"dotstar", kDotStarFrequency,
+                                std::make_shared<DigitalOut>(DOT_STAR_CS), 0, 0})),
       leds({LED1, LED2, LED3, LED4}),
       missedSuperLoopToggle(false), missedModuleRunToggle(false) {
-    dotStarNCS.write(true);
+    lowPowerPeriod = kLowPowerPeriod;
 }
 
 void LEDModule::start() {
@@ -34,8 +36,10 @@ extern std::vector<const char*> failed_modules;
 extern size_t free_space;
 
 void LEDModule::entry() {
-    for (const char* c : failed_modules) {
-        printf("[ERROR] Module failed to initialize: %s (initial heap size: %d)\r\n", c, free_space);
+    // Only report each failure once, the set can't change after startup
+    for (; reportedFailedModules < failed_modules.size(); reportedFailedModules++) {
+        LOG_ERROR("Module failed to initialize: %s (initial heap size: %d)",
+                  failed_modules[reportedFailedModules], free_space);
     }
     // update battery, fpga, and radio status leds
     uint16_t errors = 0;
@@ -192,9 +196,7 @@ void LEDModule::setColor(uint32_t led0, uint32_t led1, uint32_t led2) {
     data.push_back(0xFF);
     data.push_back(0xFF);
 
-    dotStarNCS.write(false);
-    dotStarSPI.lock()->transmit(data);
-    dotStarNCS.write(true);
+    spiBus.acquire(dotStar)->transmit(data);
 }
 
 void LEDModule::displayErrors() {
@@ -0,0 +1,9 @@
+#include "modules/LoggingModule.hpp"
+#include "Logger.hpp"
+
+LoggingModule::LoggingModule()
+    : GenericModule(kPeriod, "logging", kPriority) {}
+
+void LoggingModule::entry() {
+    Logger::drain();
+}
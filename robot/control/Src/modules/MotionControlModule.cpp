@@ -62,8 +62,21 @@ void MotionControlModule::entry() {
         }
     }
 
-    if (imuDataLock->isValid && isRecentUpdate(imuDataLock->lastUpdate)) {
-        measurements(4, 0) = 0.0; // imuDataLock->omegas[2]; // Z gyro
+    // An uncalibrated gyro's bias would read as the robot turning
+    if (imuDataLock->isValid && imuDataLock->gyroCalibrated &&
+        isRecentUpdate(imuDataLock->lastUpdate)) {
+        // Average every gyro sample since the last update, so the gyro
+        // isn't aliased down to our rate
+        float omegaZ = imuDataLock->omegas[2];
+        if (imuDataLock->numSamples > 0) {
+            omegaZ = 0.0f;
+            for (int i = 0; i < imuDataLock->numSamples; i++) {
+                omegaZ += imuDataLock->samples[i].omegas[2];
+            }
+            omegaZ /= imuDataLock->numSamples;
+            imuDataLock->numSamples = 0;
+        }
+        measurements(4, 0) = omegaZ; // Z gyro
     }
 
     // Update targets
@@ -102,6 +115,10 @@ void MotionControlModule::entry() {
     Eigen::Matrix<float, 3, 1> currentState;
     robotEstimator.getState(currentState);
 
+    // A stale reading falls back to the nominal bus voltage
+    BatteryVoltage battery = batteryVoltageLock.value();
+    battery.isValid = battery.isValid && isRecentUpdate(battery.lastUpdate);
+
     // Run controllers
     uint8_t dribblerCommand = 0;
     dribblerController.calculate(motionCommandLock->dribbler, dribblerCommand);
@@ -109,7 +126,7 @@ void MotionControlModule::entry() {
     Eigen::Matrix<float, 4, 1> targetWheels;
     Eigen::Matrix<float, 4, 1> motorCommands;
 
-    robotController.calculateBody(currentState, targetState, targetWheels);
+    robotController.calculateBody(currentState, targetState, battery, targetWheels);
     robotController.calculateWheel(currentWheels, targetWheels, motorCommands);
 
     prevCommand = motorCommands;
@@ -1,5 +1,6 @@
 #include "modules/RadioModule.hpp"
 #include "iodefs.h"
+#include "Logger.hpp"
 
 RadioModule::RadioModule(LockedStruct<BatteryVoltage>& batteryVoltage,
                          LockedStruct<FPGAStatus>& fpgaStatus,
@@ -42,7 +43,7 @@ RadioModule::RadioModule(LockedStruct<BatteryVoltage>& batteryVoltage,
 
 void RadioModule::start() {
     link.init();
-    printf("INFO: Radio initialized\r\n");
+    LOG_INFO("Radio initialized");
     radioError.lock()->initialized = link.isRadioInitialized();
 }
 
@@ -1,5 +1,6 @@
 #include "modules/RotaryDialModule.hpp"
 #include "iodefs.h"
+#include "Logger.hpp"
 
 RotaryDialModule::RotaryDialModule(LockedStruct<MCP23017>& ioExpander, LockedStruct<RobotID>& robotID)
     : GenericModule(kPeriod, "dial", kPriority), robotID(robotID), dial({
@@ -12,6 +13,8 @@ RotaryDialModule::RotaryDialModule(LockedStruct<MCP23017>& ioExpander, LockedStr
     robotLock->isValid = false;
     robotLock->lastUpdate = 0;
     robotLock->robotID = -1;
+
+    lowPowerPeriod = kLowPowerPeriod;
 }
 
 void RotaryDialModule::start() {
@@ -21,7 +24,9 @@ void RotaryDialModule::start() {
 void RotaryDialModule::entry(void) {
     int new_robot_id = dial.read();
 
-    printf("Rotary dial: %d\r\n", new_robot_id);
+    if (new_robot_id != last_robot_id) {
+        LOG_INFO("Rotary dial: %d", new_robot_id);
+    }
 
     auto robotIDLock = robotID.lock();
     if (last_robot_id == new_robot_id) {
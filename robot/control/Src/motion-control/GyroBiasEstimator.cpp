@@ -0,0 +1,104 @@
+#include "motion-control/GyroBiasEstimator.hpp"
+
+#include <algorithm>
+
+GyroBiasEstimator::GyroBiasEstimator()
+    : calibration{{0, 0, 0}, {0, 0, 0}, 0},
+      calibrated(false),
+      fitWeight(0), fitTemperature(0), fitTemperatureSquared(0),
+      fitBias{0, 0, 0}, fitTemperatureBias{0, 0, 0} {
+    resetWindow();
+}
+
+void GyroBiasEstimator::setCalibration(const Calibration& newCalibration) {
+    fitWeight = 0;
+    fitTemperature = 0;
+    fitTemperatureSquared = 0;
+    std::fill_n(fitBias, 3, 0.0f);
+    std::fill_n(fitTemperatureBias, 3, 0.0f);
+
+    // A single point has no slope, the saved drift is kept until the
+    // windows cover enough temperatures
+    calibration = newCalibration;
+    addWindow(newCalibration.bias, newCalibration.temperature);
+    calibrated = true;
+}
+
+bool GyroBiasEstimator::addSample(const float omegas[3], float temperature, bool stationary) {
+    if (!stationary) {
+        resetWindow();
+        return false;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        windowSum[i] += omegas[i];
+        windowMin[i] = std::min(windowMin[i], omegas[i]);
+        windowMax[i] = std::max(windowMax[i], omegas[i]);
+        if (windowMax[i] - windowMin[i] > kMaxWindowSpread) {
+            resetWindow();
+            return false;
+        }
+    }
+    windowTemperatureSum += temperature;
+
+    if (++windowCount < kWindowSamples) {
+        return false;
+    }
+
+    float bias[3];
+    for (int i = 0; i < 3; i++) {
+        bias[i] = windowSum[i] / windowCount;
+    }
+    addWindow(bias, windowTemperatureSum / windowCount);
+    calibrated = true;
+
+    resetWindow();
+    return true;
+}
+
+void GyroBiasEstimator::correct(float omegas[3], float temperature) const {
+    if (!calibrated) {
+        return;
+    }
+
+    for (int i = 0; i < 3; i++) {
+        omegas[i] -= calibration.bias[i] + calibration.drift[i] * (temperature - calibration.temperature);
+    }
+}
+
+void GyroBiasEstimator::resetWindow() {
+    windowCount = 0;
+    windowTemperatureSum = 0;
+    for (int i = 0; i < 3; i++) {
+        windowSum[i] = 0;
+        windowMin[i] = 1e9f;
+        windowMax[i] = -1e9f;
+    }
+}
+
+void GyroBiasEstimator::addWindow(const float bias[3], float temperature) {
+    // Around room temperature so the squares keep their precision
+    const float t = temperature - kFitOrigin;
+
+    fitWeight = kForgetting * fitWeight + 1;
+    fitTemperature = kForgetting * fitTemperature + t;
+    fitTemperatureSquared = kForgetting * fitTemperatureSquared + t * t;
+
+    const float meanT = fitTemperature / fitWeight;
+    const float temperatureVariance = fitTemperatureSquared / fitWeight - meanT * meanT;
+
+    // The line goes through the weighted mean, so that's where the bias
+    // is kept
+    calibration.temperature = meanT + kFitOrigin;
+    for (int i = 0; i < 3; i++) {
+        fitBias[i] = kForgetting * fitBias[i] + bias[i];
+        fitTemperatureBias[i] = kForgetting * fitTemperatureBias[i] + t * bias[i];
+
+        const float meanBias = fitBias[i] / fitWeight;
+        calibration.bias[i] = meanBias;
+        if (temperatureVariance >= kMinTemperatureVariance) {
+            calibration.drift[i] = (fitTemperatureBias[i] / fitWeight - meanT * meanBias) /
+                                   temperatureVariance;
+        }
+    }
+}
@@ -15,18 +15,29 @@ constexpr float kRobotRadius = 0.0794;
 constexpr float kCurrentPerTorque = 1.0 / 25.1e-3;
 constexpr float kPhaseResistance = 0.464;
 
-// Hacks because the full "correct" voltages end up creating a
-// horrifically oscillatory system.
-// TODO(Kyle): Figure out why these aren't just 1.
-constexpr float kBackEmfDamping = 0.7;
-constexpr float kVoltageDamping = 0.14;
+constexpr float kGearRatio = 3.0;
+
+// Scale the ideal resistive and back-emf voltages onto what the motors
+// actually need. Fit with util/motor-sysid.py from wheel traces
+// recorded over the debug channel; rerun it after drivetrain changes.
+constexpr float kResistiveVoltageGain = 0.14;
+constexpr float kBackEmfVoltageGain = 0.7;
+
+/**
+ * Back-emf volts per wheel rad/s, from the duty cycle model at its nominal bus voltage
+ */
+float back_emf_per_speed() {
+    return RobotModel::get().SpeedToDutyCycle / 512.0 * RobotController::nominalBusVoltage;
+}
 
-void apply_wheel_force(const Eigen::Matrix<float, 4, 1> force, const Eigen::Matrix<float, 4, 1> speeds, Eigen::Matrix<float, 4, 1>& outputs) {
+void apply_wheel_force(const Eigen::Matrix<float, 4, 1> force, const Eigen::Matrix<float, 4, 1> speeds,
+                       float busVoltage, Eigen::Matrix<float, 4, 1>& outputs) {
     for (int i = 0; i < 4; i++) {
-        float torque = force(i) * RobotModel::get().WheelRadius / 3.0;
-        float voltage = torque * kCurrentPerTorque * kPhaseResistance / 24.0;
-        float back_emf = (float) speeds(i) * RobotModel::get().SpeedToDutyCycle / 512.0;
-        outputs(i, 0) = kVoltageDamping * voltage + kBackEmfDamping * back_emf;
+        float torque = force(i) * RobotModel::get().WheelRadius / kGearRatio;
+        float resistive_voltage = torque * kCurrentPerTorque * kPhaseResistance;
+        float back_emf_voltage = speeds(i) * back_emf_per_speed();
+        float voltage = kResistiveVoltageGain * resistive_voltage + kBackEmfVoltageGain * back_emf_voltage;
+        outputs(i, 0) = voltage / busVoltage;
     }
 }
 
@@ -68,7 +79,10 @@ RobotController::RobotController(uint32_t dt_us)
 
 void RobotController::calculateBody(Eigen::Matrix<float, numStates, 1> pv,
                                     Eigen::Matrix<float, numStates, 1> sp,
+                                    const BatteryVoltage& battery,
                                     Eigen::Matrix<float, numWheels, 1>& outputs) {
+    const float busVoltage = busVoltageFrom(battery);
+
     // Limit sideways velocity to <= 6m/s
     if (std::abs(sp(0)) > 6.0) {
         sp(0) = std::signbit(sp(0)) * 6.0;
@@ -83,7 +97,7 @@ void RobotController::calculateBody(Eigen::Matrix<float, numStates, 1> pv,
     Eigen::Matrix<float, numStates, 1> robot_force = Eigen::Matrix<float, 3, 1>(kRobotMassX, kRobotMassY, 30 * kRobotMassH * kRobotRadius).cwiseProduct(linear_accel);
     Eigen::Matrix<float, numWheels, 1> wheel_force = G * robot_force;
 
-    apply_wheel_force(wheel_force, G * pv, outputs);
+    apply_wheel_force(wheel_force, G * pv, busVoltage, outputs);
 
     // Debug variables
     // [0, 3) body acceleration
@@ -98,6 +112,8 @@ void RobotController::calculateBody(Eigen::Matrix<float, numStates, 1> pv,
     debugInfo.val[6] = pv(0,0) * 1000;
     debugInfo.val[7] = pv(1,0) * 1000;
     debugInfo.val[8] = pv(2,0) * 1000;
+    // [9] bus voltage the outputs were computed for (mV)
+    debugInfo.val[9] = busVoltage * 1000;
     // [10, 14) output voltagess
     debugInfo.val[10] = outputs(0, 0) * 1000;
     debugInfo.val[11] = outputs(1, 0) * 1000;
@@ -108,10 +124,23 @@ void RobotController::calculateBody(Eigen::Matrix<float, numStates, 1> pv,
 void RobotController::calculateWheel(Eigen::Matrix<float, numWheels, 1> pv,
                                      Eigen::Matrix<float, numWheels, 1> sp,
                                      Eigen::Matrix<float, numWheels, 1>& outputs) {
+    // [14, 18) measured wheel speeds (rad/s * 100) for system identification
+    debugInfo.val[14] = pv(0, 0) * 100;
+    debugInfo.val[15] = pv(1, 0) * 100;
+    debugInfo.val[16] = pv(2, 0) * 100;
+    debugInfo.val[17] = pv(3, 0) * 100;
+
     outputs = sp;
     return;
 }
 
+float RobotController::busVoltageFrom(const BatteryVoltage& battery) {
+    if (battery.isValid && battery.voltage >= minBusVoltage && battery.voltage <= maxBusVoltage) {
+        return battery.voltage;
+    }
+    return nominalBusVoltage;
+}
+
 bool RobotController::limitBodyAccel(const Eigen::Matrix<float, numStates, 1> finalTarget,
                                      Eigen::Matrix<float, numStates, 1>& dampened) {
     Eigen::Vector3f accel(maxForwardAccel, maxSideAccel, maxAngularAccel);
@@ -0,0 +1,168 @@
+#include "mtrain.hpp"
+#include "FreeRTOSConfig.h"
+#include "FreeRTOS.h"
+#include "task.h"
+
+/**
+ * Tickless idle for the mTrain
+ *
+ * Replaces the port's default `vPortSuppressTicksAndSleep` when the kernel
+ * is built with `configUSE_TICKLESS_IDLE 2`. When every task is blocked the
+ * SysTick is reprogrammed to fire at the next task deadline (the next 200 Hz
+ * motion iteration at the latest) and the core sits in WFI until then, instead
+ * of the idle task spinning through every 1 ms tick.
+ *
+ * The window where SysTick is stopped is measured with the DWT cycle counter
+ * and subtracted from the reload, rather than using a fixed compensation
+ * constant, so no time is lost across sleeps and module periods don't drift.
+ *
+ * The kernel is prebuilt in the mTrain package and FreeRTOSConfig.h comes
+ * with it, so whether the kernel ever calls this is decided there, not in
+ * this tree. This file is only built with the TICKLESS_IDLE CMake option,
+ * and then refuses to build against a config that would leave it unused.
+ */
+#if !defined(configUSE_TICKLESS_IDLE) || configUSE_TICKLESS_IDLE != 2
+#error "TICKLESS_IDLE needs an mTrain FreeRTOSConfig.h with configUSE_TICKLESS_IDLE set to 2, configure with -DTICKLESS_IDLE=OFF to build without it"
+#endif
+
+namespace {
+
+// SysTick is clocked from the core clock
+constexpr uint32_t kCyclesPerTick = configCPU_CLOCK_HZ / configTICK_RATE_HZ;
+constexpr uint32_t kMaxSuppressedTicks = SysTick_LOAD_RELOAD_Msk / kCyclesPerTick;
+
+/**
+ * Cycles between reading DWT and SysTick actually restarting
+ */
+constexpr uint32_t kRestartOverhead = 8;
+
+/**
+ * Start the DWT cycle counter if nothing has yet, it only counts once
+ * trace is enabled in the debug block
+ */
+inline void enableCycleCounter() {
+    if ((DWT->CTRL & DWT_CTRL_CYCCNTENA_Msk) == 0) {
+        CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+        DWT->CYCCNT = 0;
+        DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    }
+}
+
+/**
+ * Restart SysTick so it next fires after `cycles`, less the time it has
+ * been stopped for
+ *
+ * @return Number of cycles SysTick was stopped for
+ */
+inline uint32_t restartSysTick(uint32_t cycles, uint32_t stoppedAt) {
+    const uint32_t stopped = DWT->CYCCNT - stoppedAt + kRestartOverhead;
+    if (cycles > stopped + 1) {
+        cycles -= stopped;
+    } else {
+        cycles = 1;
+    }
+
+    SysTick->LOAD = cycles - 1;
+    SysTick->VAL = 0;
+    SysTick->CTRL |= SysTick_CTRL_ENABLE_Msk;
+
+    return stopped;
+}
+
+/**
+ * Stop SysTick without reading CTRL first, reading it clears COUNTFLAG
+ *
+ * @return Whether SysTick reached zero since it was last started
+ */
+inline bool stopSysTick() {
+    SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk | SysTick_CTRL_TICKINT_Msk;
+    return (SysTick->CTRL & SysTick_CTRL_COUNTFLAG_Msk) != 0;
+}
+
+/**
+ * Advance the HAL millisecond tick by the ticks that were skipped,
+ * everything stamping `lastUpdate` with HAL_GetTick() relies on it
+ */
+inline void stepHalTick(uint32_t ticks) {
+    for (uint32_t i = 0; i < ticks; i++) {
+        HAL_IncTick();
+    }
+}
+
+}  // namespace
+
+extern "C" void vPortSuppressTicksAndSleep(TickType_t expectedIdleTime) {
+    // Before the first sleep reads it, and again if a debugger turned it off
+    enableCycleCounter();
+
+    if (expectedIdleTime > kMaxSuppressedTicks) {
+        expectedIdleTime = kMaxSuppressedTicks;
+    }
+
+    // Stop SysTick, the remainder of the current tick is left in VAL
+    stopSysTick();
+    const uint32_t stoppedAt = DWT->CYCCNT;
+    const uint32_t remaining = (SysTick->VAL != 0) ? SysTick->VAL : kCyclesPerTick;
+
+    __disable_irq();
+    __DSB();
+    __ISB();
+
+    // A task may have been readied by an interrupt since the scheduler
+    // decided to sleep
+    if (eTaskConfirmSleepModeStatus() == eAbortSleep) {
+        restartSysTick(remaining, stoppedAt);
+        SysTick->LOAD = kCyclesPerTick - 1;
+        __enable_irq();
+        return;
+    }
+
+    const uint32_t sleepCycles = remaining + kCyclesPerTick * (expectedIdleTime - 1);
+    const uint32_t stopped = restartSysTick(sleepCycles, stoppedAt);
+    const uint32_t programmedLoad = SysTick->LOAD;
+
+    __DSB();
+    __WFI();
+    __ISB();
+
+    // Let whatever woke us run, then take control of the timer again
+    __enable_irq();
+    __DSB();
+    __ISB();
+    __disable_irq();
+    __DSB();
+    __ISB();
+
+    const bool sleptFully = stopSysTick();
+    const uint32_t wokeAt = DWT->CYCCNT;
+    const uint32_t counterValue = SysTick->VAL;
+
+    uint32_t completedTicks;
+    uint32_t nextTickCycles;
+    if (sleptFully) {
+        // The tick interrupt is pending and will account for the last
+        // tick, start the next one with whatever is left of it
+        completedTicks = expectedIdleTime - 1;
+        nextTickCycles = kCyclesPerTick - (programmedLoad - counterValue);
+        if (nextTickCycles == 0 || nextTickCycles > kCyclesPerTick) {
+            nextTickCycles = kCyclesPerTick;
+        }
+    } else {
+        // Woken early by another interrupt, count the whole ticks since
+        // the last tick boundary before we went to sleep
+        const uint32_t slept = stopped + (programmedLoad + 1 - counterValue);
+        const uint32_t sinceBoundary = slept + (kCyclesPerTick - remaining);
+        completedTicks = sinceBoundary / kCyclesPerTick;
+        nextTickCycles = kCyclesPerTick - (sinceBoundary % kCyclesPerTick);
+    }
+
+    restartSysTick(nextTickCycles, wokeAt);
+
+    vTaskStepTick(completedTicks);
+    stepHalTick(completedTicks);
+
+    // SysTick has reloaded the partial tick by now, later ticks are full length
+    SysTick->LOAD = kCyclesPerTick - 1;
+
+    __enable_irq();
+}
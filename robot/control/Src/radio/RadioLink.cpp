@@ -42,7 +42,7 @@ void RadioLink::send(const BatteryVoltage& batteryVoltage,
     status->motorErrors     = motorErrors;
     status->ballSenseStatus = static_cast<uint8_t>(kickerInfo.ballSenseTriggered);
     status->kickStatus      = static_cast<uint8_t>(kickerInfo.kickerCharged);
-    status->kickHealthy     = static_cast<uint8_t>(kickerInfo.kickerHasError);
+    status->kickHealthy     = static_cast<uint8_t>(!kickerInfo.kickerHasError);
     status->fpgaStatus      = static_cast<uint8_t>(fpgaStatus.FPGAHasError);
 
     for (int i = 0; i < 18; i++)
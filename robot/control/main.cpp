@@ -11,19 +11,24 @@
 #include "DigitalOut.hpp"
 
 #include <unistd.h>
+#include <algorithm>
+#include <atomic>
 
 #include "MicroPackets.hpp"
 #include "iodefs.h"
 
 #include "modules/BatteryModule.hpp"
 #include "modules/FPGAModule.hpp"
+#include "modules/I2CBusModule.hpp"
 #include "modules/IMUModule.hpp"
 #include "modules/KickerModule.hpp"
 #include "modules/LEDModule.hpp"
 #include "modules/MotionControlModule.hpp"
 #include "modules/RadioModule.hpp"
 #include "modules/RotaryDialModule.hpp"
+#include "modules/LoggingModule.hpp"
 #include "LockedStruct.hpp"
+#include "Logger.hpp"
 
 #define SUPER_LOOP_FREQ 200
 #define SUPER_LOOP_PERIOD (1000000L / SUPER_LOOP_FREQ)
@@ -64,20 +69,61 @@ struct MODULE_META_DATA {
 
 static std::vector<GenericModule *> moduleList;
 
+// Number of modules that have finished start()
+static std::atomic<size_t> readyModules{0};
+
+/**
+ * Logs when every module was waiting on its dependencies and starting, so
+ * whatever is holding up boot stands out. Called once by the last module
+ * to finish start().
+ */
+void logBootTimeline() {
+    LOG_INFO("Boot timeline (ms since scheduler start):");
+    TickType_t bootDone = 0;
+    for (GenericModule *module : moduleList) {
+        // start() runs from when the wait ends
+        LOG_INFO("  %-8s waited %5lu - %5lu, start() until %5lu",
+                 module->name,
+                 static_cast<unsigned long>(module->taskStartTick),
+                 static_cast<unsigned long>(module->dependenciesReadyTick),
+                 static_cast<unsigned long>(module->readyTick));
+        bootDone = std::max(bootDone, module->readyTick);
+    }
+    LOG_INFO("All modules ready at %lu ms", static_cast<unsigned long>(bootDone));
+}
+
 [[noreturn]]
 void startModule(void *pvModule) {
     GenericModule *module = static_cast<GenericModule *>(pvModule);
+    module->taskStartTick = xTaskGetTickCount();
+
+    // Dependencies are only checked at boot, so polling is fine
+    if (!module->dependenciesReady()) {
+        LOG_INFO("Module %s waiting on its dependencies", module->name);
+        while (!module->dependenciesReady()) {
+            vTaskDelay(1);
+        }
+    }
+    module->dependenciesReadyTick = xTaskGetTickCount();
 
-    printf("[INFO] Starting module %s\r\n", module->name);
+    LOG_INFO("Starting module %s", module->name);
     module->start();
-    printf("[INFO] Finished starting module %s\r\n", module->name);
+    module->readyTick = xTaskGetTickCount();
+    module->ready = true;
+    LOG_INFO("Finished starting module %s in %lu ms", module->name,
+             static_cast<unsigned long>(module->readyTick - module->dependenciesReadyTick));
+
+    if (++readyModules == moduleList.size()) {
+        logBootTimeline();
+    }
 
     TickType_t last_wait_time = xTaskGetTickCount();
-    TickType_t increment = module->period.count();
 
     while (true) {
         module->entry();
-        vTaskDelayUntil(&last_wait_time, increment);
+
+        // Re-read every iteration so the power profile can change the rate
+        vTaskDelayUntil(&last_wait_time, module->currentPeriod().count());
     }
 }
 
@@ -92,13 +138,21 @@ void createModule(GenericModule *module) {
                                     module->priority,
                                     &(module->handle));
     if (result != pdPASS) {
-        printf("[ERROR] Failed to initialize task %s for reason %x:\r\n", module->name, module->stackSize);
+        LOG_ERROR("Failed to initialize task %s for reason %x:", module->name, module->stackSize);
         failed_modules.push_back(module->name);
     } else {
-        printf("[INFO] Initialized task %s.\r\n", module->name);
+        LOG_INFO("Initialized task %s.", module->name);
+        moduleList.push_back(module);
     }
 }
 
+void setLowPowerMode(bool enabled) {
+    for (GenericModule *module : moduleList) {
+        module->lowPower = enabled;
+    }
+    LOG_WARN("Power profile: %s", enabled ? "low power" : "normal");
+}
+
 LockedStruct<DebugInfo> debugInfo;
 
 [[noreturn]]
@@ -107,6 +161,8 @@ int main() {
     static LockedStruct<I2C> sharedI2C(SHARED_I2C_BUS);
     static std::unique_ptr<SPI> fpgaSPI = std::make_unique<SPI>(FPGA_SPI_BUS, std::nullopt, 16'000'000);
     static LockedStruct<SPI> sharedSPI(SHARED_SPI_BUS, std::nullopt, 100'000);
+    // Sets each device's clock and chip select as it takes the bus
+    static SPIBusManager spiBus(sharedSPI);
 
     static LockedStruct<MotionCommand> motionCommand{};
     static LockedStruct<MotorCommand> motorCommand{};
@@ -119,15 +175,22 @@ int main() {
     static LockedStruct<KickerCommand> kickerCommand{};
     static LockedStruct<KickerInfo> kickerInfo{};
 
-    static LockedStruct<MCP23017> ioExpander(MCP23017{sharedI2C, 0x42});
+    // Every I2C transaction runs from the bus task, which has to be up
+    // before the modules using the bus start
+    static I2CBusManager i2cBus(sharedI2C);
+    static I2CBusModule i2c(i2cBus);
+    createModule(&i2c);
+
+    static LockedStruct<MCP23017> ioExpander(MCP23017{i2cBus, 0x42});
 
     static LEDModule led(ioExpander,
-                         sharedSPI,
+                         spiBus,
                          batteryVoltage,
                          fpgaStatus,
                          kickerInfo,
                          radioError,
                          imuData);
+    led.dependsOn(i2c);
     createModule(&led);
 
     static FPGAModule fpga(std::move(fpgaSPI),
@@ -145,7 +208,7 @@ int main() {
                              radioError);
     createModule(&radio);
 
-    static KickerModule kicker(sharedSPI,
+    static KickerModule kicker(spiBus,
                                kickerCommand,
                                kickerInfo);
     createModule(&kicker);
@@ -155,21 +218,36 @@ int main() {
 
     static RotaryDialModule dial(ioExpander,
                                  robotID);
+    dial.dependsOn(i2c);
     createModule(&dial);
 
+    static IMUModule imu(i2cBus,
+                         motorFeedback,
+                         imuData);
+    imu.dependsOn(i2c);
+    createModule(&imu);
+
     static MotionControlModule motion(batteryVoltage,
                                       imuData,
                                       motionCommand,
                                       motorFeedback,
                                       motorCommand);
+    // The motion loop needs encoder feedback, so it only has to wait for
+    // the FPGA, not the radio or kicker
+    motion.dependsOn(fpga);
     createModule(&motion);
 
+    static LoggingModule logging;
+    createModule(&logging);
+
     ////////////////////////////////////////////
 
-    printf("Starting scheduler...\r\n");
+    LOG_INFO("Starting scheduler...");
 
     vTaskStartScheduler();
 
+    // Nothing is left to drain the log queue, flush it here
+    Logger::drain();
     printf("Failed to start scheduler!\r\n");
 
     for (;;) {}
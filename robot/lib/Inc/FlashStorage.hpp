@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Keeps a small record in the last sector of the mTrain's internal flash,
+ * so it lasts across boots
+ *
+ * Every save is appended after the last one and loading takes the newest
+ * with a good CRC, so a save that was cut off just leaves the previous one.
+ * The sector is only erased once it's full. Erasing stalls every flash
+ * read, which is every instruction fetch, for over a second, so only save
+ * while nothing needs to run on time.
+ *
+ * The sector is reserved by flash_storage.ld, which fails the link if the
+ * firmware image runs into it. It has to be one whole sector with the flash
+ * in single bank mode, otherwise nothing is loaded or saved. A mass erase
+ * clears it.
+ */
+class FlashStorage {
+public:
+    /**
+     * @param magic Identifies the record, a new layout needs a new magic
+     *        so an old record isn't read as the new one
+     * @param size Record size in bytes, at most 256
+     */
+    FlashStorage(uint32_t magic, size_t size);
+
+    /**
+     * Finds the newest record, at boot
+     *
+     * @param data Filled with the record, `size` bytes
+     * @return Whether there was a record
+     */
+    bool load(void* data);
+
+    /**
+     * Appends a record, erasing the sector first if it's full
+     *
+     * Call load() first, until then there's no sector to write to.
+     *
+     * @param data `size` bytes
+     * @return Whether it was written
+     */
+    bool save(const void* data);
+
+private:
+    struct Header {
+        uint32_t magic;
+        uint32_t size;
+        uint32_t crc;
+    };
+
+    static uint32_t crc32(const uint8_t* data, size_t length);
+
+    /**
+     * Header and data, rounded up to the word flash is programmed in
+     */
+    size_t recordSize() const { return (sizeof(Header) + size + 3) & ~static_cast<size_t>(3); }
+
+    uint32_t magic;
+    size_t size;
+
+    /**
+     * Flash sector number, found by load()
+     */
+    uint32_t sector;
+
+    /**
+     * Where the next record goes, found by load()
+     */
+    uint32_t nextRecord;
+};
@@ -0,0 +1,147 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+#include <type_traits>
+
+/**
+ * Log levels, lowest to highest severity
+ *
+ * Anything below `LOG_LEVEL` is removed at compile time, including the
+ * evaluation of its arguments. Override from the build with
+ * `-DLOG_LEVEL=LOG_LEVEL_DEBUG` to get verbose driver output back.
+ */
+#define LOG_LEVEL_DEBUG  0
+#define LOG_LEVEL_INFO   1
+#define LOG_LEVEL_WARN   2
+#define LOG_LEVEL_ERROR  3
+#define LOG_LEVEL_SEVERE 4
+#define LOG_LEVEL_NONE   5
+
+#ifndef LOG_LEVEL
+#define LOG_LEVEL LOG_LEVEL_INFO
+#endif
+
+#define LOG_DISCARD(...) do {} while (0)
+
+#if LOG_LEVEL <= LOG_LEVEL_DEBUG
+#define LOG_DEBUG(fmt, ...) Logger::log(LOG_LEVEL_DEBUG, fmt, ##__VA_ARGS__)
+#else
+#define LOG_DEBUG(...) LOG_DISCARD()
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_INFO
+#define LOG_INFO(fmt, ...) Logger::log(LOG_LEVEL_INFO, fmt, ##__VA_ARGS__)
+#else
+#define LOG_INFO(...) LOG_DISCARD()
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_WARN
+#define LOG_WARN(fmt, ...) Logger::log(LOG_LEVEL_WARN, fmt, ##__VA_ARGS__)
+#else
+#define LOG_WARN(...) LOG_DISCARD()
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_ERROR
+#define LOG_ERROR(fmt, ...) Logger::log(LOG_LEVEL_ERROR, fmt, ##__VA_ARGS__)
+#else
+#define LOG_ERROR(...) LOG_DISCARD()
+#endif
+
+#if LOG_LEVEL <= LOG_LEVEL_SEVERE
+#define LOG_SEVERE(fmt, ...) Logger::log(LOG_LEVEL_SEVERE, fmt, ##__VA_ARGS__)
+#else
+#define LOG_SEVERE(...) LOG_DISCARD()
+#endif
+
+/**
+ * Deferred binary logger
+ *
+ * Call sites never format or touch stdout. They copy the address of the
+ * format string (which lives in flash and doubles as the message ID) and
+ * up to `kMaxArgs` raw 32 bit arguments into a lock-free ring buffer.
+ * A low priority task calls `drain()` to do the formatting and the
+ * blocking write to USB/UART.
+ *
+ * Pushing is safe from any task or interrupt. If the ring is full the
+ * message is dropped and counted, the drain reports how many were lost.
+ *
+ * Restrictions compared to printf:
+ *  - At most `kMaxArgs` arguments, each 32 bits or smaller (or a float/double)
+ *  - `%s` arguments must point to storage that outlives the message
+ *    (string literals, module names), the pointer is stored, not the text
+ *  - Messages should not include a trailing newline, one is added on output
+ */
+namespace Logger {
+
+/**
+ * Maximum number of arguments carried per message
+ */
+constexpr size_t kMaxArgs = 4;
+
+/**
+ * Number of messages that can be queued before new ones are dropped
+ *
+ * Must be a power of two
+ */
+constexpr size_t kQueueSize = 64;
+
+/**
+ * One raw argument, the conversion in the format string decides how
+ * it is read back
+ */
+union Arg {
+    int32_t i;
+    uint32_t u;
+    float f;
+    const void* p;
+
+    Arg() : u(0) {}
+
+    template <typename T, typename std::enable_if<std::is_integral<T>::value || std::is_enum<T>::value, int>::type = 0>
+    Arg(T val) {
+        static_assert(sizeof(T) <= sizeof(uint32_t), "Logger: integer arguments are limited to 32 bits");
+        if (std::is_signed<T>::value) {
+            i = static_cast<int32_t>(val);
+        } else {
+            u = static_cast<uint32_t>(val);
+        }
+    }
+
+    Arg(float val) : f(val) {}
+    Arg(double val) : f(static_cast<float>(val)) {}
+    Arg(const void* val) : p(val) {}
+};
+
+/**
+ * Queue a message without formatting it
+ *
+ * @param level One of the LOG_LEVEL_* values
+ * @param fmt printf style format string with static storage duration
+ * @param args Raw argument values
+ * @param numArgs Number of values in `args`
+ */
+void push(uint8_t level, const char* fmt, const Arg* args, size_t numArgs);
+
+template <typename... Args>
+inline void log(uint8_t level, const char* fmt, Args... args) {
+    static_assert(sizeof...(Args) <= kMaxArgs, "Logger: too many arguments for one message");
+    const Arg packed[sizeof...(Args) + 1] = {Arg(args)...};
+    push(level, fmt, packed, sizeof...(Args));
+}
+
+/**
+ * Format and write every queued message to stdout
+ *
+ * Must only be called from a single task
+ *
+ * @return Number of messages written
+ */
+size_t drain();
+
+/**
+ * @return Number of messages dropped because the queue was full
+ */
+uint32_t droppedCount();
+
+}  // namespace Logger
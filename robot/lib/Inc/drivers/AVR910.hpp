@@ -41,7 +41,8 @@
 #include "mtrain.hpp"
 #include "SPI.hpp"
 #include "DigitalOut.hpp"
-#include "LockedStruct.hpp"
+#include "drivers/SPIBusManager.hpp"
+#include <cstdio>
 #include <memory>
 
 // AVR SPI Commands
@@ -70,12 +71,12 @@ public:
     /**
      * Constructor.
      *
-     * @param spi SPI bus being used for this device
+     * @param spiBus SPI bus being used for this device
      * @param nCs Chip select pin on mtrain
      * @param nReset mtrain pin for not reset line on the ISP interface.
      *
      */
-    AVR910(LockedStruct<SPI>& spi, std::shared_ptr<DigitalOut> nCs, PinName nReset);
+    AVR910(SPIBusManager& spiBus, std::shared_ptr<DigitalOut> nCs, PinName nReset);
 
     /**
      * Sends an enable programming command, allowing device registers to be
@@ -152,33 +153,58 @@ public:
     int readPartNumber();
 
 protected:
-    void writeFuseBitsLow();
+    /**
+     * Read the low fuse byte, a programmed bit reads 0
+     */
+    int readFuseBitsLow();
+
+    /**
+     * Write the low fuse byte. Clock settings take effect from the next
+     * reset.
+     *
+     * @return false if the chip never finished the write
+     */
+    bool writeFuseBitsLow(uint8_t fuses);
+
+    /**
+     * Read the high fuse byte, a programmed bit reads 0
+     */
+    int readFuseBitsHigh();
+
+    /**
+     * Write the high fuse byte. Only EESAVE takes effect before leaving
+     * programming mode.
+     *
+     * @return false if the chip never finished the write
+     */
+    bool writeFuseBitsHigh(uint8_t fuses);
 
     int readRegister(int reg);
 
     /**
      * Check the binary has been written correctly.
      *
-     * @param numPages The number of pages written to the AVR microcontroller.
      * @param pageSize The size of a page in words
+     * @param numPages The number of pages to check, erased past the end of
+     *                 the binary
      * @param binary File pointer to the binary used.
      *
      * @return boolean indicating success
      */
-    bool checkMemory(int numPages, int pageSize, FILE* binary,
+    bool checkMemory(int pageSize, int numPages, FILE* binary,
                      bool verbose = false);
 
     /**
      * Check the binary has been written correctly.
      *
-     * @param numPages The number of pages written to the AVR microcontroller.
      * @param pageSize The size of a page in words
+     * @param numPages The number of pages written to the AVR microcontroller.
      * @param binary Byte array pointer to the binary used
      * @param length Length of the binary byte array used
      *
      * @return boolean indicating success
      */
-    bool checkMemory(int numPages, int pageSize, const uint8_t* binary,
+    bool checkMemory(int pageSize, int numPages, const uint8_t* binary,
                      unsigned int length, bool verbose = false);
 
     /**
@@ -188,22 +214,53 @@ protected:
      */
     void exitProgramming();
 
-    LockedStruct<SPI>::Lock lock_spi() {
-        // Lock the SPI struct. If it's the first time it's been locked, we also
-        // need to set the frequency.
-        bool set_freq;
-        auto spi_lock = spi_.lock(&set_freq);
-        if (set_freq) {
-            spi_lock->frequency(100'000);
-        }
-        return spi_lock;
+    /**
+     * Takes the bus at the serial programming clock, with the chip selected
+     */
+    SPIBusManager::Transfer lock_spi() {
+        return spiBus_.acquire(ispDevice_);
     }
 
-    LockedStruct<SPI>& spi_;
-    std::shared_ptr<DigitalOut> nCs_;
+    /**
+     * Low fuse bits, programmed is 0. The kicker's ATtiny runs off its
+     * internal 8 MHz RC oscillator, divided down to 1 MHz while CKDIV8 is
+     * programmed.
+     */
+    static constexpr int FUSE_LOW_CKDIV8 = 1 << 7;
+    static constexpr int FUSE_LOW_CKSEL_MASK = 0x0F;
+    static constexpr int FUSE_LOW_CKSEL_RC_8MHZ = 0x02;
+
+    /**
+     * Serial programming SCK (Hz), under a quarter of a 1 MHz chip clock
+     * until the fuses show it's running at 8 MHz
+     */
+    static constexpr int ISP_SLOW_HZ = 100'000;
+    static constexpr int ISP_FAST_HZ = 1'000'000;
+
+    SPIBusManager& spiBus_;
+    SPIBusManager::DeviceId ispDevice_;
     DigitalOut nReset_;
 
 private:
+    /**
+     * Largest page loaded in one burst, in words
+     */
+    static constexpr int MAX_PAGE_WORDS = ATTINY_PAGESIZE;
+
+    /**
+     * Wait after taking nReset low before enabling programming (ms), at
+     * least 20
+     */
+    static constexpr uint32_t RESET_WAIT_MS = 21;
+
+    /**
+     * How long a write may stay busy before giving up on it (ms), a few
+     * times the datasheet's worst case
+     */
+    static constexpr uint32_t CHIP_ERASE_TIMEOUT_MS = 50;
+    static constexpr uint32_t PAGE_WRITE_TIMEOUT_MS = 25;
+    static constexpr uint32_t FUSE_WRITE_TIMEOUT_MS = 25;
+
     /**
      * Issue an enable programming command to the AVR microcontroller.
      *
@@ -211,24 +268,49 @@ private:
      */
     bool enableProgramming();
 
+    /**
+     * Ask the device whether it's still busy with a write or erase.
+     */
+    bool isBusy();
+
     /**
      * Poll the device until it has finished its current operation.
+     *
+     * @param timeoutMs How long to give it
+     *
+     * @return false if it was still busy after timeoutMs
      */
-    void poll(int high_low, char page_number, char page_offset);
+    bool poll(uint32_t timeoutMs);
 
     /**
-     * Issue a chip erase command to the AVR microcontroller.
+     * Issue a chip erase command to the AVR microcontroller and wait for it
+     * to finish.
+     *
+     * @return false if it never finished
      */
-    void chipErase();
+    bool chipErase();
 
     /**
-     * Load a byte into the memory page buffer.
+     * Load and write one page, skipping it if it's all erased bytes.
      *
-     * @param highLow Indicate whether the byte being loaded is a high or low
-     *                byte.
-     * @param data The data byte to load.
+     * @param pageNumber The page number to write to in flash memory.
+     * @param pageSize The size of a page in words
+     * @param data The page's bytes
+     * @param length How many, at most a page
+     *
+     * @return false if the write never finished
      */
-    void loadMemoryPage(int highLow, char address, char data);
+    bool writePage(int pageNumber, int pageSize, const uint8_t* data,
+                   unsigned int length);
+
+    /**
+     * Load bytes into the memory page buffer from its start, in one burst.
+     *
+     * @param pageSize The size of a page in words
+     * @param data The bytes to load, alternating low and high
+     * @param length How many, at most a page
+     */
+    void loadMemoryPage(int pageSize, const uint8_t* data, unsigned int length);
 
     /**
      * Write a byte into the flash memory.
@@ -241,21 +323,43 @@ private:
     void writeFlashMemoryByte(int highLow, int address, char data);
 
     /**
-     * Write the memory page buffer to flash memory.
+     * Write the memory page buffer to flash memory and wait for it to
+     * finish.
      *
      * @param pageNumber The page number to write to in flash memory.
+     * @param pageSize The size of a page in words
+     *
+     * @return false if it never finished
      */
-    void writeFlashMemoryPage(char pageNumber, char lc_offset, int lc_highLow);
+    bool writeFlashMemoryPage(int pageNumber, int pageSize);
 
     /**
-     * Read a byte from program memory.
+     * Read bytes from program memory, in one burst.
      *
-     * @param highLow Indicate whether the byte being read is a low or high
-     * byte.
-     * @param pageNumber The page number to read from.
-     * @param pageOffset Address of byte in the page.
+     * @param address Byte address to start at
+     * @param data Where to put them
+     * @param length How many to read
+     */
+    void readProgramMemory(unsigned int address, uint8_t* data, unsigned int length);
+
+    /**
+     * Compare program memory from `address` against `expected`.
      *
-     * @return The byte at the specified memory location.
+     * @param verbose Log every byte that differs rather than stopping at
+     *                the first
+     *
+     * @return true if they all match
+     */
+    bool checkBytes(unsigned int address, const uint8_t* expected,
+                    unsigned int length, bool verbose);
+
+    /**
+     * Log how long program() took since `start` (HAL ticks)
+     */
+    void logThroughput(unsigned int length, uint32_t start);
+
+    /**
+     * Load commands for a page, 4 bytes for each of its bytes
      */
-    char readProgramMemory(int highLow, char pageNumber, char pageOffset);
+    uint8_t pageCommands_[MAX_PAGE_WORDS * 2 * 4];
 };
@@ -2,24 +2,72 @@
 
 #include "cstdint"
 
+#include "mtrain.hpp"
+
 /** @class Battery
- * Interfaces with analog pin to get voltage-related data
+ * Interfaces with the battery sense divider to get voltage-related data
+ *
+ * ADC1 converts the divider continuously and DMA writes the samples into a
+ * circular buffer, so reading the battery never blocks or takes an interrupt.
+ * Each `update()` takes the median of the latest buffer to reject switching
+ * spikes from the motors, then low pass filters it.
  *
- * @note As of May 2020, this class does not currently work, as we have no analog_in driver to read pin
+ * Motor current makes the pack sag well below its resting voltage under
+ * acceleration, so state of charge and the critical threshold are based on
+ * a sag-compensated resting estimate that follows the voltage up quickly but
+ * down only slowly. A hard floor on the instantaneous voltage still trips
+ * critical if the pack collapses.
  */
 class Battery {
 public:
     Battery();
 
-    void update();             /**< Updates reading from analog pin*/
+    bool ok() const;           /**< Returns whether the ADC and DMA came up, nothing else is meaningful until they have */
+
+    void update();             /**< Filters the latest buffer of samples and updates the state of charge */
+
+    float getBattPercentage(); /**< Returns the last state of charge estimate (0-100) */
 
-    float getBattPercentage(); /**< Returns the last battery percentage read */
+    float getVoltage();        /**< Returns the filtered bus voltage (volts) */
 
     uint8_t getRaw();          /**< Returns battery voltage as a raw 8-bit integer */
 
     bool isBattCritical();     /**< Returns whether battery is critical (at or below 0%) */
 
+    /**
+     * Number of samples in the DMA circular buffer
+     *
+     * A multiple of 16 so the buffer fills whole 32 byte cache lines
+     */
+    static constexpr int kNumSamples = 32;
+
 private:
+    /**
+     * Battery sense input on the mTrain (PA3, ADC123_IN3)
+     */
+    static constexpr uint32_t kAdcChannel = ADC_CHANNEL_3;
+    static constexpr uint16_t kSensePin = GPIO_PIN_3;
+
+    /**
+     * Number of series cells in the pack
+     */
+    static constexpr int kNumCells = 5;
+
+    /**
+     * Divider ratio of the 68k and 10k ohm resistors between the battery and the ADC
+     */
+    static constexpr float kDividerRatio = (68.0f + 10.0f) / 10.0f;
+
+    /**
+     * ADC reference voltage (volts)
+     */
+    static constexpr float kAdcReference = 3.3f;
+
+    /**
+     * Full scale reading of the 12 bit ADC
+     */
+    static constexpr float kAdcFullScale = 4095.0f;
+
     /**
      * The maximum voltage the battery can safely hold
      *
@@ -35,7 +83,7 @@ private:
     * The minimum voltage the battery can safely hold
     *
     * Calculations:
-    *  - 5-cell lipo * 4.3 v per cell = 21.5 battery volts
+    *  - 5-cell lipo * 3.0 v per cell = 15.0 battery volts
     *  - 68k and 10k ohm voltage divider, analog in read voltage 1.923
     */
     const float MIN_SAFE_BATT_VOLTAGE_READ = 1.923;
@@ -46,11 +94,65 @@ private:
     const float BATT_VOLTAGE_READ_RANGE =
         (MAX_SAFE_BATT_VOLTAGE_READ - MIN_SAFE_BATT_VOLTAGE_READ);
 
-    // AnalogIn hasn't been implemented it yet so
-    // we couldn't actually do this the correct way
-    // - Joe Aug 2019
-    //AnalogIn battVoltageAIPin;
+    /**
+     * Resting cell voltage below which the battery is reported critical (volts per cell)
+     */
+    static constexpr float kCriticalCellVoltage = 3.4f;
+
+    /**
+     * Resting voltage the battery must recover above to clear critical (volts per cell)
+     */
+    static constexpr float kCriticalHysteresis = 0.1f;
+
+    /**
+     * Instantaneous cell voltage that trips critical regardless of load (volts per cell)
+     */
+    static constexpr float kAbsoluteMinCellVoltage = 3.0f;
+
+    /**
+     * IIR coefficient applied to each median reading
+     */
+    static constexpr float kFilterAlpha = 0.3f;
+
+    /**
+     * IIR coefficients for the resting estimate, quick to recover after
+     * a load is removed but slow to follow sag under load
+     */
+    static constexpr float kRestRiseAlpha = 0.2f;
+    static constexpr float kRestFallAlpha = 0.01f;
+
+    /**
+     * Converts a raw ADC reading to battery volts
+     */
+    static float adcToVoltage(float adc);
+
+    /**
+     * Resting per cell voltage to state of charge (0-100) from a lipo discharge curve
+     */
+    static float cellVoltageToPercentage(float cellVoltage);
+
+    /**
+     * Sets up the sense pin, ADC1 and DMA2 stream 0 and starts conversions
+     *
+     * @return Whether conversions were started
+     */
+    bool initAdc();
+
+    ADC_HandleTypeDef adcHandle;
+    DMA_HandleTypeDef dmaHandle;
+
+    /**
+     * Circular buffer written by DMA, aligned to a cache line so it can be
+     * invalidated without touching neighbouring data
+     */
+    alignas(32) volatile uint16_t samples[kNumSamples];
+
+    bool initialized;         /**< Whether conversions are running into `samples` */
+    bool hasReading;          /**< Whether the filters have been seeded */
+    bool critical;            /**< Latched critical state */
 
+    float filteredVoltage;    /**< Low passed bus voltage (volts) */
+    float restingVoltage;     /**< Sag-compensated resting voltage estimate (volts) */
     float lastReadPercentage; /**< Battery percentage on last read */
     uint8_t rawVoltage;       /**< Raw battery voltage (0-255) */
-};
\ No newline at end of file
+};
@@ -9,6 +9,59 @@
 #include "SPI.hpp"
 #include "DigitalIn.hpp"
 #include "DigitalOut.hpp"
+#include "pin_defs.h"
+
+/**
+ * Response to a `set_duty_get_all` transfer, laid out byte for byte as the
+ * FPGA clocks it out so the whole transfer is received straight into it
+ *
+ * The fields are kept as raw bytes (the FPGA mixes byte orders), use the
+ * accessors to decode them.
+ */
+struct FPGATelemetry {
+    uint8_t status;                 /**< Status byte, see `set_duty_get_enc` */
+    uint8_t enc_deltas[4][2];       /**< Drive motor encoder ticks since the last update, high byte first */
+    uint8_t watchdog_ticks[2];      /**< Watchdog ticks since the last update, high byte first */
+    uint8_t hall_counts[5];         /**< Hall transitions since the last update, dribbler last */
+    uint8_t gate_drv_status[5][2];  /**< DRV8303 status registers, low byte first */
+    uint8_t currents[5][2];         /**< Largest phase current in ADC lsb, high byte first */
+    uint8_t velocities[4][4];       /**< Drive motor encoder velocities, high byte first */
+    uint8_t sequence;               /**< Motor update count, wraps, one more than the last update's */
+
+    int16_t enc_delta(size_t motor) const {
+        return static_cast<int16_t>(enc_deltas[motor][0] << 8 | enc_deltas[motor][1]);
+    }
+
+    uint16_t dt_ticks() const {
+        return static_cast<uint16_t>(watchdog_ticks[0] << 8 | watchdog_ticks[1]);
+    }
+
+    /**
+     * Same layout as the halfwords from `FPGA::gate_drivers`
+     */
+    uint16_t gate_drv(size_t motor) const {
+        return static_cast<uint16_t>(gate_drv_status[motor][1] << 8 | gate_drv_status[motor][0]);
+    }
+
+    uint16_t current(size_t motor) const {
+        return static_cast<uint16_t>(currents[motor][0] << 8 | currents[motor][1]);
+    }
+
+    /**
+     * Encoder ticks per second in fixed point, see `ENC_VELOCITY_FRAC_BITS`
+     */
+    int32_t enc_velocity(size_t motor) const {
+        const uint8_t* v = velocities[motor];
+        return static_cast<int32_t>(static_cast<uint32_t>(v[0]) << 24 | v[1] << 16 | v[2] << 8 | v[3]);
+    }
+
+    /**
+     * Fractional bits of `enc_velocity`, VELOCITY_FRAC_WIDTH in robocup.v
+     */
+    static constexpr int ENC_VELOCITY_FRAC_BITS = 8;
+};
+
+static_assert(sizeof(FPGATelemetry) == 53, "FPGATelemetry must match the CMD_UPDATE_MTRS_ALL response in robocup.v");
 
 class FPGA { 
 public:
@@ -18,6 +71,9 @@ public:
     /**
      * Configure FPGA with the "fpga_bin.h" binary
      * Must be called to initialize the fpga
+     *
+     * Waits on the DONE pin's interrupt, so the FPGA is ready to use as soon
+     * as this returns
      * 
      * @return true if configured correctly, false if not
      * 
@@ -25,11 +81,39 @@ public:
      */
     bool configure();
 
+    /**
+     * Checks whether the FPGA is already running the design in "fpga_bin.h",
+     * like after a reset of the mTrain that didn't power cycle the FPGA
+     * If it is, the FPGA is ready without calling `configure`
+     *
+     * @return True if DONE is high and the FPGA reports the git hash of a
+     *         clean build that matches the one in "fpga_bin.h". Always false
+     *         while "fpga_bin.h" has no hash or a dirty one.
+     */
+    bool check_loaded();
+
     /**
      * @return True if initialized and configured
      */
     bool isReady();
 
+    /**
+     * Reads which version of robocup.v is loaded, done by `configure` and
+     * `check_loaded` once the FPGA is running
+     *
+     * @return DESIGN_VERSION in robocup.v, 0 for a design from before the
+     *         version register
+     */
+    uint8_t read_design_version();
+
+    /**
+     * Whether the loaded design is from before the version register, like
+     * the bitstream in "fpga_bin.h" until it's regenerated. It only takes
+     * 0x80 with 9 bit duty cycles and runs at a fixed PWM frequency, so the
+     * commands it doesn't have fall back to 0x80 where they can.
+     */
+    bool legacy_design() const { return _designVersion == 0; }
+
     /**
      * Sets the duty cycles and read the encoders for all motors
      * Also resets the watchdog on the fpga
@@ -66,6 +150,51 @@ public:
     uint8_t set_duty_get_enc(int16_t* duty_cycles, size_t size_dut,
                              int16_t* enc_deltas, size_t size_enc);
 
+    /**
+     * Same as `set_duty_get_enc`, but also reads the phase current of every
+     * motor in the same transfer
+     *
+     * @param currents 5 element array that will be changed to hold the
+     *                 largest phase current magnitude of each motor in ADC lsb,
+     *                 sampled at the same time as the encoders
+     *                 Element 1-4 are drive motors 1-4
+     *                 Element 5 is the dribbler motor
+     * @param size_cur Number of elements in this array
+     *
+     * @return Status byte, see `set_duty_get_enc`
+     *
+     * @note All three arrays must be 5 otherwise a array out of bounds condition
+     *       occurs
+     *
+     * @note A legacy design sends 0x80 instead, and the currents are 0
+     */
+    uint8_t set_duty_get_enc_cur(int16_t* duty_cycles, size_t size_dut,
+                                 int16_t* enc_deltas, size_t size_enc,
+                                 uint16_t* currents, size_t size_cur);
+
+    /**
+     * Sets the duty cycles and reads back all of the motor telemetry in a
+     * single transfer: encoder deltas, watchdog ticks, hall counts, gate
+     * driver status, phase currents and encoder velocities
+     * Also resets the watchdog on the fpga
+     *
+     * @param duty_cycles 5 element array specifying the duty cycle for
+     *                    the specific motor
+     *                    Element 1-4 are drive motors 1-4
+     *                    Element 5 is the dribbler motor
+     * @param size_dut Number of elements in the array
+     *
+     * @param telemetry Filled with the FPGA's response
+     *
+     * @return Status byte, see `set_duty_get_enc`
+     *
+     * @note A legacy design sends 0x80 instead. Only the encoder deltas
+     *       and watchdog ticks come back, the velocities are averaged over
+     *       the time since the last update and the rest is 0.
+     */
+    uint8_t set_duty_get_all(int16_t* duty_cycles, size_t size_dut,
+                             FPGATelemetry& telemetry);
+
     /**
      * Sets the duty cycles for all motors
      * Also reset the watchdog on the fpga
@@ -158,6 +287,26 @@ public:
      */
     uint8_t read_halls(uint8_t* halls, size_t size);
 
+    /**
+     * Sets the PWM carrier frequency of every motor
+     *
+     * The FPGA counts whole clock cycles per PWM period, so the frequency is
+     * rounded to the nearest one and limited to 9kHz - 72kHz. The duty cycle
+     * resolution doesn't depend on it, the FPGA dithers the on time across
+     * PWM periods.
+     *
+     * @param frequency PWM frequency in Hz, 18kHz after the FPGA is configured
+     *
+     * @return Status byte, see `set_duty_get_enc`, 0x7F without sending
+     *         anything if the design is legacy and can't change it
+     */
+    uint8_t set_pwm_frequency(uint32_t frequency);
+
+    /**
+     * @return The PWM carrier frequency the FPGA is running at in Hz
+     */
+    uint32_t read_pwm_frequency();
+
     /**
      * Enables or disables the motors on the fpga
      * The on->off or off->on toggle of motors resets the watchdog
@@ -219,6 +368,8 @@ public:
     /**
      * Sends the config over to the FPGA
      * It is assumed that the fpga has already initialized and the spi bus is cleared out
+     *
+     * The bitstream is decompressed as it's sent, see convert.py
      * 
      * @return True if the config send was successful
      */
@@ -235,14 +386,34 @@ public:
     void chip_deselect();
 
     static constexpr int FPGA_SPI_FREQ = 100'000;
-    static const int16_t MAX_DUTY_CYCLE = 511;
+    static constexpr uint32_t FPGA_CLK_FREQ = 18'432'000;
+
+    /**
+     * Duty cycle magnitude of 100%, duty cycles are sent to the FPGA as a sign
+     * and 13 bit magnitude
+     */
+    static const int16_t MAX_DUTY_CYCLE = 8191;
+
+    /**
+     * DESIGN_VERSION in robocup.v that this driver was written against
+     */
+    static constexpr uint8_t DESIGN_VERSION = 1;
 
 private:
+    /**
+     * Duty cycle in the format the loaded design takes
+     */
+    uint16_t duty_word(int16_t duty) const;
+
+    uint8_t set_duty_get_all_legacy(int16_t* duty_cycles, size_t size_dut,
+                                    FPGATelemetry& telemetry);
+
     bool _isInit = false;
+    uint8_t _designVersion = 0;
 
     std::unique_ptr<SPI> _spi_bus;
     DigitalOut _nCs;
     DigitalIn _initB;
-    DigitalIn _done;
+    pin_name _done;     // Also interrupts `configure`
     DigitalOut _progB;
 };
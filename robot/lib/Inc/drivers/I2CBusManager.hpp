@@ -0,0 +1,160 @@
+#pragma once
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "semphr.h"
+
+#include "I2C.hpp"
+#include "LockedStruct.hpp"
+
+#include <array>
+#include <cstdint>
+
+/**
+ * Runs every transaction on a shared I2C bus from the one task
+ *
+ * Devices queue transactions and carry on instead of holding the bus lock
+ * while they wait. The bus task runs them one at a time, always emptying
+ * the high priority queue before taking the next low priority one, so a
+ * slow device only ever holds up a fast one by the single transaction
+ * already on the bus.
+ *
+ * A finished transaction calls its callback, if it has one. Writes are
+ * copied in, so they can be fire and forget. Reads go straight into the
+ * caller's buffer, so read() waits for them.
+ */
+class I2CBusManager {
+public:
+    enum class Priority : uint8_t {
+        High = 0,
+        Low = 1
+    };
+
+    using DeviceId = uint8_t;
+
+    /**
+     * Called from the bus task once a transaction is done
+     */
+    using Callback = void (*)(void* context, bool success);
+
+    /**
+     * How a transaction went, for the devices that keep track of timeouts
+     */
+    struct Result {
+        bool success = false;
+        uint32_t busTime = 0;   /**< Time spent on the bus (microseconds) */
+    };
+
+    static constexpr size_t kMaxDevices = 4;
+
+    /**
+     * Transactions each priority can have waiting
+     */
+    static constexpr UBaseType_t kQueueLength = 8;
+
+    /**
+     * Longest write, a DMP memory chunk for the MPU6050
+     */
+    static constexpr uint8_t kMaxWriteLength = 16;
+
+    /**
+     * @param sharedI2C Bus the transactions run on, still locked for
+     *        each one so the bus recovery can take it
+     */
+    explicit I2CBusManager(LockedStruct<I2C>& sharedI2C);
+
+    /**
+     * Registers a device, before the scheduler starts
+     *
+     * @param name Shown in the stats, has to outlive the manager
+     * @param priority Queue every transaction of the device goes into
+     */
+    DeviceId addDevice(const char* name, Priority priority);
+
+    /**
+     * Queues a write without waiting for it, only for room in the queue
+     *
+     * @param address 8 bit address, as I2C takes it
+     * @return Whether it was queued, false if it's too long
+     */
+    bool write(DeviceId device, uint8_t address, uint8_t regAddr,
+               const uint8_t* data, uint8_t length,
+               Callback callback = nullptr, void* context = nullptr);
+
+    /**
+     * Queues a read and waits until it's done
+     *
+     * Only one task can be waiting on each device.
+     *
+     * @param address 8 bit address, as I2C takes it
+     */
+    Result read(DeviceId device, uint8_t address, uint8_t regAddr,
+                uint8_t* data, uint8_t length);
+
+    /**
+     * Queues a write and waits until it's done
+     */
+    Result writeAndWait(DeviceId device, uint8_t address, uint8_t regAddr,
+                        const uint8_t* data, uint8_t length);
+
+    /**
+     * Runs queued transactions, from the bus task
+     *
+     * @param wait Longest to wait for the first one (ticks)
+     */
+    void service(TickType_t wait);
+
+    /**
+     * Logs each device's latency and share of the bus since the last call,
+     * and starts counting again
+     */
+    void logStats();
+
+    LockedStruct<I2C>& i2c() { return sharedI2C; }
+
+private:
+    struct Transaction {
+        DeviceId device;
+        uint8_t address;
+        uint8_t regAddr;
+        bool isRead;
+        uint8_t length;
+        uint8_t* readData;
+        uint8_t writeData[kMaxWriteLength];
+        uint32_t submitted;             /**< DWT cycles */
+        Callback callback;
+        void* context;
+        Result* result;                 /**< Filled in, then the device's semaphore given */
+    };
+
+    struct Device {
+        const char* name;
+        Priority priority;
+        SemaphoreHandle_t done;
+
+        // Since the last logStats()
+        uint32_t transactions;
+        uint32_t failures;
+        uint32_t totalLatency;          /**< Submitted to done (microseconds) */
+        uint32_t maxLatency;
+        uint32_t busTime;               /**< Microseconds */
+    };
+
+    void submit(Transaction& transaction);
+    Result submitAndWait(Transaction& transaction);
+    void run(Transaction& transaction);
+
+    LockedStruct<I2C>& sharedI2C;
+
+    std::array<QueueHandle_t, 2> queues;
+
+    /**
+     * Given once per queued transaction, the bus task waits on it
+     */
+    SemaphoreHandle_t pending;
+
+    std::array<Device, kMaxDevices> devices{};
+    size_t numDevices = 0;
+
+    uint32_t statsStart = 0;            /**< HAL ticks */
+};
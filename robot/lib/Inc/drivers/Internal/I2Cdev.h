@@ -9,15 +9,81 @@
 #define I2Cdev_h
 
 #include "I2C.hpp"
-#include <memory>
+#include "LockedStruct.hpp"
+#include "drivers/I2CBusManager.hpp"
+#include <cstdint>
+#include <optional>
 
 
+/**
+ * Register access to one device on a shared I2C bus
+ *
+ * Transactions run through the bus manager and are waited on. A transaction
+ * that fails, by timing out or coming back short, recovers the bus, and a
+ * device that keeps failing is only retried occasionally so it can't stall
+ * the other devices.
+ */
 class I2Cdev {
-private:
-    std::shared_ptr<I2C> i2c;
-
 public:
-    I2Cdev(std::shared_ptr<I2C> sharedI2C) : i2c(sharedI2C) {}
+    /**
+     * SCL and SDA of the bus, driven as GPIOs to recover it
+     */
+    struct BusPins {
+        PinName scl;
+        PinName sda;
+    };
+
+    /**
+     * Transaction counts for this device
+     */
+    struct Stats {
+        uint32_t transactions = 0;
+        uint32_t timeouts = 0;      /**< Transactions that took too long or came back short */
+        uint32_t recoveries = 0;    /**< Times the bus was clocked out after a timeout */
+    };
+
+    /**
+     * Longest a transaction can take before it counts as a timeout
+     * (milliseconds). A 255 byte read at 100 kHz takes 23 ms.
+     */
+    static constexpr uint32_t kTransactionTimeout = 30;
+
+    /**
+     * Timeouts in a row before the device is considered offline
+     */
+    static constexpr uint32_t kMaxConsecutiveTimeouts = 3;
+
+    /**
+     * How often an offline device is tried again (milliseconds)
+     */
+    static constexpr uint32_t kOfflineRetryPeriod = 1000;
+
+    /**
+     * @param name Device name for the bus stats
+     * @param priority Queue the device's transactions go into
+     */
+    I2Cdev(I2CBusManager& i2cBus, const char* name, I2CBusManager::Priority priority)
+        : i2cBus(i2cBus), device(i2cBus.addDevice(name, priority)) {}
+
+    /**
+     * Enable the bus recovery after a timeout
+     *
+     * @param bus Bus whose I2C peripheral is reset afterwards, only
+     *            I2CBus1 can be recovered
+     * @param pins SCL and SDA of that bus
+     */
+    void setBusRecovery(I2CBus bus, BusPins pins) {
+        recoveryBus = bus;
+        recoveryPins = pins;
+    }
+
+    const Stats& getStats() const { return stats; }
+
+    /**
+     * @return Whether the device has stopped responding, transactions
+     *         fail without touching the bus until its next retry
+     */
+    bool isOffline() const { return consecutiveTimeouts >= kMaxConsecutiveTimeouts; }
 
     int8_t readBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum,
                    uint8_t* data, uint16_t timeout = I2Cdev::readTimeout());
@@ -54,6 +120,43 @@ public:
                     uint16_t* data);
 
     static uint16_t readTimeout(void);
+
+private:
+    /**
+     * @return Whether to run a transaction, false while the device is
+     *         offline and not due a retry
+     */
+    bool beginTransaction();
+
+    /**
+     * Counts a transaction, and recovers the bus if it failed
+     *
+     * @return Whether the transaction succeeded
+     */
+    bool endTransaction(const I2CBusManager::Result& result);
+
+    /**
+     * Clocks SCL up to 9 times, until a device holding SDA low lets go,
+     * sends a stop and resets the I2C peripheral's state, leaving the I2C
+     * driver in `i2cLock` as it was set up
+     */
+    void recoverBus(LockedStruct<I2C>::Lock& i2cLock);
+
+    /**
+     * @return Registers of the peripheral behind `bus`, nullptr if it
+     *         can't be recovered
+     */
+    static I2C_TypeDef* i2cPeripheral(I2CBus bus);
+
+    I2CBusManager& i2cBus;
+    I2CBusManager::DeviceId device;
+
+    std::optional<I2CBus> recoveryBus;
+    std::optional<BusPins> recoveryPins;
+
+    Stats stats;
+    uint32_t consecutiveTimeouts = 0;
+    uint32_t lastRetry = 0;
 };
 
 
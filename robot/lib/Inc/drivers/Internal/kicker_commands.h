@@ -1,15 +1,32 @@
 #pragma once
 
-// Kicker packet definition
+#include <stdint.h>
+
+// Kicker protocol v2
+//
+// Every transfer is framed by chip select. A frame of
+// KICKER_FRAME_LENGTH bytes is a command and status exchange, a single
+// byte is a read (see Reads below), anything else is ignored.
+//
+// Command frame, mtrain -> kicker
+// | version | flags | strength | sequence | 0 ... 0 | crc low | crc high |
+//
+// Status frame, kicker -> mtrain, sent at the same time a byte behind.
+// The first byte is a read reply (or 0), the status starts at
+// FRAME_STATUS_OFFSET.
+// | version | state | faults | voltage | accepted seq | fired seq |
+// | time low | time high | breakbeam time low | breakbeam time high |
+// | crc low | crc high |
+//
+// Both CRCs are kicker_crc_update() over everything before them.
+//
+// Command flags byte
 // |---------------------------------------|
 // | (7) | (6) (5) | (4) | (3) (2) (1) (0) |
-// |---------------------------------------| 
+// |---------------------------------------|
 //
 // Bits 0-3
-//  Power of kick
-//      0 - 15
-//      0 is min power
-//      15 is max power
+//  Unused, 0
 //
 // Bits 4
 //  Charge Allowed
@@ -19,6 +36,7 @@
 //
 // Bits 5-6
 //  Type of kick activation
+//      0b00 Keep the current one
 //      0b01 Kick on breakbeam
 //      0b10 Kick immediately
 //      0b11 Cancel all current kick commands
@@ -27,6 +45,11 @@
 //  Type of kick
 //      1 Chip
 //      0 Kick
+//
+// The activation is only acted on when the sequence differs from the last
+// frame's, so the same frame can be sent every cycle without kicking again.
+// The kicker reports the sequence it last accepted, and the sequence of
+// the command behind the last kick that actually fired.
 
 // Whether the kick should be a chip or kick
 #define TYPE_FIELD (1 << 7)
@@ -51,15 +74,146 @@
 // Allow the kicker to charge
 #define CHARGE_ALLOWED (1 << 4)
 
-// How powerful the kick should be
+// Power field of a single byte command, the read for a read command and
+// the kick power (0 - 15) for v1 firmware
 #define KICK_POWER_MASK (0x0F)
 
+/**
+ * Protocol v1
+ *
+ * Firmware from before the frames takes each single byte as a command of
+ * the flags above and the power, and answers every byte with its status,
+ * reads included.
+ */
+#define V1_BREAKBEAM_TRIPPED (1 << 7)
+#define V1_VOLTAGE_MASK (0x7F)
+#define V1_VOLTAGE_SCALE (2)    // To the same scale as v2's voltage
+
+/**
+ * Reads
+ *
+ * A single byte cancel without charge allowed and with a nonzero power,
+ * the power field says what to read. The value comes back as the first
+ * byte of the next transfer. They're the same as in protocol v1, so mtrain
+ * can check what it's talking to before sending it any frames.
+ */
+#define READ_COMMAND_MASK (TYPE_FIELD | CANCEL_KICK | CHARGE_ALLOWED)
+#define READ_COMMAND (TYPE_KICK | CANCEL_KICK)
+#define IS_READ_COMMAND(cmd) \
+    (((cmd) & READ_COMMAND_MASK) == READ_COMMAND && ((cmd) & KICK_POWER_MASK) != 0)
+
+// CRC of the whole flash, see kicker_crc_update()
+#define READ_FLASH_CRC_LOW (READ_COMMAND | 0x01)
+#define READ_FLASH_CRC_HIGH (READ_COMMAND | 0x02)
+
+// KICKER_PROTOCOL_VERSION, v1 firmware replies with its status
+#define READ_PROTOCOL_VERSION (READ_COMMAND | 0x03)
+
+// CPU cycles from the breakbeam edge to the FET turning on for the last
+// kick on breakbeam, saturating at 0xFFFF. Only firmware built with
+// KICKER_INSTRUMENT_LATENCY measures it, the rest reply 0.
+#define READ_KICK_LATENCY_LOW (READ_COMMAND | 0x04)
+#define READ_KICK_LATENCY_HIGH (READ_COMMAND | 0x05)
+
 
-// Whether the breakbeam is tripped (1) or not (0)
-#define BREAKBEAM_TRIPPED (1 << 7)
+#define KICKER_PROTOCOL_VERSION (2)
 
-// Voltage of the kicker
-#define VOLTAGE_MASK   (0x7F)
+#define KICKER_FRAME_LENGTH (13)
 
-// How much to multiple the voltage returned
-#define VOLTAGE_SCALE (2)
\ No newline at end of file
+// Command frame
+#define FRAME_CMD_VERSION   (0)
+#define FRAME_CMD_FLAGS     (1)
+#define FRAME_CMD_STRENGTH  (2)     // 0 - 255, chips are always full power, see Kick calibration
+#define FRAME_CMD_SEQUENCE  (3)
+#define FRAME_CMD_CRC       (11)
+
+// Status frame, offsets from FRAME_STATUS_OFFSET
+#define FRAME_STATUS_OFFSET             (1)
+#define FRAME_STATUS_VERSION            (0)
+#define FRAME_STATUS_STATE              (1)
+#define FRAME_STATUS_FAULTS             (2)
+#define FRAME_STATUS_VOLTAGE            (3)     // ADC, 0 - 255, roughly volts
+#define FRAME_STATUS_ACCEPTED_SEQUENCE  (4)
+#define FRAME_STATUS_FIRED_SEQUENCE     (5)
+#define FRAME_STATUS_TIME               (6)     // kicker ticks when the frame started
+#define FRAME_STATUS_BREAKBEAM_TIME     (8)     // kicker ticks when the ball was last sensed
+#define FRAME_STATUS_CRC                (10)
+#define FRAME_STATUS_LENGTH             (12)
+
+// Length of a kicker tick, 1024 CPU cycles at 8 MHz
+#define KICKER_TICK_US (128)
+
+// State bits
+#define STATE_BALL_SENSED       (1 << 0)
+#define STATE_CHARGING          (1 << 1)    // LT3751 charge enabled
+#define STATE_CHARGED           (1 << 2)    // Caps at the charge target
+#define STATE_KICKING           (1 << 3)    // Kick sequence running, including the recharge
+#define STATE_ARMED             (1 << 4)    // Waiting on the breakbeam to kick
+#define STATE_CHARGE_ALLOWED    (1 << 5)
+#define STATE_DEBUG_MODE        (1 << 6)    // Commands are ignored
+#define STATE_CALIBRATED        (1 << 7)    // Kick strength is a ball speed, see Kick calibration
+
+// Fault bits, each stays set until the frame that reports it
+#define FAULT_BAD_FRAME         (1 << 0)    // A command frame with a bad length, version or CRC
+#define FAULT_CHARGE_TIMEOUT    (1 << 1)    // Charging for too long without reaching the target
+#define FAULT_OVERVOLTAGE       (1 << 2)    // Caps above the safe maximum
+
+
+/**
+ * Kick calibration
+ *
+ * With a valid table in the kicker's EEPROM, a kick's strength is the ball
+ * speed to kick at in KICK_CAL_SPEED_STEP_MM_S, and the FET on time comes
+ * from the table for that speed and the cap voltage. Without one the on
+ * time is linear in the strength. kicker/calibrate.py fits the table from
+ * logged kicks.
+ *
+ * | version | on time [row][column] ... | crc low | crc high |
+ *
+ * On times are in kicker FET ticks of KICK_CAL_TICK_US. Row r is for a cap
+ * voltage of KICK_CAL_VOLTAGE_MIN + (r << KICK_CAL_VOLTAGE_SHIFT) ADC
+ * counts, column c for a strength of c << KICK_CAL_STRENGTH_SHIFT, the last
+ * one past 255 so every strength is between two. The CRC is
+ * kicker_crc_update() over everything before it.
+ */
+#define KICK_CAL_VERSION            (1)
+#define KICK_CAL_ADDRESS            (0)     // EEPROM address
+#define KICK_CAL_ROWS               (5)
+#define KICK_CAL_COLUMNS            (9)
+#define KICK_CAL_VOLTAGE_MIN        (176)
+#define KICK_CAL_VOLTAGE_SHIFT      (4)     // 16 ADC counts between rows
+#define KICK_CAL_STRENGTH_SHIFT     (5)     // 32 strength between columns
+#define KICK_CAL_SPEED_STEP_MM_S    (32)    // 255 is 8.16 m/s
+#define KICK_CAL_TICK_US            (250)
+
+#define KICK_CAL_TABLE              (1)
+#define KICK_CAL_CRC                (KICK_CAL_TABLE + KICK_CAL_ROWS * KICK_CAL_COLUMNS)
+#define KICK_CAL_LENGTH             (KICK_CAL_CRC + 2)
+
+
+// Initial value for kicker_crc_update()
+#define KICKER_CRC_INIT (0xFFFF)
+
+/**
+ * CRC-16/MCRF4XX, the same as _crc_ccitt_update() in avr-libc
+ *
+ * The kicker computes it over its entire flash when it boots, mtrain
+ * over the binary padded with erased (0xFF) bytes, so it can tell if
+ * the kicker needs to be programmed without reading it back.
+ */
+static inline uint16_t kicker_crc_update(uint16_t crc, uint8_t data) {
+    data ^= (uint8_t)crc;
+    data ^= (uint8_t)(data << 4);
+    return (uint16_t)((((uint16_t)data << 8) | (crc >> 8)) ^
+                      (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+/**
+ * CRC of a frame's first `length` bytes
+ */
+static inline uint16_t kicker_frame_crc(const uint8_t* data, uint8_t length) {
+    uint16_t crc = KICKER_CRC_INIT;
+    for (uint8_t i = 0; i < length; i++)
+        crc = kicker_crc_update(crc, data[i]);
+    return crc;
+}
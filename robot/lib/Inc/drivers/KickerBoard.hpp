@@ -5,7 +5,7 @@
 #include "Internal/kicker_commands.h"
 #include "SPI.hpp"
 #include "mtrain.hpp"
-#include "LockedStruct.hpp"
+#include "drivers/SPIBusManager.hpp"
 
 #include <string>
 
@@ -18,11 +18,11 @@ public:
     /**
      * Constructor for KickerBoard
      *
-     * @param spi A pointer to the shared spi bus
+     * @param spiBus The shared spi bus
      * @param nCs mtrain pin for not chip select for the kicker board
      * @param nReset mtrain pin for not reset line on the ISP interface.
      */
-    KickerBoard(LockedStruct<SPI>& spi, std::shared_ptr<DigitalOut> nCs, PinName nReset);
+    KickerBoard(SPIBusManager& spiBus, std::shared_ptr<DigitalOut> nCs, PinName nReset);
 
     /**
      * Reflashes the program on the kicker board MCU with the file
@@ -61,11 +61,22 @@ public:
      */
     void kickType(bool isKick);
 
+    /**
+     * Asks the kicker firmware which protocol it speaks. Frames are only
+     * sent once it's KICKER_PROTOCOL_VERSION, anything older would take
+     * every byte of one as a kick command. Otherwise it's driven with v1
+     * single byte commands, which any kicker firmware takes.
+     *
+     * @return Whether the kicker speaks KICKER_PROTOCOL_VERSION
+     */
+    bool checkProtocolVersion();
+
     /**
      * Sends the KickerBoard a command to kick for the allotted time in
      * in milliseconds. This roughly corresponds to kick strength.
      *
-     * @param Kicker strength, eventually gets mapped to duty cycle
+     * @param Kicker strength, a ball speed if isCalibrated(), otherwise
+     *        mapped linearly to FET on time
      */
     void kick(uint8_t strength);
 
@@ -74,7 +85,8 @@ public:
      * in milliseconds once the breakbeam triggers. This roughly corresponds
      * to kick strength.
      *
-     * @param Kicker strength, eventually gets mapped to duty cycle
+     * @param Kicker strength, a ball speed if isCalibrated(), otherwise
+     *        mapped linearly to FET on time
      */
     void kickOnBreakbeam(uint8_t strength);
 
@@ -105,16 +117,47 @@ public:
      */
     bool isCharged();
 
+    /**
+     * @return Whether the kicker has a kick calibration, so kick strengths
+     *         are ball speeds in KICK_CAL_SPEED_STEP_MM_S rather than FET
+     *         on times
+     */
+    bool isCalibrated();
+
+    /**
+     * @return How long ago the kicker last sensed the ball (us), by the
+     *         kicker's clock as of the last status
+     */
+    uint32_t getBallSensedAge();
+
+    /**
+     * @return Whether the kicker has taken the last kick, kick on
+     *         breakbeam or cancel, and fired the last kick if it was one
+     */
+    bool isKickDone();
+
+    /**
+     * @return FAULT_* bits from the last status
+     */
+    uint8_t getFaults();
+
     /**
      * Sets the charge pin (to high) and allows the caps to charge up to max voltage
      */
     void setChargeAllowed(bool chargeAllowed);
 
+    /**
+     * @return Whether the kicker speaks this protocol, its status frames
+     *         are getting through and it isn't reporting a charge fault.
+     *         On v1, whether it reports any voltage.
+     */
     bool isHealthy();
 
     /**
      * Must be called once an interation (~25hz) to communicate and update
      * the kicker
+     *
+     * Sends one command frame and reads back the status
      */
     void service();
 
@@ -130,12 +173,122 @@ protected:
                       bool verbose = false);
 
 private:
-    bool verbose;
+    /**
+     * Programs the EESAVE fuse if it isn't already, so the chip erase
+     * before programming leaves the kick calibration in EEPROM alone.
+     * Must be in programming mode.
+     */
+    void keepEeprom(bool verbose);
+
+    /**
+     * Unprograms the CKDIV8 fuse if it's programmed, so the kicker comes
+     * out of reset at 8 MHz and the next flash can run SCK at ISP_FAST_HZ.
+     * Must be in programming mode.
+     */
+    void undivideClock(bool verbose);
+
+    /**
+     * Computes the CRC the kicker reports for its flash if it was
+     * programmed with `binary`
+     */
+    static uint16_t binaryCrc(const uint8_t* binary, unsigned int length);
+
+    /**
+     * Asks the kicker firmware for the CRC of its flash
+     */
+    uint16_t readFlashCrc();
+
+    /**
+     * Asks the kicker how long its last kick on breakbeam took from the
+     * breakbeam edge to the FET turning on
+     *
+     * @return CPU cycles at 8 MHz, 0 unless the firmware was built with
+     *         KICKER_INSTRUMENT_LATENCY
+     */
+    uint16_t readKickLatency();
+
+    /**
+     * Takes the kicker out of reset and waits for it to report a flash
+     * CRC of `expected`
+     *
+     * @return False if it never did, because it's programmed with
+     *         something else or isn't running
+     */
+    bool checkFlashCrc(uint16_t expected);
+
+    /**
+     * Sends one command byte to the kicker firmware
+     *
+     * @return The byte the kicker sent back at the same time
+     */
+    uint8_t transfer(uint8_t command);
+
+    /**
+     * Sends a command frame, reading the status frame back at the same
+     * time, all under one chip select
+     */
+    void transferFrame(const uint8_t* command, uint8_t* reply);
+
+    /**
+     * service() for v1 firmware, one command byte that reads back the
+     * breakbeam and voltage
+     */
+    void serviceV1();
+
+    /**
+     * Checks a status frame and takes the state from it
+     *
+     * @return Whether it had the right version and CRC
+     */
+    bool parseStatus(const uint8_t* status);
+
+    static constexpr unsigned int FLASH_SIZE = ATTINY_PAGESIZE * 2 * ATTINY_NUM_PAGES;
+
+    // The kicker takes around 60 ms to boot and compute its CRC
+    static constexpr int FLASH_CRC_TRIES = 5;
+    static constexpr int FLASH_CRC_RETRY_MS = 50;
+
+    /**
+     * SCK for commands and frames (Hz). The kicker's SPI slave takes up to
+     * 2 MHz, but its interrupt has to read each byte before the next one
+     * lands, which this leaves it a byte and a gap to do.
+     */
+    static constexpr int FRAME_HZ = 500'000;
+
+    /**
+     * Chip select to the first clock and from the last one (us), at least
+     * 10 for the kicker's interrupt to see it
+     */
+    static constexpr uint32_t CS_SETUP_US = 50;
+    static constexpr uint32_t CS_HOLD_US = 50;
+
+    /**
+     * Gap between the bytes of a frame, for the kicker's SPI interrupt to
+     * load the next status byte (us)
+     */
+    static constexpr uint32_t FRAME_BYTE_GAP_US = 20;
+
+    /**
+     * Voltage above which a v1 kicker counts as charged, v1 doesn't say
+     */
+    static constexpr uint8_t V1_CHARGED_VOLTAGE = 230;
+
+    /**
+     * Bad status frames in a row before the kicker counts as unhealthy
+     */
+    static constexpr int MAX_BAD_FRAMES = 3;
 
     /**
-     * Voltage threshold for kicker board to be considered charged (voltage mapped to 0-255)
+     * ATtiny167 high fuse bits, programmed is 0
      */
-    const uint8_t isChargedCutoff = 230;
+    static constexpr int FUSE_HIGH_RSTDISBL = 1 << 7;
+    static constexpr int FUSE_HIGH_DWEN = 1 << 6;
+    static constexpr int FUSE_HIGH_SPIEN = 1 << 5;
+    static constexpr int FUSE_HIGH_EESAVE = 1 << 3;
+
+    SPIBusManager::DeviceId frameDevice_;
+
+    bool verbose;
 
     /**
      * Stores whether the breakbeam has been tripped
@@ -143,34 +296,65 @@ private:
     bool _ball_sensed = false;
 
     /**
-     * Stores whether Kicker is responding back with non-zero voltage values
+     * KICKER_PROTOCOL_VERSION or 1 for older firmware, from
+     * checkProtocolVersion(). Nothing is sent to the kicker while it's 0.
      */
-    bool _is_healthy = true;
+    uint8_t _protocol_version = 0;
 
     /**
-     * Current voltage stored in Kicker (volts)
+     * Status frames that failed their version or CRC in a row
      */
-    uint8_t _current_voltage = 0;
+    int _bad_frames = 0;
 
     /**
-     * Stores whether current maneuver is a kick (true) or a chip (false)
+     * STATE_* and FAULT_* bits from the last status
      */
-    bool _is_kick        = false;
+    uint8_t _state = 0;
+    uint8_t _faults = 0;
+
+    /**
+     * _state in the status before, to log the calibration changing
+     */
+    uint8_t _last_state = 0;
+
+    /**
+     * Kicker ticks between the ball last being sensed and the last status
+     */
+    uint16_t _ball_sensed_ticks = 0;
+
+    /**
+     * Sequence of the last kick, kick on breakbeam or cancel, and what the
+     * kicker last reported taking and firing
+     */
+    uint8_t _sequence = 0;
+    uint8_t _accepted_sequence = 0;
+    uint8_t _fired_sequence = 0;
+
+    /**
+     * _fired_sequence in the status before, to notice a kick firing
+     */
+    uint8_t _last_fired_sequence = 0;
+
+    /**
+     * Whether the last command fires a kick when the kicker takes it
+     */
+    bool _sequence_kicks = false;
 
     /**
-     * Stores whether kick is to be performed immediately
+     * Current voltage stored in Kicker (volts)
      */
-    bool _kick_immediate = false;
+    uint8_t _current_voltage = 0;
 
     /**
-     * Stores whether to kick when breakbeam is triggered
+     * Stores whether current maneuver is a kick (true) or a chip (false)
      */
-    bool _kick_breakbeam = false;
+    bool _is_kick        = false;
 
     /**
-     * Stores whether to cancel kick on breakbeam
+     * Kick activation of the last command, KICK_IMMEDIATE, KICK_ON_BREAKBEAM
+     * or CANCEL_KICK. Sent until the kicker takes it.
      */
-    bool _cancel_kick    = true;
+    uint8_t _activation  = CANCEL_KICK;
 
     /**
      * Stores whether the kicker board can safely charge the capacitors
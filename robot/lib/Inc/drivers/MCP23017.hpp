@@ -1,8 +1,7 @@
 #pragma once
 
 #include <memory>
-#include "I2C.hpp"
-#include "LockedStruct.hpp"
+#include "drivers/I2CBusManager.hpp"
 
 /**
  * Allow access to an I2C-connected MCP23017 16-bit I/O extender chip
@@ -46,7 +45,7 @@ public:
         PinB7 = 15
     } ExpPinName;
 
-    MCP23017(LockedStruct<I2C>& sharedI2C, int i2cAddress);
+    MCP23017(I2CBusManager& i2cBus, int i2cAddress);
 
     /**
      * Initialize the device.
@@ -118,7 +117,8 @@ public:
     void internalPullupMask(uint16_t mask);
 
 private:
-    LockedStruct<I2C>& _i2c;
+    I2CBusManager& _i2cBus;
+    I2CBusManager::DeviceId _device;
     int _i2cAddress;  // physical I2C address
 
     // Cached copies of the register values
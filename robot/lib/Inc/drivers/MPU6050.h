@@ -417,8 +417,13 @@ private:
     I2Cdev* i2Cdev;
 
 public:
-    MPU6050(std::shared_ptr<I2C> sharedI2C);
-    MPU6050(std::shared_ptr<I2C> sharedI2C, uint8_t address);
+    MPU6050(I2CBusManager& i2cBus);
+    MPU6050(I2CBusManager& i2cBus, uint8_t address);
+
+    /**
+     * The bus access, for its timeout stats and to set up bus recovery
+     */
+    I2Cdev& getI2Cdev() { return *i2Cdev; }
 
     void initialize();
     bool testConnection();
@@ -691,7 +696,7 @@ public:
     // FIFO_R_W register
     uint8_t getFIFOByte();
     void setFIFOByte(uint8_t data);
-    void getFIFOBytes(uint8_t* data, uint8_t length);
+    bool getFIFOBytes(uint8_t* data, uint8_t length);
 
     // WHO_AM_I register
     uint8_t getDeviceID();
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "DigitalOut.hpp"
+#include "LockedStruct.hpp"
+#include "SPI.hpp"
+
+#include <array>
+#include <cstdint>
+#include <memory>
+
+/**
+ * Shares one SPI bus between devices that each want their own clock and
+ * chip select
+ *
+ * Each device registers a profile. A transfer holds the bus lock for as
+ * long as it lives, sets the clock only when the device before it wanted a
+ * different one, and keeps the device's chip select asserted the whole
+ * time, so nothing else clocks the bus while it's selected.
+ *
+ * Unlike the I2C bus, transfers run in the caller's task: the kicker wants
+ * its reply straight away and nothing on the bus takes long enough to be
+ * worth queueing.
+ *
+ * Every device on the bus is mode 0, which is all the mTrain's SPI driver
+ * does, so a profile has no mode.
+ */
+class SPIBusManager {
+public:
+    using DeviceId = uint8_t;
+
+    struct Profile {
+        const char* name;                   /**< Shown in the stats, has to outlive the manager */
+        int frequency;                      /**< SCK (Hz), the fastest the device takes */
+        std::shared_ptr<DigitalOut> cs;     /**< Active low, nullptr if the device has none */
+        uint32_t setupUs;                   /**< Chip select to the first clock */
+        uint32_t holdUs;                    /**< Last clock to chip select released */
+    };
+
+    /**
+     * The bus for one device, until it goes out of scope
+     */
+    class Transfer {
+    public:
+        Transfer(const Transfer&) = delete;
+        Transfer& operator=(const Transfer&) = delete;
+
+        ~Transfer();
+
+        SPI* operator->() { return &lock.value(); }
+
+    private:
+        friend class SPIBusManager;
+
+        Transfer(SPIBusManager& bus, DeviceId device, bool select);
+
+        // In order, to time the wait for the lock
+        SPIBusManager& bus;
+        DeviceId device;
+        bool select;
+        uint32_t requested;                 /**< DWT cycles */
+        LockedStruct<SPI>::Lock lock;
+        uint32_t acquired;                  /**< DWT cycles */
+    };
+
+    static constexpr size_t kMaxDevices = 4;
+
+    /**
+     * How often the per device stats are logged, by whichever transfer
+     * ends after they're due (milliseconds)
+     */
+    static constexpr uint32_t kStatsPeriod = 10'000;
+
+    /**
+     * Waits for the bus longer than this count as contended (microseconds)
+     */
+    static constexpr uint32_t kContendedUs = 10;
+
+    /**
+     * @param sharedSPI Bus the devices share, only ever locked through the
+     *        manager from now on
+     */
+    explicit SPIBusManager(LockedStruct<SPI>& sharedSPI);
+
+    /**
+     * Registers a device and releases its chip select, before the
+     * scheduler starts
+     */
+    DeviceId addDevice(const Profile& profile);
+
+    /**
+     * Takes the bus for a device, with its clock set and, if `select`, its
+     * chip select asserted
+     */
+    Transfer acquire(DeviceId device, bool select = true) {
+        return Transfer(*this, device, select);
+    }
+
+    /**
+     * Changes the clock a device runs at from its next transfer, for one
+     * that only finds out how fast it can go once it's talking
+     */
+    void setFrequency(DeviceId device, int hz);
+
+    int frequency(DeviceId device) const { return devices[device].profile.frequency; }
+
+    /**
+     * Logs each device's waits for the bus and share of it since the last
+     * call, and starts counting again
+     */
+    void logStats();
+
+private:
+    struct Device {
+        Profile profile;
+
+        // Since the last logStats()
+        uint32_t transfers;
+        uint32_t contended;             /**< Transfers that waited over kContendedUs */
+        uint32_t totalWait;             /**< Microseconds */
+        uint32_t maxWait;
+        uint32_t busTime;               /**< Microseconds */
+        uint32_t clockChanges;
+    };
+
+    LockedStruct<SPI>& sharedSPI;
+
+    std::array<Device, kMaxDevices> devices{};
+    size_t numDevices = 0;
+
+    /**
+     * Clock the bus was last set to, 0 before the first transfer
+     */
+    int busFrequency = 0;
+
+    uint32_t statsStart = 0;            /**< HAL ticks */
+};
@@ -0,0 +1,164 @@
+#include "FlashStorage.hpp"
+#include "Logger.hpp"
+
+#include <cstring>
+
+#include "mtrain.hpp"
+
+// Reserved by flash_storage.ld
+extern "C" const uint8_t __flash_storage_start[];
+extern "C" const uint8_t __flash_storage_end[];
+
+namespace {
+// The STM32F769's 2 MB flash in single bank mode. Dual bank mode splits it
+// into 24 smaller sectors, numbered differently.
+constexpr uint32_t kFlashStart = 0x08000000;
+constexpr uint32_t kNumSectors = 12;
+
+constexpr uint32_t sectorSize(uint32_t sector) {
+    return sector < 4 ? 32 * 1024 : sector == 4 ? 128 * 1024 : 256 * 1024;
+}
+
+constexpr uint32_t sectorStart(uint32_t sector) {
+    uint32_t address = kFlashStart;
+    for (uint32_t i = 0; i < sector; i++) {
+        address += sectorSize(i);
+    }
+    return address;
+}
+
+static_assert(sectorStart(kNumSectors) == kFlashStart + 2 * 1024 * 1024,
+              "Flash sectors don't add up to 2 MB");
+static_assert(FLASH_SECTOR_11 == kNumSectors - 1,
+              "Flash sectors aren't numbered like the HAL's");
+
+const uint32_t kSectorStart = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(__flash_storage_start));
+const uint32_t kSectorEnd = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(__flash_storage_end));
+
+/**
+ * The sector the linker script reserved, kNumSectors if it isn't exactly
+ * one sector or the flash is in dual bank mode
+ */
+uint32_t reservedSector() {
+    if ((FLASH->OPTCR & FLASH_OPTCR_nDBANK) == 0) {
+        return kNumSectors;
+    }
+
+    for (uint32_t sector = 0; sector < kNumSectors; sector++) {
+        if (sectorStart(sector) == kSectorStart && sectorStart(sector + 1) == kSectorEnd) {
+            return sector;
+        }
+    }
+    return kNumSectors;
+}
+
+// Flash that's been erased and not written since
+constexpr uint32_t kErased = 0xFFFFFFFF;
+}
+
+FlashStorage::FlashStorage(uint32_t magic, size_t size)
+    : magic(magic), size(size), sector(kNumSectors), nextRecord(kSectorEnd) {}
+
+bool FlashStorage::load(void* data) {
+    sector = reservedSector();
+    if (sector == kNumSectors) {
+        LOG_ERROR("FlashStorage: 0x%08lx isn't a single bank flash sector", kSectorStart);
+        nextRecord = kSectorEnd;
+        return false;
+    }
+
+    bool found = false;
+    uint32_t address = kSectorStart;
+
+    while (address + sizeof(Header) <= kSectorEnd) {
+        Header header;
+        std::memcpy(&header, reinterpret_cast<const void*>(address), sizeof(header));
+        if (header.magic == kErased) {
+            break;
+        }
+
+        // Anything else would have been erased first, so treat it as full
+        if (header.magic != magic || header.size != size) {
+            address = kSectorEnd;
+            break;
+        }
+
+        const uint8_t* record = reinterpret_cast<const uint8_t*>(address + sizeof(Header));
+        if (address + recordSize() <= kSectorEnd && crc32(record, size) == header.crc) {
+            std::memcpy(data, record, size);
+            found = true;
+        }
+        address += recordSize();
+    }
+
+    nextRecord = address;
+    return found;
+}
+
+bool FlashStorage::save(const void* data) {
+    if (sector == kNumSectors) {
+        return false;
+    }
+
+    HAL_FLASH_Unlock();
+
+    if (nextRecord + recordSize() > kSectorEnd) {
+        FLASH_EraseInitTypeDef erase{};
+        erase.TypeErase = FLASH_TYPEERASE_SECTORS;
+        erase.Sector = sector;
+        erase.NbSectors = 1;
+        erase.VoltageRange = FLASH_VOLTAGE_RANGE_3;
+
+        uint32_t sectorError = 0;
+        if (HAL_FLASHEx_Erase(&erase, &sectorError) != HAL_OK) {
+            HAL_FLASH_Lock();
+            LOG_ERROR("FlashStorage: Erase failed");
+            return false;
+        }
+        nextRecord = kSectorStart;
+    }
+
+    uint32_t words[256 / 4] = {};
+    const size_t numWords = (recordSize() - sizeof(Header)) / 4;
+    if (numWords > sizeof(words) / sizeof(words[0])) {
+        HAL_FLASH_Lock();
+        return false;
+    }
+    std::memcpy(words, data, size);
+
+    // A record cut off part way fails its CRC, and load() steps over it
+    const Header header{magic, static_cast<uint32_t>(size),
+                        crc32(static_cast<const uint8_t*>(data), size)};
+    const uint32_t* headerWords = reinterpret_cast<const uint32_t*>(&header);
+
+    bool ok = true;
+    for (size_t i = 0; ok && i < sizeof(Header) / 4; i++) {
+        ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, nextRecord + 4 * i, headerWords[i]) == HAL_OK;
+    }
+
+    const uint32_t dataStart = nextRecord + sizeof(Header);
+    for (size_t i = 0; ok && i < numWords; i++) {
+        ok = HAL_FLASH_Program(FLASH_TYPEPROGRAM_WORD, dataStart + 4 * i, words[i]) == HAL_OK;
+    }
+
+    HAL_FLASH_Lock();
+
+    // Even a partly written record takes up its space
+    nextRecord += recordSize();
+
+    if (!ok) {
+        LOG_ERROR("FlashStorage: Programming failed");
+    }
+    return ok;
+}
+
+uint32_t FlashStorage::crc32(const uint8_t* data, size_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (size_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
@@ -0,0 +1,232 @@
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+
+#include "mtrain.hpp"
+
+namespace Logger {
+
+namespace {
+
+static_assert((kQueueSize & (kQueueSize - 1)) == 0, "Logger: queue size must be a power of two");
+
+struct Entry {
+    /**
+     * Sequence number used to hand slots between producers and the drain,
+     * see Vyukov's bounded MPMC queue
+     */
+    std::atomic<uint32_t> sequence;
+
+    const char* fmt;
+    uint32_t timestamp;
+    uint8_t level;
+    uint8_t numArgs;
+    Arg args[kMaxArgs];
+};
+
+Entry queue[kQueueSize];
+std::atomic<uint32_t> head{0};
+uint32_t tail = 0;
+std::atomic<uint32_t> dropped{0};
+uint32_t droppedReported = 0;
+bool initialized = false;
+
+constexpr size_t kLineLength = 160;
+
+const char* const levelNames[] = {"DEBUG", "INFO", "WARN", "ERROR", "SEVERE"};
+
+void initQueue() {
+    for (uint32_t i = 0; i < kQueueSize; i++) {
+        queue[i].sequence.store(i, std::memory_order_relaxed);
+    }
+    initialized = true;
+}
+
+bool isConversion(char c) {
+    return strchr("diouxXcsfFeEgGp%", c) != nullptr;
+}
+
+bool isLengthModifier(char c) {
+    return strchr("hlLqjzt", c) != nullptr;
+}
+
+/**
+ * Expand `fmt` one conversion at a time, reading each argument back
+ * with the type its conversion specifier asks for
+ */
+size_t format(char* out, size_t outLen, const char* fmt, const Arg* args, size_t numArgs) {
+    size_t len = 0;
+    size_t argIndex = 0;
+
+    while (*fmt != '\0' && len + 1 < outLen) {
+        if (*fmt != '%') {
+            out[len++] = *fmt++;
+            continue;
+        }
+
+        // Copy the flags, width and precision, skip length modifiers
+        // since every argument was stored as 32 bits
+        char spec[16];
+        size_t specLen = 0;
+        spec[specLen++] = *fmt++;
+        while (*fmt != '\0' && !isConversion(*fmt)) {
+            if (!isLengthModifier(*fmt) && specLen < sizeof(spec) - 2) {
+                spec[specLen++] = *fmt;
+            }
+            fmt++;
+        }
+
+        if (*fmt == '\0') {
+            break;
+        }
+
+        const char conversion = *fmt++;
+        spec[specLen++] = conversion;
+        spec[specLen] = '\0';
+
+        if (conversion == '%') {
+            out[len++] = '%';
+            continue;
+        }
+
+        const Arg arg = (argIndex < numArgs) ? args[argIndex] : Arg();
+        argIndex++;
+
+        char* dst = out + len;
+        const size_t remaining = outLen - len;
+        int written = 0;
+        switch (conversion) {
+            case 'd':
+            case 'i':
+            case 'c':
+                written = snprintf(dst, remaining, spec, static_cast<int>(arg.i));
+                break;
+            case 'o':
+            case 'u':
+            case 'x':
+            case 'X':
+                written = snprintf(dst, remaining, spec, static_cast<unsigned int>(arg.u));
+                break;
+            case 'f':
+            case 'F':
+            case 'e':
+            case 'E':
+            case 'g':
+            case 'G':
+                written = snprintf(dst, remaining, spec, static_cast<double>(arg.f));
+                break;
+            case 's':
+                written = snprintf(dst, remaining, spec,
+                                   arg.p ? static_cast<const char*>(arg.p) : "(null)");
+                break;
+            case 'p':
+                written = snprintf(dst, remaining, spec, arg.p);
+                break;
+            default:
+                break;
+        }
+
+        if (written > 0) {
+            len += std::min(static_cast<size_t>(written), remaining - 1);
+        }
+    }
+
+    out[len] = '\0';
+    return len;
+}
+
+}  // namespace
+
+void push(uint8_t level, const char* fmt, const Arg* args, size_t numArgs) {
+    if (!initialized) {
+        // Only reachable before the scheduler starts, so there is no
+        // other producer to race with
+        initQueue();
+    }
+
+    uint32_t pos = head.load(std::memory_order_relaxed);
+    Entry* entry;
+    while (true) {
+        entry = &queue[pos & (kQueueSize - 1)];
+        const uint32_t seq = entry->sequence.load(std::memory_order_acquire);
+        const int32_t diff = static_cast<int32_t>(seq - pos);
+
+        if (diff == 0) {
+            // Slot is free, try to claim it
+            if (head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Drain hasn't caught up, drop rather than block the caller
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        } else {
+            pos = head.load(std::memory_order_relaxed);
+        }
+    }
+
+    entry->fmt = fmt;
+    entry->timestamp = HAL_GetTick();
+    entry->level = level;
+    entry->numArgs = static_cast<uint8_t>(std::min(numArgs, kMaxArgs));
+    for (size_t i = 0; i < entry->numArgs; i++) {
+        entry->args[i] = args[i];
+    }
+
+    entry->sequence.store(pos + 1, std::memory_order_release);
+}
+
+size_t drain() {
+    if (!initialized) {
+        return 0;
+    }
+
+    char line[kLineLength];
+    size_t count = 0;
+
+    while (true) {
+        Entry& entry = queue[tail & (kQueueSize - 1)];
+        const uint32_t seq = entry.sequence.load(std::memory_order_acquire);
+
+        // Either empty or a producer has claimed the slot but not yet
+        // finished filling it, pick it up on the next drain
+        if (static_cast<int32_t>(seq - (tail + 1)) < 0) {
+            break;
+        }
+
+        int prefix = snprintf(line, sizeof(line), "[%s] (%lu) ",
+                              levelNames[std::min<size_t>(entry.level, LOG_LEVEL_SEVERE)],
+                              static_cast<unsigned long>(entry.timestamp));
+        prefix = std::max(0, std::min(prefix, static_cast<int>(sizeof(line)) - 1));
+        format(line + prefix, sizeof(line) - prefix, entry.fmt, entry.args, entry.numArgs);
+
+        // Release the slot before the slow write so producers can reuse it
+        entry.sequence.store(tail + kQueueSize, std::memory_order_release);
+        tail++;
+
+        printf("%s\r\n", line);
+        count++;
+    }
+
+    const uint32_t droppedNow = dropped.load(std::memory_order_relaxed);
+    if (droppedNow != droppedReported) {
+        printf("[WARN] Logger: dropped %lu messages\r\n",
+               static_cast<unsigned long>(droppedNow - droppedReported));
+        droppedReported = droppedNow;
+    }
+
+    if (count > 0) {
+        fflush(stdout);
+    }
+
+    return count;
+}
+
+uint32_t droppedCount() {
+    return dropped.load(std::memory_order_relaxed);
+}
+
+}  // namespace Logger
@@ -35,100 +35,102 @@
 
 #include "drivers/AVR910.hpp"
 #include "delay.h"
+#include "Logger.hpp"
+
+#include <algorithm>
 
 using namespace std;
 
-AVR910::AVR910(LockedStruct<SPI>& spi, std::shared_ptr<DigitalOut> nCs, PinName nReset)
-    : spi_(spi), nCs_(nCs), nReset_(nReset) {
+AVR910::AVR910(SPIBusManager& spiBus, std::shared_ptr<DigitalOut> nCs, PinName nReset)
+    : spiBus_(spiBus),
+      ispDevice_(spiBus.addDevice({"kicker ISP", ISP_SLOW_HZ, nCs, 0, 0})),
+      nReset_(nReset) {
 }
 
 bool AVR910::init() {
+    // Slow enough for a chip still dividing its clock down to 1 MHz, until
+    // the fuses say otherwise
+    spiBus_.setFrequency(ispDevice_, ISP_SLOW_HZ);
+
     int tryCnt = 0;
     bool enabled = false;
     do {
         // Give nReset a positive pulse for at least two CPU clock cycles
         nReset_ = 1;
-        vTaskDelay(100);
+        vTaskDelay(1);
         nReset_ = 0;
 
         // Wait at least 20 ms
-        vTaskDelay(100);
+        vTaskDelay(RESET_WAIT_MS);
 
         // Enable SPI Serial Programming
         // may not be synced so toggle and try again
         enabled = enableProgramming();
+        tryCnt++;
     } while (!enabled && tryCnt < 20);
 
     if (!enabled) {
-        printf(
-                "ERROR: AVR910 unable to enable programming mode for chip.  "
-                "Further commands will fail\r\n");
+        LOG_ERROR("AVR910: unable to enable programming mode for chip.  "
+                  "Further commands will fail");
+        return false;
+    }
+
+    // SCK has to stay under a quarter of the chip's clock, which the fuses
+    // picked as it came out of reset
+    const int fuses = readFuseBitsLow();
+    if ((fuses & FUSE_LOW_CKSEL_MASK) == FUSE_LOW_CKSEL_RC_8MHZ &&
+        (fuses & FUSE_LOW_CKDIV8)) {
+        spiBus_.setFrequency(ispDevice_, ISP_FAST_HZ);
     }
 
-    return enabled;
+    return true;
 }
 
 bool AVR910::program(FILE* binary, int pageSize, int numPages) {
+    const uint32_t start = HAL_GetTick();
+
     // Clear memory contents.
-    chipErase();
+    if (!chipErase()) {
+        exitProgramming();
+        return false;
+    }
 
-    char pageOffset = 0;
-    int pageNumber = 0;
+    int pages = 1;
+    unsigned int length = 0;
     int address = 0;
     int c = 0;
     int highLow = 0;
 
-    char lc_offset = 0xFF;
-    int lc_highlow = 0xFF;
-
     fseek(binary, 0, SEEK_SET);
     // We're dealing with paged memory.
     if (numPages > 1) {
-        while ((c = getc(binary)) != EOF) {
-            // Page is fully loaded, time to write it to flash.
-            if (pageOffset == (pageSize)) {
-                writeFlashMemoryPage(pageNumber, lc_offset, lc_highlow);
-                lc_offset = 0xFF;
-                lc_highlow = 0xFF;
-
-                pageNumber++;
-                if (pageNumber > numPages) {
-                    printf(
-                        "ERROR: AVR910 binary exceeds chip memory "
-                        "capacity\r\n");
-                    return false;
-                }
-                pageOffset = 0;
-            }
+        if (pageSize > MAX_PAGE_WORDS) {
+            LOG_ERROR("AVR910: pages of %d words are too big to load", pageSize);
+            exitProgramming();
+            return false;
+        }
 
-            if (lc_offset == 0xFF && c != 0xFF) {
-                lc_offset = pageOffset;
-                if (!highLow) {
-                    lc_highlow = READ_LOW_BYTE;
-                } else {
-                    lc_highlow = READ_HIGH_BYTE;
-                }
+        uint8_t page[MAX_PAGE_WORDS * 2];
+        size_t pageLength = 0;
+        for (pages = 0; (pageLength = fread(page, 1, pageSize * 2, binary)) > 0; pages++) {
+            if (pages == numPages) {
+                LOG_ERROR("AVR910: binary exceeds chip memory capacity");
+                exitProgramming();
+                return false;
             }
 
-            // Write low byte.
-            if (highLow == 0) {
-                loadMemoryPage(WRITE_LOW_BYTE, pageOffset, c);
-                highLow = 1;
-                // printf("Writing low\r\n");
+            if (!writePage(pages, pageSize, page, pageLength)) {
+                exitProgramming();
+                return false;
             }
-            // Write high byte.
-            else {
-                loadMemoryPage(WRITE_HIGH_BYTE, pageOffset, c);
-                highLow = 0;
-                pageOffset++;
-            }
-            // printf("PageNumber: %d\r\n", pageNumber);
+            length += pageLength;
         }
-
     } else {
         // We're dealing with non-paged memory.
 
         while ((c = getc(binary)) != EOF) {
+            length++;
+
             // Write low byte.
             if (highLow == 0) {
                 writeFlashMemoryByte(WRITE_LOW_FLASH_BYTE, address, c);
@@ -143,95 +145,63 @@ bool AVR910::program(FILE* binary, int pageSize, int numPages) {
                 // Therefore if we've gone beyond our size break because we
                 // don't have any more room.
                 if (address > pageSize) {
-                    printf(
-                        "ERROR: AVR910 binary exceeds chip memory "
-                        "capacity\r\n");
+                    LOG_ERROR("AVR910: binary exceeds chip memory capacity");
+                    exitProgramming();
                     return false;
                 }
             }
         }
     }
 
-    // We might have partially filled up a page.
-    writeFlashMemoryPage(pageNumber, lc_offset, lc_highlow);
-
-    bool success = checkMemory(pageSize, pageNumber + 1, binary, true);
+    bool success = checkMemory(pageSize, pages, binary, true);
 
     // Leave serial programming mode by toggling reset
     exitProgramming();
 
+    logThroughput(length, start);
     return success;
 }
 
 bool AVR910::program(const uint8_t* binary, unsigned int length, int pageSize, int numPages) {
+    const uint32_t start = HAL_GetTick();
+
     // Clear memory contents.
-    // should automatically be cleared
-    chipErase();
+    if (!chipErase()) {
+        exitProgramming();
+        return false;
+    }
 
-    char pageOffset = 0;
-    int pageNumber = 0;
+    int pages = 1;
     int address = 0;
-    int c = 0;
     int highLow = 0;
-    unsigned int binaryLoc = 0;
-
-    char lc_offset = 0xFF;
-    int lc_highlow = 0xFF;
 
     // We're dealing with paged memory.
     if (numPages > 1) {
-        while (binaryLoc < length) {
-            c = binary[binaryLoc];
-            binaryLoc++;
-
-            // Page is fully loaded, time to write it to flash.
-            // printf("page size: %d\r\n", pageSize);
-            // printf("page offset: %d\r\n", pageOffset);
-            if (pageOffset == (pageSize)) {
-                writeFlashMemoryPage(pageNumber, lc_offset, lc_highlow);
-                lc_offset = 0xFF;
-                lc_highlow = 0xFF;
-
-                pageNumber++;
-                if (pageNumber > numPages) {
-                    printf(
-                        "ERROR: AVR910 binary exceeds chip memory "
-                        "capacity\r\n");
-                    return false;
-                }
-                pageOffset = 0;
-            }
-
-            if (lc_offset == 0xFF && c != 0xFF) {
-                lc_offset = pageOffset;
-                if (highLow == 0) {
-                    lc_highlow = READ_LOW_BYTE;
-                } else {
-                    lc_highlow = READ_HIGH_BYTE;
-                }
-            }
+        const unsigned int pageBytes = pageSize * 2;
+        pages = (length + pageBytes - 1) / pageBytes;
+        if (pageSize > MAX_PAGE_WORDS) {
+            LOG_ERROR("AVR910: pages of %d words are too big to load", pageSize);
+            exitProgramming();
+            return false;
+        }
+        if (pages > numPages) {
+            LOG_ERROR("AVR910: binary exceeds chip memory capacity");
+            exitProgramming();
+            return false;
+        }
 
-            // Write low byte.
-            if (highLow == 0) {
-                loadMemoryPage(WRITE_LOW_BYTE, pageOffset, c);
-                highLow = 1;
-                // printf("Writing low\r\n");
-            }
-            // Write high byte.
-            else {
-                loadMemoryPage(WRITE_HIGH_BYTE, pageOffset, c);
-                highLow = 0;
-                pageOffset++;
-                // printf("Writing high\r\n");
+        for (int page = 0; page < pages; page++) {
+            const unsigned int offset = page * pageBytes;
+            if (!writePage(page, pageSize, binary + offset, min(pageBytes, length - offset))) {
+                exitProgramming();
+                return false;
             }
-            // printf("PageNumber: %d\r\n", pageNumber);
         }
     } else {
         // We're dealing with non-paged memory.
 
-        while (binaryLoc < length) {
-            c = binary[binaryLoc];
-            binaryLoc++;
+        for (unsigned int binaryLoc = 0; binaryLoc < length; binaryLoc++) {
+            const uint8_t c = binary[binaryLoc];
 
             // Write low byte.
             if (highLow == 0) {
@@ -247,37 +217,43 @@ bool AVR910::program(const uint8_t* binary, unsigned int length, int pageSize, i
                 // Therefore if we've gone beyond our size break because we
                 // don't have any more room.
                 if (address > pageSize) {
-                    printf(
-                        "ERROR: AVR910 binary exceeds chip memory "
-                        "capacity\r\n");
+                    LOG_ERROR("AVR910: binary exceeds chip memory capacity");
+                    exitProgramming();
                     return false;
                 }
             }
         }
     }
 
-    // We might have partially filled up a page.
-    writeFlashMemoryPage(pageNumber, lc_offset, lc_highlow);
-
-    bool success = checkMemory(pageSize, pageNumber + 1, binary, length, true);
+    bool success = checkMemory(pageSize, pages, binary, length, true);
 
     // Leave serial programming mode by toggling reset
     exitProgramming();
 
+    logThroughput(length, start);
     return success;
 }
 
+bool AVR910::writePage(int pageNumber, int pageSize, const uint8_t* data,
+                       unsigned int length) {
+    // The chip erase already left an erased page at 0xFF
+    if (all_of(data, data + length, [](uint8_t b) { return b == 0xFF; })) {
+        return true;
+    }
+
+    loadMemoryPage(pageSize, data, length);
+    return writeFlashMemoryPage(pageNumber, pageSize);
+}
+
 bool AVR910::enableProgramming() {
     auto spi_lock = lock_spi();
 
     // Programming Enable Command: 0xAC, 0x53, 0x00, 0x00
     // Byte two echo'd back in byte three.
-    nCs_->write(0);
     spi_lock->transmit(0xAC);
     spi_lock->transmit(0x53);
     int response = spi_lock->transmitReceive(0x00);
     spi_lock->transmit(0x00);
-    nCs_->write(1);
 
     if (response == 0x53) {
         return true;
@@ -286,30 +262,41 @@ bool AVR910::enableProgramming() {
     }
 }
 
-void AVR910::poll(int high_low, char page_number, char page_offset) {
+bool AVR910::isBusy() {
     auto spi_lock = lock_spi();
 
-    // Query the chip until it indicates it's ready by setting the busy bit to 0
-    int response = 0;
-    nCs_->write(0);
-    do {
-        spi_lock->transmit(0xF0);
-        spi_lock->transmit(0x00);
-        spi_lock->transmit(0x00);
-        response = spi_lock->transmitReceive(0x00);
-    } while ((response & 0x01) != 0);
-    nCs_->write(0);
+    // Poll RDY/BSY command, the busy bit is the last byte's LSB
+    spi_lock->transmit(0xF0);
+    spi_lock->transmit(0x00);
+    spi_lock->transmit(0x00);
+    int response = spi_lock->transmitReceive(0x00);
+
+    return (response & 0x01) != 0;
+}
+
+bool AVR910::poll(uint32_t timeoutMs) {
+    const uint32_t start = HAL_GetTick();
+
+    // Query the chip until it indicates it's ready by setting the busy bit
+    // to 0, letting go of the bus in between
+    while (isBusy()) {
+        if (HAL_GetTick() - start > timeoutMs) {
+            LOG_ERROR("AVR910: chip still busy after %lu ms", timeoutMs);
+            return false;
+        }
+        vTaskDelay(1);
+    }
+
+    return true;
 }
 
 int AVR910::readRegister(int reg) {
     auto spi_lock = lock_spi();
 
-    nCs_->write(0);
     spi_lock->transmit(0x30);
     spi_lock->transmit(0x00);
     spi_lock->transmit(reg);
     int val = spi_lock->transmitReceive(0x00);
-    nCs_->write(1);
 
     return val;
 }
@@ -332,169 +319,209 @@ int AVR910::readPartNumber() {
     return readRegister(0x02);
 }
 
-void AVR910::chipErase() {
-    auto spi_lock = lock_spi();
+bool AVR910::chipErase() {
+    {
+        auto spi_lock = lock_spi();
 
-    // Issue chip erase command.
-    nCs_->write(0);
-    spi_lock->transmit(0xAC);
-    spi_lock->transmit(0x80);
-    spi_lock->transmit(0x00);
-    spi_lock->transmit(0x00);
-    nCs_->write(1);
+        // Issue chip erase command.
+        spi_lock->transmit(0xAC);
+        spi_lock->transmit(0x80);
+        spi_lock->transmit(0x00);
+        spi_lock->transmit(0x00);
+    }
 
-    vTaskDelay(15); // 9 ms min
+    return poll(CHIP_ERASE_TIMEOUT_MS); // 9 ms min
 }
 
 /**
  * Load program memory page
- * 
- * @param highLog first byte of the command, whether low or high byte
- *                0100 0000 for low byte
- *                0100 1000 for high byte
- * @param address 6 lsbs of the word address
- *                AKA location in the current page
- * @param data byte of data to be stored
- * 
- * @note load low before high
+ *
+ * Every byte's command goes out back to back under one chip select, low
+ * byte before high byte of each word:
+ *   0100 H000  00xx xxxx  xxbb bbbb  iiii iiii
+ * with H set for the high byte, b the word's address in the page and i
+ * the data.
+ *
+ * @param pageSize words in a page, for the address bits that count
+ * @param data bytes from the start of the page
+ * @param length how many, at most a page
  */
-void AVR910::loadMemoryPage(int highLow, char address, char data) {
+void AVR910::loadMemoryPage(int pageSize, const uint8_t* data, unsigned int length) {
+    for (unsigned int i = 0; i < length; i++) {
+        uint8_t* command = &pageCommands_[i * 4];
+        command[0] = (i & 1) ? WRITE_HIGH_BYTE : WRITE_LOW_BYTE;
+        command[1] = 0x00;
+        command[2] = (i / 2) & (pageSize - 1);
+        command[3] = data[i];
+    }
+
     auto spi_lock = lock_spi();
 
-    // Load program memory page command
-    // Write H (high or low) data i to Program
-    // Memory page at word address b. Data
-    // low byte must be loaded before Data
-    // high byte is applied within the same
-    // address.
-    nCs_->write(0);
-    spi_lock->transmit(highLow); // 0100 H000
-    spi_lock->transmit(0x00); // 00xx xxxx
-    spi_lock->transmit(address & 0x3F); // xxxb bbbb
-    spi_lock->transmit(data); // iiii iiii
-    nCs_->write(1);
+    spi_lock->transmit(pageCommands_, length * 4);
 }
 
 void AVR910::writeFlashMemoryByte(int highLow, int address, char data) {
     auto spi_lock = lock_spi();
 
-    nCs_->write(0);
     spi_lock->transmit(0x4C);
     spi_lock->transmit(address & 0xFF00 >> 8);
     spi_lock->transmit(address & 0x003F);
     spi_lock->transmit(data);
-    nCs_->write(1);
 }
 
-void AVR910::writeFuseBitsLow() {
+int AVR910::readFuseBitsLow() {
     auto spi_lock = lock_spi();
 
-    nCs_->write(0);
-    spi_lock->transmit(0xAC);
-    spi_lock->transmit(0xA0);
-    spi_lock->transmit(0x33);
-    spi_lock->transmit(0xE4);
-    nCs_->write(1);
+    spi_lock->transmit(0x50);
+    spi_lock->transmit(0x00);
+    spi_lock->transmit(0x00);
+    int val = spi_lock->transmitReceive(0x00);
+
+    return val;
+}
+
+bool AVR910::writeFuseBitsLow(uint8_t fuses) {
+    {
+        auto spi_lock = lock_spi();
+
+        spi_lock->transmit(0xAC);
+        spi_lock->transmit(0xA0);
+        spi_lock->transmit(0x00);
+        spi_lock->transmit(fuses);
+    }
+
+    return poll(FUSE_WRITE_TIMEOUT_MS); // 4.5 ms min
+}
+
+int AVR910::readFuseBitsHigh() {
+    auto spi_lock = lock_spi();
+
+    spi_lock->transmit(0x58);
+    spi_lock->transmit(0x08);
+    spi_lock->transmit(0x00);
+    int val = spi_lock->transmitReceive(0x00);
+
+    return val;
+}
+
+bool AVR910::writeFuseBitsHigh(uint8_t fuses) {
+    {
+        auto spi_lock = lock_spi();
+
+        spi_lock->transmit(0xAC);
+        spi_lock->transmit(0xA8);
+        spi_lock->transmit(0x00);
+        spi_lock->transmit(fuses);
+    }
+
+    return poll(FUSE_WRITE_TIMEOUT_MS); // 4.5 ms min
 }
 
 /**
  * Write program memory page
- * 
+ *
  * @param pageNumber page number to write
+ * @param pageSize words in a page
  */
-void AVR910::writeFlashMemoryPage(char pageNumber, char pageOffset, int highlow) {
-    auto spi_lock = lock_spi();
+bool AVR910::writeFlashMemoryPage(int pageNumber, int pageSize) {
+    const unsigned int address = pageNumber * pageSize;
+
+    {
+        auto spi_lock = lock_spi();
+
+        // Write program memory page command
+        // Write Program Memory Page at
+        // address a:b.
+        spi_lock->transmit(0x4C); // 0100 1100
+        spi_lock->transmit(address >> 8); // 00aa aaaa
+        spi_lock->transmit(address & 0xFF); // aaxx xxxx
+        spi_lock->transmit(0x00); // xxxx xxxx
+    }
 
-    // Write program memory page command
-    // Write Program Memory Page at
-    // address a:b.
-    nCs_->write(0);
-    spi_lock->transmit(0x4C); // 0100 1100
-    // 11 bits total, 5 for page offset, 6 for page number
-    spi_lock->transmit(pageNumber >> 2); // 0000 0000
-    spi_lock->transmit(pageNumber << 6); // 0x00aa aaaa
-    spi_lock->transmit(0x00); // xxxx xxxx
-    nCs_->write(1);
-
-    poll(highlow, pageNumber, pageOffset);
+    return poll(PAGE_WRITE_TIMEOUT_MS); // 4.5 ms min
 }
 
 /**
  * Read program memory
- * 
- * @param highLow First byte of command
- *                0100 0000 for low byte
- *                0100 0100 for high byte
- * @param pageNumber Page number from [0 - N]
- * @param pageOffset location in words in page to read
- * 
- * @return value read
+ *
+ * Every byte's command goes out under one chip select:
+ *   0010 H000  00aa aaaa  bbbb bbbb  oooo oooo
+ * with H set for the high byte, a:b the word address and o the data.
+ *
+ * @param address byte address to start at
+ * @param data where to read to
+ * @param length bytes to read
  */
-char AVR910::readProgramMemory(int highLow, char pageNumber, char pageOffset) {
+void AVR910::readProgramMemory(unsigned int address, uint8_t* data, unsigned int length) {
     auto spi_lock = lock_spi();
 
-    // Read program memory command
-    // Read H (high or low) data o from
-    // Program memory at word address a:b
-    nCs_->write(0);
-    spi_lock->transmit(highLow); // 0100 0H00
-    spi_lock->transmit(pageNumber >> 2); // 00aa aaaa
-    spi_lock->transmit((pageNumber << 6) | (pageOffset & 0x3F)); // aabb bbbb
-    char response = spi_lock->transmitReceive(0x00); // oooo oooo
-    nCs_->write(1);
-
-    return response;
+    for (unsigned int i = 0; i < length; i++) {
+        const unsigned int byte = address + i;
+        spi_lock->transmit((byte & 1) ? READ_HIGH_BYTE : READ_LOW_BYTE);
+        spi_lock->transmit(byte >> 9);
+        spi_lock->transmit((byte >> 1) & 0xFF);
+        data[i] = spi_lock->transmitReceive(0x00);
+    }
+}
+
+bool AVR910::checkBytes(unsigned int address, const uint8_t* expected,
+                        unsigned int length, bool verbose) {
+    bool success = true;
+
+    // A page's worth at a time, each under one chip select
+    for (unsigned int start = 0; start < length; start += MAX_PAGE_WORDS * 2) {
+        uint8_t read[MAX_PAGE_WORDS * 2];
+        const unsigned int count = min<unsigned int>(sizeof(read), length - start);
+        readProgramMemory(address + start, read, count);
+
+        for (unsigned int i = 0; i < count; i++) {
+            if (read[i] == expected[start + i]) {
+                continue;
+            }
+
+            if (!verbose) {
+                return false;
+            }
+            LOG_DEBUG("AVR910: Byte 0x%04x: 0x%02x, correct byte is 0x%02x",
+                      address + start + i, read[i], expected[start + i]);
+            success = false;
+        }
+    }
+
+    return success;
 }
 
 bool AVR910::checkMemory(int pageSize, int numPages, FILE* binary,
                          bool verbose) {
     bool success = true;
 
-    printf("Checking memory? (pagesize: %d, numpages: %d) \r\n", pageSize,
-           numPages);
+    LOG_DEBUG("AVR910: Checking memory (pagesize: %d, numpages: %d)", pageSize,
+              numPages);
 
     // Go back to the beginning of the binary file.
     fseek(binary, 0, SEEK_SET);
 
-    for (int page = 0; page < numPages; page++) {
-        for (int offset = 0; offset < pageSize; offset++) {
-            int response;
-            char c = getc(binary);
-            // Read program memory low byte.
-            response = readProgramMemory(READ_LOW_BYTE, page, offset);
-
-            if (c != response) {
-                if (verbose || true) {
-                    printf("Page %i low byte %i: 0x%02x : ", page, offset,
-                           response);
-                    printf("Correct byte is 0x%02x\r\n", c);
-                } else {
-                    return false;
-                }
-                success = false;
-            }
-            c = getc(binary);
-            // Read program memory high byte.
-            response = readProgramMemory(READ_HIGH_BYTE, page, offset);
-
-            if (c != response) {
-                if (verbose || true) {
-                    printf("Page %i high byte %i: 0x%02x : ", page, offset,
-                           response);
-                    printf("Correct byte is 0x%02x\r\n", c);
-                } else {
-                    return false;
-                }
-                success = false;
+    const unsigned int memoryBytes = pageSize * numPages * 2;
+    for (unsigned int address = 0; address < memoryBytes; address += MAX_PAGE_WORDS * 2) {
+        // Past the end of the binary should still be erased
+        uint8_t expected[MAX_PAGE_WORDS * 2];
+        const unsigned int count = min<unsigned int>(sizeof(expected), memoryBytes - address);
+        const size_t read = fread(expected, 1, count, binary);
+        fill(expected + read, expected + count, 0xFF);
+
+        if (!checkBytes(address, expected, count, verbose)) {
+            if (!verbose) {
+                return false;
             }
+            success = false;
         }
     }
 
     if (verbose) {
         if (success) {
-            printf("Kicker Memory Contents: OK.\r\n");
+            LOG_INFO("AVR910: Kicker Memory Contents: OK.");
         } else {
-            printf("Kicker Memory Contents: FAILED.\r\n");
+            LOG_WARN("AVR910: Kicker Memory Contents: FAILED.");
         }
     }
 
@@ -503,66 +530,23 @@ bool AVR910::checkMemory(int pageSize, int numPages, FILE* binary,
 
 bool AVR910::checkMemory(int pageSize, int numPages, const uint8_t* binary,
                          unsigned int length, bool verbose) {
-    bool success = true;
-
-    printf("Checking memory? pagesize: %d, numpages: %d \r\n", pageSize,
-           numPages);
-
-    unsigned int binaryLoc = 0;
-
-    for (int page = 0; page < numPages; page++) {
-        for (int offset = 0; offset < pageSize; offset++) {
-            int response;
-            char c = binary[binaryLoc];
-            binaryLoc++;
-
-            if (binaryLoc >= length) {
-                printf("Done reading\r\n");
-                break;
-            }
+    LOG_DEBUG("AVR910: Checking memory (pagesize: %d, numpages: %d)", pageSize,
+              numPages);
 
-            // Read program memory low byte.
-            response = readProgramMemory(READ_LOW_BYTE, page, offset);
-
-            if (c != response) {
-                if (verbose) {
-                    printf("Page %i low byte %i: 0x%02x\r\n", page, offset,
-                           response);
-                    printf("Correct byte is 0x%02x\r\n", c);
-                } else {
-                    return false;
-                }
-                success = false;
-            }
-
-            c = binary[binaryLoc];
-            binaryLoc++;
-
-            if (binaryLoc >= length)
-                break;
-
-            // Read program memory high byte.
-            response = readProgramMemory(READ_HIGH_BYTE, page, offset);
-
-            if (c != response) {
-                if (verbose) {
-                    printf("Page %i high byte %i: 0x%02x\r\n", page, offset,
-                           response);
-                    printf("Correct byte is 0x%02x\r\n", c);
-                } else {
-                    return false;
-                }
-                success = false;
-            }
-        }
-    }
-
-    return success;
+    const unsigned int memoryBytes = pageSize * numPages * 2;
+    return checkBytes(0, binary, min(length, memoryBytes), verbose);
 }
 
 void AVR910::exitProgramming() {
     nReset_.write(0);
-    // TODO(Kyle): Why wasn't vTaskDelay working here?
-    DWT_Delay(100000);
+    // Only needs to be low for a couple of the chip's clock cycles
+    DWT_Delay(100);
     nReset_.write(1);
 }
+
+void AVR910::logThroughput(unsigned int length, uint32_t start) {
+    const uint32_t elapsed = HAL_GetTick() - start;
+    const uint32_t rate = elapsed > 0 ? length * 1000 / elapsed : 0;
+    LOG_INFO("AVR910: Programmed %u bytes in %lu ms, %lu bytes/s with SCK at %d Hz",
+             length, elapsed, rate, spiBus_.frequency(ispDevice_));
+}
@@ -1,24 +1,175 @@
 #include "drivers/Battery.hpp"
 
+#include <algorithm>
+#include <array>
+
+#include "Logger.hpp"
+
+namespace {
+/**
+ * Resting lipo cell voltage at every 10% state of charge, 0% first
+ */
+constexpr std::array<float, 11> kDischargeCurve = {
+    3.40f, 3.68f, 3.74f, 3.77f, 3.79f, 3.82f, 3.87f, 3.92f, 3.98f, 4.06f, 4.20f
+};
+}
+
 Battery::Battery()
-    : lastReadPercentage(0.0f), rawVoltage(0) {
-    // init analog pin
+    : initialized(false), hasReading(false), critical(false),
+      filteredVoltage(0.0f), restingVoltage(0.0f),
+      lastReadPercentage(0.0f), rawVoltage(0) {
+    std::fill(std::begin(samples), std::end(samples), 0);
+    initialized = initAdc();
+}
+
+bool Battery::ok() const {
+    return initialized;
+}
+
+bool Battery::initAdc() {
+    __HAL_RCC_GPIOA_CLK_ENABLE();
+    __HAL_RCC_ADC1_CLK_ENABLE();
+    __HAL_RCC_DMA2_CLK_ENABLE();
+
+    GPIO_InitTypeDef pinInit = {};
+    pinInit.Pin = kSensePin;
+    pinInit.Mode = GPIO_MODE_ANALOG;
+    pinInit.Pull = GPIO_NOPULL;
+    HAL_GPIO_Init(GPIOA, &pinInit);
+
+    // Circular, so the buffer always holds the latest kNumSamples conversions.
+    // No interrupts are enabled in the NVIC, the buffer is just read in place.
+    dmaHandle.Instance = DMA2_Stream0;
+    dmaHandle.Init.Channel = DMA_CHANNEL_0;
+    dmaHandle.Init.Direction = DMA_PERIPH_TO_MEMORY;
+    dmaHandle.Init.PeriphInc = DMA_PINC_DISABLE;
+    dmaHandle.Init.MemInc = DMA_MINC_ENABLE;
+    dmaHandle.Init.PeriphDataAlignment = DMA_PDATAALIGN_HALFWORD;
+    dmaHandle.Init.MemDataAlignment = DMA_MDATAALIGN_HALFWORD;
+    dmaHandle.Init.Mode = DMA_CIRCULAR;
+    dmaHandle.Init.Priority = DMA_PRIORITY_LOW;
+    dmaHandle.Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    if (HAL_DMA_Init(&dmaHandle) != HAL_OK) {
+        LOG_ERROR("Battery: DMA init failed");
+        return false;
+    }
+
+    // Slowest sample time, the divider has a high source impedance and
+    // there's no reason to convert any faster
+    adcHandle.Instance = ADC1;
+    adcHandle.Init.ClockPrescaler = ADC_CLOCK_SYNC_PCLK_DIV8;
+    adcHandle.Init.Resolution = ADC_RESOLUTION_12B;
+    adcHandle.Init.ScanConvMode = DISABLE;
+    adcHandle.Init.ContinuousConvMode = ENABLE;
+    adcHandle.Init.DiscontinuousConvMode = DISABLE;
+    adcHandle.Init.ExternalTrigConvEdge = ADC_EXTERNALTRIGCONVEDGE_NONE;
+    adcHandle.Init.ExternalTrigConv = ADC_SOFTWARE_START;
+    adcHandle.Init.DataAlign = ADC_DATAALIGN_RIGHT;
+    adcHandle.Init.NbrOfConversion = 1;
+    adcHandle.Init.DMAContinuousRequests = ENABLE;
+    adcHandle.Init.EOCSelection = ADC_EOC_SINGLE_CONV;
+    __HAL_LINKDMA(&adcHandle, DMA_Handle, dmaHandle);
+    if (HAL_ADC_Init(&adcHandle) != HAL_OK) {
+        LOG_ERROR("Battery: ADC init failed");
+        return false;
+    }
+
+    ADC_ChannelConfTypeDef channel = {};
+    channel.Channel = kAdcChannel;
+    channel.Rank = ADC_REGULAR_RANK_1;
+    channel.SamplingTime = ADC_SAMPLETIME_480CYCLES;
+    if (HAL_ADC_ConfigChannel(&adcHandle, &channel) != HAL_OK) {
+        LOG_ERROR("Battery: ADC channel config failed");
+        return false;
+    }
+
+    if (HAL_ADC_Start_DMA(&adcHandle, reinterpret_cast<uint32_t*>(const_cast<uint16_t*>(samples)), kNumSamples) != HAL_OK) {
+        LOG_ERROR("Battery: ADC DMA start failed");
+        return false;
+    }
+
+    return true;
 }
 
 void Battery::update() {
-    // read analog pin
-    lastReadPercentage = 100.0;
-    rawVoltage = 255;
+    // Without conversions the buffer is still all zeros, which would read
+    // as a flat battery
+    if (!initialized) {
+        return;
+    }
+
+    // DMA writes behind the data cache
+    SCB_InvalidateDCache_by_Addr(reinterpret_cast<uint32_t*>(const_cast<uint16_t*>(samples)), sizeof(samples));
+
+    std::array<uint16_t, kNumSamples> snapshot;
+    std::copy(std::begin(samples), std::end(samples), snapshot.begin());
+
+    auto middle = snapshot.begin() + kNumSamples / 2;
+    std::nth_element(snapshot.begin(), middle, snapshot.end());
+    const uint16_t median = *middle;
+
+    const float voltage = adcToVoltage(median);
+
+    if (!hasReading) {
+        filteredVoltage = voltage;
+        restingVoltage = voltage;
+        hasReading = true;
+    } else {
+        filteredVoltage += kFilterAlpha * (voltage - filteredVoltage);
+
+        const float alpha = (filteredVoltage > restingVoltage) ? kRestRiseAlpha : kRestFallAlpha;
+        restingVoltage += alpha * (filteredVoltage - restingVoltage);
+    }
+
+    rawVoltage = static_cast<uint8_t>(median >> 4);
+
+    const float restingCellVoltage = restingVoltage / kNumCells;
+    lastReadPercentage = cellVoltageToPercentage(restingCellVoltage);
+
+    if (critical) {
+        critical = restingCellVoltage < kCriticalCellVoltage + kCriticalHysteresis;
+    } else {
+        critical = restingCellVoltage < kCriticalCellVoltage ||
+                   filteredVoltage / kNumCells < kAbsoluteMinCellVoltage;
+    }
 }
 
 float Battery::getBattPercentage() {
     return lastReadPercentage;
 }
 
+float Battery::getVoltage() {
+    return filteredVoltage;
+}
+
 uint8_t Battery::getRaw() {
     return rawVoltage;
 }
 
 bool Battery::isBattCritical() {
-    return lastReadPercentage <= 0.0;
-}
\ No newline at end of file
+    return critical;
+}
+
+float Battery::adcToVoltage(float adc) {
+    return adc / kAdcFullScale * kAdcReference * kDividerRatio;
+}
+
+float Battery::cellVoltageToPercentage(float cellVoltage) {
+    if (cellVoltage <= kDischargeCurve.front()) {
+        return 0.0f;
+    }
+    if (cellVoltage >= kDischargeCurve.back()) {
+        return 100.0f;
+    }
+
+    // Linear interpolation between the 10% points
+    for (size_t i = 1; i < kDischargeCurve.size(); i++) {
+        if (cellVoltage < kDischargeCurve[i]) {
+            const float fraction = (cellVoltage - kDischargeCurve[i - 1]) /
+                                   (kDischargeCurve[i] - kDischargeCurve[i - 1]);
+            return 10.0f * (i - 1 + fraction);
+        }
+    }
+
+    return 100.0f;
+}
@@ -1,5 +1,8 @@
 #include "drivers/FPGA.hpp"
 
+#include <algorithm>
+#include <array>
+#include <limits>
 #include <memory>
 #include <stdint.h>
 
@@ -7,6 +10,8 @@
 
 #include "FreeRTOS.h"
 #include "task.h"
+#include "interrupt_in.h"
+#include "Logger.hpp"
 
 template <size_t SIGN_INDEX>
 uint16_t toSignMag(int16_t val) {
@@ -22,6 +27,171 @@ int16_t fromSignMag(uint16_t val) {
     return val;
 }
 
+namespace {
+/**
+ * Duty cycle words with this bit set are in the high resolution format, a sign
+ * bit and `FPGA::MAX_DUTY_CYCLE` magnitude. Without it the FPGA still takes the
+ * original format, with the sign at bit 9 and a 9 bit magnitude.
+ */
+constexpr uint16_t DUTY_HIGH_RES_FLAG = 1 << 15;
+constexpr size_t DUTY_SIGN_INDEX = 13;
+constexpr size_t LEGACY_DUTY_SIGN_INDEX = 9;
+constexpr int LEGACY_DUTY_SHIFT = DUTY_SIGN_INDEX - LEGACY_DUTY_SIGN_INDEX;
+
+/**
+ * PWM periods the FPGA accepts, in clock cycles minus 1 (PWM_PERIOD_MIN and
+ * the width of PWM_PERIOD_WIDTH in robocup.v)
+ */
+constexpr uint32_t PWM_PERIOD_MIN = 255;
+constexpr uint32_t PWM_PERIOD_MAX = 2047;
+
+/**
+ * What a design from before the version register fills the response to an
+ * unknown command with
+ */
+constexpr uint8_t UNKNOWN_COMMAND_FILL = 0xAA;
+
+/**
+ * Clock cycles per watchdog tick, the dt at the end of a 0x80 response
+ */
+constexpr int64_t WATCHDOG_TICK_CYCLES = 2 * 128;
+
+/**
+ * PWM frequency of a legacy design, which can't change it
+ */
+constexpr uint32_t LEGACY_PWM_FREQUENCY = FPGA::FPGA_CLK_FREQ / 1024;
+
+uint16_t toDutyWord(int16_t duty) {
+    return toSignMag<DUTY_SIGN_INDEX>(duty) | DUTY_HIGH_RES_FLAG;
+}
+
+uint16_t toLegacyDutyWord(int16_t duty) {
+    return toSignMag<LEGACY_DUTY_SIGN_INDEX>(duty / (1 << LEGACY_DUTY_SHIFT));
+}
+
+int16_t fromDutyWord(uint16_t word) {
+    if (word & DUTY_HIGH_RES_FLAG) {
+        return fromSignMag<DUTY_SIGN_INDEX>(word & ~DUTY_HIGH_RES_FLAG);
+    }
+    return fromSignMag<LEGACY_DUTY_SIGN_INDEX>(word) * (1 << LEGACY_DUTY_SHIFT);
+}
+}
+
+namespace {
+/**
+ * The bitstream is stored LZ4 compressed by convert.py, and decompressed
+ * into a window of the last CONFIG_WINDOW bytes that's sent out a chunk at a
+ * time as it fills up. convert.py limits matches to the window, so that's
+ * all of the output that's ever referred back to.
+ */
+constexpr size_t CONFIG_WINDOW = 2048;
+constexpr size_t CONFIG_CHUNK = 256;
+constexpr size_t LZ4_MIN_MATCH = 4;
+
+static_assert(FPGA_BYTES_WINDOW <= CONFIG_WINDOW, "fpga_bin.h was compressed with a larger window than FPGA::send_config keeps");
+static_assert(CONFIG_WINDOW % CONFIG_CHUNK == 0, "Chunks must not wrap around the window");
+
+uint8_t configWindow[CONFIG_WINDOW];
+
+/**
+ * Reads an LZ4 length that continues in extra bytes, see lz4_Block_format.md
+ */
+bool lz4_length(const uint8_t*& src, const uint8_t* end, size_t& len) {
+    uint8_t more;
+    do {
+        if (src == end) {
+            return false;
+        }
+        more = *src++;
+        len += more;
+    } while (more == 255);
+
+    return true;
+}
+
+/**
+ * Decompresses an LZ4 block, calling `send` with every chunk of output
+ *
+ * @return The number of bytes decompressed, 0 if the data is corrupt
+ */
+template <typename Send>
+size_t lz4_stream(const uint8_t* src, size_t srcLen, Send&& send) {
+    const uint8_t* const end = src + srcLen;
+    size_t out = 0;
+
+    auto put = [&](uint8_t byte) {
+        configWindow[out % CONFIG_WINDOW] = byte;
+        out++;
+        if (out % CONFIG_CHUNK == 0) {
+            send(&configWindow[(out - CONFIG_CHUNK) % CONFIG_WINDOW], CONFIG_CHUNK);
+        }
+    };
+
+    while (src != end) {
+        const uint8_t token = *src++;
+
+        size_t literals = token >> 4;
+        if (literals == 15 && !lz4_length(src, end, literals)) {
+            return 0;
+        }
+        if (literals > static_cast<size_t>(end - src)) {
+            return 0;
+        }
+        for (size_t i = 0; i < literals; i++) {
+            put(*src++);
+        }
+
+        // The last sequence is only literals
+        if (src == end) {
+            break;
+        }
+
+        if (end - src < 2) {
+            return 0;
+        }
+        const size_t offset = src[0] | src[1] << 8;
+        src += 2;
+
+        size_t match = token & 0x0F;
+        if (match == 15 && !lz4_length(src, end, match)) {
+            return 0;
+        }
+        match += LZ4_MIN_MATCH;
+
+        if (offset == 0 || offset > out || offset > CONFIG_WINDOW) {
+            return 0;
+        }
+        for (size_t i = 0; i < match; i++) {
+            put(configWindow[(out - offset) % CONFIG_WINDOW]);
+        }
+    }
+
+    if (out % CONFIG_CHUNK != 0) {
+        send(&configWindow[(out - out % CONFIG_CHUNK) % CONFIG_WINDOW], out % CONFIG_CHUNK);
+    }
+
+    return out;
+}
+
+/**
+ * Longest the FPGA takes to assert DONE after the last byte of the bitstream
+ */
+constexpr TickType_t DONE_TIMEOUT = pdMS_TO_TICKS(1000);
+
+/**
+ * Task waiting in `FPGA::configure` for DONE, notified from its interrupt
+ */
+TaskHandle_t doneWaiter = nullptr;
+
+void done_cb() {
+    if (doneWaiter != nullptr) {
+        BaseType_t woken = pdFALSE;
+        vTaskNotifyGiveFromISR(doneWaiter, &woken);
+        portYIELD_FROM_ISR(woken);
+    }
+}
+}
+
 /**
  * This command set represents the commands that can
  * be issued to the FPGA.
@@ -31,14 +201,19 @@ int16_t fromSignMag(uint16_t val) {
  */
 namespace {
 enum {
+    CMD_W_PWM_PERIOD = 0x17,
     CMD_EN_DIS_MTRS = 0x30,
     CMD_R_ENC_W_VEL = 0x80,
+    CMD_R_ENC_CUR_W_VEL = 0x81,
+    CMD_R_ALL_W_VEL = 0x82,
     CMD_READ_ENC = 0x91,
     CMD_READ_HALLS = 0x92,
     CMD_READ_DUTY = 0x93,
     CMD_READ_HASH1 = 0x94,
     CMD_READ_HASH2 = 0x95,
-    CMD_CHECK_DRV = 0x96
+    CMD_CHECK_DRV = 0x96,
+    CMD_READ_PWM_PERIOD = 0x97,
+    CMD_READ_DESIGN_VERSION = 0x98
 };
 }
 
@@ -59,11 +234,12 @@ FPGA::FPGA(std::unique_ptr<SPI> spi_bus, PinName nCs, PinName initB,
     : _spi_bus(std::move(spi_bus)),
       _nCs(nCs, PullType::PullNone, PinMode::PushPull, PinSpeed::Low, true),
       _initB(initB),
-      _done(done),
+      _done{done.port, done.pin},
       _progB(progB, PullType::PullNone, PinMode::OpenDrain, PinSpeed::Low, false)
       {
     _spi_bus->frequency(FPGA_SPI_FREQ);
     _progB = 1;
+    interruptin_init_ex(_done, &done_cb, PULL_NONE, INTERRUPT_RISING);
 }
 
 bool FPGA::configure() {
@@ -72,10 +248,11 @@ bool FPGA::configure() {
     vTaskDelay(1);
     _progB = 1;
 
-    // wait for the FPGA to tell us it's ready for the bitstream
+    // wait for the FPGA to tell us it's ready for the bitstream, clearing
+    // its configuration memory only takes a couple of milliseconds
     auto fpgaReady = false;
-    for (auto i = 0; i < 100; ++i) {
-        vTaskDelay(10);
+    for (auto i = 0; i < 1000; ++i) {
+        vTaskDelay(1);
 
         // We're ready to start the configuration process when _initB goes high
         if (_initB) {
@@ -86,39 +263,43 @@ bool FPGA::configure() {
 
     // show INIT_B error if it never went low
     if (!fpgaReady) {
-        printf("[SEVERE] FPGA: INIT_B pin timed out\r\n");
+        LOG_SEVERE("FPGA: INIT_B pin timed out");
 
         return false;
     }
 
-    printf("[FPGA] Got INIT_B at tick %ld\r\n", xTaskGetTickCount());
+    LOG_INFO("FPGA: Got INIT_B at tick %lu", xTaskGetTickCount());
 
-    // Configure the FPGA with the bitstream file, this returns false if file
-    // can't be opened
+    // DONE can go high before the last bytes are out, so be listening for it
+    // before starting. Any old notification is cleared first.
+    doneWaiter = xTaskGetCurrentTaskHandle();
+    ulTaskNotifyTake(pdTRUE, 0);
+
+    // Configure the FPGA with the bitstream file, this returns false if the
+    // bitstream is corrupt
     const auto sendSuccess = send_config();
     if (sendSuccess) {
-        // Wait some extra time in case the _done pin needs time to be asserted
-        auto configSuccess = false;
-        for (auto i = 0; i < 1000; i++) {
-            vTaskDelay(100);
-            if (_done == true) {
-                printf("Got done on i=%d, but InitB=%d\r\n", i, _initB.read());
-                configSuccess = _initB;
-                break;
+        const auto gotDone = interruptin_read(_done) || ulTaskNotifyTake(pdTRUE, DONE_TIMEOUT) != 0;
+        doneWaiter = nullptr;
+
+        if (gotDone) {
+            LOG_INFO("FPGA: Got done at tick %lu, InitB=%d", xTaskGetTickCount(), _initB.read());
+
+            // INIT_B goes low on a CRC error
+            if (_initB) {
+                // everything worked are we're good to go!
+                _isInit = true;
+                read_design_version();
+                return true;
             }
+        } else {
+            LOG_SEVERE("FPGA: DONE pin timed out");
         }
-
-        if (configSuccess) {
-            // everything worked are we're good to go!
-            _isInit = true;
-            return true;
-        }
-
-        printf("[SEVERE] FPGA: DONE pin timed out\r\n");
     }
 
-    printf("[SEVERE] FPGA: FPGA bitstream write error\r\n");
-    printf("[SEVERE] Failure at tick %ld\r\n", xTaskGetTickCount());
+    doneWaiter = nullptr;
+
+    LOG_SEVERE("FPGA: FPGA bitstream write error at tick %lu", xTaskGetTickCount());
 
     return false;
 }
@@ -127,13 +308,63 @@ bool FPGA::send_config() {
     chip_select();
     
     _spi_bus->frequency(16'000'000);
-    _spi_bus->transmit(FPGA_BYTES, FPGA_BYTES_LEN);
+    const auto sent = lz4_stream(FPGA_BYTES, FPGA_BYTES_LEN, [this](const uint8_t* chunk, size_t len) {
+        _spi_bus->transmit(chunk, len);
+    });
     
     chip_deselect();
+
+    if (sent != FPGA_BYTES_DECOMPRESSED_LEN) {
+        LOG_SEVERE("FPGA: bitstream is corrupt, decompressed %u of %u bytes",
+                   static_cast<unsigned>(sent), static_cast<unsigned>(FPGA_BYTES_DECOMPRESSED_LEN));
+        return false;
+    }
     
     return true;
 }
 
+bool FPGA::check_loaded() {
+    // A dirty build's hash doesn't say what's in it, and a bitstream
+    // converted without --git-version has a hash of 0
+    const bool noHash = std::all_of(std::begin(FPGA_BYTES_GIT_HASH), std::end(FPGA_BYTES_GIT_HASH),
+                                    [](uint8_t b) { return b == 0; });
+    if (FPGA_BYTES_GIT_DIRTY || noHash || !interruptin_read(_done) || !_initB) {
+        return false;
+    }
+
+    _spi_bus->frequency(FPGA_SPI_FREQ);
+
+    std::vector<uint8_t> hash;
+    const bool dirty = git_hash(hash);
+    if (dirty || hash.size() != sizeof(FPGA_BYTES_GIT_HASH) ||
+        !std::equal(hash.begin(), hash.end(), FPGA_BYTES_GIT_HASH)) {
+        return false;
+    }
+
+    _isInit = true;
+    read_design_version();
+    return true;
+}
+
+uint8_t FPGA::read_design_version() {
+    _spi_bus->frequency(FPGA_SPI_FREQ);
+
+    chip_select();
+    _spi_bus->transmit(CMD_READ_DESIGN_VERSION);
+    const uint8_t version = _spi_bus->transmitReceive(0x00);
+    chip_deselect();
+
+    _designVersion = (version == UNKNOWN_COMMAND_FILL) ? 0 : version;
+
+    if (_designVersion == 0) {
+        LOG_WARN("FPGA: design has no version register, using only its original commands");
+    } else if (_designVersion > DESIGN_VERSION) {
+        LOG_WARN("FPGA: design version %u is newer than the driver's %u", _designVersion, DESIGN_VERSION);
+    }
+
+    return _designVersion;
+}
+
 uint8_t FPGA::read_halls(uint8_t* halls, size_t size) {
     uint8_t status;
 
@@ -173,7 +404,7 @@ uint8_t FPGA::read_duty_cycles(int16_t* duty_cycles, size_t size) {
     for (size_t i = 0; i < size; i++) {
         uint16_t dc = _spi_bus->transmitReceive(0x00) << 8;
         dc |= _spi_bus->transmitReceive(0x00);
-        duty_cycles[i] = fromSignMag<9>(dc);
+        duty_cycles[i] = fromDutyWord(dc);
     }
 
     chip_deselect();
@@ -185,7 +416,7 @@ uint8_t FPGA::set_duty_cycles(int16_t* duty_cycles, size_t size) {
     uint8_t status;
 
     if (size != 5) {
-        printf("[WARN] FPGA: set_duty_cycles() requires input buffer to be of size 5\r\n");
+        LOG_WARN("FPGA: set_duty_cycles() requires input buffer to be of size 5");
     }
 
     // Check for valid duty cycles values
@@ -197,7 +428,7 @@ uint8_t FPGA::set_duty_cycles(int16_t* duty_cycles, size_t size) {
 
 
     for (size_t i = 0; i < size; i++) {
-        uint16_t dc = toSignMag<9>(duty_cycles[i]);
+        uint16_t dc = duty_word(duty_cycles[i]);
         _spi_bus->transmit(dc & 0xFF);
         _spi_bus->transmit(dc >> 8);
     }
@@ -213,7 +444,7 @@ uint8_t FPGA::set_duty_get_enc(int16_t* duty_cycles, size_t size_dut,
     uint8_t status;
 
     if (size_dut != 5 || size_enc != 5) {
-        printf("[WARN] FPGA: set_duty_get_enc() requires input buffers to be of size 5\r\n");
+        LOG_WARN("FPGA: set_duty_get_enc() requires input buffers to be of size 5");
     }
 
     // Check for valid duty cycles values
@@ -225,17 +456,130 @@ uint8_t FPGA::set_duty_get_enc(int16_t* duty_cycles, size_t size_dut,
     status = _spi_bus->transmitReceive(CMD_R_ENC_W_VEL);
 
     for (size_t i = 0; i < 5; i++) {
-        uint16_t dc = toSignMag<9>(duty_cycles[i]);
+        uint16_t dc = duty_word(duty_cycles[i]);
+        uint16_t enc = _spi_bus->transmitReceive(dc & 0xFF) << 8;
+        enc |= _spi_bus->transmitReceive(dc >> 8);
+        enc_deltas[i] = static_cast<int16_t>(enc);
+    }
+
+    chip_deselect();
+
+    return status;
+}
+
+uint8_t FPGA::set_duty_get_enc_cur(int16_t* duty_cycles, size_t size_dut,
+                                   int16_t* enc_deltas, size_t size_enc,
+                                   uint16_t* currents, size_t size_cur) {
+    _spi_bus->frequency(400'000);
+    uint8_t status;
+
+    if (size_dut != 5 || size_enc != 5 || size_cur != 5) {
+        LOG_WARN("FPGA: set_duty_get_enc_cur() requires input buffers to be of size 5");
+    }
+
+    // A legacy design has no currents to send back
+    if (legacy_design()) {
+        std::fill(currents, currents + size_cur, 0);
+        return set_duty_get_enc(duty_cycles, size_dut, enc_deltas, size_enc);
+    }
+
+    // Check for valid duty cycles values
+    for (size_t i = 0; i < size_dut; i++) {
+        if (abs(duty_cycles[i]) > MAX_DUTY_CYCLE) return 0x7F;
+    }
+
+    chip_select();
+    status = _spi_bus->transmitReceive(CMD_R_ENC_CUR_W_VEL);
+
+    for (size_t i = 0; i < 5; i++) {
+        uint16_t dc = duty_word(duty_cycles[i]);
         uint16_t enc = _spi_bus->transmitReceive(dc & 0xFF) << 8;
         enc |= _spi_bus->transmitReceive(dc >> 8);
         enc_deltas[i] = static_cast<int16_t>(enc);
     }
 
+    // Currents follow with the high byte first
+    for (size_t i = 0; i < 5; i++) {
+        uint16_t cur = _spi_bus->transmitReceive(0x00) << 8;
+        cur |= _spi_bus->transmitReceive(0x00);
+        currents[i] = cur;
+    }
+
     chip_deselect();
 
     return status;
 }
 
+uint8_t FPGA::set_duty_get_all(int16_t* duty_cycles, size_t size_dut,
+                               FPGATelemetry& telemetry) {
+    _spi_bus->frequency(400'000);
+
+    if (size_dut != 5) {
+        LOG_WARN("FPGA: set_duty_get_all() requires input buffer to be of size 5");
+    }
+
+    if (legacy_design()) {
+        return set_duty_get_all_legacy(duty_cycles, size_dut, telemetry);
+    }
+
+    // Check for valid duty cycles values
+    for (size_t i = 0; i < size_dut; i++) {
+        if (abs(duty_cycles[i]) > MAX_DUTY_CYCLE) return 0x7F;
+    }
+
+    // The command and duty cycles go out first, the rest is clocked out with
+    // zeros. It's one burst, the response replaces them in the same buffer.
+    auto buffer = reinterpret_cast<uint8_t*>(&telemetry);
+    std::fill(buffer, buffer + sizeof(FPGATelemetry), 0);
+    buffer[0] = CMD_R_ALL_W_VEL;
+    for (size_t i = 0; i < 5; i++) {
+        uint16_t dc = duty_word(duty_cycles[i]);
+        buffer[2 * i + 1] = dc & 0xFF;
+        buffer[2 * i + 2] = dc >> 8;
+    }
+
+    chip_select();
+    _spi_bus->transmitReceive(buffer, sizeof(FPGATelemetry));
+    chip_deselect();
+
+    return telemetry.status;
+}
+
+uint8_t FPGA::set_duty_get_all_legacy(int16_t* duty_cycles, size_t size_dut,
+                                      FPGATelemetry& telemetry) {
+    std::array<int16_t, 5> encDeltas{};
+    telemetry = FPGATelemetry{};
+    telemetry.status = set_duty_get_enc(duty_cycles, size_dut, encDeltas.data(), encDeltas.size());
+
+    const uint16_t ticks = static_cast<uint16_t>(encDeltas[4]);
+    telemetry.watchdog_ticks[0] = ticks >> 8;
+    telemetry.watchdog_ticks[1] = ticks & 0xFF;
+
+    for (size_t i = 0; i < 4; i++) {
+        const uint16_t delta = static_cast<uint16_t>(encDeltas[i]);
+        telemetry.enc_deltas[i][0] = delta >> 8;
+        telemetry.enc_deltas[i][1] = delta & 0xFF;
+
+        // Averaged over the time since the last update, in the same fixed
+        // point as the velocities the FPGA works out itself
+        int64_t velocity = 0;
+        if (ticks != 0) {
+            velocity = int64_t{encDeltas[i]} * FPGA_CLK_FREQ * (1 << FPGATelemetry::ENC_VELOCITY_FRAC_BITS) /
+                       (ticks * WATCHDOG_TICK_CYCLES);
+            velocity = std::clamp<int64_t>(velocity, std::numeric_limits<int32_t>::min(),
+                                           std::numeric_limits<int32_t>::max());
+        }
+
+        const uint32_t v = static_cast<uint32_t>(velocity);
+        telemetry.velocities[i][0] = v >> 24;
+        telemetry.velocities[i][1] = (v >> 16) & 0xFF;
+        telemetry.velocities[i][2] = (v >> 8) & 0xFF;
+        telemetry.velocities[i][3] = v & 0xFF;
+    }
+
+    return telemetry.status;
+}
+
 bool FPGA::git_hash(std::vector<uint8_t>& v) {
     bool dirty_bit;
 
@@ -282,6 +626,40 @@ void FPGA::gate_drivers(std::vector<uint16_t>& v) {
     chip_deselect();
 }
 
+uint8_t FPGA::set_pwm_frequency(uint32_t frequency) {
+    uint8_t status;
+
+    if (legacy_design()) {
+        return 0x7F;
+    }
+
+    // Nearest whole number of clock cycles, limited to the periods the FPGA supports
+    uint32_t cycles = (frequency == 0) ? PWM_PERIOD_MAX + 1 : (FPGA_CLK_FREQ + frequency / 2) / frequency;
+    uint16_t period = std::clamp(cycles, PWM_PERIOD_MIN + 1, PWM_PERIOD_MAX + 1) - 1;
+
+    chip_select();
+    status = _spi_bus->transmitReceive(CMD_W_PWM_PERIOD);
+    _spi_bus->transmit(period & 0xFF);
+    _spi_bus->transmit(period >> 8);
+    chip_deselect();
+
+    return status;
+}
+
+uint32_t FPGA::read_pwm_frequency() {
+    if (legacy_design()) {
+        return LEGACY_PWM_FREQUENCY;
+    }
+
+    chip_select();
+    _spi_bus->transmit(CMD_READ_PWM_PERIOD);
+    uint16_t period = _spi_bus->transmitReceive(0x00) << 8;
+    period |= _spi_bus->transmitReceive(0x00);
+    chip_deselect();
+
+    return FPGA_CLK_FREQ / (period + 1);
+}
+
 uint8_t FPGA::motors_en(bool state) {
     uint8_t status;
 
@@ -307,3 +685,7 @@ void FPGA::chip_deselect() {
 
 bool FPGA::isReady() { return _isInit; }
 
+uint16_t FPGA::duty_word(int16_t duty) const {
+    return legacy_design() ? toLegacyDutyWord(duty) : toDutyWord(duty);
+}
+
@@ -0,0 +1,177 @@
+#include "drivers/I2CBusManager.hpp"
+#include "delay.h"
+#include "Logger.hpp"
+
+#include <algorithm>
+#include <vector>
+
+I2CBusManager::I2CBusManager(LockedStruct<I2C>& sharedI2C)
+    : sharedI2C(sharedI2C) {
+    for (QueueHandle_t& queue : queues) {
+        queue = xQueueCreate(kQueueLength, sizeof(Transaction));
+    }
+    pending = xSemaphoreCreateCounting(kQueueLength * queues.size(), 0);
+}
+
+I2CBusManager::DeviceId I2CBusManager::addDevice(const char* name, Priority priority) {
+    if (numDevices == kMaxDevices) {
+        // Still works, it just shares the last device's stats
+        LOG_ERROR("I2C: No room for device %s, raise kMaxDevices", name);
+        return kMaxDevices - 1;
+    }
+
+    Device& device = devices[numDevices];
+    device.name = name;
+    device.priority = priority;
+    device.done = xSemaphoreCreateBinary();
+    return numDevices++;
+}
+
+bool I2CBusManager::write(DeviceId device, uint8_t address, uint8_t regAddr,
+                          const uint8_t* data, uint8_t length,
+                          Callback callback, void* context) {
+    if (length > kMaxWriteLength) {
+        return false;
+    }
+
+    Transaction transaction{};
+    transaction.device = device;
+    transaction.address = address;
+    transaction.regAddr = regAddr;
+    transaction.isRead = false;
+    transaction.length = length;
+    std::copy(data, data + length, transaction.writeData);
+    transaction.callback = callback;
+    transaction.context = context;
+
+    submit(transaction);
+    return true;
+}
+
+I2CBusManager::Result I2CBusManager::read(DeviceId device, uint8_t address, uint8_t regAddr,
+                                          uint8_t* data, uint8_t length) {
+    Transaction transaction{};
+    transaction.device = device;
+    transaction.address = address;
+    transaction.regAddr = regAddr;
+    transaction.isRead = true;
+    transaction.length = length;
+    transaction.readData = data;
+    return submitAndWait(transaction);
+}
+
+I2CBusManager::Result I2CBusManager::writeAndWait(DeviceId device, uint8_t address, uint8_t regAddr,
+                                                  const uint8_t* data, uint8_t length) {
+    if (length > kMaxWriteLength) {
+        return Result{};
+    }
+
+    Transaction transaction{};
+    transaction.device = device;
+    transaction.address = address;
+    transaction.regAddr = regAddr;
+    transaction.isRead = false;
+    transaction.length = length;
+    std::copy(data, data + length, transaction.writeData);
+    return submitAndWait(transaction);
+}
+
+void I2CBusManager::submit(Transaction& transaction) {
+    transaction.submitted = DWT_GetTick();
+    QueueHandle_t queue = queues[static_cast<size_t>(devices[transaction.device].priority)];
+    // The queue only stays full until the bus task gets to it, a burst of
+    // writes like a reset fills it
+    xQueueSendToBack(queue, &transaction, portMAX_DELAY);
+    xSemaphoreGive(pending);
+}
+
+I2CBusManager::Result I2CBusManager::submitAndWait(Transaction& transaction) {
+    Result result{};
+    transaction.result = &result;
+
+    // The buffer has to stay put until it's done
+    submit(transaction);
+    xSemaphoreTake(devices[transaction.device].done, portMAX_DELAY);
+    return result;
+}
+
+void I2CBusManager::service(TickType_t wait) {
+    while (xSemaphoreTake(pending, wait) == pdTRUE) {
+        Transaction transaction;
+        // Every low priority transaction waits for the high ones queued
+        // while it did
+        if (xQueueReceive(queues[static_cast<size_t>(Priority::High)], &transaction, 0) == pdTRUE ||
+            xQueueReceive(queues[static_cast<size_t>(Priority::Low)], &transaction, 0) == pdTRUE) {
+            run(transaction);
+        }
+        wait = 0;
+    }
+}
+
+void I2CBusManager::run(Transaction& transaction) {
+    bool success;
+    uint32_t start;
+    uint32_t end;
+    {
+        auto i2cLock = sharedI2C.lock();
+        start = DWT_GetTick();
+        if (transaction.isRead) {
+            std::vector<uint8_t> data = i2cLock->receive(transaction.address, transaction.regAddr,
+                                                         transaction.length);
+            success = data.size() >= transaction.length;
+            if (success) {
+                std::copy(data.begin(), data.begin() + transaction.length, transaction.readData);
+            }
+        } else {
+            std::vector<uint8_t> data(transaction.writeData,
+                                      transaction.writeData + transaction.length);
+            i2cLock->transmit(transaction.address, transaction.regAddr, data);
+            success = true;
+        }
+        end = DWT_GetTick();
+    }
+
+    const uint32_t cyclesPerUs = DWT_SysTick_To_us();
+    const uint32_t busTime = (end - start) / cyclesPerUs;
+    const uint32_t latency = (end - transaction.submitted) / cyclesPerUs;
+
+    Device& device = devices[transaction.device];
+    device.transactions++;
+    device.failures += success ? 0 : 1;
+    device.totalLatency += latency;
+    device.maxLatency = std::max(device.maxLatency, latency);
+    device.busTime += busTime;
+
+    if (transaction.callback != nullptr) {
+        transaction.callback(transaction.context, success);
+    }
+    if (transaction.result != nullptr) {
+        transaction.result->success = success;
+        transaction.result->busTime = busTime;
+        xSemaphoreGive(device.done);
+    }
+}
+
+void I2CBusManager::logStats() {
+    const uint32_t now = HAL_GetTick();
+    const uint32_t elapsed = std::max<uint32_t>(now - statsStart, 1);
+
+    for (size_t i = 0; i < numDevices; i++) {
+        Device& device = devices[i];
+        const uint32_t averageLatency = device.transactions == 0 ? 0 : device.totalLatency / device.transactions;
+        // Bus time in us over elapsed time in ms is in tenths of a percent
+        const uint32_t utilization = device.busTime / elapsed;
+
+        LOG_INFO("I2C %s: %lu transactions, %lu failed",
+                 device.name, device.transactions, device.failures);
+        LOG_INFO("  latency %lu us avg, %lu us max, bus busy %lu.%lu%%",
+                 averageLatency, device.maxLatency, utilization / 10, utilization % 10);
+
+        device.transactions = 0;
+        device.failures = 0;
+        device.totalLatency = 0;
+        device.maxLatency = 0;
+        device.busTime = 0;
+    }
+    statsStart = now;
+}
@@ -5,6 +5,10 @@
 // 2013-01-08 - first release
 
 #include "drivers/Internal/I2Cdev.h"
+#include "DigitalIn.hpp"
+#include "DigitalOut.hpp"
+#include "delay.h"
+#include "Logger.hpp"
 
 /** Read a single bit from an 8-bit device register.
  * @param devAddr I2C slave device address
@@ -133,10 +137,12 @@ int8_t I2Cdev::readWord(uint8_t devAddr, uint8_t regAddr, uint16_t* data,
  */
 int8_t I2Cdev::readBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length,
                          uint8_t* data, uint16_t timeout) {
-    std::vector<uint8_t> ret = i2c->receive(devAddr << 1, regAddr, length);
+    if (!beginTransaction()) {
+        return -1;
+    }
 
-    for (int i = 0; i < length; i++) {
-        data[i] = ret[i];
+    if (!endTransaction(i2cBus.read(device, devAddr << 1, regAddr, data, length))) {
+        return -1;
     }
 
     return length;
@@ -157,7 +163,9 @@ int8_t I2Cdev::readWords(uint8_t devAddr, uint8_t regAddr, uint8_t length,
 bool I2Cdev::writeBit(uint8_t devAddr, uint8_t regAddr, uint8_t bitNum,
                       uint8_t data) {
     uint8_t b;
-    readByte(devAddr, regAddr, &b);
+    if (readByte(devAddr, regAddr, &b) < 0) {
+        return false;
+    }
     b = (data != 0) ? (b | (1 << bitNum)) : (b & ~(1 << bitNum));
     return writeByte(devAddr, regAddr, b);
 }
@@ -195,7 +203,7 @@ bool I2Cdev::writeBits(uint8_t devAddr, uint8_t regAddr, uint8_t bitStart,
     // 10100011 original & ~mask
     // 10101011 masked | value
     uint8_t b;
-    if (readByte(devAddr, regAddr, &b) != 0) {
+    if (readByte(devAddr, regAddr, &b) > 0) {
         uint8_t mask = ((1 << length) - 1) << (bitStart - length + 1);
         data <<= (bitStart - length + 1);  // shift data into correct position
         data &= mask;  // zero all non-important bits in data
@@ -263,13 +271,11 @@ bool I2Cdev::writeWord(uint8_t devAddr, uint8_t regAddr, uint16_t data) {
 
 bool I2Cdev::writeBytes(uint8_t devAddr, uint8_t regAddr, uint8_t length,
                         uint8_t* data) {
-    std::vector<uint8_t> sendData;
-    for (int i = 0; i < length; i++) {
-        sendData.push_back(data[i]);
+    if (!beginTransaction()) {
+        return false;
     }
 
-    i2c->transmit(devAddr << 1, regAddr, sendData);
-    return true;
+    return endTransaction(i2cBus.writeAndWait(device, devAddr << 1, regAddr, data, length));
 }
 
 bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length,
@@ -312,3 +318,105 @@ bool I2Cdev::writeWords(uint8_t devAddr, uint8_t regAddr, uint8_t length,
 }
 
 uint16_t I2Cdev::readTimeout(void) { return 0; }
+
+bool I2Cdev::beginTransaction() {
+    if (!isOffline()) {
+        return true;
+    }
+
+    const uint32_t now = HAL_GetTick();
+    if (now - lastRetry < kOfflineRetryPeriod) {
+        return false;
+    }
+    lastRetry = now;
+    return true;
+}
+
+bool I2Cdev::endTransaction(const I2CBusManager::Result& result) {
+    stats.transactions++;
+
+    if (result.success && result.busTime <= kTransactionTimeout * 1000) {
+        if (isOffline()) {
+            LOG_INFO("I2Cdev: Device back after %lu timeouts", consecutiveTimeouts);
+        }
+        consecutiveTimeouts = 0;
+        return true;
+    }
+
+    stats.timeouts++;
+    consecutiveTimeouts++;
+    if (consecutiveTimeouts == kMaxConsecutiveTimeouts) {
+        LOG_WARN("I2Cdev: Device offline after %lu timeouts in a row", consecutiveTimeouts);
+    }
+
+    // Only after the transaction, the bus task has let go of the bus
+    auto i2cLock = i2cBus.i2c().lock();
+    recoverBus(i2cLock);
+    return false;
+}
+
+void I2Cdev::recoverBus(LockedStruct<I2C>::Lock& i2cLock) {
+    if (!recoveryBus || !recoveryPins) {
+        return;
+    }
+
+    I2C_TypeDef* const peripheral = i2cPeripheral(*recoveryBus);
+    if (peripheral == nullptr) {
+        return;
+    }
+
+    stats.recoveries++;
+
+    // A device that was part way through sending a byte when the master
+    // gave up is still holding SDA low for its next bit. Clocking it
+    // lets it finish, at 100 kHz.
+    {
+        DigitalOut scl(recoveryPins->scl, PullType::PullUp, PinMode::OpenDrain);
+        DigitalIn sda(recoveryPins->sda, PullType::PullUp);
+        scl = 1;
+        for (int i = 0; i < 9 && !sda.read(); i++) {
+            DWT_Delay(5);
+            scl = 0;
+            DWT_Delay(5);
+            scl = 1;
+        }
+    }
+
+    // Stop, SDA rising while SCL is high
+    {
+        DigitalOut sda(recoveryPins->sda, PullType::PullUp, PinMode::OpenDrain);
+        DigitalOut scl(recoveryPins->scl, PullType::PullUp, PinMode::OpenDrain);
+        sda = 0;
+        DWT_Delay(5);
+        scl = 1;
+        DWT_Delay(5);
+        sda = 1;
+        DWT_Delay(5);
+    }
+
+    // Hand the pins back to the I2C peripheral
+    for (const PinName& pin : {recoveryPins->scl, recoveryPins->sda}) {
+        GPIO_InitTypeDef pinInit = {};
+        pinInit.Pin = pin.pin;
+        pinInit.Mode = GPIO_MODE_AF_OD;
+        pinInit.Pull = GPIO_PULLUP;
+        pinInit.Speed = GPIO_SPEED_FREQ_VERY_HIGH;
+        pinInit.Alternate = GPIO_AF4_I2C1;
+        HAL_GPIO_Init(pin.port, &pinInit);
+    }
+
+    // It also has to forget the transaction it gave up on. Clearing PE is
+    // the peripheral's own software reset: it clears the state machine and
+    // status flags but keeps the timing and addressing the I2C driver set
+    // up, so the driver's handle stays valid. PE has to stay low for 3 APB
+    // clock cycles, which reading it back twice covers.
+    CLEAR_BIT(peripheral->CR1, I2C_CR1_PE);
+    (void)READ_REG(peripheral->CR1);
+    (void)READ_REG(peripheral->CR1);
+    SET_BIT(peripheral->CR1, I2C_CR1_PE);
+}
+
+I2C_TypeDef* I2Cdev::i2cPeripheral(I2CBus bus) {
+    // The pins are handed back with I2C1's alternate function
+    return (bus == I2CBus::I2CBus1) ? I2C1 : nullptr;
+}
@@ -2,6 +2,7 @@
 #include "delay.h"
 #include <cstring>
 #include "interrupt_in.h"
+#include "Logger.hpp"
 
 #include "FreeRTOS.h"
 #include "task.h"
@@ -318,7 +319,7 @@ void ISM43340::reset() {
         isInit = !interruptin_read(dataReady);
 
         if (isInit) {
-            printf("Could not initialize radio\r\n");
+            LOG_ERROR("ISM43340: Could not initialize radio");
             //return;
         } else {
             break;
@@ -382,7 +383,7 @@ void ISM43340::reset() {
         // Failed to connect to network
         // not sure what to have it do here
         connected = false;
-        printf("Failed to connect to network\r\n");
+        LOG_ERROR("ISM43340: Failed to connect to network");
         return;
     }
 
@@ -430,5 +431,5 @@ void ISM43340::reset() {
 
     currentSocket = SOCKET_TYPE::SEND;
     connected = true;
-    printf("Radio initialized\r\n");
+    LOG_INFO("ISM43340: Radio initialized");
 }
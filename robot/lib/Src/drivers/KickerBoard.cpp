@@ -1,26 +1,27 @@
 #include "drivers/KickerBoard.hpp"
 
 #include "delay.h"
+#include "Logger.hpp"
 #include "device-bins/kicker_bin.h"
 #include <tuple>
 
 using namespace std;
 
-KickerBoard::KickerBoard(LockedStruct<SPI>& spi, std::shared_ptr<DigitalOut> nCs,
+KickerBoard::KickerBoard(SPIBusManager& spiBus, std::shared_ptr<DigitalOut> nCs,
                          PinName nReset)
-    : AVR910(spi, nCs, nReset)  {}
+    : AVR910(spiBus, nCs, nReset),
+      frameDevice_(spiBus.addDevice({"kicker", FRAME_HZ, nCs, CS_SETUP_US, CS_HOLD_US})) {}
 
 bool KickerBoard::verify_param(const char* name, char expected,
                                int (AVR910::*paramMethod)(), char mask,
                                bool verbose) {
-    if (verbose) printf("Checking %s...", name);
     int val = (*this.*paramMethod)();
     bool success = ((val & mask) == expected);
     if (verbose) {
         if (success) {
-            printf("done\r\n");
+            LOG_INFO("Kicker: Checking %s...done", name);
         } else {
-            printf("Got unexpected value: 0x%X\r\n", val);
+            LOG_WARN("Kicker: Checking %s...got unexpected value: 0x%X", name, val);
         }
     }
 
@@ -59,7 +60,7 @@ bool KickerBoard::flash(const string& proFilename,
         //LOG(INFO, "Opened kicker binary, attempting to program kicker.");
         bool shouldProgram = true;
         if (onlyIfDifferent &&
-            (checkMemory(ATTINY_PAGESIZE, ATTINY_NUM_PAGES, fp, false) == 0))
+            checkMemory(ATTINY_PAGESIZE, ATTINY_NUM_PAGES, fp, false))
             shouldProgram = false;
 
         if (!shouldProgram) {
@@ -68,6 +69,8 @@ bool KickerBoard::flash(const string& proFilename,
             // exit programming mode by bringing nReset high
             exitProgramming();
         } else {
+            keepEeprom(verbose);
+            undivideClock(verbose);
             bool success = program(fp, ATTINY_PAGESIZE, ATTINY_NUM_PAGES);
 
             if (!success) {
@@ -84,6 +87,17 @@ bool KickerBoard::flash(const string& proFilename,
 }
 
 bool KickerBoard::flash(bool onlyIfDifferent, bool verbose) {
+    const uint8_t* progBinary = KICKER_BYTES;
+    unsigned int length = KICKER_BYTES_LEN;
+
+    // The kicker firmware reports a CRC of its flash, which is much faster
+    // than reading it back over ISP. Firmware without the read command
+    // just never matches.
+    if (onlyIfDifferent && checkFlashCrc(binaryCrc(progBinary, length))) {
+        LOG_INFO("Kicker: Flash CRC matches, no need to flash.");
+        return true;
+    }
+
     if (!init()) {
         return false;
     }
@@ -105,81 +119,274 @@ bool KickerBoard::flash(bool onlyIfDifferent, bool verbose) {
         }
     }
 
-    const uint8_t* progBinary = KICKER_BYTES;
-    unsigned int length = KICKER_BYTES_LEN;
-
-    printf("[INFO] Kicker: Attempting to program kicker.\r\n");
+    LOG_INFO("Kicker: Attempting to program kicker.");
     bool shouldProgram = true;
+    // Reading back every byte is slow, only do it when the CRC didn't match
     if (onlyIfDifferent &&
-        (checkMemory(ATTINY_PAGESIZE, ATTINY_NUM_PAGES, progBinary, length, false) == 0))
+        checkMemory(ATTINY_PAGESIZE, ATTINY_NUM_PAGES, progBinary, length, false))
         shouldProgram = false;
     
     if (!shouldProgram) {
-        printf("[INFO] Kicker: Kicker up-to-date, no need to flash.\r\n");
+        LOG_INFO("Kicker: Kicker up-to-date, no need to flash.");
 
         // exit programming mode by bringing nReset high
         exitProgramming();
+        return true;
+    }
+
+    keepEeprom(verbose);
+    undivideClock(verbose);
+    bool success = program(progBinary, length, ATTINY_PAGESIZE, ATTINY_NUM_PAGES);
+
+    if (!success) {
+        LOG_WARN("Kicker: Failed to program kicker.");
     } else {
-        bool success = program(progBinary, length, ATTINY_PAGESIZE, ATTINY_NUM_PAGES);
+        LOG_INFO("Kicker: Kicker successfully programmed.");
+    }
 
-        if (!success) {
-            printf("[WARN] Kicker: Failed to program kicker.\r\n");
-        } else {
-            printf("[INFO] Kicker: Kicker successfully programmed.\r\n");
+    return success;
+}
+
+void KickerBoard::keepEeprom(bool verbose) {
+    const int fuses = readFuseBitsHigh();
+
+    if (!(fuses & FUSE_HIGH_EESAVE)) {
+        return;
+    }
+
+    // Programmed bits read 0, anything else isn't a sane read of a
+    // kicker's fuses and writing it back could lock the chip out of ISP
+    if ((fuses & (FUSE_HIGH_RSTDISBL | FUSE_HIGH_DWEN | FUSE_HIGH_SPIEN)) !=
+        (FUSE_HIGH_RSTDISBL | FUSE_HIGH_DWEN)) {
+        LOG_WARN("Kicker: Unexpected high fuse 0x%02X, the kick calibration won't survive flashing",
+                 fuses);
+        return;
+    }
+
+    writeFuseBitsHigh(fuses & ~FUSE_HIGH_EESAVE);
+
+    if (verbose) {
+        LOG_INFO("Kicker: Set EESAVE, high fuse 0x%02X", readFuseBitsHigh());
+    }
+}
+
+void KickerBoard::undivideClock(bool verbose) {
+    const int fuses = readFuseBitsLow();
+
+    if (fuses & FUSE_LOW_CKDIV8) {
+        return;
+    }
+
+    // The firmware takes the RC oscillator to 8 MHz as it boots anyway, a
+    // kicker on any other clock is left alone
+    if ((fuses & FUSE_LOW_CKSEL_MASK) != FUSE_LOW_CKSEL_RC_8MHZ) {
+        LOG_WARN("Kicker: Unexpected low fuse 0x%02X, flashing stays at %d Hz",
+                 fuses, ISP_SLOW_HZ);
+        return;
+    }
+
+    writeFuseBitsLow(fuses | FUSE_LOW_CKDIV8);
+
+    if (verbose) {
+        LOG_INFO("Kicker: Cleared CKDIV8, low fuse 0x%02X", readFuseBitsLow());
+    }
+}
+
+uint16_t KickerBoard::binaryCrc(const uint8_t* binary, unsigned int length) {
+    uint16_t crc = KICKER_CRC_INIT;
+    for (unsigned int i = 0; i < FLASH_SIZE; i++) {
+        // Anything past the binary was left erased
+        crc = kicker_crc_update(crc, i < length ? binary[i] : 0xFF);
+    }
+    return crc;
+}
+
+uint16_t KickerBoard::readFlashCrc() {
+    // Each reply comes back in the transfer after the read
+    transfer(READ_FLASH_CRC_LOW);
+    uint8_t low = transfer(READ_FLASH_CRC_HIGH);
+    uint8_t high = transfer(READ_FLASH_CRC_LOW);
+    return static_cast<uint16_t>(high << 8 | low);
+}
+
+uint16_t KickerBoard::readKickLatency() {
+    transfer(READ_KICK_LATENCY_LOW);
+    uint8_t low = transfer(READ_KICK_LATENCY_HIGH);
+    uint8_t high = transfer(READ_KICK_LATENCY_LOW);
+    return static_cast<uint16_t>(high << 8 | low);
+}
+
+bool KickerBoard::checkFlashCrc(uint16_t expected) {
+    // Let the kicker run, it computes the CRC as it boots
+    nReset_ = 1;
+
+    uint16_t crc = 0;
+    for (int i = 0; i < FLASH_CRC_TRIES; i++) {
+        vTaskDelay(FLASH_CRC_RETRY_MS);
+
+        crc = readFlashCrc();
+        if (crc == expected) {
+            return true;
+        }
+    }
+
+    LOG_INFO("Kicker: Flash CRC 0x%04X, expected 0x%04X", crc, expected);
+    return false;
+}
+
+bool KickerBoard::checkProtocolVersion() {
+    uint8_t version = 0;
+    uint8_t latency = 0;
+    for (int i = 0; i < FLASH_CRC_TRIES; i++) {
+        // Each reply comes back in the transfer after the read. v1 firmware
+        // answers every byte with its status, so the version only counts
+        // if the latency read, 0 after a reset, answers something else.
+        transfer(READ_PROTOCOL_VERSION);
+        version = transfer(READ_KICK_LATENCY_HIGH);
+        latency = transfer(READ_PROTOCOL_VERSION);
+        if (version == KICKER_PROTOCOL_VERSION && latency != version) {
+            _protocol_version = KICKER_PROTOCOL_VERSION;
+            return true;
+        }
+
+        vTaskDelay(FLASH_CRC_RETRY_MS);
+    }
+
+    // Anything older takes every byte of a frame as a kick command
+    LOG_WARN("Kicker: Firmware doesn't speak protocol %u (replied %u), using v1 commands",
+             KICKER_PROTOCOL_VERSION, version);
+    _protocol_version = 1;
+    return false;
+}
+
+uint8_t KickerBoard::transfer(uint8_t command) {
+    auto spi = spiBus_.acquire(frameDevice_);
+    return spi->transmitReceive(command);
+}
+
+void KickerBoard::transferFrame(const uint8_t* command, uint8_t* reply) {
+    auto spi = spiBus_.acquire(frameDevice_);
+    for (int i = 0; i < KICKER_FRAME_LENGTH; i++) {
+        if (i > 0) {
+            DWT_Delay(FRAME_BYTE_GAP_US);
         }
+        reply[i] = spi->transmitReceive(command[i]);
+    }
+}
+
+bool KickerBoard::parseStatus(const uint8_t* status) {
+    const uint16_t crc = status[FRAME_STATUS_CRC] |
+                         static_cast<uint16_t>(status[FRAME_STATUS_CRC + 1] << 8);
+    if (status[FRAME_STATUS_VERSION] != KICKER_PROTOCOL_VERSION ||
+        kicker_frame_crc(status, FRAME_STATUS_CRC) != crc) {
+        return false;
     }
 
+    const uint16_t now = status[FRAME_STATUS_TIME] |
+                         static_cast<uint16_t>(status[FRAME_STATUS_TIME + 1] << 8);
+    const uint16_t ballSensedTime = status[FRAME_STATUS_BREAKBEAM_TIME] |
+                                    static_cast<uint16_t>(status[FRAME_STATUS_BREAKBEAM_TIME + 1] << 8);
+
+    _state = status[FRAME_STATUS_STATE];
+    _faults = status[FRAME_STATUS_FAULTS];
+    _current_voltage = status[FRAME_STATUS_VOLTAGE];
+    _accepted_sequence = status[FRAME_STATUS_ACCEPTED_SEQUENCE];
+    _fired_sequence = status[FRAME_STATUS_FIRED_SEQUENCE];
+    _ball_sensed = _state & STATE_BALL_SENSED;
+    _ball_sensed_ticks = now - ballSensedTime;
     return true;
 }
 
 void KickerBoard::service() {
-    uint8_t command = 0x00;
+    if (_protocol_version == 0) {
+        return;
+    }
+
+    if (_protocol_version == 1) {
+        serviceV1();
+        return;
+    }
+
+    uint8_t flags = 0x00;
 
     if (_is_kick)
-        command |= TYPE_KICK;
+        flags |= TYPE_KICK;
     else
-        command |= TYPE_CHIP;
+        flags |= TYPE_CHIP;
 
-    if (_kick_immediate) {
-        command |= KICK_IMMEDIATE;
-        _kick_immediate = false;
+    // Once the kicker has taken it, it's only repeated as a no-op, so a
+    // kicker that reset doesn't fire an old kick
+    if (_accepted_sequence != _sequence) {
+        flags |= _activation;
     }
 
-    if (_kick_breakbeam) {
-        command |= KICK_ON_BREAKBEAM;
-        _kick_breakbeam = false;
+    if (_charge_allowed) {
+        flags |= CHARGE_ALLOWED;
     }
 
-    if (_cancel_kick) {
-        command |= CANCEL_KICK;
-        _cancel_kick = false;
+    uint8_t command[KICKER_FRAME_LENGTH] = {};
+    command[FRAME_CMD_VERSION] = KICKER_PROTOCOL_VERSION;
+    command[FRAME_CMD_FLAGS] = flags;
+    command[FRAME_CMD_STRENGTH] = _kick_strength;
+    command[FRAME_CMD_SEQUENCE] = _sequence;
+    const uint16_t crc = kicker_frame_crc(command, FRAME_CMD_CRC);
+    command[FRAME_CMD_CRC] = crc & 0xFF;
+    command[FRAME_CMD_CRC + 1] = crc >> 8;
+
+    uint8_t reply[KICKER_FRAME_LENGTH];
+    transferFrame(command, reply);
+
+    if (!parseStatus(reply + FRAME_STATUS_OFFSET)) {
+        if (_bad_frames < MAX_BAD_FRAMES) {
+            _bad_frames++;
+        }
+        return;
     }
+    _bad_frames = 0;
 
-    if (_charge_allowed) {
-        command |= CHARGE_ALLOWED;
+    if ((_state ^ _last_state) & STATE_CALIBRATED) {
+        if (_state & STATE_CALIBRATED) {
+            LOG_INFO("Kicker: Kick strength calibrated to ball speed");
+        } else {
+            LOG_WARN("Kicker: No kick calibration, strength is FET on time");
+        }
     }
+    _last_state = _state;
+
+    // Only an instrumented kicker build measures it, the rest say 0
+    if (_fired_sequence != _last_fired_sequence &&
+        _fired_sequence == _sequence && _activation == KICK_ON_BREAKBEAM) {
+        uint16_t latency = readKickLatency();
+        if (latency != 0) {
+            LOG_INFO("Kicker: Breakbeam to FET on in %u cycles", latency);
+        }
+    }
+    _last_fired_sequence = _fired_sequence;
+}
 
-    command |= static_cast<uint8_t>(static_cast<float>(_kick_strength)/255 * 0xF) & KICK_POWER_MASK;
-
-    auto spi_lock = lock_spi();
-    spi_lock->frequency(100'000);
-
-    // Transmit byte over to kicker
-    // Must wait at least 10 us such that the isr actually triggers
-    nCs_->write(0);
-    DWT_Delay(50);
-    uint8_t resp = spi_lock->transmitReceive(command);
-    DWT_Delay(50);
-    nCs_->write(1);
-
+void KickerBoard::serviceV1() {
+    uint8_t command = _is_kick ? TYPE_KICK : TYPE_CHIP;
 
-    _current_voltage = (resp & VOLTAGE_MASK) * VOLTAGE_SCALE;
+    // There's no sequence in v1, the activation is sent once and counts
+    // as taken. It can't say when a kick on breakbeam fires either.
+    if (_accepted_sequence != _sequence) {
+        command |= _activation;
+        _accepted_sequence = _sequence;
+        _fired_sequence = _sequence;
+    }
 
-    _ball_sensed = resp & BREAKBEAM_TRIPPED;
+    if (_charge_allowed) {
+        command |= CHARGE_ALLOWED;
+    }
 
+    // A cancel with power is a read
+    if ((command & CANCEL_KICK) != CANCEL_KICK) {
+        command |= (_kick_strength * KICK_POWER_MASK / 255) & KICK_POWER_MASK;
+    }
 
-    // Assume healthy if we get some voltage back
-    _is_healthy = _current_voltage > 0;
+    const uint8_t status = transfer(command);
+    _current_voltage = (status & V1_VOLTAGE_MASK) * V1_VOLTAGE_SCALE;
+    _ball_sensed = status & V1_BREAKBEAM_TRIPPED;
 }
 
 void KickerBoard::kickType(bool isKick) {
@@ -187,32 +394,58 @@ void KickerBoard::kickType(bool isKick) {
 }
 
 void KickerBoard::kick(uint8_t strength) {
-    _kick_immediate = true;
-    _kick_breakbeam = false;
+    _activation = KICK_IMMEDIATE;
     _kick_strength = strength;
-    _cancel_kick = false;
+    _sequence_kicks = true;
+    _sequence++;
 }
 
 void KickerBoard::kickOnBreakbeam(uint8_t strength) {
-    _kick_immediate = false;
-    _kick_breakbeam = true;
+    _activation = KICK_ON_BREAKBEAM;
     _kick_strength = strength;
-    _cancel_kick = false;
+    _sequence_kicks = true;
+    _sequence++;
 }
 
 void KickerBoard::cancelBreakbeam() {
-    _kick_immediate = false;
-    _kick_breakbeam = false;
-    _cancel_kick = true;
+    _activation = CANCEL_KICK;
+    _sequence_kicks = false;
+    _sequence++;
 }
 
 bool KickerBoard::isBallSensed() { return _ball_sensed; }
 
-bool KickerBoard::isHealthy() { return _is_healthy; }
+bool KickerBoard::isHealthy() {
+    // v1 reports no faults, a kicker that's there reads some voltage
+    if (_protocol_version == 1) {
+        return _current_voltage > 0;
+    }
+
+    return _protocol_version != 0 && _bad_frames < MAX_BAD_FRAMES &&
+           (_faults & (FAULT_CHARGE_TIMEOUT | FAULT_OVERVOLTAGE)) == 0;
+}
 
 uint8_t KickerBoard::getVoltage() { return _current_voltage; }
 
-bool KickerBoard::isCharged() { return getVoltage() > isChargedCutoff; }
+bool KickerBoard::isCharged() {
+    if (_protocol_version == 1) {
+        return _current_voltage > V1_CHARGED_VOLTAGE;
+    }
+    return _state & STATE_CHARGED;
+}
+
+bool KickerBoard::isCalibrated() { return _state & STATE_CALIBRATED; }
+
+uint32_t KickerBoard::getBallSensedAge() {
+    return static_cast<uint32_t>(_ball_sensed_ticks) * KICKER_TICK_US;
+}
+
+bool KickerBoard::isKickDone() {
+    return _accepted_sequence == _sequence &&
+           (!_sequence_kicks || _fired_sequence == _sequence);
+}
+
+uint8_t KickerBoard::getFaults() { return _faults; }
 
 void KickerBoard::setChargeAllowed(bool chargeAllowed) {
     _charge_allowed = chargeAllowed;
@@ -1,8 +1,11 @@
 #include "LockedStruct.hpp"
 #include "drivers/MCP23017.hpp"
 
-MCP23017::MCP23017(LockedStruct<I2C>& sharedI2C, int i2cAddress)
-    : _i2c(sharedI2C), _i2cAddress(i2cAddress) {
+MCP23017::MCP23017(I2CBusManager& i2cBus, int i2cAddress)
+    : _i2cBus(i2cBus),
+      // LEDs and the dial can wait behind the IMU
+      _device(i2cBus.addDevice("ioexp", I2CBusManager::Priority::Low)),
+      _i2cAddress(i2cAddress) {
 }
 
 void MCP23017::init() {
@@ -10,8 +13,8 @@ void MCP23017::init() {
 }
 
 void MCP23017::reset() {
-    // Lock is a recursive mutex, so it's okay that child also call it.
-    auto lock = _i2c.lock();
+    // The writes are queued in order, so nothing else can get to the
+    // expander in between
 
     // Set all pins to input mode (via IODIR register)
     inputOutputMask(0xFFFF);
@@ -27,15 +30,15 @@ void MCP23017::reset() {
 }
 
 void MCP23017::writeRegister(MCP23017::Register regAddress, uint16_t data) {
-    auto i2c_lock = _i2c.lock();
-    std::vector<uint8_t> buffer{static_cast<uint8_t>(data & 0xff),
-                                static_cast<uint8_t>(data >> 8)};
-    i2c_lock->transmit(_i2cAddress, regAddress, buffer);
+    // Queued without waiting for it to be sent
+    const uint8_t buffer[2]{static_cast<uint8_t>(data & 0xff),
+                            static_cast<uint8_t>(data >> 8)};
+    _i2cBus.write(_device, _i2cAddress, regAddress, buffer, sizeof(buffer));
 }
 
 uint16_t MCP23017::readRegister(MCP23017::Register regAddress) {
-    auto i2c_lock = _i2c.lock();
-    std::vector<uint8_t> buffer = i2c_lock->receive(_i2cAddress, regAddress, 2);
+    uint8_t buffer[2]{0, 0};
+    _i2cBus.read(_device, _i2cAddress, regAddress, buffer, sizeof(buffer));
 
     return (uint16_t)(buffer[0] | (buffer[1] << 8));
 }
@@ -46,6 +46,7 @@ THE SOFTWARE.
 */
 #include "drivers/MPU6050.h"
 #include <cstring>
+#include "Logger.hpp"
 
 // instead of using pgmspace.h
 typedef const unsigned char prog_uchar;
@@ -55,8 +56,9 @@ typedef const unsigned char prog_uchar;
 /** Default constructor, uses default I2C address.
  * @see MPU6050_DEFAULT_ADDRESS
  */
-MPU6050::MPU6050(std::shared_ptr<I2C> sharedI2C) {
-    this->i2Cdev = new I2Cdev(sharedI2C);
+MPU6050::MPU6050(I2CBusManager& i2cBus) {
+    // Read at the sample rate, ahead of the slower devices on the bus
+    this->i2Cdev = new I2Cdev(i2cBus, "mpu6050", I2CBusManager::Priority::High);
     devAddr = MPU6050_DEFAULT_ADDRESS;
 }
 
@@ -68,8 +70,8 @@ MPU6050::MPU6050(std::shared_ptr<I2C> sharedI2C) {
  * @param i2c sda
  * @param i2c scl
  */
-MPU6050::MPU6050(std::shared_ptr<I2C> sharedI2C, uint8_t address) {
-    this->i2Cdev = new I2Cdev(sharedI2C);
+MPU6050::MPU6050(I2CBusManager& i2cBus, uint8_t address) {
+    this->i2Cdev = new I2Cdev(i2cBus, "mpu6050", I2CBusManager::Priority::High);
     devAddr = address;
 }
 
@@ -97,7 +99,7 @@ void MPU6050::initialize() {
  */
 bool MPU6050::testConnection() {
     uint8_t deviceId = getDeviceID();
-    printf("deviceID = %d\n", deviceId);
+    LOG_DEBUG("MPU6050: deviceID = %d", deviceId);
     return deviceId == 0x34;
 }
 
@@ -2852,7 +2854,9 @@ void MPU6050::setStandbyZGyroEnabled(bool enabled) {
  * @return Current FIFO buffer size
  */
 uint16_t MPU6050::getFIFOCount() {
-    i2Cdev->readBytes(devAddr, MPU6050_RA_FIFO_COUNTH, 2, buffer);
+    if (i2Cdev->readBytes(devAddr, MPU6050_RA_FIFO_COUNTH, 2, buffer) < 0) {
+        return 0;
+    }
     return (((uint16_t)buffer[0]) << 8) | buffer[1];
 }
 
@@ -2887,8 +2891,8 @@ uint8_t MPU6050::getFIFOByte() {
     i2Cdev->readByte(devAddr, MPU6050_RA_FIFO_R_W, buffer);
     return buffer[0];
 }
-void MPU6050::getFIFOBytes(uint8_t* data, uint8_t length) {
-    i2Cdev->readBytes(devAddr, MPU6050_RA_FIFO_R_W, length, data);
+bool MPU6050::getFIFOBytes(uint8_t* data, uint8_t length) {
+    return i2Cdev->readBytes(devAddr, MPU6050_RA_FIFO_R_W, length, data) == length;
 }
 /** Write byte to FIFO buffer.
  * @see getFIFOByte()
@@ -0,0 +1,95 @@
+#include "drivers/SPIBusManager.hpp"
+#include "delay.h"
+#include "Logger.hpp"
+
+#include <algorithm>
+
+SPIBusManager::SPIBusManager(LockedStruct<SPI>& sharedSPI)
+    : sharedSPI(sharedSPI) {}
+
+SPIBusManager::DeviceId SPIBusManager::addDevice(const Profile& profile) {
+    if (numDevices == kMaxDevices) {
+        // Still works, it just takes the last device's profile
+        LOG_ERROR("SPI: No room for device %s, raise kMaxDevices", profile.name);
+        return kMaxDevices - 1;
+    }
+
+    if (profile.cs != nullptr) {
+        profile.cs->write(1);
+    }
+
+    devices[numDevices].profile = profile;
+    return numDevices++;
+}
+
+void SPIBusManager::setFrequency(DeviceId device, int hz) {
+    // Under the lock, so it can't change part way through a transfer
+    auto spiLock = sharedSPI.lock();
+    devices[device].profile.frequency = hz;
+}
+
+SPIBusManager::Transfer::Transfer(SPIBusManager& bus, DeviceId device, bool select)
+    : bus(bus), device(device), select(select), requested(DWT_GetTick()),
+      lock(bus.sharedSPI.lock()), acquired(DWT_GetTick()) {
+    Device& d = bus.devices[device];
+    if (bus.busFrequency != d.profile.frequency) {
+        lock->frequency(d.profile.frequency);
+        bus.busFrequency = d.profile.frequency;
+        d.clockChanges++;
+    }
+
+    if (select && d.profile.cs != nullptr) {
+        d.profile.cs->write(0);
+        if (d.profile.setupUs > 0) {
+            DWT_Delay(d.profile.setupUs);
+        }
+    }
+
+    const uint32_t wait = (acquired - requested) / DWT_SysTick_To_us();
+    d.transfers++;
+    d.contended += wait > kContendedUs ? 1 : 0;
+    d.totalWait += wait;
+    d.maxWait = std::max(d.maxWait, wait);
+}
+
+SPIBusManager::Transfer::~Transfer() {
+    Device& d = bus.devices[device];
+    if (select && d.profile.cs != nullptr) {
+        if (d.profile.holdUs > 0) {
+            DWT_Delay(d.profile.holdUs);
+        }
+        d.profile.cs->write(1);
+    }
+
+    d.busTime += (DWT_GetTick() - acquired) / DWT_SysTick_To_us();
+
+    // Still holding the bus, so only one transfer logs them
+    if (HAL_GetTick() - bus.statsStart >= kStatsPeriod) {
+        bus.logStats();
+    }
+}
+
+void SPIBusManager::logStats() {
+    const uint32_t now = HAL_GetTick();
+    const uint32_t elapsed = std::max<uint32_t>(now - statsStart, 1);
+
+    for (size_t i = 0; i < numDevices; i++) {
+        Device& device = devices[i];
+        const uint32_t averageWait = device.transfers == 0 ? 0 : device.totalWait / device.transfers;
+        // Bus time in us over elapsed time in ms is in tenths of a percent
+        const uint32_t utilization = device.busTime / elapsed;
+
+        LOG_INFO("SPI %s: %lu transfers, %lu contended, %lu clock changes",
+                 device.profile.name, device.transfers, device.contended, device.clockChanges);
+        LOG_INFO("  wait %lu us avg, %lu us max, bus busy %lu.%lu%%",
+                 averageWait, device.maxWait, utilization / 10, utilization % 10);
+
+        device.transfers = 0;
+        device.contended = 0;
+        device.totalWait = 0;
+        device.maxWait = 0;
+        device.busTime = 0;
+        device.clockChanges = 0;
+    }
+    statsStart = now;
+}
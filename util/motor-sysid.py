@@ -0,0 +1,143 @@
+#!/usr/bin/env python3
+
+#
+# Fits the drive motor feed-forward gains in
+# robot/control/Src/motion-control/RobotController.cpp from recorded traces
+#
+# RobotController streams the following over the radio debug channel
+# every control tick:
+#   debug[10..13]  duty cycle sent to each wheel (% max * 1000)
+#   debug[9]       bus voltage the duty cycles were computed for (mV)
+#   debug[14..17]  measured wheel speed (rad/s * 100)
+#
+# Record a trace in soccer while driving the robot through a range of
+# accelerations and speeds (on the ground, not on a stand) and export it
+# as a csv with a `time` column in seconds and `debug_0` .. `debug_17`.
+#
+# The applied motor voltage is fit per tick as
+#   V = c_a * wheel_accel + c_w * wheel_speed + c_f * sign(wheel_speed)
+# and c_a / c_w are turned into the firmware's resistive and back-emf
+# gains using the same motor model the firmware uses.
+#
+# Example usage:
+# python3 util/motor-sysid.py trace1.csv trace2.csv --wheel-radius 0.02856 --speed-to-duty 2.9
+#
+
+import argparse
+import csv
+
+import numpy as np
+
+# Mirrors the constants in RobotController.cpp
+ROBOT_MASS = 6.35
+GEAR_RATIO = 3.0
+CURRENT_PER_TORQUE = 1.0 / 25.1e-3
+PHASE_RESISTANCE = 0.464
+NOMINAL_BUS_VOLTAGE = 24.0
+NUM_WHEELS = 4
+
+
+def load_trace(path):
+    with open(path, newline='') as f:
+        reader = csv.DictReader(f)
+        rows = list(reader)
+
+    if not rows:
+        print("No samples in " + path)
+        exit(-1)
+
+    try:
+        time = np.array([float(r['time']) for r in rows])
+        debug = np.array([[float(r['debug_' + str(i)]) for i in range(18)] for r in rows])
+    except KeyError as e:
+        print(path + " is missing column " + str(e))
+        exit(-1)
+
+    duty = debug[:, 10:14] / 1000.0
+    bus = debug[:, 9] / 1000.0
+    speed = debug[:, 14:18] / 100.0
+
+    return time, duty, bus, speed
+
+
+def smooth(x, window):
+    if window <= 1:
+        return x
+    kernel = np.ones(window) / window
+    return np.apply_along_axis(lambda col: np.convolve(col, kernel, mode='same'), 0, x)
+
+
+def build_samples(path, window, max_duty):
+    time, duty, bus, speed = load_trace(path)
+
+    speed = smooth(speed, window)
+    accel = np.gradient(speed, time, axis=0)
+    voltage = duty * bus[:, None]
+
+    # Saturated outputs and missing battery readings say nothing about the motor
+    valid = (np.abs(duty) < max_duty) & (bus[:, None] > 1.0)
+
+    # Edge samples are distorted by the smoothing window, and the
+    # derivative next to them by extension
+    edge = window // 2 + 1
+    valid[:edge, :] = False
+    valid[-edge:, :] = False
+
+    return accel[valid], speed[valid], voltage[valid], valid
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Fit drive motor feed-forward gains from recorded traces")
+    parser.add_argument('traces', nargs='+', help="csv traces with time and debug_0..debug_17 columns")
+    parser.add_argument('--wheel-radius', type=float, required=True,
+                        help="RobotModel::WheelRadius from robocup-fshare (m)")
+    parser.add_argument('--speed-to-duty', type=float, required=True,
+                        help="RobotModel::SpeedToDutyCycle from robocup-fshare")
+    parser.add_argument('--window', type=int, default=5,
+                        help="moving average window applied to wheel speeds before differentiating (samples)")
+    parser.add_argument('--max-duty', type=float, default=0.95,
+                        help="discard samples at or above this duty cycle")
+    args = parser.parse_args()
+
+    accel, speed, voltage = [], [], []
+    for path in args.traces:
+        a, w, v, valid = build_samples(path, args.window, args.max_duty)
+        print(path + ": " + str(len(v)) + " usable wheel samples")
+        accel.append(a)
+        speed.append(w)
+        voltage.append(v)
+
+    accel = np.concatenate(accel)
+    speed = np.concatenate(speed)
+    voltage = np.concatenate(voltage)
+
+    if len(voltage) < 10:
+        print("Not enough usable samples to fit")
+        exit(-1)
+
+    A = np.column_stack([accel, speed, np.sign(speed)])
+    coeffs, _, _, _ = np.linalg.lstsq(A, voltage, rcond=None)
+    c_a, c_w, c_f = coeffs
+
+    residual = voltage - A @ coeffs
+    r_squared = 1.0 - np.sum(residual ** 2) / np.sum((voltage - np.mean(voltage)) ** 2)
+
+    # Firmware model: each wheel pushes a quarter of the robot's mass
+    model_volts_per_accel = ((ROBOT_MASS / NUM_WHEELS) * args.wheel_radius ** 2 / GEAR_RATIO *
+                             CURRENT_PER_TORQUE * PHASE_RESISTANCE)
+    model_volts_per_speed = args.speed_to_duty / 512.0 * NOMINAL_BUS_VOLTAGE
+
+    print("")
+    print("Fit: V = %.5f * accel + %.5f * speed + %.4f * sign(speed)" % (c_a, c_w, c_f))
+    print("R^2 = %.3f over %d samples" % (r_squared, len(voltage)))
+    print("")
+    print("constexpr float kResistiveVoltageGain = %.4f;" % (c_a / model_volts_per_accel))
+    print("constexpr float kBackEmfVoltageGain = %.4f;" % (c_w / model_volts_per_speed))
+
+    if abs(c_f) > 0.5:
+        print("")
+        print("Note: %.2f V of static friction isn't modeled in the firmware" % c_f)
+
+
+if __name__ == '__main__':
+    main()
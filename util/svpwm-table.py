@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+
+#
+# Generates fpga/src/SVPWM_Table.v, the space vector PWM waveform used for
+# sinusoidal commutation in fpga/src/BLDC/BLDC_Driver.v
+#
+# Space vector PWM is a sine on each phase with the midpoint of the largest
+# and smallest of the three phases subtracted from all of them. That doesn't
+# change the line to line voltages, but flattens the peaks so the phases
+# reach 15% further before clipping. The waveform is scaled to +/-1 here.
+#
+# The waveform has quarter wave symmetry, so only the first quarter is
+# stored. Entry i is the value at (i + 0.5) quarter / ENTRIES so the table
+# folds onto the other three quarters without an off by one.
+#
+# Example usage:
+# python3 util/svpwm-table.py > fpga/src/SVPWM_Table.v
+#
+
+import argparse
+import math
+
+# Must match SECTOR_ANGLE in BLDC_Driver.v, a quarter wave is 1.5 sectors
+SECTOR_ANGLE = 256
+ENTRIES = SECTOR_ANGLE * 3 // 2
+VALUE_WIDTH = 12
+
+
+def svpwm(angle):
+    phases = [math.cos(angle - k * 2.0 * math.pi / 3.0) for k in range(3)]
+    offset = (max(phases) + min(phases)) / 2.0
+    return (phases[0] - offset) * 2.0 / math.sqrt(3.0)
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Generate the SVPWM quarter wave lookup table")
+    parser.parse_args()
+
+    full_scale = (1 << VALUE_WIDTH) - 1
+    addr_width = (ENTRIES - 1).bit_length()
+
+    print("/*")
+    print("*  SVPWM_Table.v")
+    print("*")
+    print("*  Generated by util/svpwm-table.py, edit that instead.")
+    print("*")
+    print("*  The first quarter wave of one phase of the space vector PWM waveform, full")
+    print("*  scale is %d. The value is registered so it's inferred as a block ROM." % full_scale)
+    print("*")
+    print("*/")
+    print("")
+    print("`ifndef _SVPWM_TABLE_")
+    print("`define _SVPWM_TABLE_")
+    print("")
+    print("// SVPWM_Table module")
+    print("module SVPWM_Table ( clk, addr, value );")
+    print("")
+    print("input clk;")
+    print("input [%d:0] addr;" % (addr_width - 1))
+    print("output reg [%d:0] value = 0;" % (VALUE_WIDTH - 1))
+    print("")
+    print("always @( posedge clk ) begin : SVPWM_LOOKUP")
+    print("    case ( addr )")
+    for i in range(ENTRIES):
+        angle = (i + 0.5) * (math.pi / 2.0) / ENTRIES
+        value = int(round(svpwm(angle) * full_scale))
+        print("        %d'd%-3d : value <= %d'd%d;" % (addr_width, i, VALUE_WIDTH, value))
+    print("        default : value <= 0;")
+    print("    endcase")
+    print("end")
+    print("")
+    print("endmodule")
+    print("")
+    print("`endif")
+
+
+if __name__ == '__main__':
+    main()